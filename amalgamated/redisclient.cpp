@@ -4,6 +4,282 @@
  * License: MIT
  */
 
+#ifndef REDISCLIENT_REDISSCANNER_H
+#define REDISCLIENT_REDISSCANNER_H
+
+#include <stddef.h>
+
+// SSE2 is a part of x86-64, AVX2 is selected at runtime (GCC and clang only).
+#if !defined(REDIS_CLIENT_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#    define REDIS_CLIENT_HAS_SSE2
+#    include <emmintrin.h>
+#    if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#        define REDIS_CLIENT_HAS_AVX2
+#        include <immintrin.h>
+#    endif
+#endif
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Scanning kernels for RedisParser. Every function returns the length of
+// the leading run of valid bytes, so the first invalid byte (usually '\r')
+// is ptr[result] or result == size.
+//
+// scanSimpleString: bytes allowed in simple string and error replies
+//                   (printable ASCII, 0x20..0x7e).
+// scanInteger:      bytes allowed in integer, bulk size and array size
+//                   lines ('0'..'9' and '-').
+
+typedef size_t (*ScanFunction)(const char *ptr, size_t size);
+
+inline bool isSimpleStringChar(char c)
+{
+    return c >= 0x20 && c < 0x7f;
+}
+
+inline bool isIntegerChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-';
+}
+
+inline unsigned countTrailingZeros(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline size_t scanSimpleStringScalar(const char *ptr, size_t size)
+{
+    size_t i = 0;
+
+    while( i < size && isSimpleStringChar(ptr[i]) )
+        ++i;
+
+    return i;
+}
+
+inline size_t scanIntegerScalar(const char *ptr, size_t size)
+{
+    size_t i = 0;
+
+    while( i < size && isIntegerChar(ptr[i]) )
+        ++i;
+
+    return i;
+}
+
+#ifdef REDIS_CLIENT_HAS_SSE2
+
+inline size_t scanSimpleStringSse2(const char *ptr, size_t size)
+{
+    // signed compare: bytes >= 0x80 are negative and fail the lower bound
+    const __m128i lower = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + i));
+        __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, del),
+                                         _mm_cmpgt_epi8(chunk, lower));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(valid)) ^ 0xffffu;
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanSimpleStringScalar(ptr + i, size - i);
+}
+
+inline size_t scanIntegerSse2(const char *ptr, size_t size)
+{
+    const __m128i beforeZero = _mm_set1_epi8('0' - 1);
+    const __m128i afterNine = _mm_set1_epi8('9' + 1);
+    const __m128i minus = _mm_set1_epi8('-');
+    size_t i = 0;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + i));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, beforeZero),
+                                      _mm_cmplt_epi8(chunk, afterNine));
+        __m128i valid = _mm_or_si128(digit, _mm_cmpeq_epi8(chunk, minus));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(valid)) ^ 0xffffu;
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanIntegerScalar(ptr + i, size - i);
+}
+
+#endif // REDIS_CLIENT_HAS_SSE2
+
+#ifdef REDIS_CLIENT_HAS_AVX2
+
+__attribute__((target("avx2")))
+inline size_t scanSimpleStringAvx2(const char *ptr, size_t size)
+{
+    const __m256i lower = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + i));
+        __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, del),
+                                            _mm256_cmpgt_epi8(chunk, lower));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(valid));
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanSimpleStringSse2(ptr + i, size - i);
+}
+
+__attribute__((target("avx2")))
+inline size_t scanIntegerAvx2(const char *ptr, size_t size)
+{
+    const __m256i beforeZero = _mm256_set1_epi8('0' - 1);
+    const __m256i nine = _mm256_set1_epi8('9');
+    const __m256i minus = _mm256_set1_epi8('-');
+    size_t i = 0;
+
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + i));
+        __m256i digit = _mm256_andnot_si256(_mm256_cmpgt_epi8(chunk, nine),
+                                            _mm256_cmpgt_epi8(chunk, beforeZero));
+        __m256i valid = _mm256_or_si256(digit, _mm256_cmpeq_epi8(chunk, minus));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(valid));
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanIntegerSse2(ptr + i, size - i);
+}
+
+inline bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // REDIS_CLIENT_HAS_AVX2
+
+inline ScanFunction selectScanSimpleString()
+{
+#if defined(REDIS_CLIENT_HAS_AVX2)
+    return cpuHasAvx2() ? &scanSimpleStringAvx2 : &scanSimpleStringSse2;
+#elif defined(REDIS_CLIENT_HAS_SSE2)
+    return &scanSimpleStringSse2;
+#else
+    return &scanSimpleStringScalar;
+#endif
+}
+
+inline ScanFunction selectScanInteger()
+{
+#if defined(REDIS_CLIENT_HAS_AVX2)
+    return cpuHasAvx2() ? &scanIntegerAvx2 : &scanIntegerSse2;
+#elif defined(REDIS_CLIENT_HAS_SSE2)
+    return &scanIntegerSse2;
+#else
+    return &scanIntegerScalar;
+#endif
+}
+
+// Most lines are short (+OK, :123, *2), so the first 16 bytes are checked
+// inline and the vector code is called only for longer runs.
+static const size_t scanInlineBytes = 16;
+
+inline size_t scanSimpleString(const char *ptr, size_t size)
+{
+    size_t head = size < scanInlineBytes ? size : scanInlineBytes;
+    size_t i = scanSimpleStringScalar(ptr, head);
+
+    if( i < head )
+        return i;
+
+    static const ScanFunction scan = selectScanSimpleString();
+    return i + scan(ptr + i, size - i);
+}
+
+inline size_t scanInteger(const char *ptr, size_t size)
+{
+    size_t head = size < scanInlineBytes ? size : scanInlineBytes;
+    size_t i = scanIntegerScalar(ptr, head);
+
+    if( i < head )
+        return i;
+
+    static const ScanFunction scan = selectScanInteger();
+    return i + scan(ptr + i, size - i);
+}
+
+}
+
+}
+
+#endif // REDISCLIENT_REDISSCANNER_H
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_CLUSTERPIPELINE_CPP
+#define REDISCLIENT_CLUSTERPIPELINE_CPP
+
+
+
+
+
+namespace redisclient
+{
+
+ClusterPipeline::ClusterPipeline(RedisClusterClient &client)
+    : client(client)
+{
+}
+
+ClusterPipeline &ClusterPipeline::command(std::string cmd, RedisArguments args)
+{
+    args.push_front(std::move(cmd));
+    commands.push_back(std::move(args));
+    return *this;
+}
+
+void ClusterPipeline::finish(std::function<void(RedisValue)> handler)
+{
+    std::vector<RedisArguments> items;
+
+    items.swap(commands);
+    client.pipelinedArguments(std::move(items), std::move(handler));
+}
+
+}
+
+#endif // REDISCLIENT_CLUSTERPIPELINE_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
 #ifndef REDISCLIENT_PIPELINE_CPP
 #define REDISCLIENT_PIPELINE_CPP
 
@@ -19,7 +295,7 @@ Pipeline::Pipeline(RedisSyncClient &client)
 {
 }
 
-Pipeline &Pipeline::command(std::string cmd, std::deque<RedisBuffer> args)
+Pipeline &Pipeline::command(std::string cmd, RedisArguments args)
 {
     args.push_front(std::move(cmd));
     commands.push_back(std::move(args));
@@ -28,12 +304,20 @@ Pipeline &Pipeline::command(std::string cmd, std::deque<RedisBuffer> args)
 
 RedisValue Pipeline::finish()
 {
-    return client.pipelined(std::move(commands));
+    boost::system::error_code ec;
+    RedisValue result = client.pipelinedArguments(commands, ec);
+
+    commands.clear();
+    detail::throwIfError(ec);
+    return result;
 }
 
 RedisValue Pipeline::finish(boost::system::error_code &ec)
 {
-    return client.pipelined(std::move(commands), ec);
+    RedisValue result = client.pipelinedArguments(commands, ec);
+
+    commands.clear();
+    return result;
 }
 
 }
@@ -44,9 +328,102 @@ RedisValue Pipeline::finish(boost::system::error_code &ec)
  * License: MIT
  */
 
+#ifndef REDISCLIENT_REDISARENA_CPP
+#define REDISCLIENT_REDISARENA_CPP
+
+#include <stdint.h>
+
+
+
+namespace redisclient {
+
+RedisArena::RedisArena(size_t blockSize)
+    : blockSize(blockSize), current(nullptr), available(0)
+{
+}
+
+RedisArena::~RedisArena()
+{
+    for(void *block: blocks)
+    {
+        ::operator delete(block);
+    }
+
+    for(void *block: largeBlocks)
+    {
+        ::operator delete(block);
+    }
+}
+
+void *RedisArena::allocate(size_t size, size_t alignment)
+{
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(current) % alignment) % alignment;
+
+    if( padding + size > available )
+    {
+        if( size > blockSize / 2 )
+        {
+            // Big arrays get a block of their own, the current block
+            // is still used for the small allocations.
+            void *block = ::operator new(size);
+
+            largeBlocks.push_back(block);
+            return block;
+        }
+
+        current = static_cast<char *>(::operator new(blockSize));
+        available = blockSize;
+        blocks.push_back(current);
+        padding = 0;
+    }
+
+    void *result = current + padding;
+
+    current += padding + size;
+    available -= padding + size;
+
+    return result;
+}
+
+void RedisArena::release()
+{
+    for(void *block: largeBlocks)
+    {
+        ::operator delete(block);
+    }
+
+    largeBlocks.clear();
+
+    if( blocks.empty() == false )
+    {
+        for(size_t i = 1; i < blocks.size(); ++i)
+        {
+            ::operator delete(blocks[i]);
+        }
+
+        blocks.resize(1);
+        current = static_cast<char *>(blocks.front());
+        available = blockSize;
+    }
+}
+
+size_t RedisArena::blockCount() const
+{
+    return blocks.size() + largeBlocks.size();
+}
+
+}
+
+#endif // REDISCLIENT_REDISARENA_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
 #ifndef REDISASYNCCLIENT_REDISASYNCCLIENT_CPP
 #define REDISASYNCCLIENT_REDISASYNCCLIENT_CPP
 
+#include <algorithm>
 #include <memory>
 #include <functional>
 
@@ -72,6 +449,7 @@ void RedisAsyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
     if( pimpl->state == State::Closed )
     {
         pimpl->redisParser = RedisParser();
+        pimpl->replyInProgress = false;
         std::move(pimpl->socket);
     }
 
@@ -116,8 +494,9 @@ void RedisAsyncClient::connect(const boost::asio::local::stream_protocol::endpoi
 
 bool RedisAsyncClient::isConnected() const
 {
-    return pimpl->getState() == State::Connected ||
-            pimpl->getState() == State::Subscribed;
+    State state = pimpl->getState();
+
+    return state == State::Connected || state == State::Subscribed;
 }
 
 void RedisAsyncClient::disconnect()
@@ -130,15 +509,110 @@ void RedisAsyncClient::installErrorHandler(std::function<void(const std::string
     pimpl->errorHandler = std::move(handler);
 }
 
-void RedisAsyncClient::command(const std::string &cmd, std::deque<RedisBuffer> args,
+void RedisAsyncClient::setMaxReadBufferSize(size_t size)
+{
+    pimpl->setMaxReadBufferSize(size);
+}
+
+void RedisAsyncClient::setMaxWriteBufferSize(size_t size)
+{
+    pimpl->setMaxWriteBufferSize(size);
+}
+
+size_t RedisAsyncClient::queueDepth() const
+{
+    return pimpl->outstanding.load(std::memory_order_relaxed);
+}
+
+void RedisAsyncClient::cork(size_t maxCommands, size_t maxBytes,
+        const boost::posix_time::time_duration &maxDelay)
+{
+    pimpl->post(std::bind(&RedisClientImpl::cork, pimpl,
+                maxCommands, maxBytes, maxDelay));
+}
+
+void RedisAsyncClient::uncork()
+{
+    pimpl->post(std::bind(&RedisClientImpl::uncork, pimpl));
+}
+
+void RedisAsyncClient::flush()
+{
+    pimpl->post(std::bind(&RedisClientImpl::flush, pimpl));
+}
+
+void RedisAsyncClient::command(const std::string &cmd, RedisArguments args,
                           std::function<void(RedisValue)> handler)
 {
     if(stateValid())
     {
         args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        pimpl->submit(args, std::move(handler));
+    }
+}
+
+void RedisAsyncClient::commandStream(const std::string &cmd, RedisArguments args,
+                                     size_t chunkSize,
+                                     std::function<void(std::vector<RedisValue>)> chunkHandler,
+                                     std::function<void(RedisValue)> handler)
+{
+    if(stateValid())
+    {
+        args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        chunkSize = std::max<size_t>(chunkSize, 1);
+
+        std::shared_ptr<std::vector<RedisValue>> chunk =
+            std::make_shared<std::vector<RedisValue>>();
+
+        chunk->reserve(chunkSize);
+
+        auto elementHandler = [chunk, chunkSize, chunkHandler](RedisValue value) {
+            chunk->push_back(std::move(value));
+
+            if( chunk->size() >= chunkSize )
+            {
+                std::vector<RedisValue> ready;
+
+                ready.reserve(chunkSize);
+                ready.swap(*chunk);
+                chunkHandler(std::move(ready));
+            }
+        };
+
+        auto replyHandler = [chunk, chunkHandler, handler](RedisValue value) {
+            if( chunk->empty() == false )
+            {
+                chunkHandler(std::move(*chunk));
+                chunk->clear();
+            }
+
+            handler(std::move(value));
+        };
+
+        RedisClientImpl::ReplyHandler replyHandlers{std::move(replyHandler),
+            std::move(elementHandler), nullptr};
+
+        pimpl->submit(args, std::move(replyHandlers));
+    }
+}
+
+void RedisAsyncClient::commandToSink(const std::string &cmd, RedisArguments args,
+                                     std::function<void(const char *, size_t)> sink,
+                                     std::function<void(RedisValue)> handler)
+{
+    if(stateValid())
+    {
+        args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        RedisClientImpl::ReplyHandler replyHandlers{std::move(handler),
+            nullptr, std::move(sink)};
 
-        pimpl->post(std::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(args), std::move(handler)));
+        pimpl->submit(args, std::move(replyHandlers));
     }
 }
 
@@ -193,14 +667,10 @@ void RedisAsyncClient::publish(const std::string &channel, const RedisBuffer &ms
 
     if( pimpl->state == State::Connected )
     {
-        std::deque<RedisBuffer> items(3);
+        RedisArguments items{publishStr, channel, msg};
+        detail::copyRefs(items);
 
-        items[0] = publishStr;
-        items[1] = channel;
-        items[2] = msg;
-
-        pimpl->post(std::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), std::move(handler)));
+        pimpl->submit(items, std::move(handler));
     }
     else
     {
@@ -248,209 +718,268 @@ bool RedisAsyncClient::stateValid() const
 #define REDISCLIENT_REDISCLIENTIMPL_CPP
 
 #include <boost/asio/write.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
+
+#include <sys/uio.h>
+
 
 
 
 namespace
 {
-    static const char crlf[] = {'\r', '\n'};
-    inline void bufferAppend(std::vector<char> &vec, const std::string &s);
-    inline void bufferAppend(std::vector<char> &vec, const std::vector<char> &s);
-    inline void bufferAppend(std::vector<char> &vec, const char *s);
-    inline void bufferAppend(std::vector<char> &vec, char c);
-    template<size_t size>
-    inline void bufferAppend(std::vector<char> &vec, const char (&s)[size]);
+    // Bounds of the read buffer (see RedisClientImpl::prepareReadBuffer).
+    const size_t minReadBufferSize = 4096;
+    const size_t defaultMaxReadBufferSize = 1024 * 1024;
+
+    // The read buffer shrinks by half after this number of consecutive
+    // reads which filled less than a quarter of it.
+    const size_t smallReadsToShrink = 8;
+
+    // Default limit of the async output buffer.
+    const size_t defaultMaxWriteBufferSize = 1024 * 1024;
+
+    // Limit of buffers in one sendmsg call.
+#ifdef IOV_MAX
+    const size_t maxIovecs = IOV_MAX;
+#else
+    const size_t maxIovecs = 1024;
+#endif
 
-    inline void bufferAppend(std::vector<char> &vec, const redisclient::RedisBuffer &buf)
-    {
-        if (buf.data.type() == typeid(std::string))
-            bufferAppend(vec, boost::get<std::string>(buf.data));
-        else
-            bufferAppend(vec, boost::get<std::vector<char>>(buf.data));
-    }
+    typedef redisclient::RedisClientImpl::Deadline Deadline;
 
-    inline void bufferAppend(std::vector<char> &vec, const std::string &s)
+    // Milliseconds left until the deadline, rounded up, so poll does not
+    // wake up just before the deadline.
+    int remainingMsec(const Deadline &deadline)
     {
-        vec.insert(vec.end(), s.begin(), s.end());
-    }
+        Deadline now = std::chrono::steady_clock::now();
 
-    inline void bufferAppend(std::vector<char> &vec, const std::vector<char> &s)
-    {
-        vec.insert(vec.end(), s.begin(), s.end());
-    }
+        if (now >= deadline)
+            return 0;
 
-    inline void bufferAppend(std::vector<char> &vec, const char *s)
-    {
-        vec.insert(vec.end(), s, s + strlen(s));
-    }
+        std::chrono::milliseconds::rep msec = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - now + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
 
-    inline void bufferAppend(std::vector<char> &vec, char c)
-    {
-        vec.resize(vec.size() + 1);
-        vec[vec.size() - 1] = c;
+        return static_cast<int>(std::min<std::chrono::milliseconds::rep>(msec, INT_MAX));
     }
 
-    template<size_t size>
-    inline void bufferAppend(std::vector<char> &vec, const char (&s)[size])
+    // Wait until the socket is ready for the events. The socket is polled
+    // only after a non-blocking recv/send would block, so the usual
+    // request/response takes one syscall for each direction.
+    bool socketWait(int socket, short events, const Deadline &deadline,
+            boost::system::error_code &ec)
     {
-        vec.insert(vec.end(), s, s + size);
-    }
+        pollfd pfd;
 
-    ssize_t socketReadSomeImpl(int socket, char *buffer, size_t size,
-            size_t timeoutMsec)
-    {
-        struct timeval tv = {static_cast<time_t>(timeoutMsec / 1000),
-            static_cast<__suseconds_t>((timeoutMsec % 1000) * 1000)};
-        int result = setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        pfd.fd = socket;
+        pfd.events = events;
 
-        if (result != 0)
+        for(;;)
         {
-            return result;
-        }
-
-        pollfd pfd;
+            int result = ::poll(&pfd, 1, remainingMsec(deadline));
 
-        pfd.fd = socket;
-        pfd.events = POLLIN;
+            if (result > 0)
+            {
+                return true;
+            }
+            else if (result == 0)
+            {
+                // poll waits INT_MAX msec at most
+                if (std::chrono::steady_clock::now() < deadline)
+                    continue;
 
-        result = ::poll(&pfd, 1, timeoutMsec);
-        if (result > 0)
-        {
-            return recv(socket, buffer, size, MSG_DONTWAIT);
-        }
-        else
-        {
-            return result;
+                ec = boost::asio::error::timed_out;
+                return false;
+            }
+            else if (errno != EINTR)
+            {
+                ec = boost::system::error_code(errno,
+                        boost::asio::error::get_system_category());
+                return false;
+            }
         }
     }
 
-    size_t socketReadSome(int socket, boost::asio::mutable_buffer buffer,
-            const boost::posix_time::time_duration &timeout,
+    // Read what is available without waiting. Returns 0 if there is no
+    // data, ec is set on errors.
+    size_t socketTryReadSome(int socket, boost::asio::mutable_buffer buffer,
             boost::system::error_code &ec)
     {
-        size_t bytesRecv = 0;
-        size_t timeoutMsec = timeout.total_milliseconds();
-
         for(;;)
         {
-            ssize_t result = socketReadSomeImpl(socket,
-                    boost::asio::buffer_cast<char *>(buffer) + bytesRecv,
-                    boost::asio::buffer_size(buffer) - bytesRecv, timeoutMsec);
+            ssize_t result = recv(socket, boost::asio::buffer_cast<char *>(buffer),
+                    boost::asio::buffer_size(buffer), MSG_DONTWAIT);
 
-            if (result < 0)
+            if (result > 0)
             {
-                if (errno == EINTR)
-                {
-                    continue;
-                }
-                else
-                {
-                    ec = boost::system::error_code(errno,
-                            boost::asio::error::get_system_category());
-                    break;
-                }
+                return result;
             }
             else if (result == 0)
             {
-                // boost::asio::error::connection_reset();
-                // boost::asio::error::eof
                 ec = boost::asio::error::eof;
-                break;
+                return 0;
             }
-            else
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
             {
-                bytesRecv += result;
-                break;
+                return 0;
+            }
+            else if (errno != EINTR)
+            {
+                ec = boost::system::error_code(errno,
+                        boost::asio::error::get_system_category());
+                return 0;
             }
         }
-
-        return bytesRecv;
     }
 
-
-    ssize_t socketWriteImpl(int socket, const char *buffer, size_t size,
-            size_t timeoutMsec)
+    size_t socketReadSome(int socket, boost::asio::mutable_buffer buffer,
+            const Deadline &deadline,
+            boost::system::error_code &ec)
     {
-        struct timeval tv = {static_cast<time_t>(timeoutMsec / 1000),
-            static_cast<__suseconds_t>((timeoutMsec % 1000) * 1000)};
-        int result = setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-        if (result != 0)
+        for(;;)
         {
-            return result;
+            size_t result = socketTryReadSome(socket, buffer, ec);
+
+            if (result > 0 || ec)
+                return result;
+            if (!socketWait(socket, POLLIN, deadline, ec))
+                return 0;
         }
+    }
 
-        pollfd pfd;
+    // Gather list written with sendmsg, IOV_MAX buffers at a time.
+    class GatherWriter
+    {
+    public:
+        explicit GatherWriter(const std::vector<boost::asio::const_buffer> &buffers)
+            : first(0)
+        {
+            iov.reserve(buffers.size());
 
-        pfd.fd = socket;
-        pfd.events = POLLOUT;
+            for(const auto &buffer: buffers)
+            {
+                if (boost::asio::buffer_size(buffer) > 0)
+                {
+                    iovec item;
 
-        result = ::poll(&pfd, 1, timeoutMsec);
-        if (result > 0)
-        {
-            return send(socket, buffer, size, 0);
+                    item.iov_base = const_cast<char *>(boost::asio::buffer_cast<const char *>(buffer));
+                    item.iov_len = boost::asio::buffer_size(buffer);
+                    iov.push_back(item);
+                }
+            }
         }
-        else
+
+        bool done() const
         {
-            return result;
+            return first == iov.size();
         }
-    }
-
-    size_t socketWrite(int socket, boost::asio::const_buffer buffer,
-            const boost::posix_time::time_duration &timeout,
-            boost::system::error_code &ec)
-    {
-        size_t bytesSend = 0;
-        size_t timeoutMsec = timeout.total_milliseconds();
 
-        while(bytesSend < boost::asio::buffer_size(buffer))
+        // Write as much as the socket takes without waiting. Returns false
+        // if nothing was written, ec is set on errors.
+        bool writeSome(int socket, boost::system::error_code &ec)
         {
-            ssize_t result = socketWriteImpl(socket,
-                    boost::asio::buffer_cast<const char *>(buffer) + bytesSend,
-                    boost::asio::buffer_size(buffer) - bytesSend, timeoutMsec);
-
-            if (result < 0)
+            for(;;)
             {
-                if (errno == EINTR)
+                msghdr msg = msghdr();
+
+                msg.msg_iov = iov.data() + first;
+                msg.msg_iovlen = std::min(iov.size() - first, maxIovecs);
+
+                ssize_t result = sendmsg(socket, &msg, MSG_DONTWAIT);
+
+                if (result > 0)
                 {
-                    continue;
+                    skip(result);
+                    return true;
                 }
-                else
+                else if (result == 0)
+                {
+                    ec = boost::asio::error::eof;
+                    return false;
+                }
+                else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    return false;
+                }
+                else if (errno != EINTR)
                 {
                     ec = boost::system::error_code(errno,
                             boost::asio::error::get_system_category());
-                    break;
+                    return false;
                 }
             }
-            else if (result == 0)
+        }
+
+    private:
+        // skip the written buffers and the written part of the last one
+        void skip(size_t written)
+        {
+            while(first < iov.size() && written >= iov[first].iov_len)
             {
-                    // boost::asio::error::connection_reset();
-                    // boost::asio::error::eof
-                    ec = boost::asio::error::eof;
-                    break;
+                written -= iov[first].iov_len;
+                ++first;
             }
-            else
+
+            if (written > 0)
             {
-                bytesSend += result;
+                iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + written;
+                iov[first].iov_len -= written;
             }
         }
 
-        return bytesSend;
+        std::vector<iovec> iov;
+        size_t first;
+    };
+
+    void socketWrite(int socket, const std::vector<boost::asio::const_buffer> &buffers,
+            const Deadline &deadline,
+            boost::system::error_code &ec)
+    {
+        GatherWriter writer(buffers);
+
+        while(!writer.done())
+        {
+            if (!writer.writeSome(socket, ec) &&
+                    (ec || !socketWait(socket, POLLOUT, deadline, ec)))
+                break;
+        }
     }
 
-    size_t socketWrite(int socket, const std::vector<boost::asio::const_buffer> &buffers,
-            const boost::posix_time::time_duration &timeout,
+    size_t socketWrite(int socket, boost::asio::const_buffer buffer,
+            const Deadline &deadline,
             boost::system::error_code &ec)
     {
         size_t bytesSend = 0;
-        for(const auto &buffer: buffers)
+
+        while(bytesSend < boost::asio::buffer_size(buffer))
         {
-            bytesSend += socketWrite(socket, buffer, timeout, ec);
+            ssize_t result = send(socket,
+                    boost::asio::buffer_cast<const char *>(buffer) + bytesSend,
+                    boost::asio::buffer_size(buffer) - bytesSend, MSG_DONTWAIT);
 
-            if (ec)
+            if (result > 0)
+            {
+                bytesSend += result;
+            }
+            else if (result == 0)
+            {
+                ec = boost::asio::error::eof;
+                break;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (!socketWait(socket, POLLOUT, deadline, ec))
+                    break;
+            }
+            else if (errno != EINTR)
+            {
+                ec = boost::system::error_code(errno,
+                        boost::asio::error::get_system_category());
                 break;
+            }
         }
 
         return bytesSend;
@@ -461,7 +990,14 @@ namespace redisclient {
 
 RedisClientImpl::RedisClientImpl(boost::asio::io_service &ioService_)
     : ioService(ioService_), strand(ioService), socket(ioService),
-    bufSize(0),subscribeSeq(0), state(State::Unconnected)
+    buf(minReadBufferSize), bufPos(0), bufSize(0), lastReadSize(0), smallReads(0),
+    maxReadBufferSize(defaultMaxReadBufferSize),
+    subscribeSeq(0), replyInProgress(false),
+    maxWriteBufferSize(defaultMaxWriteBufferSize), writeInProgress(false),
+    corked(false), corkCommands(0), corkBytes(0), queuedCommands(0), queuedBytes(0),
+    flushScheduled(false), flushRequested(false), flushTimer(ioService), flushGeneration(0),
+    outstanding(0),
+    state(State::Unconnected)
 {
 }
 
@@ -475,8 +1011,24 @@ void RedisClientImpl::close() noexcept
     boost::system::error_code ignored_ec;
 
     msgHandlers.clear();
-    decltype(handlers)().swap(handlers);
-
+    outstanding.fetch_sub(handlers.size(), std::memory_order_relaxed);
+    handlers.clear();
+
+    // the commands not written yet would go to the next connection, with
+    // their handlers dropped their replies would go to the next commands
+    outputQueued.data.clear();
+    outputQueued.splices.clear();
+    outputQueued.args.clear();
+    dataQueued.clear();
+    queuedCommands = 0;
+    queuedBytes = 0;
+
+    // nor is a reply cut by the close continued there
+    redisParser = RedisParser();
+    replyInProgress = false;
+
+    cancelFlush();
+    flushRequested = false;
     socket.cancel(ignored_ec);
     socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     socket.close(ignored_ec);
@@ -489,11 +1041,66 @@ RedisClientImpl::State RedisClientImpl::getState() const
     return state;
 }
 
+void RedisClientImpl::setMaxReadBufferSize(size_t size)
+{
+    maxReadBufferSize = std::max(size, minReadBufferSize);
+}
+
+void RedisClientImpl::setMaxWriteBufferSize(size_t size)
+{
+    maxWriteBufferSize = size;
+}
+
+// Resize the read buffer before the next read. The buffer doubles after a
+// read which filled it and grows to fit the rest of a big bulk string, so
+// big replies take a few large reads instead of many 4 KiB ones. It shrinks
+// back after a series of small reads. Must be called only when the buffer
+// holds no unparsed data. lastReadSize is the size of the read since the
+// last call, 0 if there was none.
+void RedisClientImpl::prepareReadBuffer()
+{
+    size_t size = buf.size();
+
+    if( lastReadSize == 0 )
+    {
+        // no read since the last call
+    }
+    else if( lastReadSize == size )
+    {
+        smallReads = 0;
+        size *= 2;
+    }
+    else if( lastReadSize < size / 4 && size > minReadBufferSize )
+    {
+        if( ++smallReads >= smallReadsToShrink )
+        {
+            smallReads = 0;
+            size /= 2;
+        }
+    }
+    else
+    {
+        smallReads = 0;
+    }
+
+    lastReadSize = 0;
+    size = std::max(size, redisParser.pendingBulkSize());
+    size = std::max(std::min(size, maxReadBufferSize), minReadBufferSize);
+
+    if( size != buf.size() )
+    {
+        // the content is not needed, do not copy it
+        std::vector<char>(size).swap(buf);
+    }
+}
+
 void RedisClientImpl::processMessage()
 {
+    prepareReadBuffer();
     socket.async_read_some(boost::asio::buffer(buf),
-                           std::bind(&RedisClientImpl::asyncRead,
-                                       shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+                           detail::makeAllocatingHandler(readMemory,
+                               std::bind(&RedisClientImpl::asyncRead,
+                                   shared_from_this(), std::placeholders::_1, std::placeholders::_2)));
 }
 
 void RedisClientImpl::doProcessMessage(RedisValue v)
@@ -534,8 +1141,11 @@ void RedisClientImpl::doProcessMessage(RedisValue v)
                     cmd == "psubscribe" || cmd == "punsubscribe")
                    )
             {
-                handlers.front()(std::move(v));
+                detail::ReplyCallback handler = std::move(handlers.front().handler);
+
                 handlers.pop();
+                outstanding.fetch_sub(1, std::memory_order_relaxed);
+                handler(std::move(v));
             }
             else
             {
@@ -559,8 +1169,12 @@ void RedisClientImpl::doProcessMessage(RedisValue v)
     {
         if( handlers.empty() == false )
         {
-            handlers.front()(std::move(v));
+            // the slot may be reused by a command sent from the handler
+            detail::ReplyCallback handler = std::move(handlers.front().handler);
+
             handlers.pop();
+            outstanding.fetch_sub(1, std::memory_order_relaxed);
+            handler(std::move(v));
         }
         else
         {
@@ -577,29 +1191,157 @@ void RedisClientImpl::doProcessMessage(RedisValue v)
 
 void RedisClientImpl::asyncWrite(const boost::system::error_code &ec, size_t)
 {
+    writeInProgress = false;
     dataWrited.clear();
 
+    // keep the buffer for the next write unless it was over the limit
+    if( outputWrited.data.capacity() > maxWriteBufferSize )
+        std::vector<char>().swap(outputWrited.data);
+    else
+        outputWrited.data.clear();
+
+    outputWrited.splices.clear();
+    outputWrited.args.clear();
+
     if( ec )
     {
-        errorHandler(ec.message());
+        // the write is cancelled by close
+        if( ec != boost::asio::error::operation_aborted )
+        {
+            errorHandler(ec.message());
+        }
+        return;
+    }
+
+    writeQueued(flushRequested);
+}
+
+void RedisClientImpl::writeQueued(bool force)
+{
+    if( writeInProgress )
+    {
+        return;
+    }
+    else if( outputQueued.data.empty() && dataQueued.empty() )
+    {
+        // a flush of nothing does not apply to the next commands
+        flushRequested = false;
         return;
     }
 
-    if( dataQueued.empty() == false )
+    if( !corked || force || queuedCommands >= corkCommands || queuedBytes >= corkBytes )
     {
-        std::vector<boost::asio::const_buffer> buffers(dataQueued.size());
+        startWrite();
+    }
+    else if( !flushScheduled )
+    {
+        flushScheduled = true;
 
-        for(size_t i = 0; i < dataQueued.size(); ++i)
+        if( corkDelay.ticks() > 0 )
+        {
+            flushTimer.expires_from_now(corkDelay);
+            flushTimer.async_wait(std::bind(&RedisClientImpl::flushTimeout,
+                        shared_from_this(), std::placeholders::_1, flushGeneration));
+        }
+        else
         {
-            buffers[i] = boost::asio::buffer(dataQueued[i]);
+            // flush at the end of the current event loop turn
+            post(std::bind(&RedisClientImpl::flushTimeout,
+                        shared_from_this(), boost::system::error_code(), flushGeneration));
         }
+    }
+}
+
+void RedisClientImpl::startWrite()
+{
+    // the flush scheduled for these commands must not cut the next batch
+    cancelFlush();
+
+    outputQueued.swap(outputWrited);
+    dataQueued.swap(dataWrited);
+    writeInProgress = true;
+    flushRequested = false;
+    queuedCommands = 0;
+    queuedBytes = 0;
+
+    if( outputWrited.splices.empty() && dataWrited.empty() )
+    {
+        boost::asio::async_write(socket, boost::asio::buffer(outputWrited.data),
+                detail::makeAllocatingHandler(writeMemory,
+                    std::bind(&RedisClientImpl::asyncWrite, shared_from_this(),
+                        std::placeholders::_1, std::placeholders::_2)));
+    }
+    else
+    {
+        std::vector<boost::asio::const_buffer> buffers;
+
+        buffers.reserve(2 * outputWrited.splices.size() + 1 + dataWrited.size());
+        detail::gatherBuffers(outputWrited.data, outputWrited.splices, buffers);
 
-        std::swap(dataQueued, dataWrited);
+        for(const QueuedCommand &queued: dataWrited)
+        {
+            if( queued.splices.empty() )
+                buffers.push_back(boost::asio::buffer(queued.data));
+            else
+                detail::gatherBuffers(queued.data, queued.splices, buffers);
+        }
 
         boost::asio::async_write(socket, buffers,
-                std::bind(&RedisClientImpl::asyncWrite, shared_from_this(),
-                    std::placeholders::_1, std::placeholders::_2));
+                detail::makeAllocatingHandler(writeMemory,
+                    std::bind(&RedisClientImpl::asyncWrite, shared_from_this(),
+                        std::placeholders::_1, std::placeholders::_2)));
+    }
+}
+
+void RedisClientImpl::cork(size_t maxCommands, size_t maxBytes,
+        const boost::posix_time::time_duration &maxDelay)
+{
+    corked = true;
+    corkCommands = std::max<size_t>(maxCommands, 1);
+    corkBytes = std::max<size_t>(maxBytes, 1);
+    corkDelay = maxDelay;
+}
+
+void RedisClientImpl::uncork()
+{
+    corked = false;
+    flush();
+}
+
+void RedisClientImpl::flush()
+{
+    // commands submitted before the flush are sent by it
+    drainSubmissions();
+
+    if( writeInProgress )
+        flushRequested = true;
+    else
+        writeQueued(true);
+}
+
+void RedisClientImpl::cancelFlush()
+{
+    if( flushScheduled )
+    {
+        boost::system::error_code ignored_ec;
+
+        flushScheduled = false;
+        ++flushGeneration;
+        flushTimer.cancel(ignored_ec);
+    }
+}
+
+void RedisClientImpl::flushTimeout(const boost::system::error_code &ec,
+        size_t generation)
+{
+    if( ec == boost::asio::error::operation_aborted || generation != flushGeneration )
+    {
+        return;
     }
+
+    // no write has started since the flush was scheduled
+    flushScheduled = false;
+    writeQueued(true);
 }
 
 void RedisClientImpl::handleAsyncConnect(const boost::system::error_code &ec,
@@ -624,126 +1366,316 @@ std::vector<char> RedisClientImpl::makeCommand(const std::deque<RedisBuffer> &it
 {
     std::vector<char> result;
 
-    bufferAppend(result, '*');
-    bufferAppend(result, std::to_string(items.size()));
-    bufferAppend<>(result, crlf);
+    detail::appendCommand(result, items);
+    return result;
+}
+
+RedisClientImpl::Deadline RedisClientImpl::makeDeadline(
+        const boost::posix_time::time_duration &timeout)
+{
+    if( timeout.is_pos_infinity() )
+        return Deadline::max();
+
+    return std::chrono::steady_clock::now() +
+        std::chrono::microseconds(timeout.total_microseconds());
+}
 
-    for(const auto &item: items)
+void RedisClientImpl::syncWriteBuffer(const Deadline &deadline,
+        boost::system::error_code &ec)
+{
+    if( writeSplices.empty() )
     {
-        bufferAppend(result, '$');
-        bufferAppend(result, std::to_string(item.size()));
-        bufferAppend<>(result, crlf);
-        bufferAppend(result, item);
-        bufferAppend<>(result, crlf);
+        socketWrite(socket.native_handle(), boost::asio::buffer(writeBuffer), deadline, ec);
     }
+    else
+    {
+        std::vector<boost::asio::const_buffer> buffers;
 
-    return result;
+        detail::gatherBuffers(writeBuffer, writeSplices, buffers);
+        socketWrite(socket.native_handle(), buffers, deadline, ec);
+    }
+
+    resetWriteBuffer();
+}
+
+void RedisClientImpl::resetWriteBuffer()
+{
+    // keep the buffer for the next command unless a huge one was sent
+    static const size_t maxCapacity = 1024 * 1024;
+
+    if( writeBuffer.capacity() > maxCapacity )
+        std::vector<char>().swap(writeBuffer);
+    else
+        writeBuffer.clear();
+
+    writeSplices.clear();
+}
+
+RedisValue RedisClientImpl::doSyncCommand(const RedisArguments &command,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec)
+{
+    detail::appendCommand(writeBuffer, writeSplices, command);
+    return doSyncEncodedCommand(timeout, ec);
+}
+
+RedisValue RedisClientImpl::doSyncCommand(const boost::string_ref *items, size_t size,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec)
+{
+    detail::appendCommand(writeBuffer, writeSplices, boost::make_iterator_range(items, items + size));
+    return doSyncEncodedCommand(timeout, ec);
 }
-RedisValue RedisClientImpl::doSyncCommand(const std::deque<RedisBuffer> &command,
+
+RedisValue RedisClientImpl::doSyncEncodedCommand(
         const boost::posix_time::time_duration &timeout,
         boost::system::error_code &ec)
 {
-    std::vector<char> data = makeCommand(command);
-    socketWrite(socket.native_handle(), boost::asio::buffer(data), timeout, ec);
+    Deadline deadline = makeDeadline(timeout);
+    RedisValue result;
+
+    syncWriteBuffer(deadline, ec);
+
+    if( !ec )
+    {
+        result = syncReadResponse(deadline, ec);
+    }
 
     if( ec )
     {
-        return RedisValue();
+        // the reply may still come, the next command would read it
+        close();
     }
 
-    return syncReadResponse(timeout, ec);
+    return result;
 }
 
-RedisValue RedisClientImpl::doSyncCommand(const std::deque<std::deque<RedisBuffer>> &commands,
+RedisValue RedisClientImpl::doSyncCommand(const std::vector<RedisArguments> &commands,
         const boost::posix_time::time_duration &timeout,
         boost::system::error_code &ec)
 {
-    std::vector<std::vector<char>> data;
-    std::vector<boost::asio::const_buffer> buffers;
-
-    data.reserve(commands.size());
-    buffers.reserve(commands.size());
+    size_t size = 0;
 
     for(const auto &command: commands)
     {
-        data.push_back(makeCommand(command));
-        buffers.push_back(boost::asio::buffer(data.back()));
+        size += detail::commandSize(command, detail::spliceThreshold);
     }
 
-    socketWrite(socket.native_handle(), buffers, timeout, ec);
+    writeBuffer.reserve(size);
 
-    if( ec )
+    for(const auto &command: commands)
     {
-        return RedisValue();
+        detail::appendCommand(writeBuffer, writeSplices, command);
     }
 
+    // the timeout is for the whole pipeline
+    Deadline deadline = makeDeadline(timeout);
+    int fd = socket.native_handle();
+    std::vector<boost::asio::const_buffer> buffers;
     std::vector<RedisValue> responses;
+    RedisValue value;
 
-    for(size_t i = 0; i < commands.size(); ++i)
-    {
-        responses.push_back(syncReadResponse(timeout, ec));
+    if( writeSplices.empty() )
+        buffers.push_back(boost::asio::buffer(writeBuffer));
+    else
+        detail::gatherBuffers(writeBuffer, writeSplices, buffers);
 
-        if (ec)
-        {
-            return RedisValue();
-        }
-    }
+    responses.reserve(commands.size());
 
-    return RedisValue(std::move(responses));
-}
+    // Replies are read while the pipeline is written. Otherwise, when the
+    // pipeline is bigger than socket buffers, the server blocks writing
+    // replies and stops reading commands, while we block writing them.
+    GatherWriter writer(buffers);
 
-RedisValue RedisClientImpl::syncReadResponse(
-        const boost::posix_time::time_duration &timeout,
-        boost::system::error_code &ec)
-{
-    for(;;)
+    while( !writer.done() )
     {
-        if (bufSize == 0)
-        {
-            bufSize = socketReadSome(socket.native_handle(),
-                    boost::asio::buffer(buf), timeout, ec);
+        bool wrote = writer.writeSome(fd, ec);
 
-            if (ec)
-                return RedisValue();
-        }
+        if( ec )
+            break;
 
-        for(size_t pos = 0; pos < bufSize;)
-        {
-            std::pair<size_t, RedisParser::ParseResult> result =
-                redisParser.parse(buf.data() + pos, bufSize - pos);
+        while( syncParseResponse(value) )
+            responses.push_back(std::move(value));
 
-            pos += result.first;
+        bool read = syncRead(false, deadline, ec);
 
-            ::memmove(buf.data(), buf.data() + pos, bufSize - pos);
-            bufSize -= pos;
+        if( ec )
+            break;
 
-            if( result.second == RedisParser::Completed )
-            {
-                return redisParser.result();
-            }
-            else if( result.second == RedisParser::Incompleted )
-            {
-                continue;
-            }
-            else
-            {
-                errorHandler("[RedisClient] Parser error");
-                return RedisValue();
-            }
-        }
+        if( !wrote && !read && !socketWait(fd, POLLIN | POLLOUT, deadline, ec) )
+            break;
     }
+
+    resetWriteBuffer();
+
+    while( !ec && responses.size() < commands.size() )
+    {
+        responses.push_back(syncReadResponse(deadline, ec));
+    }
+
+    if( ec )
+    {
+        // the replies may still come, the next command would read them
+        close();
+        return RedisValue();
+    }
+
+    return RedisValue(std::move(responses));
 }
 
-void RedisClientImpl::doAsyncCommand(std::vector<char> buff,
-                                     std::function<void(RedisValue)> handler)
+RedisValue RedisClientImpl::syncReadResponse(
+        const Deadline &deadline,
+        boost::system::error_code &ec)
+{
+    RedisValue value;
+
+    while( !syncParseResponse(value) )
+    {
+        if( !syncRead(true, deadline, ec) )
+            return RedisValue();
+    }
+
+    return value;
+}
+
+bool RedisClientImpl::syncParseResponse(RedisValue &value)
+{
+    if( bufPos == bufSize )
+        return false;
+
+    // Parsed bytes are skipped, never moved. The parser keeps its state
+    // between chunks, so the buffer is read again only when all of it
+    // is consumed.
+    std::pair<size_t, RedisParser::ParseResult> result =
+        redisParser.parse(buf.data() + bufPos, bufSize - bufPos);
+
+    bufPos += result.first;
+
+    if( result.second == RedisParser::Completed )
+    {
+        value = redisParser.result();
+        return true;
+    }
+    else if( result.second == RedisParser::Error )
+    {
+        bufPos = bufSize = 0;
+        errorHandler("[RedisClient] Parser error");
+        value = RedisValue();
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool RedisClientImpl::syncRead(bool wait, const Deadline &deadline,
+        boost::system::error_code &ec)
+{
+    assert( bufPos == bufSize );
+
+    bufPos = bufSize = 0;
+    prepareReadBuffer();
+
+    if( wait )
+        bufSize = socketReadSome(socket.native_handle(), boost::asio::buffer(buf), deadline, ec);
+    else
+        bufSize = socketTryReadSome(socket.native_handle(), boost::asio::buffer(buf), ec);
+
+    if( bufSize > 0 )
+        lastReadSize = bufSize;
+
+    return bufSize > 0;
+}
+
+void RedisClientImpl::submit(RedisArguments &command, ReplyHandler handler)
+{
+    // nodes drained by any client come back to the threads submitting
+    static thread_local detail::NodeCache<Submission> cache;
+
+    Submission *submission = cache.pop(freeSubmissions);
+
+    if( submission )
+    {
+        submission->args = std::move(command);
+        submission->handler = std::move(handler);
+    }
+    else
+    {
+        submission = new Submission{nullptr, std::move(command), std::move(handler)};
+    }
+
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+
+    if( submissions.push(submission) )
+    {
+        post(detail::makeAllocatingHandler(drainMemory,
+                    std::bind(&RedisClientImpl::drainSubmissions, shared_from_this())));
+    }
+}
+
+void RedisClientImpl::submit(RedisArguments &command,
+                             std::function<void(RedisValue)> handler)
 {
-    handlers.push( std::move(handler) );
-    dataQueued.push_back(std::move(buff));
+    submit(command, ReplyHandler{std::move(handler), nullptr, nullptr});
+}
 
-    if( dataWrited.empty() )
+void RedisClientImpl::drainSubmissions()
+{
+    Submission *first = submissions.takeAll();
+    Submission *last = nullptr;
+
+    for(Submission *submission = first; submission; submission = submission->next)
     {
-        // start transmit process
-        asyncWrite(boost::system::error_code(), 0);
+        queueCommand(submission->args, std::move(submission->handler));
+        submission->args.clear();
+        last = submission;
+    }
+
+    // the nodes are reused by the next submissions
+    if( first )
+        freeSubmissions.pushAll(first, last);
+
+    // the whole batch is sent by one write
+    writeQueued(false);
+}
+
+void RedisClientImpl::queueCommand(RedisArguments &command, ReplyHandler handler)
+{
+    handlers.push(std::move(handler));
+    ++queuedCommands;
+
+    if( outputQueued.data.size() < maxWriteBufferSize && dataQueued.empty() )
+    {
+        const RedisArguments *args = &command;
+
+        for(const RedisBuffer &item: command)
+        {
+            if( item.size() >= detail::spliceThreshold )
+            {
+                // big arguments are written from here
+                outputQueued.args.push_back(std::move(command));
+                args = &outputQueued.args.back();
+                break;
+            }
+        }
+
+        size_t size = outputQueued.data.size();
+
+        detail::appendCommand(outputQueued.data, outputQueued.splices, *args);
+        queuedBytes += outputQueued.data.size() - size;
+    }
+    else
+    {
+        dataQueued.emplace_back();
+
+        // The queued command is never moved until it is written,
+        // so big arguments are written from the moved arguments.
+        QueuedCommand &queued = dataQueued.back();
+
+        queued.args = std::move(command);
+        detail::appendCommand(queued.data, queued.splices, queued.args);
+        queuedBytes += queued.data.size();
     }
 }
 
@@ -758,16 +1690,25 @@ void RedisClientImpl::asyncRead(const boost::system::error_code &ec, const size_
         return;
     }
 
+    lastReadSize = size;
+
     for(size_t pos = 0; pos < size;)
     {
+        if( !replyInProgress )
+        {
+            prepareNextReply();
+        }
+
         std::pair<size_t, RedisParser::ParseResult> result = redisParser.parse(buf.data() + pos, size - pos);
 
         if( result.second == RedisParser::Completed )
         {
+            replyInProgress = false;
             doProcessMessage(redisParser.result());
         }
         else if( result.second == RedisParser::Incompleted )
         {
+            replyInProgress = true;
             processMessage();
             return;
         }
@@ -783,6 +1724,20 @@ void RedisClientImpl::asyncRead(const boost::system::error_code &ec, const size_
     processMessage();
 }
 
+void RedisClientImpl::prepareNextReply()
+{
+    // The next reply belongs to the first handler in the queue
+    if( state != State::Subscribed && handlers.empty() == false )
+    {
+        const ReplyHandler &next = handlers.front();
+
+        if( next.elementHandler )
+            redisParser.streamNextReply(next.elementHandler);
+        if( next.bulkSink )
+            redisParser.sinkNextReply(next.bulkSink);
+    }
+}
+
 void RedisClientImpl::onRedisError(const RedisValue &v)
 {
     errorHandler(v.toString());
@@ -804,9 +1759,9 @@ size_t RedisClientImpl::subscribe(
 
     if (state == State::Connected || state == State::Subscribed)
     {
-        std::deque<RedisBuffer> items{ command, channel };
+        RedisArguments items{ command, channel };
 
-        post(std::bind(&RedisClientImpl::doAsyncCommand, this, makeCommand(items), std::move(handler)));
+        submit(items, std::move(handler));
         msgHandlers.insert(std::make_pair(channel, std::make_pair(subscribeSeq, std::move(msgHandler))));
         state = State::Subscribed;
 
@@ -836,9 +1791,9 @@ void RedisClientImpl::singleShotSubscribe(
     if (state == State::Connected ||
         state == State::Subscribed)
     {
-        std::deque<RedisBuffer> items{ command, channel };
+        RedisArguments items{ command, channel };
 
-        post(std::bind(&RedisClientImpl::doAsyncCommand, this, makeCommand(items), std::move(handler)));
+        submit(items, std::move(handler));
         singleShotMsgHandlers.insert(std::make_pair(channel, std::move(msgHandler)));
         state = State::Subscribed;
     }
@@ -881,38 +1836,735 @@ void RedisClientImpl::unsubscribe(const std::string &command,
             }
             else
             {
-                ++it;
+                ++it;
+            }
+        }
+
+        RedisArguments items{ command, channel };
+
+        // Unsubscribe command for Redis
+        submit(items, handler);
+    }
+    else
+    {
+        std::stringstream ss;
+
+        ss << "RedisClientImpl::unsubscribe called with invalid state "
+            << to_string(state);
+
+#ifdef DEBUG
+        --recursion;
+#endif
+        errorHandler(ss.str());
+        return;
+    }
+
+#ifdef DEBUG
+    --recursion;
+#endif
+}
+
+}
+
+#endif // REDISCLIENT_REDISCLIENTIMPL_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLIENTPOOL_CPP
+#define REDISCLIENT_REDISCLIENTPOOL_CPP
+
+#include <algorithm>
+
+
+
+namespace redisclient {
+
+RedisClientPool::RedisClientPool(boost::asio::io_service &ioService, size_t size)
+    : next(0)
+{
+    size = std::max<size_t>(size, 1);
+    clients.reserve(size);
+
+    for(size_t i = 0; i < size; ++i)
+        clients.emplace_back(new RedisAsyncClient(ioService));
+}
+
+RedisClientPool::~RedisClientPool()
+{
+}
+
+void RedisClientPool::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                              std::function<void(boost::system::error_code)> handler)
+{
+    struct Progress {
+        size_t remaining;
+        std::function<void(boost::system::error_code)> handler;
+    };
+
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+
+    progress->remaining = clients.size();
+    progress->handler = std::move(handler);
+
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+    {
+        client->connect(endpoint, [progress](boost::system::error_code ec) {
+            if( !progress->handler )
+            {
+                // already failed
+                return;
+            }
+            else if( ec || --progress->remaining == 0 )
+            {
+                std::function<void(boost::system::error_code)> handler;
+
+                handler.swap(progress->handler);
+                handler(ec);
+            }
+        });
+    }
+}
+
+bool RedisClientPool::isConnected() const
+{
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+    {
+        if( !client->isConnected() )
+            return false;
+    }
+
+    return true;
+}
+
+void RedisClientPool::disconnect()
+{
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+        client->disconnect();
+}
+
+void RedisClientPool::installErrorHandler(std::function<void(const std::string &)> handler)
+{
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+        client->installErrorHandler(handler);
+}
+
+size_t RedisClientPool::size() const
+{
+    return clients.size();
+}
+
+RedisAsyncClient &RedisClientPool::connection(size_t index)
+{
+    return *clients.at(index);
+}
+
+size_t RedisClientPool::queueDepth(size_t index) const
+{
+    return clients.at(index)->queueDepth();
+}
+
+RedisAsyncClient &RedisClientPool::leastLoaded()
+{
+    const size_t size = clients.size();
+    const size_t start = next.fetch_add(1, std::memory_order_relaxed) % size;
+
+    RedisAsyncClient *best = nullptr;
+    size_t bestDepth = 0;
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        RedisAsyncClient *client = clients[(start + i) % size].get();
+
+        // a subscribed connection takes no commands
+        if( client->state() != RedisAsyncClient::State::Connected )
+            continue;
+
+        size_t depth = client->queueDepth();
+
+        if( best == nullptr || depth < bestDepth )
+        {
+            best = client;
+            bestDepth = depth;
+
+            if( depth == 0 )
+                break;
+        }
+    }
+
+    // nothing is connected, the command fails on the connection
+    return best ? *best : *clients[start];
+}
+
+void RedisClientPool::command(const std::string &cmd, RedisArguments args,
+                              std::function<void(RedisValue)> handler)
+{
+    leastLoaded().command(cmd, std::move(args), std::move(handler));
+}
+
+}
+
+#endif // REDISCLIENT_REDISCLIENTPOOL_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLUSTERCLIENT_CPP
+#define REDISCLIENT_REDISCLUSTERCLIENT_CPP
+
+
+
+
+namespace redisclient {
+
+RedisClusterClient::RedisClusterClient(boost::asio::io_service &ioService)
+    : pimpl(std::make_shared<RedisClusterImpl>(ioService))
+{
+}
+
+RedisClusterClient::~RedisClusterClient()
+{
+    pimpl->disconnect();
+}
+
+void RedisClusterClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                                 std::function<void(boost::system::error_code)> handler)
+{
+    pimpl->connect(endpoint, std::move(handler));
+}
+
+bool RedisClusterClient::isConnected() const
+{
+    return pimpl->slotsLoaded;
+}
+
+void RedisClusterClient::disconnect()
+{
+    pimpl->disconnect();
+}
+
+void RedisClusterClient::installErrorHandler(std::function<void(const std::string &)> handler)
+{
+    // called by the connections to the nodes, see RedisClusterImpl::handleError
+    pimpl->errorHandler = std::move(handler);
+}
+
+void RedisClusterClient::refreshSlots(std::function<void(boost::system::error_code)> handler)
+{
+    pimpl->refreshSlots(std::move(handler));
+}
+
+size_t RedisClusterClient::keySlot(const boost::string_ref &key)
+{
+    return detail::hashSlot(key);
+}
+
+boost::asio::ip::tcp::endpoint RedisClusterClient::slotNode(size_t slot) const
+{
+    RedisClusterImpl::Node *node = pimpl->slots.at(slot);
+
+    return node ? node->endpoint : boost::asio::ip::tcp::endpoint();
+}
+
+size_t RedisClusterClient::nodes() const
+{
+    return pimpl->nodes.size();
+}
+
+void RedisClusterClient::command(const std::string &cmd, RedisArguments args,
+                                 std::function<void(RedisValue)> handler)
+{
+    RedisClusterImpl::Node *node = pimpl->route(args, 0);
+
+    if( node == nullptr )
+    {
+        pimpl->errorHandler("RedisClusterClient::command called before connect");
+        return;
+    }
+
+    std::shared_ptr<RedisClusterImpl::Request> request =
+        std::make_shared<RedisClusterImpl::Request>();
+
+    detail::copyRefs(args);
+
+    request->cmd = cmd;
+    request->args = std::move(args);
+    request->handler = std::move(handler);
+    request->redirects = 0;
+
+    pimpl->send(node, std::move(request), false);
+}
+
+void RedisClusterClient::pipelinedArguments(std::vector<RedisArguments> commands,
+                                            std::function<void(RedisValue)> handler)
+{
+    pimpl->pipelined(std::move(commands), std::move(handler));
+}
+
+ClusterPipeline RedisClusterClient::pipelined()
+{
+    return ClusterPipeline(*this);
+}
+
+}
+
+#endif // REDISCLIENT_REDISCLUSTERCLIENT_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLUSTERIMPL_CPP
+#define REDISCLIENT_REDISCLUSTERIMPL_CPP
+
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+
+
+namespace redisclient {
+
+namespace
+{
+    RedisValue errorValue(const std::string &message)
+    {
+        return RedisValue(std::vector<char>(message.begin(), message.end()),
+                RedisValue::ErrorTag());
+    }
+}
+
+RedisClusterImpl::Node::Node(boost::asio::io_service &ioService,
+                             const boost::asio::ip::tcp::endpoint &endpoint)
+    : endpoint(endpoint), client(ioService)
+{
+}
+
+RedisClusterImpl::RedisClusterImpl(boost::asio::io_service &ioService)
+    : ioService(ioService), slots(detail::hashSlots, nullptr),
+    errorHandler(&RedisClientImpl::defaulErrorHandler),
+    refreshing(false), slotsLoaded(false), maxRedirects(5)
+{
+}
+
+RedisClusterImpl::~RedisClusterImpl()
+{
+}
+
+void RedisClusterImpl::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                               std::function<void(boost::system::error_code)> handler)
+{
+    std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+    whenConnected(node(endpoint), [weak, handler](boost::system::error_code ec) {
+        std::shared_ptr<RedisClusterImpl> self = weak.lock();
+
+        if( !self )
+            return;
+        else if( ec )
+            handler(ec);
+        else
+            self->refreshSlots(handler);
+    });
+}
+
+void RedisClusterImpl::disconnect()
+{
+    for(auto &item: nodes)
+    {
+        item.second->client.disconnect();
+        item.second->sent.clear();
+    }
+}
+
+void RedisClusterImpl::refreshSlots(std::function<void(boost::system::error_code)> handler)
+{
+    if( handler )
+        refreshHandlers.push_back(std::move(handler));
+
+    if( refreshing )
+        return;
+
+    if( nodes.empty() )
+    {
+        std::vector<std::function<void(boost::system::error_code)>> handlers;
+
+        handlers.swap(refreshHandlers);
+
+        for(const std::function<void(boost::system::error_code)> &handler: handlers)
+            handler(boost::asio::error::not_connected);
+
+        return;
+    }
+
+    refreshing = true;
+
+    std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    Node *target = anyNode();
+
+    request->cmd = "CLUSTER";
+    request->args.emplace_back("SLOTS");
+    request->redirects = maxRedirects;
+    request->handler = [weak, target](RedisValue value) {
+        if( std::shared_ptr<RedisClusterImpl> self = weak.lock() )
+            self->handleSlots(target, value);
+    };
+
+    send(target, std::move(request), false);
+}
+
+void RedisClusterImpl::send(Node *node, std::shared_ptr<Request> request, bool asking)
+{
+    if( node->client.isConnected() == false )
+    {
+        std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+        whenConnected(node, [weak, node, request, asking](boost::system::error_code ec) {
+            std::shared_ptr<RedisClusterImpl> self = weak.lock();
+
+            if( !self )
+            {
+                return;
+            }
+            else if( ec )
+            {
+                std::stringstream ss;
+
+                ss << "ERR cluster node " << node->endpoint << ": " << ec.message();
+                request->handler(errorValue(ss.str()));
+            }
+            else
+            {
+                self->send(node, request, asking);
+            }
+        });
+
+        return;
+    }
+
+    std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+    // ASKING is valid for the next command of the connection only
+    if( asking )
+        node->client.command("ASKING", {});
+
+    node->sent.push_back(request);
+    node->client.command(request->cmd, request->args, [weak, node, request](RedisValue value) {
+        std::shared_ptr<RedisClusterImpl> self = weak.lock();
+
+        if( self && self->takeSent(node, request) )
+            self->handleReply(request, std::move(value));
+    });
+}
+
+void RedisClusterImpl::pipelined(std::vector<RedisArguments> commands,
+                                 std::function<void(RedisValue)> handler)
+{
+    struct Batch {
+        std::vector<RedisValue> replies;
+        size_t remaining;
+        std::function<void(RedisValue)> handler;
+    };
+
+    if( commands.empty() )
+    {
+        handler(RedisValue(std::vector<RedisValue>()));
+        return;
+    }
+
+    std::vector<std::pair<Node *, size_t>> order;
+
+    order.reserve(commands.size());
+
+    for(size_t i = 0; i < commands.size(); ++i)
+    {
+        Node *node = route(commands[i], 1);
+
+        // the pipeline is replied anyway, not left waiting
+        if( node == nullptr )
+        {
+            handler(errorValue("ERR RedisClusterClient::pipelined called before connect"));
+            return;
+        }
+
+        order.emplace_back(node, i);
+    }
+
+    // one sub-pipeline per node, the commands of a node keep their order
+    std::stable_sort(order.begin(), order.end(),
+            [](const std::pair<Node *, size_t> &a, const std::pair<Node *, size_t> &b) {
+        return std::less<Node *>()(a.first, b.first);
+    });
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+
+    batch->replies.resize(commands.size());
+    batch->remaining = commands.size();
+    batch->handler = std::move(handler);
+
+    for(const std::pair<Node *, size_t> &item: order)
+    {
+        RedisArguments &items = commands[item.second];
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        size_t index = item.second;
+
+        request->cmd = detail::argumentRef(items.front()).to_string();
+        request->args.reserve(items.size() - 1);
+
+        for(size_t i = 1; i < items.size(); ++i)
+            request->args.push_back(std::move(items[i]));
+
+        request->redirects = 0;
+        request->handler = [batch, index](RedisValue value) {
+            batch->replies[index] = std::move(value);
+
+            if( --batch->remaining == 0 )
+                batch->handler(RedisValue(std::move(batch->replies)));
+        };
+
+        detail::copyRefs(request->args);
+        send(item.first, std::move(request), false);
+    }
+}
+
+RedisClusterImpl::Node *RedisClusterImpl::route(const RedisArguments &args, size_t key)
+{
+    Node *node = nullptr;
+
+    if( args.size() > key )
+        node = slots[detail::hashSlot(detail::argumentRef(args[key]))];
+
+    // a slot without a node replies with MOVED
+    if( node == nullptr && nodes.empty() == false )
+        node = anyNode();
+
+    return node;
+}
+
+RedisClusterImpl::Node *RedisClusterImpl::node(const boost::asio::ip::tcp::endpoint &endpoint)
+{
+    std::unique_ptr<Node> &node = nodes[endpoint];
+
+    if( !node )
+    {
+        std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+        Node *target = new Node(ioService, endpoint);
+
+        node.reset(target);
+        node->client.installErrorHandler([weak, target](const std::string &error) {
+            if( std::shared_ptr<RedisClusterImpl> self = weak.lock() )
+                self->handleError(target, error);
+        });
+    }
+
+    return node.get();
+}
+
+RedisClusterImpl::Node *RedisClusterImpl::anyNode()
+{
+    for(auto &item: nodes)
+    {
+        if( item.second->client.isConnected() )
+            return item.second.get();
+    }
+
+    return nodes.begin()->second.get();
+}
+
+void RedisClusterImpl::whenConnected(Node *node,
+                                     std::function<void(boost::system::error_code)> handler)
+{
+    if( node->client.isConnected() )
+    {
+        handler(boost::system::error_code());
+        return;
+    }
+
+    node->waiting.push_back(std::move(handler));
+
+    if( node->client.state() != RedisAsyncClient::State::Connecting )
+    {
+        std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+        node->client.connect(node->endpoint, [weak, node](boost::system::error_code ec) {
+            if( std::shared_ptr<RedisClusterImpl> self = weak.lock() )
+                self->handleConnect(node, ec);
+        });
+    }
+}
+
+void RedisClusterImpl::handleConnect(Node *node, const boost::system::error_code &ec)
+{
+    std::vector<std::function<void(boost::system::error_code)>> waiting;
+
+    waiting.swap(node->waiting);
+
+    for(const std::function<void(boost::system::error_code)> &handler: waiting)
+        handler(ec);
+}
+
+bool RedisClusterImpl::takeSent(Node *node, const std::shared_ptr<Request> &request)
+{
+    // replies come in order, the request is the first one
+    std::deque<std::shared_ptr<Request>>::iterator it =
+        std::find(node->sent.begin(), node->sent.end(), request);
+
+    if( it == node->sent.end() )
+        return false;
+
+    node->sent.erase(it);
+    return true;
+}
+
+void RedisClusterImpl::handleReply(std::shared_ptr<Request> request, RedisValue value)
+{
+    bool ask = false;
+    size_t slot = 0;
+    boost::asio::ip::tcp::endpoint endpoint;
+
+    if( value.isError() && request->redirects < maxRedirects &&
+            parseRedirection(value.toString(), ask, slot, endpoint) )
+    {
+        Node *target = this->node(endpoint);
+
+        ++request->redirects;
+
+        if( !ask )
+        {
+            // the slot has moved for good, the other slots may have too
+            slots[slot] = target;
+            refreshSlots(nullptr);
+        }
+
+        send(target, std::move(request), ask);
+        return;
+    }
+
+    request->handler(std::move(value));
+}
+
+void RedisClusterImpl::handleError(Node *node, const std::string &error)
+{
+    std::deque<std::shared_ptr<Request>> failed;
+
+    // the replies of the requests sent are lost with the connection
+    failed.swap(node->sent);
+    node->client.disconnect();
+
+    if( failed.empty() == false )
+    {
+        std::stringstream ss;
+
+        ss << "ERR cluster node " << node->endpoint << ": " << error;
+
+        RedisValue value = errorValue(ss.str());
+
+        // the CLUSTER SLOTS request in progress too, so the next refresh
+        // is not held back by it
+        for(const std::shared_ptr<Request> &request: failed)
+            request->handler(value);
+    }
+
+    errorHandler(error);
+}
+
+void RedisClusterImpl::handleSlots(Node *node, const RedisValue &value)
+{
+    std::vector<Node *> map(detail::hashSlots, nullptr);
+    bool valid = value.isArray();
+
+    if( valid )
+    {
+        // [[start, end, [host, port, id], replicas...], ...]
+        for(const RedisValue &range: value.getArray())
+        {
+            if( range.isArray() == false || range.getArray().size() < 3 ||
+                    range.getArray()[2].isArray() == false ||
+                    range.getArray()[2].getArray().size() < 2 )
+            {
+                valid = false;
+                break;
+            }
+
+            const std::vector<RedisValue> &items = range.getArray();
+            const std::vector<RedisValue> &master = items[2].getArray();
+            int64_t start = items[0].toInt();
+            int64_t end = items[1].toInt();
+            std::string host = master[0].toString();
+            boost::system::error_code ec;
+            boost::asio::ip::tcp::endpoint endpoint(node->endpoint.address(),
+                    static_cast<unsigned short>(master[1].toInt()));
+
+            // an empty host is the address of the node replying
+            if( host.empty() == false )
+                endpoint.address(boost::asio::ip::address::from_string(host, ec));
+
+            if( ec || start < 0 || start > end || end >= static_cast<int64_t>(detail::hashSlots) )
+            {
+                valid = false;
+                break;
             }
+
+            Node *owner = this->node(endpoint);
+
+            for(int64_t slot = start; slot <= end; ++slot)
+                map[slot] = owner;
         }
+    }
 
-        std::deque<RedisBuffer> items{ command, channel };
+    std::vector<std::function<void(boost::system::error_code)>> handlers;
 
-        // Unsubscribe command for Redis
-        post(std::bind(&RedisClientImpl::doAsyncCommand, this,
-             makeCommand(items), handler));
+    handlers.swap(refreshHandlers);
+    refreshing = false;
+
+    boost::system::error_code ec;
+
+    if( valid )
+    {
+        slots.swap(map);
+        slotsLoaded = true;
     }
     else
     {
-        std::stringstream ss;
+        ec = boost::system::errc::make_error_code(boost::system::errc::protocol_error);
+    }
 
-        ss << "RedisClientImpl::unsubscribe called with invalid state "
-            << to_string(state);
+    for(const std::function<void(boost::system::error_code)> &handler: handlers)
+        handler(ec);
+}
 
-#ifdef DEBUG
-        --recursion;
-#endif
-        errorHandler(ss.str());
-        return;
-    }
+bool RedisClusterImpl::parseRedirection(const std::string &error, bool &ask, size_t &slot,
+                                        boost::asio::ip::tcp::endpoint &endpoint)
+{
+    std::istringstream ss(error);
+    std::string kind, address;
+    size_t colon;
+    unsigned short port;
+    boost::system::error_code ec;
 
-#ifdef DEBUG
-    --recursion;
-#endif
+    if( !(ss >> kind >> slot >> address) || slot >= detail::hashSlots )
+        return false;
+    else if( kind != "MOVED" && kind != "ASK" )
+        return false;
+    else if( (colon = address.rfind(':')) == std::string::npos )
+        return false;
+    else if( !(std::istringstream(address.substr(colon + 1)) >> port) )
+        return false;
+
+    endpoint.address(boost::asio::ip::address::from_string(address.substr(0, colon), ec));
+    endpoint.port(port);
+    ask = kind == "ASK";
+
+    return !ec;
 }
 
 }
 
-#endif // REDISCLIENT_REDISCLIENTIMPL_CPP
+#endif // REDISCLIENT_REDISCLUSTERIMPL_CPP
 /*
  * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
  * License: MIT
@@ -930,12 +2582,50 @@ void RedisClientImpl::unsubscribe(const std::string &command,
 
 
 
+
 namespace redisclient {
 
 RedisParser::RedisParser()
-    : bulkSize(0)
+    : mode(ValueMode), arena(nullptr), bulkSize(0), offset(0), stringOffset(0)
+{
+    reserve();
+}
+
+RedisParser::RedisParser(Mode mode)
+    : mode(mode), arena(nullptr), bulkSize(0), offset(0), stringOffset(0)
+{
+    reserve();
+}
+
+void RedisParser::reserve()
 {
+    // Usual replies are nested a few levels at most (EXEC, XRANGE,
+    // CLUSTER SLOTS), deeper ones just grow the storage.
+    static const size_t depth = 16;
+
     buf.reserve(64);
+    states.reserve(1);
+    arraySizes.reserve(depth);
+
+    if( mode == ViewMode )
+        arrayViews.reserve(depth);
+    else
+        arrayValues.reserve(depth);
+}
+
+void RedisParser::reset()
+{
+    states.clear();
+    bulkSize = 0;
+    buf.clear();
+    bulk.clear();
+    elementHandler = nullptr;
+    bulkSink = nullptr;
+    offset = 0;
+    stringOffset = 0;
+    arraySizes.clear();
+    arrayValues.clear();
+    arrayViews.clear();
 }
 
 std::pair<size_t, RedisParser::ParseResult> RedisParser::parse(const char *ptr, size_t size)
@@ -943,6 +2633,43 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parse(const char *ptr,
     return RedisParser::parseChunk(ptr, size);
 }
 
+template<typename Value>
+void RedisParser::appendToArray(std::vector<Value> &arrays, Value &value)
+{
+    // Values are only moved, so a subtree is never copied when the arrays
+    // are closed, whatever the nesting level.
+    assert(arraySizes.size() > 0);
+
+    if (!streamElement(value))
+        arrays.back().getArray().push_back(std::move(value));
+
+    while(!arraySizes.empty() && --arraySizes.back() == 0)
+    {
+        arraySizes.pop_back();
+        value = std::move(arrays.back());
+        arrays.pop_back();
+
+        if (!arraySizes.empty() && !streamElement(value))
+            arrays.back().getArray().push_back(std::move(value));
+    }
+}
+
+bool RedisParser::streamElement(RedisValue &value)
+{
+    if (elementHandler && arraySizes.size() == 1)
+    {
+        elementHandler(std::move(value));
+        return true;
+    }
+
+    return false;
+}
+
+bool RedisParser::streamElement(RedisValueView &)
+{
+    return false;
+}
+
 std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *ptr, size_t size)
 {
     size_t position = 0;
@@ -950,8 +2677,8 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
 
     if (!states.empty())
     {
-        state = states.top();
-        states.pop();
+        state = states.back();
+        states.pop_back();
     }
 
     while(position < size)
@@ -970,9 +2697,11 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     case stringReply:
                         state = String;
+                        stringOffset = offset + position;
                         break;
                     case errorReply:
                         state = ErrorString;
+                        stringOffset = offset + position;
                         break;
                     case integerReply:
                         state = Integer;
@@ -985,6 +2714,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                         state = ArraySize;
                         break;
                     default:
+                        reset();
                         return std::make_pair(position, Error);
                 }
                 break;
@@ -995,11 +2725,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isChar(c) && !isControl(c) )
                 {
-                    buf.push_back(c);
+                    // consume the whole run of valid bytes at once
+                    size_t run = detail::scanSimpleString(ptr + position, size - position);
+
+                    if( mode == ValueMode )
+                        buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1010,11 +2745,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isChar(c) && !isControl(c) )
                 {
-                    buf.push_back(c);
+                    // consume the whole run of valid bytes at once
+                    size_t run = detail::scanSimpleString(ptr + position, size - position);
+
+                    if( mode == ValueMode )
+                        buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1023,7 +2763,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     if( buf.empty() )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
@@ -1033,11 +2773,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isdigit(c) || c == '-' )
                 {
-                    buf.push_back(c);
+                    size_t run = detail::scanInteger(ptr + position, size - position);
+
+                    buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1045,11 +2788,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 if( c == '\n')
                 {
                     state = Start;
-                    redisValue = RedisValue(buf);
+
+                    if( mode == ViewMode )
+                        redisValueView = RedisValueView(stringOffset,
+                                offset + position - 2 - stringOffset);
+                    else
+                        redisValue = RedisValue(buf);
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1058,11 +2806,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     state = Start;
                     RedisValue::ErrorTag tag;
-                    redisValue = RedisValue(buf, tag);
+
+                    if( mode == ViewMode )
+                        redisValueView = RedisValueView(stringOffset,
+                                offset + position - 2 - stringOffset, tag);
+                    else
+                        redisValue = RedisValue(buf, tag);
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1071,11 +2824,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     bulkSize = bufToLong(buf.data(), buf.size());
                     buf.clear();
+                    bulk.clear();
+                    stringOffset = offset + position;
 
                     if( bulkSize == -1 )
                     {
                         state = Start;
                         redisValue = RedisValue(); // Nil
+                        redisValueView = RedisValueView();
                     }
                     else if( bulkSize == 0 )
                     {
@@ -1083,19 +2839,23 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                     }
                     else if( bulkSize < 0 )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
                     {
-                        buf.reserve(bulkSize);
+                        if( mode == ValueMode && !sinkBulk() )
+                            bulk.reserve(bulkSize);
 
                         long int available = size - position;
                         long int canRead = std::min(bulkSize, available);
 
                         if( canRead > 0 )
                         {
-                            buf.assign(ptr + position, ptr + position + canRead);
+                            if( sinkBulk() )
+                                bulkSink(ptr + position, canRead);
+                            else if( mode == ValueMode )
+                                bulk.assign(ptr + position, ptr + position + canRead);
                             position += canRead;
                             bulkSize -= canRead;
                         }
@@ -1113,7 +2873,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1123,7 +2883,10 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 long int available = size - position + 1;
                 long int canRead = std::min(available, bulkSize);
 
-                buf.insert(buf.end(), ptr + position - 1, ptr + position - 1 + canRead);
+                if( sinkBulk() )
+                    bulkSink(ptr + position - 1, canRead);
+                else if( mode == ValueMode )
+                    bulk.insert(bulk.end(), ptr + position - 1, ptr + position - 1 + canRead);
                 bulkSize -= canRead;
                 position += canRead - 1;
 
@@ -1140,7 +2903,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1148,11 +2911,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 if( c == '\n')
                 {
                     state = Start;
-                    redisValue = RedisValue(buf);
+
+                    if( mode == ViewMode )
+                        redisValueView = RedisValueView(stringOffset,
+                                offset + position - 2 - stringOffset);
+                    else
+                        redisValue = RedisValue(std::move(bulk));
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1161,7 +2929,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     if( buf.empty() )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
@@ -1171,11 +2939,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isdigit(c) || c == '-' )
                 {
-                    buf.push_back(c);
+                    size_t run = detail::scanInteger(ptr + position, size - position);
+
+                    buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1189,29 +2960,45 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                     {
                         state = Start;
                         redisValue = RedisValue();  // Nil value
+                        redisValueView = RedisValueView();
                     }
                     else if( arraySize == 0 )
                     {
                         state = Start;
                         redisValue = RedisValue(std::move(array));  // Empty array
+                        redisValueView = RedisValueView(RedisValueView::Elements());
                     }
                     else if( arraySize < 0 )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
+                    else if( mode == ViewMode )
+                    {
+                        RedisArenaAllocator<RedisValueView> allocator(arena);
+                        RedisValueView::Elements views(allocator);
+
+                        views.reserve(arraySize);
+                        arraySizes.push_back(arraySize);
+                        arrayViews.push_back(std::move(views));
+
+                        state = StartArray;
+                    }
                     else
                     {
-                        array.reserve(arraySize);
-                        arraySizes.push(arraySize);
-                        arrayValues.push(std::move(array));
+                        // streamed elements are not collected
+                        if( !elementHandler || !arraySizes.empty() )
+                            array.reserve(arraySize);
+
+                        arraySizes.push_back(arraySize);
+                        arrayValues.push_back(std::move(array));
 
                         state = StartArray;
                     }
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1220,7 +3007,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     if( buf.empty() )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
@@ -1230,11 +3017,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isdigit(c) || c == '-' )
                 {
-                    buf.push_back(c);
+                    size_t run = detail::scanInteger(ptr + position, size - position);
+
+                    buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -1245,16 +3035,17 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
 
                     buf.clear();
                     redisValue = RedisValue(value);
+                    redisValueView = RedisValueView(value);
                     state = Start;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
             default:
-                std::stack<State>().swap(states);
+                reset();
                 return std::make_pair(position, Error);
         }
 
@@ -1263,18 +3054,10 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
         {
             if (!arraySizes.empty())
             {
-                assert(arraySizes.size() > 0);
-                arrayValues.top().getArray().push_back(redisValue);
-
-                while(!arraySizes.empty() && --arraySizes.top() == 0)
-                {
-                    arraySizes.pop();
-                    redisValue = std::move(arrayValues.top());
-                    arrayValues.pop();
-
-                    if (!arraySizes.empty())
-                        arrayValues.top().getArray().push_back(redisValue);
-                }
+                if (mode == ViewMode)
+                    appendToArray(arrayViews, redisValueView);
+                else
+                    appendToArray(arrayValues, redisValue);
             }
 
 
@@ -1288,11 +3071,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
 
     if (arraySizes.empty() && state == Start)
     {
+        // the next reply starts from scratch
+        reset();
         return std::make_pair(position, Completed);
     }
     else
     {
-        states.push(state);
+        offset += position;
+        states.push_back(state);
         return std::make_pair(position, Incompleted);
     }
 }
@@ -1302,6 +3088,40 @@ RedisValue RedisParser::result()
     return std::move(redisValue);
 }
 
+RedisValueView RedisParser::resultView()
+{
+    return std::move(redisValueView);
+}
+
+void RedisParser::setArena(RedisArena *arena_)
+{
+    arena = arena_;
+}
+
+void RedisParser::streamNextReply(std::function<void(RedisValue)> handler)
+{
+    elementHandler = std::move(handler);
+}
+
+void RedisParser::sinkNextReply(std::function<void(const char *, size_t)> sink)
+{
+    bulkSink = std::move(sink);
+}
+
+size_t RedisParser::pendingBulkSize() const
+{
+    if( !states.empty() && states.back() == Bulk )
+        return static_cast<size_t>(bulkSize) + 2;
+    else
+        return 0;
+}
+
+bool RedisParser::sinkBulk() const
+{
+    // only the bulk string reply itself, not bulk strings inside of arrays
+    return bulkSink && arraySizes.empty();
+}
+
 /*
  * Convert string to long. I can't use atol/strtol because it
  * work only with null terminated string. I can use temporary
@@ -1350,6 +3170,246 @@ long int RedisParser::bufToLong(const char *str, size_t size)
  * License: MIT
  */
 
+#ifndef REDISCLIENT_REDISSHARDEDCLIENT_CPP
+#define REDISCLIENT_REDISSHARDEDCLIENT_CPP
+
+#include <algorithm>
+#include <mutex>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+
+namespace redisclient {
+
+namespace
+{
+    // FNV-1a, stable between runs and platforms unlike std::hash.
+    inline uint64_t keyHash(const boost::string_ref &key)
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        for(char c: key)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    // CPUs the process may run on.
+    inline std::vector<int> allowedCpus()
+    {
+        std::vector<int> result;
+
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+
+        if( sched_getaffinity(0, sizeof(set), &set) == 0 )
+        {
+            for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if( CPU_ISSET(cpu, &set) )
+                    result.push_back(cpu);
+            }
+        }
+#endif
+
+        return result;
+    }
+
+    // Default error handler of the connections. The default one of
+    // RedisAsyncClient throws, which would terminate the process from the
+    // thread of the shard.
+    inline void ignoreError(const std::string &)
+    {
+    }
+
+    // Best effort, the thread keeps running anywhere on failure.
+    inline void pinThread(std::thread &thread, int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+    }
+}
+
+RedisShardedClient::Shard::Shard(size_t connections)
+    : work(new boost::asio::io_service::work(ioService)),
+    pool(ioService, connections)
+{
+    pool.installErrorHandler(&ignoreError);
+}
+
+RedisShardedClient::RedisShardedClient(size_t shardsCount, size_t connectionsPerShard,
+                                       bool pinThreads)
+    : connectionsPerShard(std::max<size_t>(connectionsPerShard, 1)),
+    routing(Routing::LeastLoaded), next(0)
+{
+    std::vector<int> cpus;
+
+    if( pinThreads )
+        cpus = allowedCpus();
+
+    shardsCount = std::max<size_t>(shardsCount, 1);
+    shards.reserve(shardsCount);
+
+    for(size_t i = 0; i < shardsCount; ++i)
+    {
+        shards.emplace_back(new Shard(this->connectionsPerShard));
+
+        Shard *shard = shards.back().get();
+
+        shard->thread = std::thread([shard]() { shard->ioService.run(); });
+
+        if( !cpus.empty() )
+            pinThread(shard->thread, cpus[i % cpus.size()]);
+    }
+}
+
+RedisShardedClient::~RedisShardedClient()
+{
+    disconnect();
+
+    for(const std::unique_ptr<Shard> &shard: shards)
+        shard->work.reset();
+
+    for(const std::unique_ptr<Shard> &shard: shards)
+        shard->thread.join();
+}
+
+void RedisShardedClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                                 std::function<void(boost::system::error_code)> handler)
+{
+    // shards connect in parallel, in their threads
+    struct Progress {
+        std::mutex mutex;
+        size_t remaining;
+        std::function<void(boost::system::error_code)> handler;
+    };
+
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+
+    progress->remaining = shards.size();
+    progress->handler = std::move(handler);
+
+    for(const std::unique_ptr<Shard> &shard: shards)
+    {
+        RedisClientPool *pool = &shard->pool;
+
+        shard->ioService.post([pool, endpoint, progress]() {
+            pool->connect(endpoint, [progress](boost::system::error_code ec) {
+                std::function<void(boost::system::error_code)> handler;
+
+                {
+                    std::lock_guard<std::mutex> lock(progress->mutex);
+
+                    if( progress->handler && (ec || --progress->remaining == 0) )
+                        handler.swap(progress->handler);
+                }
+
+                if( handler )
+                    handler(ec);
+            });
+        });
+    }
+}
+
+bool RedisShardedClient::isConnected() const
+{
+    for(const std::unique_ptr<Shard> &shard: shards)
+    {
+        if( !shard->pool.isConnected() )
+            return false;
+    }
+
+    return true;
+}
+
+void RedisShardedClient::disconnect()
+{
+    for(const std::unique_ptr<Shard> &shard: shards)
+    {
+        RedisClientPool *pool = &shard->pool;
+
+        shard->ioService.post([pool]() { pool->disconnect(); });
+    }
+}
+
+void RedisShardedClient::installErrorHandler(std::function<void(const std::string &)> handler)
+{
+    for(const std::unique_ptr<Shard> &shard: shards)
+        shard->pool.installErrorHandler(handler);
+}
+
+void RedisShardedClient::setRouting(Routing routing_)
+{
+    routing = routing_;
+}
+
+size_t RedisShardedClient::size() const
+{
+    return shards.size();
+}
+
+boost::asio::io_service &RedisShardedClient::ioService(size_t index)
+{
+    return shards.at(index)->ioService;
+}
+
+RedisClientPool &RedisShardedClient::shard(size_t index)
+{
+    return shards.at(index)->pool;
+}
+
+RedisAsyncClient &RedisShardedClient::connectionForKey(const boost::string_ref &key)
+{
+    uint64_t index = keyHash(key) % (shards.size() * connectionsPerShard);
+
+    return shards[index % shards.size()]->pool.connection(index / shards.size());
+}
+
+RedisAsyncClient &RedisShardedClient::route(const RedisArguments &args)
+{
+    if( routing == Routing::KeyHash && args.empty() == false )
+        return connectionForKey(detail::argumentRef(args.front()));
+
+    size_t index = next.fetch_add(1, std::memory_order_relaxed) % shards.size();
+
+    // reads only the atomic state and queue depth of the connections
+    return shards[index]->pool.leastLoaded();
+}
+
+void RedisShardedClient::command(const std::string &cmd, RedisArguments args,
+                                 std::function<void(RedisValue)> handler)
+{
+    // the key is read before the arguments are moved
+    RedisAsyncClient &client = route(args);
+
+    client.command(cmd, std::move(args), std::move(handler));
+}
+
+}
+
+#endif // REDISCLIENT_REDISSHARDEDCLIENT_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
 #ifndef REDISCLIENT_REDISSYNCCLIENT_CPP
 #define REDISCLIENT_REDISSYNCCLIENT_CPP
 
@@ -1398,6 +3458,8 @@ void RedisSyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint)
 void RedisSyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
     boost::system::error_code &ec)
 {
+    reset();
+
     pimpl->socket.open(endpoint.protocol(), ec);
 
     if (!ec && tcpNoDelay)
@@ -1533,6 +3595,8 @@ void RedisSyncClient::connect(const boost::asio::local::stream_protocol::endpoin
 void RedisSyncClient::connect(const boost::asio::local::stream_protocol::endpoint &endpoint,
         boost::system::error_code &ec)
 {
+    reset();
+
     pimpl->socket.open(endpoint.protocol(), ec);
 
     if (!ec)
@@ -1544,6 +3608,20 @@ void RedisSyncClient::connect(const boost::asio::local::stream_protocol::endpoin
 
 #endif
 
+void RedisSyncClient::reset()
+{
+    // the connection was closed in the middle of a reply, or the last
+    // connect failed
+    if (pimpl->state == State::Closed)
+    {
+        boost::system::error_code ignored_ec;
+
+        pimpl->socket.close(ignored_ec);
+        pimpl->redisParser = RedisParser();
+        pimpl->bufPos = pimpl->bufSize = 0;
+    }
+}
+
 bool RedisSyncClient::isConnected() const
 {
     return pimpl->getState() == State::Connected ||
@@ -1561,23 +3639,56 @@ void RedisSyncClient::installErrorHandler(
     pimpl->errorHandler = std::move(handler);
 }
 
-RedisValue RedisSyncClient::command(std::string cmd, std::deque<RedisBuffer> args)
+RedisValue RedisSyncClient::command(std::string cmd, RedisArguments args)
+{
+    boost::system::error_code ec;
+    RedisValue result = command(std::move(cmd), std::move(args), ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+RedisValue RedisSyncClient::command(std::string cmd, RedisArguments args,
+            boost::system::error_code &ec)
+{
+    if(stateValid())
+    {
+        args.push_front(std::move(cmd));
+
+        return pimpl->doSyncCommand(args, commandTimeout, ec);
+    }
+    else
+    {
+        return RedisValue();
+    }
+}
+
+RedisValue RedisSyncClient::commandToSink(std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink)
 {
     boost::system::error_code ec;
-    RedisValue result = command(std::move(cmd), std::move(args), ec);
+    RedisValue result = commandToSink(std::move(cmd), std::move(args), std::move(sink), ec);
 
     detail::throwIfError(ec);
     return result;
 }
 
-RedisValue RedisSyncClient::command(std::string cmd, std::deque<RedisBuffer> args,
+RedisValue RedisSyncClient::commandToSink(std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink,
             boost::system::error_code &ec)
 {
     if(stateValid())
     {
         args.push_front(std::move(cmd));
 
-        return pimpl->doSyncCommand(args, commandTimeout, ec);
+        pimpl->redisParser.sinkNextReply(std::move(sink));
+
+        RedisValue result = pimpl->doSyncCommand(args, commandTimeout, ec);
+
+        // the sink is dropped by the parser when the reply is completed,
+        // but not if the command failed
+        pimpl->redisParser.sinkNextReply(nullptr);
+        return result;
     }
     else
     {
@@ -1602,6 +3713,21 @@ RedisValue RedisSyncClient::pipelined(std::deque<std::deque<RedisBuffer>> comman
 
 RedisValue RedisSyncClient::pipelined(std::deque<std::deque<RedisBuffer>> commands,
         boost::system::error_code &ec)
+{
+    std::vector<RedisArguments> arguments;
+
+    arguments.reserve(commands.size());
+
+    for(auto &command: commands)
+    {
+        arguments.push_back(std::move(command));
+    }
+
+    return pipelinedArguments(arguments, ec);
+}
+
+RedisValue RedisSyncClient::pipelinedArguments(const std::vector<RedisArguments> &commands,
+        boost::system::error_code &ec)
 {
     if(stateValid())
     {
@@ -1613,6 +3739,19 @@ RedisValue RedisSyncClient::pipelined(std::deque<std::deque<RedisBuffer>> comman
     }
 }
 
+RedisValue RedisSyncClient::commandRefs(const boost::string_ref *items, size_t size,
+        boost::system::error_code &ec)
+{
+    if(stateValid())
+    {
+        return pimpl->doSyncCommand(items, size, commandTimeout, ec);
+    }
+    else
+    {
+        return RedisValue();
+    }
+}
+
 RedisSyncClient::State RedisSyncClient::state() const
 {
     return pimpl->getState();
@@ -1663,6 +3802,12 @@ RedisSyncClient &RedisSyncClient::setTcpKeepAlive(bool enable)
     return *this;
 }
 
+RedisSyncClient &RedisSyncClient::setMaxReadBufferSize(size_t size)
+{
+    pimpl->setMaxReadBufferSize(size);
+    return *this;
+}
+
 }
 
 #endif // REDISCLIENT_REDISSYNCCLIENT_CPP
@@ -1671,6 +3816,240 @@ RedisSyncClient &RedisSyncClient::setTcpKeepAlive(bool enable)
  * License: MIT
  */
 
+#ifndef REDISCLIENT_REDISSYNCCLIENTPOOL_CPP
+#define REDISCLIENT_REDISSYNCCLIENTPOOL_CPP
+
+#include <algorithm>
+
+
+
+
+namespace redisclient {
+
+RedisSyncClientPool::Lease::Lease()
+    : pool(nullptr), client(nullptr)
+{
+}
+
+RedisSyncClientPool::Lease::Lease(RedisSyncClientPool *pool, RedisSyncClient *client)
+    : pool(pool), client(client)
+{
+}
+
+RedisSyncClientPool::Lease::Lease(Lease &&other)
+    : pool(other.pool), client(other.client)
+{
+    other.pool = nullptr;
+    other.client = nullptr;
+}
+
+RedisSyncClientPool::Lease &RedisSyncClientPool::Lease::operator=(Lease &&other)
+{
+    if( this != &other )
+    {
+        checkin();
+        std::swap(pool, other.pool);
+        std::swap(client, other.client);
+    }
+
+    return *this;
+}
+
+RedisSyncClientPool::Lease::~Lease()
+{
+    checkin();
+}
+
+RedisSyncClientPool::Lease::operator bool() const
+{
+    return client != nullptr;
+}
+
+RedisSyncClient &RedisSyncClientPool::Lease::operator*() const
+{
+    return *client;
+}
+
+RedisSyncClient *RedisSyncClientPool::Lease::operator->() const
+{
+    return client;
+}
+
+void RedisSyncClientPool::Lease::checkin()
+{
+    if( client )
+    {
+        pool->checkin(client);
+        pool = nullptr;
+        client = nullptr;
+    }
+}
+
+RedisSyncClientPool::RedisSyncClientPool(boost::asio::io_service &ioService, size_t size)
+    : reconnect(false)
+{
+    size = std::max<size_t>(size, 1);
+    clients.reserve(size);
+    idle.reserve(size);
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        clients.emplace_back(new RedisSyncClient(ioService));
+        idle.push_back(clients.back().get());
+    }
+
+    setConnectTimeout(boost::posix_time::seconds(5));
+}
+
+RedisSyncClientPool::~RedisSyncClientPool()
+{
+}
+
+void RedisSyncClientPool::connect(const boost::asio::ip::tcp::endpoint &endpoint_,
+                                  boost::system::error_code &ec)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        endpoint = endpoint_;
+        reconnect = true;
+    }
+
+    for(const std::unique_ptr<RedisSyncClient> &client: clients)
+    {
+        client->connect(endpoint_, ec);
+
+        if( ec )
+            return;
+    }
+}
+
+void RedisSyncClientPool::connect(const boost::asio::ip::tcp::endpoint &endpoint)
+{
+    boost::system::error_code ec;
+
+    connect(endpoint, ec);
+    detail::throwIfError(ec);
+}
+
+RedisSyncClientPool &RedisSyncClientPool::setConnectTimeout(
+        const boost::posix_time::time_duration &timeout)
+{
+    for(const std::unique_ptr<RedisSyncClient> &client: clients)
+        client->setConnectTimeout(timeout);
+
+    return *this;
+}
+
+size_t RedisSyncClientPool::size() const
+{
+    return clients.size();
+}
+
+size_t RedisSyncClientPool::available() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return idle.size();
+}
+
+RedisSyncClient &RedisSyncClientPool::connection(size_t index)
+{
+    return *clients.at(index);
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::checkout(boost::system::error_code &ec)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    checkedIn.wait(lock, [this]() { return !idle.empty(); });
+
+    RedisSyncClient *client = idle.back();
+    bool reconnect = this->reconnect;
+    boost::asio::ip::tcp::endpoint endpoint = this->endpoint;
+
+    idle.pop_back();
+    lock.unlock();
+
+    return lease(client, reconnect, endpoint, ec);
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::checkout()
+{
+    boost::system::error_code ec;
+    Lease result = checkout(ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::tryCheckout(boost::system::error_code &ec)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    ec = boost::system::error_code();
+
+    if( idle.empty() )
+        return Lease();
+
+    RedisSyncClient *client = idle.back();
+    bool reconnect = this->reconnect;
+    boost::asio::ip::tcp::endpoint endpoint = this->endpoint;
+
+    idle.pop_back();
+    lock.unlock();
+
+    return lease(client, reconnect, endpoint, ec);
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::tryCheckout()
+{
+    boost::system::error_code ec;
+    Lease result = tryCheckout(ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::lease(RedisSyncClient *client, bool reconnect,
+                                                      const boost::asio::ip::tcp::endpoint &endpoint,
+                                                      boost::system::error_code &ec)
+{
+    Lease result(this, client);
+
+    ec = boost::system::error_code();
+
+    if( reconnect && client->state() == RedisSyncClient::State::Closed )
+    {
+        client->connect(endpoint, ec);
+
+        // checked in closed, the next borrower tries again
+        if( ec )
+            return Lease();
+    }
+
+    return result;
+}
+
+void RedisSyncClientPool::checkin(RedisSyncClient *client)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        idle.push_back(client);
+    }
+
+    checkedIn.notify_one();
+}
+
+}
+
+#endif // REDISCLIENT_REDISSYNCCLIENTPOOL_CPP
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
 #ifndef REDISCLIENT_REDISVALUE_CPP
 #define REDISCLIENT_REDISVALUE_CPP
 
@@ -1685,11 +4064,18 @@ RedisValue::RedisValue()
 {
 }
 
-RedisValue::RedisValue(RedisValue &&other)
+RedisValue::RedisValue(RedisValue &&other) noexcept
     : value(std::move(other.value)), error(other.error)
 {
 }
 
+RedisValue &RedisValue::operator = (RedisValue &&other) noexcept
+{
+    value = std::move(other.value);
+    error = other.error;
+    return *this;
+}
+
 RedisValue::RedisValue(int64_t i)
     : value(i), error(false)
 {
@@ -1864,3 +4250,150 @@ bool RedisValue::operator != (const RedisValue &rhs) const
 
 #endif // REDISCLIENT_REDISVALUE_CPP
 
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISVALUEVIEW_CPP
+#define REDISCLIENT_REDISVALUEVIEW_CPP
+
+
+
+namespace redisclient {
+
+RedisValueView::RedisValueView()
+    : valueType(Null), intValue(0), rangeOffset(0), rangeLength(0)
+{
+}
+
+RedisValueView::RedisValueView(int64_t i)
+    : valueType(Int), intValue(i), rangeOffset(0), rangeLength(0)
+{
+}
+
+RedisValueView::RedisValueView(size_t offset, size_t length)
+    : valueType(String), intValue(0), rangeOffset(offset), rangeLength(length)
+{
+}
+
+RedisValueView::RedisValueView(size_t offset, size_t length, RedisValue::ErrorTag)
+    : valueType(Error), intValue(0), rangeOffset(offset), rangeLength(length)
+{
+}
+
+RedisValueView::RedisValueView(Elements array)
+    : valueType(Array), intValue(0), rangeOffset(0), rangeLength(0),
+    arrayValue(std::move(array))
+{
+}
+
+RedisValueView::Type RedisValueView::type() const
+{
+    return valueType;
+}
+
+bool RedisValueView::isOk() const
+{
+    return !isError();
+}
+
+bool RedisValueView::isError() const
+{
+    return valueType == Error;
+}
+
+bool RedisValueView::isNull() const
+{
+    return valueType == Null;
+}
+
+bool RedisValueView::isInt() const
+{
+    return valueType == Int;
+}
+
+bool RedisValueView::isString() const
+{
+    return valueType == String;
+}
+
+bool RedisValueView::isArray() const
+{
+    return valueType == Array;
+}
+
+int64_t RedisValueView::toInt() const
+{
+    return intValue;
+}
+
+size_t RedisValueView::offset() const
+{
+    return rangeOffset;
+}
+
+size_t RedisValueView::length() const
+{
+    return rangeLength;
+}
+
+const char *RedisValueView::data(const char *base) const
+{
+    return base + rangeOffset;
+}
+
+std::string RedisValueView::toString(const char *base) const
+{
+    if( valueType == String || valueType == Error )
+        return std::string(data(base), rangeLength);
+    else
+        return std::string();
+}
+
+RedisValueView::Elements &RedisValueView::getArray()
+{
+    if( valueType != Array )
+        throw boost::bad_get();
+    return arrayValue;
+}
+
+const RedisValueView::Elements &RedisValueView::getArray() const
+{
+    if( valueType != Array )
+        throw boost::bad_get();
+    return arrayValue;
+}
+
+RedisValue RedisValueView::toRedisValue(const char *base) const
+{
+    switch(valueType)
+    {
+        case Int:
+            return RedisValue(intValue);
+        case String:
+            return RedisValue(std::vector<char>(data(base), data(base) + rangeLength));
+        case Error:
+            return RedisValue(std::vector<char>(data(base), data(base) + rangeLength),
+                    RedisValue::ErrorTag());
+        case Array: {
+            std::vector<RedisValue> array;
+
+            array.reserve(arrayValue.size());
+
+            for(const RedisValueView &item: arrayValue)
+            {
+                array.push_back(item.toRedisValue(base));
+            }
+
+            return RedisValue(std::move(array));
+        }
+        case Null:
+        default:
+            return RedisValue();
+    }
+}
+
+}
+
+#endif // REDISCLIENT_REDISVALUEVIEW_CPP
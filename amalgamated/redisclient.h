@@ -10,6 +10,344 @@
 #define REDIS_CLIENT_VERSION 10002 // 1.0.2
 
 
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_SMALLVECTOR_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace redisclient {
+
+// Vector with inline storage for N elements, the heap is used only when
+// it grows beyond N. Elements are stored contiguously.
+//
+// Unlike std::vector, push_front/emplace_front are provided (O(size)),
+// and SmallVector is implicitly constructible from std::deque, so the
+// API which used to take std::deque keeps accepting it.
+template<typename T, size_t N>
+class SmallVector {
+public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+    typedef size_t size_type;
+
+    SmallVector() noexcept
+        : items(inlineItems()), itemCount(0), itemCapacity(N)
+    {
+    }
+
+    SmallVector(std::initializer_list<T> list)
+        : SmallVector()
+    {
+        append(list.begin(), list.end());
+    }
+
+    SmallVector(const std::deque<T> &other)
+        : SmallVector()
+    {
+        append(other.begin(), other.end());
+    }
+
+    SmallVector(std::deque<T> &&other)
+        : SmallVector()
+    {
+        append(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+    }
+
+    SmallVector(const SmallVector &other)
+        : SmallVector()
+    {
+        append(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector &&other) noexcept
+        : SmallVector()
+    {
+        steal(other);
+    }
+
+    ~SmallVector()
+    {
+        clear();
+        freeItems();
+    }
+
+    SmallVector &operator = (const SmallVector &other)
+    {
+        if( this != &other )
+        {
+            clear();
+            append(other.begin(), other.end());
+        }
+
+        return *this;
+    }
+
+    SmallVector &operator = (SmallVector &&other) noexcept
+    {
+        if( this != &other )
+        {
+            clear();
+            freeItems();
+            steal(other);
+        }
+
+        return *this;
+    }
+
+    iterator begin() noexcept
+    {
+        return items;
+    }
+
+    iterator end() noexcept
+    {
+        return items + itemCount;
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return items;
+    }
+
+    const_iterator end() const noexcept
+    {
+        return items + itemCount;
+    }
+
+    T *data() noexcept
+    {
+        return items;
+    }
+
+    const T *data() const noexcept
+    {
+        return items;
+    }
+
+    size_t size() const noexcept
+    {
+        return itemCount;
+    }
+
+    size_t capacity() const noexcept
+    {
+        return itemCapacity;
+    }
+
+    bool empty() const noexcept
+    {
+        return itemCount == 0;
+    }
+
+    T &operator[](size_t index)
+    {
+        return items[index];
+    }
+
+    const T &operator[](size_t index) const
+    {
+        return items[index];
+    }
+
+    T &front()
+    {
+        return items[0];
+    }
+
+    const T &front() const
+    {
+        return items[0];
+    }
+
+    T &back()
+    {
+        return items[itemCount - 1];
+    }
+
+    const T &back() const
+    {
+        return items[itemCount - 1];
+    }
+
+    void reserve(size_t capacity)
+    {
+        if( capacity > itemCapacity )
+            reallocate(capacity);
+    }
+
+    void clear() noexcept
+    {
+        for(size_t i = 0; i < itemCount; ++i)
+        {
+            items[i].~T();
+        }
+
+        itemCount = 0;
+    }
+
+    void push_back(const T &value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(T &&value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template<typename ...Args>
+    void emplace_back(Args &&...args)
+    {
+        if( itemCount == itemCapacity )
+        {
+            // the argument may refer to an element, construct it first
+            T value(std::forward<Args>(args)...);
+
+            reallocate(itemCapacity * 2);
+            new (items + itemCount) T(std::move(value));
+        }
+        else
+        {
+            new (items + itemCount) T(std::forward<Args>(args)...);
+        }
+
+        ++itemCount;
+    }
+
+    void push_front(T value)
+    {
+        insert(begin(), std::move(value));
+    }
+
+    template<typename ...Args>
+    void emplace_front(Args &&...args)
+    {
+        insert(begin(), T(std::forward<Args>(args)...));
+    }
+
+    iterator insert(const_iterator position, T value)
+    {
+        size_t index = position - items;
+
+        if( itemCount == itemCapacity )
+            reallocate(itemCapacity * 2);
+
+        if( index == itemCount )
+        {
+            new (items + itemCount) T(std::move(value));
+        }
+        else
+        {
+            new (items + itemCount) T(std::move(items[itemCount - 1]));
+            std::move_backward(items + index, items + itemCount - 1, items + itemCount);
+            items[index] = std::move(value);
+        }
+
+        ++itemCount;
+        return items + index;
+    }
+
+    void pop_back()
+    {
+        items[--itemCount].~T();
+    }
+
+private:
+    T *inlineItems() noexcept
+    {
+        return reinterpret_cast<T *>(&storage);
+    }
+
+    bool isInline() const noexcept
+    {
+        return items == reinterpret_cast<const T *>(&storage);
+    }
+
+    template<typename Iterator>
+    void append(Iterator first, Iterator last)
+    {
+        reserve(itemCount + std::distance(first, last));
+
+        for(; first != last; ++first)
+        {
+            new (items + itemCount) T(*first);
+            ++itemCount;
+        }
+    }
+
+    void reallocate(size_t capacity)
+    {
+        T *newItems = static_cast<T *>(::operator new(capacity * sizeof(T)));
+
+        for(size_t i = 0; i < itemCount; ++i)
+        {
+            new (newItems + i) T(std::move(items[i]));
+            items[i].~T();
+        }
+
+        freeItems();
+        items = newItems;
+        itemCapacity = capacity;
+    }
+
+    void freeItems() noexcept
+    {
+        if( !isInline() )
+        {
+            ::operator delete(items);
+            items = inlineItems();
+            itemCapacity = N;
+        }
+    }
+
+    // this must be empty and inline
+    void steal(SmallVector &other) noexcept
+    {
+        if( other.isInline() )
+        {
+            for(size_t i = 0; i < other.itemCount; ++i)
+            {
+                new (items + i) T(std::move(other.items[i]));
+            }
+
+            itemCount = other.itemCount;
+            other.clear();
+        }
+        else
+        {
+            items = other.items;
+            itemCount = other.itemCount;
+            itemCapacity = other.itemCapacity;
+
+            other.items = other.inlineItems();
+            other.itemCount = 0;
+            other.itemCapacity = N;
+        }
+    }
+
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type storage;
+    T *items;
+    size_t itemCount;
+    size_t itemCapacity;
+};
+
+}
+
+
 /*
  * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
  * License: MIT
@@ -20,12 +358,14 @@
 #define REDISSYNCCLIENT_REDISBUFFER_H
 
 #include <boost/variant.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include <string>
 #include <vector>
 
 
 
+
 namespace redisclient {
 
 struct RedisBuffer
@@ -36,11 +376,27 @@ struct RedisBuffer
     inline RedisBuffer(std::string s);
     inline RedisBuffer(std::vector<char> buf);
 
+    // Non-owning buffer, the data is not copied:
+    //
+    //  redis.command("GET", {boost::string_ref(key.data(), key.size())});
+    //
+    // The data must be alive until the sync command returns or until
+    // Pipeline::finish() returns. The async client copies the data when
+    // the command is queued.
+    inline RedisBuffer(boost::string_ref ref);
+
     inline size_t size() const;
 
-    boost::variant<std::string,std::vector<char>> data;
+    // Return true if the buffer refers to data it does not own.
+    inline bool isRef() const;
+
+    boost::variant<std::string,std::vector<char>,boost::string_ref> data;
 };
 
+// Arguments of a command. Usual commands fit into the inline storage,
+// so no allocation is made for the list itself.
+typedef SmallVector<RedisBuffer, 8> RedisArguments;
+
 
 RedisBuffer::RedisBuffer(const char *ptr, size_t dataSize)
     : data(std::vector<char>(ptr, ptr + dataSize))
@@ -62,12 +418,27 @@ RedisBuffer::RedisBuffer(std::vector<char> buf)
 {
 }
 
+RedisBuffer::RedisBuffer(boost::string_ref ref)
+    : data(ref)
+{
+}
+
 size_t RedisBuffer::size() const
 {
-    if (data.type() == typeid(std::string))
-        return boost::get<std::string>(data).size();
-    else
-        return boost::get<std::vector<char>>(data).size();
+    switch(data.which())
+    {
+        case 0:
+            return boost::get<std::string>(data).size();
+        case 1:
+            return boost::get<std::vector<char>>(data).size();
+        default:
+            return boost::get<boost::string_ref>(data).size();
+    }
+}
+
+bool RedisBuffer::isRef() const
+{
+    return data.which() == 2;
 }
 
 }
@@ -95,7 +466,7 @@ public:
     struct ErrorTag {};
 
      RedisValue();
-     RedisValue(RedisValue &&other);
+     RedisValue(RedisValue &&other) noexcept;
      RedisValue(int64_t i);
      RedisValue(const char *s);
      RedisValue(const std::string &s);
@@ -106,7 +477,9 @@ public:
 
     RedisValue(const RedisValue &) = default;
     RedisValue& operator = (const RedisValue &) = default;
-    RedisValue& operator = (RedisValue &&) = default;
+    // noexcept, so that std::vector<RedisValue> moves the values when it
+    // grows instead of copying them with all the nested arrays
+     RedisValue& operator = (RedisValue &&other) noexcept;
 
     // Return the value as a std::string if
     // type is a byte string; otherwise returns an empty std::string.
@@ -197,126 +570,224 @@ bool RedisValue::typeEq() const
 
 
 
-
-
-
 /*
  * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
  * License: MIT
  */
 
 
-#define REDISCLIENT_REDISPARSER_H
+#define REDISCLIENT_REDISARENA_H
 
-#include <stack>
-#include <vector>
-#include <utility>
+#include <boost/noncopyable.hpp>
 
+#include <new>
+#include <type_traits>
+#include <vector>
 
 
 
 namespace redisclient {
 
-class RedisParser
-{
+// Monotonic memory arena for reply trees. Memory is carved sequentially from
+// large blocks, deallocation is a no-op and everything is freed at once by
+// release(). Not thread safe.
+//
+// Usage:
+//
+//  RedisArena arena;
+//  RedisParser parser(RedisParser::ViewMode);
+//
+//  parser.setArena(&arena);
+//  ... parse and use parser.resultView() ...
+//
+//  // all views must be destroyed before release()
+//  arena.release();
+//
+class RedisArena : boost::noncopyable {
 public:
-     RedisParser();
+     explicit RedisArena(size_t blockSize = 64 * 1024);
+     ~RedisArena();
 
-    enum ParseResult {
-        Completed,
-        Incompleted,
-        Error,
-    };
+     void *allocate(size_t size, size_t alignment);
 
-     std::pair<size_t, ParseResult> parse(const char *ptr, size_t size);
+    // Free all allocated memory. The first block is kept for the next reply.
+     void release();
 
-     RedisValue result();
+    // Number of blocks allocated from the heap.
+     size_t blockCount() const;
 
-protected:
-     std::pair<size_t, ParseResult> parseChunk(const char *ptr, size_t size);
+private:
+    size_t blockSize;
+    std::vector<void *> blocks;
+    std::vector<void *> largeBlocks;
+    char *current;
+    size_t available;
+};
 
-    inline bool isChar(int c)
+// std allocator adapter for RedisArena. Default constructed allocator
+// uses the heap, so containers behave as usual without an arena.
+template<typename T>
+class RedisArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    RedisArenaAllocator() noexcept
+        : arena(nullptr)
     {
-        return c >= 0 && c <= 127;
     }
 
-    inline bool isControl(int c)
+    explicit RedisArenaAllocator(RedisArena *arena) noexcept
+        : arena(arena)
     {
-        return (c >= 0 && c <= 31) || (c == 127);
     }
 
-     long int bufToLong(const char *str, size_t size);
-
-private:
-    enum State {
-        Start = 0,
-        StartArray = 1,
-
-        String = 2,
-        StringLF = 3,
-
-        ErrorString = 4,
-        ErrorLF = 5,
-
-        Integer = 6,
-        IntegerLF = 7,
-
-        BulkSize = 8,
-        BulkSizeLF = 9,
-        Bulk = 10,
-        BulkCR = 11,
-        BulkLF = 12,
+    template<typename U>
+    RedisArenaAllocator(const RedisArenaAllocator<U> &other) noexcept
+        : arena(other.arena)
+    {
+    }
 
-        ArraySize = 13,
-        ArraySizeLF = 14,
-    };
+    T *allocate(size_t n)
+    {
+        if( arena )
+            return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+        else
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
 
-    std::stack<State> states;
+    void deallocate(T *ptr, size_t) noexcept
+    {
+        if( arena == nullptr )
+            ::operator delete(ptr);
+    }
 
-    long int bulkSize;
-    std::vector<char> buf;
-    RedisValue redisValue;
+    template<typename U>
+    bool operator == (const RedisArenaAllocator<U> &rhs) const noexcept
+    {
+        return arena == rhs.arena;
+    }
 
-    // temporary variables
-    std::stack<long int> arraySizes;
-    std::stack<RedisValue> arrayValues;
+    template<typename U>
+    bool operator != (const RedisArenaAllocator<U> &rhs) const noexcept
+    {
+        return arena != rhs.arena;
+    }
 
-    static const char stringReply = '+';
-    static const char errorReply = '-';
-    static const char integerReply = ':';
-    static const char bulkReply = '$';
-    static const char arrayReply = '*';
+    RedisArena *arena;
 };
 
 }
 
 
 
-
-
-
 /*
  * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
  * License: MIT
  */
 
 
-#define REDISCLIENT_REDISCLIENTIMPL_H
-
-#include <boost/array.hpp>
-#include <boost/noncopyable.hpp>
-#include <boost/asio/generic/stream_protocol.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/asio/local/stream_protocol.hpp>
-#include <boost/asio/strand.hpp>
-#include <boost/asio/io_service.hpp>
+#define REDISCLIENT_REDISVALUEVIEW_H
 
 #include <string>
 #include <vector>
-#include <queue>
-#include <map>
+
+
+
+
+
+namespace redisclient {
+
+// Non-owning reply value produced by RedisParser in the view mode.
+//
+// String and error values do not hold a copy of the bytes, only an
+// (offset, length) range in the receive buffer. Offsets are counted from
+// the first byte of the reply, so the caller passes a pointer to that byte
+// as `base` to access the data.
+//
+// Arrays may be allocated from a RedisArena (see RedisParser::setArena),
+// in that case the arena must outlive the view.
+class RedisValueView {
+public:
+    typedef std::vector<RedisValueView, RedisArenaAllocator<RedisValueView> > Elements;
+
+    enum Type {
+        Null,
+        Int,
+        String,
+        Error,
+        Array,
+    };
+
+     RedisValueView();
+     RedisValueView(int64_t i);
+     RedisValueView(size_t offset, size_t length);
+     RedisValueView(size_t offset, size_t length, RedisValue::ErrorTag);
+     RedisValueView(Elements array);
+
+    // Return type of the value.
+     Type type() const;
+
+    // Return true if value not a error
+     bool isOk() const;
+    // Return true if value is a error
+     bool isError() const;
+    // Return true if this is a null.
+     bool isNull() const;
+    // Return true if type is an int
+     bool isInt() const;
+    // Return true if type is a string/byte array (error strings are excluded).
+     bool isString() const;
+    // Return true if type is an array
+     bool isArray() const;
+
+    // Return the value as an int if type is an int; otherwise returns 0.
+     int64_t toInt() const;
+
+    // Byte range of a string or error value, relative to the first byte
+    // of the reply. Both are 0 for other types.
+     size_t offset() const;
+     size_t length() const;
+
+    // Return pointer to the string data inside the receive buffer.
+     const char *data(const char *base) const;
+
+    // Return a copy of the string data if type is a string or an error;
+    // otherwise returns an empty std::string.
+     std::string toString(const char *base) const;
+
+    // Throws: boost::bad_get if the type is not an array
+     Elements &getArray();
+     const Elements &getArray() const;
+
+    // Build the owning value. This is the only place where string data
+    // is copied out of the receive buffer.
+     RedisValue toRedisValue(const char *base) const;
+
+private:
+    Type valueType;
+    int64_t intValue;
+    size_t rangeOffset;
+    size_t rangeLength;
+    Elements arrayValue;
+};
+
+}
+
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISPARSER_H
+
 #include <functional>
-#include <memory>
+#include <vector>
+#include <utility>
 
 
 
@@ -324,173 +795,2478 @@ private:
 
 namespace redisclient {
 
-class RedisClientImpl : public std::enable_shared_from_this<RedisClientImpl> {
+class RedisParser
+{
 public:
-    enum class State {
-        Unconnected,
-        Connecting,
-        Connected,
-        Subscribed,
-        Closed
+    enum Mode {
+        // Build RedisValue, string data is copied.
+        ValueMode,
+        // Build RedisValueView, string data stays in the caller's buffer.
+        ViewMode,
     };
 
-     RedisClientImpl(boost::asio::io_service &ioService);
-     ~RedisClientImpl();
+     RedisParser();
+     explicit RedisParser(Mode mode);
 
-     void handleAsyncConnect(
-            const boost::system::error_code &ec,
-            std::function<void(boost::system::error_code)> handler);
+    enum ParseResult {
+        Completed,
+        Incompleted,
+        Error,
+    };
 
-     size_t subscribe(const std::string &command,
-        const std::string &channel,
-        std::function<void(std::vector<char> msg)> msgHandler,
-        std::function<void(RedisValue)> handler);
+     std::pair<size_t, ParseResult> parse(const char *ptr, size_t size);
 
-     void singleShotSubscribe(const std::string &command,
-        const std::string &channel,
-        std::function<void(std::vector<char> msg)> msgHandler,
-        std::function<void(RedisValue)> handler);
+     RedisValue result();
 
-     void unsubscribe(const std::string &command,
-        size_t handle_id, const std::string &channel,
-        std::function<void(RedisValue)> handler);
+    // Return the parsed value in the view mode. Views are relative to the
+    // first byte of the reply, so all bytes of the reply must be kept in one
+    // contiguous buffer until the view is no longer used.
+     RedisValueView resultView();
 
-     void close() noexcept;
+    // Allocate arrays of the view mode replies from the arena, so a reply
+    // tree takes one or a few arena blocks instead of an allocation per
+    // array. Pass nullptr to allocate from the heap again.
+     void setArena(RedisArena *arena);
 
-     State getState() const;
+    // Pass elements of the next reply to the handler one by one as soon as
+    // they are parsed, instead of collecting them. Applies only if the reply
+    // is an array, its result is an empty array then. Value mode only.
+     void streamNextReply(std::function<void(RedisValue)> handler);
 
-     static std::vector<char> makeCommand(const std::deque<RedisBuffer> &items);
+    // Pass payload of the next reply to the sink chunk by chunk as it
+    // arrives, instead of collecting it. Applies only if the reply is a bulk
+    // string, its result is an empty string then (or a null).
+     void sinkNextReply(std::function<void(const char *, size_t)> sink);
 
-     RedisValue doSyncCommand(const std::deque<RedisBuffer> &command,
-        const boost::posix_time::time_duration &timeout,
-        boost::system::error_code &ec);
-     RedisValue doSyncCommand(const std::deque<std::deque<RedisBuffer>> &commands,
-        const boost::posix_time::time_duration &timeout,
-        boost::system::error_code &ec);
-     RedisValue syncReadResponse(
-            const boost::posix_time::time_duration &timeout,
-            boost::system::error_code &ec);
+    // Number of bytes still expected for the bulk string being parsed
+    // (including the trailing CRLF), or 0 if a bulk string is not in
+    // progress. Lets the caller size the next read.
+     size_t pendingBulkSize() const;
 
-     void doAsyncCommand(
-            std::vector<char> buff,
-            std::function<void(RedisValue)> handler);
+protected:
+     std::pair<size_t, ParseResult> parseChunk(const char *ptr, size_t size);
 
-     void sendNextCommand();
-     void processMessage();
-     void doProcessMessage(RedisValue v);
-     void asyncWrite(const boost::system::error_code &ec, const size_t);
-     void asyncRead(const boost::system::error_code &ec, const size_t);
+    inline bool isChar(int c)
+    {
+        return c >= 0 && c <= 127;
+    }
 
-     void onRedisError(const RedisValue &);
-     static void defaulErrorHandler(const std::string &s);
+    inline bool isControl(int c)
+    {
+        return (c >= 0 && c <= 31) || (c == 127);
+    }
 
-    template<typename Handler>
-    inline void post(const Handler &handler);
+     long int bufToLong(const char *str, size_t size);
 
-    boost::asio::io_service &ioService;
-    boost::asio::io_service::strand strand;
-    boost::asio::generic::stream_protocol::socket socket;
-    RedisParser redisParser;
-    boost::array<char, 4096> buf;
-    size_t bufSize; // only for sync
-    size_t subscribeSeq;
+private:
+     void reserve();
+    // Drop everything of the reply being parsed, called when a reply is
+    // completed or fails to parse, so the next one starts clean.
+     void reset();
+     bool streamElement(RedisValue &value);
+     bool streamElement(RedisValueView &value);
+     bool sinkBulk() const;
 
-    typedef std::pair<size_t, std::function<void(const std::vector<char> &buf)> > MsgHandlerType;
-    typedef std::function<void(const std::vector<char> &buf)> SingleShotHandlerType;
+    template<typename Value>
+    inline void appendToArray(std::vector<Value> &arrays, Value &value);
 
-    typedef std::multimap<std::string, MsgHandlerType> MsgHandlersMap;
-    typedef std::multimap<std::string, SingleShotHandlerType> SingleShotHandlersMap;
+    enum State {
+        Start = 0,
+        StartArray = 1,
 
-    std::queue<std::function<void(RedisValue)> > handlers;
-    std::deque<std::vector<char>> dataWrited;
-    std::deque<std::vector<char>> dataQueued;
-    MsgHandlersMap msgHandlers;
-    SingleShotHandlersMap singleShotMsgHandlers;
+        String = 2,
+        StringLF = 3,
 
-    std::function<void(const std::string &)> errorHandler;
-    State state;
+        ErrorString = 4,
+        ErrorLF = 5,
+
+        Integer = 6,
+        IntegerLF = 7,
+
+        BulkSize = 8,
+        BulkSizeLF = 9,
+        Bulk = 10,
+        BulkCR = 11,
+        BulkLF = 12,
+
+        ArraySize = 13,
+        ArraySizeLF = 14,
+    };
+
+    std::vector<State> states;
+
+    Mode mode;
+    RedisArena *arena;
+    long int bulkSize;
+    std::vector<char> buf;
+    std::vector<char> bulk; // moved to the RedisValue when completed
+    RedisValue redisValue;
+    RedisValueView redisValueView;
+    std::function<void(RedisValue)> elementHandler;
+    std::function<void(const char *, size_t)> bulkSink;
+
+    // offset of the current chunk from the start of the reply and
+    // offset of the current string value (view mode only)
+    size_t offset;
+    size_t stringOffset;
+
+    // temporary variables
+    std::vector<long int> arraySizes;
+    std::vector<RedisValue> arrayValues;
+    std::vector<RedisValueView> arrayViews;
+
+    static const char stringReply = '+';
+    static const char errorReply = '-';
+    static const char integerReply = ':';
+    static const char bulkReply = '$';
+    static const char arrayReply = '*';
 };
 
-template<typename Handler>
-inline void RedisClientImpl::post(const Handler &handler)
+}
+
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISCOMMAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/asio/buffer.hpp>
+
+#include <deque>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+
+namespace redisclient
+{
+
+namespace detail
 {
-    strand.post(handler);
+
+// Command serializer. The encoded size is computed first, so a command is
+// written into the output buffer with a single resize and no reallocations:
+//
+//  *<items>\r\n
+//  $<size>\r\n<data>\r\n   (for every item)
+//
+// Arguments of spliceThreshold bytes and more are not copied to the buffer,
+// they are written from their own memory by a gather write (see Splice).
+//
+// Items of a command are any range of RedisBuffer or boost::string_ref.
+
+static const size_t spliceThreshold = 16 * 1024;
+
+// Argument data written from its own memory at the offset of the command
+// buffer. The argument must be alive until the buffer is written.
+struct Splice
+{
+    size_t offset;
+    const char *ptr;
+    size_t size;
+};
+
+// Number of decimal digits in value.
+inline size_t decimalLength(uint64_t value)
+{
+    size_t length = 1;
+
+    for(;;)
+    {
+        if( value < 10 )
+            return length;
+        if( value < 100 )
+            return length + 1;
+        if( value < 1000 )
+            return length + 2;
+        if( value < 10000 )
+            return length + 3;
+
+        value /= 10000;
+        length += 4;
+    }
 }
 
-inline std::string to_string(RedisClientImpl::State state)
+// Write exactly `length` (see decimalLength) digits of value to out,
+// two digits at a time. Returns pointer past the last digit.
+inline char *formatDecimal(char *out, uint64_t value, size_t length)
 {
-    switch(state)
+    static const char digits[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    char *end = out + length;
+    char *pos = end;
+
+    while( value >= 100 )
     {
-        case RedisClientImpl::State::Unconnected:
-            return "Unconnected";
-            break;
-        case RedisClientImpl::State::Connecting:
-            return "Connecting";
-            break;
-        case RedisClientImpl::State::Connected:
-            return "Connected";
-            break;
-        case RedisClientImpl::State::Subscribed:
-            return "Subscribed";
-            break;
-        case RedisClientImpl::State::Closed:
-            return "Closed";
-            break;
+        size_t index = (value % 100) * 2;
+
+        value /= 100;
+        *--pos = digits[index + 1];
+        *--pos = digits[index];
     }
 
-    return "Invalid";
+    if( value >= 10 )
+    {
+        size_t index = value * 2;
+
+        *--pos = digits[index + 1];
+        *--pos = digits[index];
+    }
+    else
+    {
+        *--pos = static_cast<char>('0' + value);
+    }
+
+    return end;
+}
+
+// Size of "<prefix><value>\r\n".
+inline size_t headerSize(uint64_t value)
+{
+    return 1 + decimalLength(value) + 2;
+}
+
+inline char *writeHeader(char *out, char prefix, uint64_t value)
+{
+    *out++ = prefix;
+    out = formatDecimal(out, value, decimalLength(value));
+    *out++ = '\r';
+    *out++ = '\n';
+
+    return out;
+}
+
+inline void bufferData(const boost::string_ref &ref, const char *&ptr, size_t &size)
+{
+    ptr = ref.data();
+    size = ref.size();
+}
+
+inline void bufferData(const RedisBuffer &buffer, const char *&ptr, size_t &size)
+{
+    if( const std::string *s = boost::get<std::string>(&buffer.data) )
+    {
+        ptr = s->data();
+        size = s->size();
+    }
+    else if( const boost::string_ref *ref = boost::get<boost::string_ref>(&buffer.data) )
+    {
+        ptr = ref->data();
+        size = ref->size();
+    }
+    else
+    {
+        const std::vector<char> &v = boost::get<std::vector<char>>(buffer.data);
+
+        ptr = v.data();
+        size = v.size();
+    }
+}
+
+// Arguments of the variadic command(), passed as references.
+inline boost::string_ref argumentRef(const std::string &s)
+{
+    return boost::string_ref(s);
+}
+
+inline boost::string_ref argumentRef(const char *s)
+{
+    return boost::string_ref(s);
 }
+
+inline boost::string_ref argumentRef(const std::vector<char> &v)
+{
+    return boost::string_ref(v.data(), v.size());
 }
 
+inline boost::string_ref argumentRef(boost::string_ref ref)
+{
+    return ref;
+}
+
+inline boost::string_ref argumentRef(const RedisBuffer &buffer)
+{
+    const char *ptr;
+    size_t size;
+
+    bufferData(buffer, ptr, size);
+    return boost::string_ref(ptr, size);
+}
+
+// True if all types are valid arguments of the variadic command().
+template<typename ...Args>
+struct AreArguments;
+
+template<>
+struct AreArguments<> : std::true_type
+{
+};
+
+template<typename Arg, typename ...Args>
+struct AreArguments<Arg, Args...> : std::integral_constant<bool,
+    std::is_convertible<Arg, RedisBuffer>::value && AreArguments<Args...>::value>
+{
+};
+
+// Arguments of the variadic command() as one list, the command first.
+template<typename ...Args>
+inline RedisArguments makeArguments(std::string cmd, Args &&...args)
+{
+    RedisArguments items;
+
+    items.reserve(1 + sizeof...(Args));
+    items.emplace_back(std::move(cmd));
+
+    // expand the arguments in order
+    int expand[] = {0, (items.emplace_back(std::forward<Args>(args)), 0)...};
+    (void)expand;
+
+    return items;
+}
+
+// Replace non-owning buffers with copies of the data, for commands which
+// outlive the arguments.
+template<typename Items>
+inline void copyRefs(Items &items)
+{
+    for(RedisBuffer &item: items)
+    {
+        if( item.isRef() )
+        {
+            const boost::string_ref &ref = boost::get<boost::string_ref>(item.data);
+            item.data = std::string(ref.data(), ref.size());
+        }
+    }
+}
+
+// Exact size of the encoded command, without arguments of spliceLimit
+// bytes and more.
+template<typename Items>
+inline size_t commandSize(const Items &items,
+        size_t spliceLimit = SIZE_MAX)
+{
+    size_t result = headerSize(items.size());
+
+    for(const auto &item: items)
+    {
+        size_t size = item.size();
+
+        result += headerSize(size) + 2;
+        if( size < spliceLimit )
+            result += size;
+    }
+
+    return result;
+}
+
+// Encode the command to out, which must have commandSize(items) bytes.
+// Returns pointer past the last written byte.
+template<typename Items>
+inline char *writeCommand(char *out, const Items &items)
+{
+    out = writeHeader(out, '*', items.size());
+
+    for(const auto &item: items)
+    {
+        const char *ptr;
+        size_t size;
+
+        bufferData(item, ptr, size);
+
+        out = writeHeader(out, '$', size);
+        if( size > 0 )
+            memcpy(out, ptr, size);
+        out += size;
+        *out++ = '\r';
+        *out++ = '\n';
+    }
+
+    return out;
+}
+
+// Append the encoded command to the buffer, the buffer grows at most once.
+template<typename Items>
+inline void appendCommand(std::vector<char> &buffer, const Items &items)
+{
+    size_t offset = buffer.size();
+
+    buffer.resize(offset + commandSize(items));
+    writeCommand(buffer.data() + offset, items);
+}
+
+// Append the encoded command to the buffer, big arguments are appended to
+// splices instead.
+template<typename Items>
+inline void appendCommand(std::vector<char> &buffer, std::vector<Splice> &splices,
+        const Items &items)
+{
+    size_t offset = buffer.size();
+
+    buffer.resize(offset + commandSize(items, spliceThreshold));
+
+    char *base = buffer.data();
+    char *out = writeHeader(base + offset, '*', items.size());
+
+    for(const auto &item: items)
+    {
+        const char *ptr;
+        size_t size;
+
+        bufferData(item, ptr, size);
+
+        out = writeHeader(out, '$', size);
+        if( size >= spliceThreshold )
+        {
+            Splice splice = {static_cast<size_t>(out - base), ptr, size};
+            splices.push_back(splice);
+        }
+        else
+        {
+            if( size > 0 )
+                memcpy(out, ptr, size);
+            out += size;
+        }
+        *out++ = '\r';
+        *out++ = '\n';
+    }
+}
+
+// Gather list of the buffer with the splices inserted.
+inline void gatherBuffers(const std::vector<char> &buffer, const std::vector<Splice> &splices,
+        std::vector<boost::asio::const_buffer> &buffers)
+{
+    size_t offset = 0;
+
+    for(const Splice &splice: splices)
+    {
+        buffers.push_back(boost::asio::buffer(buffer.data() + offset, splice.offset - offset));
+        buffers.push_back(boost::asio::buffer(splice.ptr, splice.size));
+        offset = splice.offset;
+    }
+
+    if( offset < buffer.size() )
+        buffers.push_back(boost::asio::buffer(buffer.data() + offset, buffer.size() - offset));
+}
+
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISCOMMANDENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+#include <vector>
+
+
+
+namespace redisclient {
+
+namespace detail
+{
+
+// Compile time strings as character packs.
+template<char ...C>
+struct Chars
+{
+    static const size_t size = sizeof...(C);
+    static const char value[sizeof...(C)];
+};
+
+template<char ...C>
+const char Chars<C...>::value[sizeof...(C)] = {C...};
+
+template<typename ...Strings>
+struct Concat;
+
+template<char ...A>
+struct Concat<Chars<A...>>
+{
+    typedef Chars<A...> type;
+};
+
+template<char ...A, char ...B, typename ...Rest>
+struct Concat<Chars<A...>, Chars<B...>, Rest...>
+{
+    typedef typename Concat<Chars<A..., B...>, Rest...>::type type;
+};
+
+template<size_t N, char ...Digits>
+struct DecimalChars
+{
+    typedef typename DecimalChars<N / 10, static_cast<char>('0' + N % 10), Digits...>::type type;
+};
+
+template<char ...Digits>
+struct DecimalChars<0, Digits...>
+{
+    typedef Chars<Digits...> type;
+};
+
+template<>
+struct DecimalChars<0>
+{
+    typedef Chars<'0'> type;
+};
+
+// "*<items>\r\n$<name size>\r\n<name>\r\n"
+template<size_t Items, char ...Name>
+struct CommandPrefix
+{
+    typedef typename Concat<
+        Chars<'*'>, typename DecimalChars<Items>::type, Chars<'\r', '\n', '$'>,
+        typename DecimalChars<sizeof...(Name)>::type, Chars<'\r', '\n'>,
+        Chars<Name...>, Chars<'\r', '\n'>
+    >::type type;
+};
+
+// Integer arguments are formatted in place, other ones are anything
+// RedisBuffer is constructible from.
+template<typename T>
+struct IsIntegerArgument : std::integral_constant<bool,
+    std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>
+{
+};
+
+template<typename T>
+inline typename std::enable_if<std::is_signed<T>::value, bool>::type
+isNegative(T value)
+{
+    return value < 0;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_unsigned<T>::value, bool>::type
+isNegative(T)
+{
+    return false;
+}
+
+template<typename T>
+inline uint64_t integerMagnitude(T value)
+{
+    return isNegative(value) ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+}
+
+template<typename T>
+inline typename std::enable_if<IsIntegerArgument<T>::value, size_t>::type
+encodedArgumentSize(const T &value)
+{
+    size_t length = decimalLength(integerMagnitude(value)) + (isNegative(value) ? 1 : 0);
+
+    return headerSize(length) + length + 2;
+}
+
+template<typename T>
+inline typename std::enable_if<!IsIntegerArgument<T>::value, size_t>::type
+encodedArgumentSize(const T &value)
+{
+    size_t size = argumentRef(value).size();
+
+    return headerSize(size) + size + 2;
+}
+
+template<typename T>
+inline typename std::enable_if<IsIntegerArgument<T>::value, char *>::type
+writeArgument(char *out, const T &value)
+{
+    uint64_t magnitude = integerMagnitude(value);
+    size_t digits = decimalLength(magnitude);
+
+    out = writeHeader(out, '$', digits + (isNegative(value) ? 1 : 0));
+    if( isNegative(value) )
+        *out++ = '-';
+    out = formatDecimal(out, magnitude, digits);
+    *out++ = '\r';
+    *out++ = '\n';
+
+    return out;
+}
+
+template<typename T>
+inline typename std::enable_if<!IsIntegerArgument<T>::value, char *>::type
+writeArgument(char *out, const T &value)
+{
+    boost::string_ref ref = argumentRef(value);
+
+    out = writeHeader(out, '$', ref.size());
+    if( ref.size() > 0 )
+        memcpy(out, ref.data(), ref.size());
+    out += ref.size();
+    *out++ = '\r';
+    *out++ = '\n';
+
+    return out;
+}
+
+template<typename ...Args>
+struct AreEncoderArguments;
+
+template<>
+struct AreEncoderArguments<> : std::true_type
+{
+};
+
+template<typename Arg, typename ...Args>
+struct AreEncoderArguments<Arg, Args...> : std::integral_constant<bool,
+    (IsIntegerArgument<typename std::decay<Arg>::type>::value ||
+     std::is_convertible<Arg, RedisBuffer>::value) &&
+    AreEncoderArguments<Args...>::value>
+{
+};
+
+}
+
+// Encoder of a command with the name known at compile time. The header
+// with the number of items and the name is a constant, only arguments
+// are formatted at runtime. Integer arguments are formatted in place.
+//
+// Usage:
+//
+//  std::vector<char> buffer;
+//
+//  encoders::Get::append(buffer, "key");
+//  encoders::IncrBy::append(buffer, "counter", 10);
+//
+//  redis.command(encoders::Set(), "key", "value");  // see RedisSyncClient
+//
+template<char ...Name>
+class RedisCommandEncoder {
+public:
+    // Exact size of the encoded command.
+    template<typename ...Args>
+    static size_t size(const Args &...args)
+    {
+        typedef typename detail::CommandPrefix<1 + sizeof...(Args), Name...>::type Prefix;
+        size_t result = Prefix::size;
+
+        // expand the arguments in order
+        int expand[] = {0, (result += detail::encodedArgumentSize(args), 0)...};
+        (void)expand;
+
+        return result;
+    }
+
+    // Encode the command to out, which must have size(args...) bytes.
+    // Returns pointer past the last written byte.
+    template<typename ...Args>
+    static char *write(char *out, const Args &...args)
+    {
+        typedef typename detail::CommandPrefix<1 + sizeof...(Args), Name...>::type Prefix;
+
+        memcpy(out, Prefix::value, Prefix::size);
+        out += Prefix::size;
+
+        int expand[] = {0, (out = detail::writeArgument(out, args), 0)...};
+        (void)expand;
+
+        return out;
+    }
+
+    // Append the encoded command to the buffer.
+    template<typename ...Args>
+    static void append(std::vector<char> &buffer, const Args &...args)
+    {
+        size_t offset = buffer.size();
+
+        buffer.resize(offset + size(args...));
+        write(buffer.data() + offset, args...);
+    }
+
+    template<typename ...Args>
+    static std::vector<char> encode(const Args &...args)
+    {
+        std::vector<char> result;
+
+        append(result, args...);
+        return result;
+    }
+};
+
+// Encoders of the most used commands.
+namespace encoders
+{
+typedef RedisCommandEncoder<'G', 'E', 'T'> Get;
+typedef RedisCommandEncoder<'S', 'E', 'T'> Set;
+typedef RedisCommandEncoder<'D', 'E', 'L'> Del;
+typedef RedisCommandEncoder<'E', 'X', 'P', 'I', 'R', 'E'> Expire;
+typedef RedisCommandEncoder<'I', 'N', 'C', 'R', 'B', 'Y'> IncrBy;
+typedef RedisCommandEncoder<'H', 'G', 'E', 'T'> HGet;
+typedef RedisCommandEncoder<'H', 'S', 'E', 'T'> HSet;
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_SUBMISSIONQUEUE_H
+
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Lock-free multi-producer single-consumer queue of heap allocated nodes.
+// Producers push nodes one by one from any thread, the consumer takes all
+// of them at once, oldest first. Node must have a `Node *next` member.
+template<typename Node>
+class SubmissionQueue : boost::noncopyable
+{
+public:
+    SubmissionQueue()
+        : head(nullptr)
+    {
+    }
+
+    ~SubmissionQueue()
+    {
+        Node *node = takeAll();
+
+        while( node )
+        {
+            Node *next = node->next;
+
+            delete node;
+            node = next;
+        }
+    }
+
+    // Returns true if the queue was empty, so the pusher is the one to
+    // wake up the consumer.
+    bool push(Node *node)
+    {
+        Node *top = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            node->next = top;
+        }
+        while( !head.compare_exchange_weak(top, node,
+                    std::memory_order_release, std::memory_order_relaxed) );
+
+        return top == nullptr;
+    }
+
+    // Push the nodes from first to last, linked by next, at once.
+    void pushAll(Node *first, Node *last)
+    {
+        Node *top = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            last->next = top;
+        }
+        while( !head.compare_exchange_weak(top, first,
+                    std::memory_order_release, std::memory_order_relaxed) );
+    }
+
+    // Take all queued nodes, oldest first, the caller owns them.
+    Node *takeAll()
+    {
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        Node *first = nullptr;
+
+        // nodes are pushed to the head, reverse them
+        while( node )
+        {
+            Node *next = node->next;
+
+            node->next = first;
+            first = node;
+            node = next;
+        }
+
+        return first;
+    }
+
+private:
+    std::atomic<Node *> head;
+};
+
+// Free nodes of one thread. When it runs out, it takes all nodes returned
+// to a SubmissionQueue at once, so nodes are reused without a lock.
+template<typename Node>
+class NodeCache : boost::noncopyable
+{
+public:
+    NodeCache()
+        : head(nullptr)
+    {
+    }
+
+    ~NodeCache()
+    {
+        while( head )
+        {
+            Node *next = head->next;
+
+            delete head;
+            head = next;
+        }
+    }
+
+    // Take a node, from returned if the cache is empty, nullptr if both
+    // are.
+    Node *pop(SubmissionQueue<Node> &returned)
+    {
+        if( head == nullptr )
+            head = returned.takeAll();
+
+        Node *node = head;
+
+        if( node )
+            head = node->next;
+
+        return node;
+    }
+
+private:
+    Node *head;
+};
+
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_COMPLETIONSLOTS_H
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Reply handler, a type erased void(RedisValue) callable. Callables of up
+// to inlineSize bytes (a lambda capturing a few pointers and strings, or a
+// std::function) are stored in place, bigger ones on the heap.
+class ReplyCallback
+{
+public:
+    static const size_t inlineSize = 64;
+
+    ReplyCallback() noexcept
+        : ops(nullptr)
+    {
+    }
+
+    ReplyCallback(std::nullptr_t) noexcept
+        : ops(nullptr)
+    {
+    }
+
+    template<typename F, typename = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, ReplyCallback>::value>::type>
+    ReplyCallback(F &&f)
+        : ops(nullptr)
+    {
+        typedef typename std::decay<F>::type Callable;
+
+        construct<Callable>(std::forward<F>(f),
+                std::integral_constant<bool, isInline<Callable>()>());
+    }
+
+    ReplyCallback(ReplyCallback &&other) noexcept
+        : ops(other.ops)
+    {
+        if( ops )
+        {
+            ops->move(&other.storage, &storage);
+            other.ops = nullptr;
+        }
+    }
+
+    ReplyCallback &operator=(ReplyCallback &&other) noexcept
+    {
+        if( this != &other )
+        {
+            reset();
+
+            if( other.ops )
+            {
+                other.ops->move(&other.storage, &storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    ~ReplyCallback()
+    {
+        reset();
+    }
+
+    explicit operator bool() const
+    {
+        return ops != nullptr;
+    }
+
+    void operator()(RedisValue value)
+    {
+        ops->invoke(&storage, std::move(value));
+    }
+
+    template<typename Callable>
+    static constexpr bool isInline()
+    {
+        return sizeof(Callable) <= inlineSize &&
+            alignof(Callable) <= alignof(Storage) &&
+            std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+private:
+    typedef typename std::aligned_storage<inlineSize>::type Storage;
+
+    struct Ops
+    {
+        void (*invoke)(void *storage, RedisValue &&value);
+        // Move constructs to `to` and destroys `from`.
+        void (*move)(void *from, void *to);
+        void (*destroy)(void *storage);
+    };
+
+    template<typename Callable>
+    struct InlineOps
+    {
+        static void invoke(void *storage, RedisValue &&value)
+        {
+            (*static_cast<Callable *>(storage))(std::move(value));
+        }
+
+        static void move(void *from, void *to)
+        {
+            Callable *callable = static_cast<Callable *>(from);
+
+            new (to) Callable(std::move(*callable));
+            callable->~Callable();
+        }
+
+        static void destroy(void *storage)
+        {
+            static_cast<Callable *>(storage)->~Callable();
+        }
+
+        static const Ops ops;
+    };
+
+    template<typename Callable>
+    struct HeapOps
+    {
+        static void invoke(void *storage, RedisValue &&value)
+        {
+            (**static_cast<Callable **>(storage))(std::move(value));
+        }
+
+        static void move(void *from, void *to)
+        {
+            new (to) Callable *(*static_cast<Callable **>(from));
+        }
+
+        static void destroy(void *storage)
+        {
+            delete *static_cast<Callable **>(storage);
+        }
+
+        static const Ops ops;
+    };
+
+    template<typename Callable, typename F>
+    void construct(F &&f, std::true_type)
+    {
+        new (&storage) Callable(std::forward<F>(f));
+        ops = &InlineOps<Callable>::ops;
+    }
+
+    template<typename Callable, typename F>
+    void construct(F &&f, std::false_type)
+    {
+        Callable *callable = new Callable(std::forward<F>(f));
+
+        new (&storage) Callable *(callable);
+        ops = &HeapOps<Callable>::ops;
+    }
+
+    void reset() noexcept
+    {
+        if( ops )
+        {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+    Storage storage;
+    const Ops *ops;
+};
+
+template<typename Callable>
+const ReplyCallback::Ops ReplyCallback::InlineOps<Callable>::ops = {
+    &InlineOps<Callable>::invoke, &InlineOps<Callable>::move, &InlineOps<Callable>::destroy
+};
+
+template<typename Callable>
+const ReplyCallback::Ops ReplyCallback::HeapOps<Callable>::ops = {
+    &HeapOps<Callable>::invoke, &HeapOps<Callable>::move, &HeapOps<Callable>::destroy
+};
+
+// FIFO of completion slots in a ring buffer. Slots are allocated once
+// and reused by the following commands, the ring doubles when all of them
+// are in use and never shrinks, so a connection stops allocating as soon
+// as it has seen its maximum number of commands in flight.
+template<typename T>
+class CompletionRing : boost::noncopyable
+{
+public:
+    static const size_t defaultCapacity = 64;
+
+    explicit CompletionRing(size_t capacity = defaultCapacity)
+        : slots(nullptr), mask(0), head(0), count(0)
+    {
+        size_t size = 1;
+
+        while( size < capacity )
+            size *= 2;
+
+        slots = allocate(size);
+        mask = size - 1;
+    }
+
+    ~CompletionRing()
+    {
+        clear();
+        ::operator delete(slots);
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    T &front()
+    {
+        return slots[head];
+    }
+
+    void push(T &&value)
+    {
+        if( count == capacity() )
+            grow();
+
+        new (&slots[(head + count) & mask]) T(std::move(value));
+        ++count;
+    }
+
+    void pop()
+    {
+        slots[head].~T();
+        head = (head + 1) & mask;
+        --count;
+    }
+
+    // Destroy all queued items, the slots are kept.
+    void clear()
+    {
+        while( !empty() )
+            pop();
+
+        head = 0;
+    }
+
+private:
+    static T *allocate(size_t size)
+    {
+        return static_cast<T *>(::operator new(size * sizeof(T)));
+    }
+
+    void grow()
+    {
+        size_t size = capacity() * 2;
+        T *grown = allocate(size);
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            T &slot = slots[(head + i) & mask];
+
+            new (&grown[i]) T(std::move(slot));
+            slot.~T();
+        }
+
+        ::operator delete(slots);
+        slots = grown;
+        mask = size - 1;
+        head = 0;
+    }
+
+    T *slots;
+    size_t mask;
+    size_t head;
+    size_t count;
+};
+
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_HANDLERMEMORY_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <boost/version.hpp>
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Memory of one asynchronous operation at a time, the next operation
+// reuses it. An operation started while the memory is taken, or too big
+// for it, is allocated on the heap.
+class HandlerMemory : boost::noncopyable
+{
+public:
+    static const size_t size = 256;
+
+    HandlerMemory()
+        : inUse(false)
+    {
+    }
+
+    void *allocate(size_t bytes)
+    {
+        if( bytes <= size && inUse.exchange(true, std::memory_order_acquire) == false )
+            return &storage;
+        else
+            return ::operator new(bytes);
+    }
+
+    void deallocate(void *ptr)
+    {
+        if( ptr == &storage )
+            inUse.store(false, std::memory_order_release);
+        else
+            ::operator delete(ptr);
+    }
+
+private:
+    typename std::aligned_storage<size>::type storage;
+    std::atomic<bool> inUse;
+};
+
+// Allocator of the operations of an AllocatingHandler.
+template<typename T>
+class HandlerAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit HandlerAllocator(HandlerMemory &memory)
+        : memory(&memory)
+    {
+    }
+
+    template<typename U>
+    HandlerAllocator(const HandlerAllocator<U> &other)
+        : memory(other.memory)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(memory->allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T *ptr, size_t)
+    {
+        memory->deallocate(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const HandlerAllocator<U> &other) const
+    {
+        return memory == other.memory;
+    }
+
+    template<typename U>
+    bool operator!=(const HandlerAllocator<U> &other) const
+    {
+        return memory != other.memory;
+    }
+
+private:
+    template<typename> friend class HandlerAllocator;
+
+    HandlerMemory *memory;
+};
+
+// Handler whose operation is allocated from a HandlerMemory, by its
+// associated allocator.
+template<typename Handler>
+class AllocatingHandler
+{
+public:
+    typedef HandlerAllocator<Handler> allocator_type;
+
+    AllocatingHandler(HandlerMemory &memory, Handler handler)
+        : memory(&memory), handler(std::move(handler))
+    {
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(*memory);
+    }
+
+    template<typename ...Args>
+    void operator()(Args &&...args)
+    {
+        handler(std::forward<Args>(args)...);
+    }
+
+#if BOOST_VERSION < 106600
+    // boost::asio before associated allocators
+    friend void *asio_handler_allocate(size_t bytes, AllocatingHandler *self)
+    {
+        return self->memory->allocate(bytes);
+    }
+
+    friend void asio_handler_deallocate(void *ptr, size_t, AllocatingHandler *self)
+    {
+        self->memory->deallocate(ptr);
+    }
+#endif
+
+private:
+    HandlerMemory *memory;
+    Handler handler;
+};
+
+template<typename Handler>
+inline AllocatingHandler<typename std::decay<Handler>::type> makeAllocatingHandler(
+        HandlerMemory &memory, Handler &&handler)
+{
+    return AllocatingHandler<typename std::decay<Handler>::type>(
+            memory, std::forward<Handler>(handler));
+}
+
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISCLIENTIMPL_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/deadline_timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <memory>
+
+
+
+
+
+
+
+
+
+namespace redisclient {
+
+class RedisClientImpl : public std::enable_shared_from_this<RedisClientImpl> {
+public:
+    enum class State {
+        Unconnected,
+        Connecting,
+        Connected,
+        Subscribed,
+        Closed
+    };
+
+    struct ReplyHandler {
+        detail::ReplyCallback handler;
+        // Optional, called for every element of an array reply
+        // (see RedisParser::streamNextReply).
+        std::function<void(RedisValue)> elementHandler;
+        // Optional, receives the payload of a bulk string reply
+        // (see RedisParser::sinkNextReply).
+        std::function<void(const char *, size_t)> bulkSink;
+    };
+
+     RedisClientImpl(boost::asio::io_service &ioService);
+     ~RedisClientImpl();
+
+     void handleAsyncConnect(
+            const boost::system::error_code &ec,
+            std::function<void(boost::system::error_code)> handler);
+
+     size_t subscribe(const std::string &command,
+        const std::string &channel,
+        std::function<void(std::vector<char> msg)> msgHandler,
+        std::function<void(RedisValue)> handler);
+
+     void singleShotSubscribe(const std::string &command,
+        const std::string &channel,
+        std::function<void(std::vector<char> msg)> msgHandler,
+        std::function<void(RedisValue)> handler);
+
+     void unsubscribe(const std::string &command,
+        size_t handle_id, const std::string &channel,
+        std::function<void(RedisValue)> handler);
+
+     void close() noexcept;
+
+     State getState() const;
+
+     static std::vector<char> makeCommand(const std::deque<RedisBuffer> &items);
+
+     RedisValue doSyncCommand(const RedisArguments &command,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec);
+     RedisValue doSyncCommand(const boost::string_ref *items, size_t size,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec);
+    // Send the command encoded to writeBuffer.
+     RedisValue doSyncEncodedCommand(
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec);
+     RedisValue doSyncCommand(const std::vector<RedisArguments> &commands,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec);
+
+    // Time limit of a sync command or pipeline as a whole, on a monotonic
+    // clock. All writes and reads of the command share it.
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+     static Deadline makeDeadline(
+            const boost::posix_time::time_duration &timeout);
+     void syncWriteBuffer(
+            const Deadline &deadline,
+            boost::system::error_code &ec);
+     void resetWriteBuffer();
+     RedisValue syncReadResponse(
+            const Deadline &deadline,
+            boost::system::error_code &ec);
+    // Parse the next reply from buf, false if more data is needed.
+     bool syncParseResponse(RedisValue &value);
+    // Read to the empty buf, waiting until the deadline if wait is true.
+    // Returns false if nothing was read.
+     bool syncRead(bool wait, const Deadline &deadline,
+            boost::system::error_code &ec);
+
+    // Queue the command from any thread, the command is moved from. The
+    // strand is posted to only when the queue was empty, the queued
+    // commands are sent by drainSubmissions in one batch.
+     void submit(RedisArguments &command, ReplyHandler handler);
+     void submit(RedisArguments &command,
+            std::function<void(RedisValue)> handler);
+     void drainSubmissions();
+
+    // Serialize the command to the output buffer, it is written by
+    // writeQueued. The command is moved from.
+     void queueCommand(
+            RedisArguments &command,
+            ReplyHandler handler);
+
+     void setMaxReadBufferSize(size_t size);
+     void prepareReadBuffer();
+     void setMaxWriteBufferSize(size_t size);
+
+    // Corking, see RedisAsyncClient::cork.
+     void cork(size_t maxCommands, size_t maxBytes,
+            const boost::posix_time::time_duration &maxDelay);
+     void uncork();
+     void flush();
+    // Drop the scheduled flush, if any.
+     void cancelFlush();
+     void flushTimeout(const boost::system::error_code &ec,
+            size_t generation);
+    // Start writing the queued commands if no write is in progress and
+    // corking allows it (or force is true).
+     void writeQueued(bool force);
+     void startWrite();
+
+     void sendNextCommand();
+     void processMessage();
+     void doProcessMessage(RedisValue v);
+     void prepareNextReply();
+     void asyncWrite(const boost::system::error_code &ec, const size_t);
+     void asyncRead(const boost::system::error_code &ec, const size_t);
+
+     void onRedisError(const RedisValue &);
+     static void defaulErrorHandler(const std::string &s);
+
+    template<typename Handler>
+    inline void post(Handler &&handler);
+
+    boost::asio::io_service &ioService;
+    boost::asio::io_service::strand strand;
+    boost::asio::generic::stream_protocol::socket socket;
+    RedisParser redisParser;
+    std::vector<char> buf; // read buffer, see prepareReadBuffer
+    size_t bufPos; // only for sync, start of the unparsed data in buf
+    size_t bufSize; // only for sync
+    size_t lastReadSize;
+    size_t smallReads; // consecutive reads which used a small part of buf
+    size_t maxReadBufferSize;
+    std::vector<char> writeBuffer; // only for sync, reused by every command
+    std::vector<detail::Splice> writeSplices; // only for sync
+    size_t subscribeSeq;
+    bool replyInProgress; // only for async
+
+    typedef std::pair<size_t, std::function<void(const std::vector<char> &buf)> > MsgHandlerType;
+    typedef std::function<void(const std::vector<char> &buf)> SingleShotHandlerType;
+
+    typedef std::multimap<std::string, MsgHandlerType> MsgHandlersMap;
+    typedef std::multimap<std::string, SingleShotHandlerType> SingleShotHandlersMap;
+
+    // Commands serialized to one contiguous buffer. Big arguments are
+    // written from their own memory (see detail::Splice), commands with
+    // big arguments are kept in args until written.
+    struct OutputBuffer {
+        std::vector<char> data;
+        std::vector<detail::Splice> splices;
+        std::deque<RedisArguments> args;
+
+        // Unlike std::swap, never allocates.
+        void swap(OutputBuffer &other)
+        {
+            data.swap(other.data);
+            splices.swap(other.splices);
+            args.swap(other.args);
+        }
+    };
+
+    // A command with its own buffer, used when the output buffer is full
+    // (see maxWriteBufferSize).
+    struct QueuedCommand {
+        std::vector<char> data;
+        // Arguments of the command, big ones are written from here
+        // (see detail::Splice).
+        RedisArguments args;
+        std::vector<detail::Splice> splices;
+    };
+
+    struct Submission {
+        Submission *next;
+        RedisArguments args;
+        ReplyHandler handler;
+    };
+
+    detail::SubmissionQueue<Submission> submissions;
+    // Drained submissions, taken back by submit (see detail::NodeCache).
+    detail::SubmissionQueue<Submission> freeSubmissions;
+    // Operations of the drain, the write and the read in progress, so that
+    // a round trip does not allocate them (see detail::HandlerMemory).
+    detail::HandlerMemory drainMemory;
+    detail::HandlerMemory writeMemory;
+    detail::HandlerMemory readMemory;
+    // Handlers of the commands sent, in order. The slots are reused by
+    // the next commands, see detail::CompletionRing.
+    detail::CompletionRing<ReplyHandler> handlers;
+    // Commands are written by a single write of outputWrited, while new
+    // ones are added to outputQueued. Those added when outputQueued is over
+    // maxWriteBufferSize are queued one by one to dataQueued and written
+    // after it by a gather write.
+    OutputBuffer outputWrited;
+    OutputBuffer outputQueued;
+    std::deque<QueuedCommand> dataWrited;
+    std::deque<QueuedCommand> dataQueued;
+    size_t maxWriteBufferSize;
+    bool writeInProgress;
+
+    // Corking state (see cork), counters are of the commands queued since
+    // the last write started.
+    bool corked;
+    size_t corkCommands;
+    size_t corkBytes;
+    boost::posix_time::time_duration corkDelay;
+    size_t queuedCommands;
+    size_t queuedBytes;
+    bool flushScheduled;
+    bool flushRequested;
+    boost::asio::deadline_timer flushTimer;
+    // Changed when the scheduled flush is not needed anymore (a write has
+    // started or the connection is closed), so that a flush scheduled
+    // before, which may be already on its way, is ignored.
+    size_t flushGeneration;
+
+    // Commands submitted and not replied yet, read from any thread.
+    std::atomic<size_t> outstanding;
+    MsgHandlersMap msgHandlers;
+    SingleShotHandlersMap singleShotMsgHandlers;
+
+    std::function<void(const std::string &)> errorHandler;
+    // Changed in the thread of the io_service, read from any thread (see
+    // RedisAsyncClient::isConnected).
+    std::atomic<State> state;
+};
+
+template<typename Handler>
+inline void RedisClientImpl::post(Handler &&handler)
+{
+    strand.post(std::forward<Handler>(handler));
+}
+
+inline std::string to_string(RedisClientImpl::State state)
+{
+    switch(state)
+    {
+        case RedisClientImpl::State::Unconnected:
+            return "Unconnected";
+            break;
+        case RedisClientImpl::State::Connecting:
+            return "Connecting";
+            break;
+        case RedisClientImpl::State::Connected:
+            return "Connected";
+            break;
+        case RedisClientImpl::State::Subscribed:
+            return "Subscribed";
+            break;
+        case RedisClientImpl::State::Closed:
+            return "Closed";
+            break;
+    }
+
+    return "Invalid";
+}
+}
+
+
+
+
+#pragma once
+
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+inline void throwError(const boost::system::error_code &ec)
+{
+    boost::system::system_error error(ec);
+    throw error;
+}
+
+inline void throwIfError(const boost::system::error_code &ec)
+{
+    if (ec)
+    {
+        throwError(ec);
+    }
+}
+
+}
+
+}
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_HASHSLOT_H
+
+#include <boost/utility/string_ref.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Number of hash slots of a Redis Cluster.
+static const size_t hashSlots = 16384;
+
+// CRC16-CCITT (XMODEM), the key hash of Redis Cluster
+// (see https://redis.io/topics/cluster-spec).
+inline uint16_t crc16(const char *data, size_t size)
+{
+    static const uint16_t table[256] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+        0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+        0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+        0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+        0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+        0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+        0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+        0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+        0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+        0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+        0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+        0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+        0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+        0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+        0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+        0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+        0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+        0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+        0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+        0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+        0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+        0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+        0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+        0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+        0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+        0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+        0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+        0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+        0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+        0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+        0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+    };
+
+    uint16_t crc = 0;
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        unsigned char index = static_cast<unsigned char>((crc >> 8) ^ data[i]);
+
+        crc = static_cast<uint16_t>((crc << 8) ^ table[index]);
+    }
+
+    return crc;
+}
+
+// Hash slot of the key. If the key has a non-empty hash tag, the part
+// between the first '{' and the next '}', only the tag is hashed, so keys
+// with the same tag are in the same slot.
+inline size_t hashSlot(const boost::string_ref &key)
+{
+    size_t open = key.find('{');
+
+    if( open != boost::string_ref::npos )
+    {
+        boost::string_ref tag = key.substr(open + 1);
+        size_t close = tag.find('}');
+
+        if( close != boost::string_ref::npos && close != 0 )
+            return crc16(tag.data(), close) & (hashSlots - 1);
+    }
+
+    return crc16(key.data(), key.size()) & (hashSlots - 1);
+}
+
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISASYNCCLIENT_REDISCLIENT_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <string>
+#include <list>
+#include <type_traits>
+#include <functional>
+
+
+
+
+
+
+namespace redisclient {
+
+class RedisClientImpl;
+
+class RedisAsyncClient : boost::noncopyable {
+public:
+    // Subscribe handle.
+    struct Handle {
+        size_t id;
+        std::string channel;
+    };
+
+    typedef RedisClientImpl::State State;
+
+     RedisAsyncClient(boost::asio::io_service &ioService);
+     ~RedisAsyncClient();
+
+    // Connect to redis server
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+     void connect(
+            const boost::asio::local::stream_protocol::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+#endif
+
+    // Return true if is connected to redis. Safe to call from any thread.
+     bool isConnected() const;
+
+    // Return connection state. See RedisClientImpl::State. Safe to call
+    // from any thread.
+     State state() const;
+
+    // disconnect from redis and clear command queue
+     void disconnect();
+
+    // Set custom error handler.
+     void installErrorHandler(
+            std::function<void(const std::string &)> handler);
+
+    // Set the limit of the read buffer. The buffer starts at 4 KiB and grows
+    // up to the limit while big replies are read, 1 MiB by default.
+    // Call it before connect.
+     void setMaxReadBufferSize(size_t size);
+
+    // Set the limit of the output buffer. Commands are serialized to one
+    // contiguous buffer and sent by a single write, until it reaches the
+    // limit, the rest are sent by a gather write. 1 MiB by default.
+    // Call it before connect.
+     void setMaxWriteBufferSize(size_t size);
+
+    // Number of commands waiting for a reply, including the ones not
+    // written yet. Safe to call from any thread.
+     size_t queueDepth() const;
+
+    // Hold commands back to send them in batches. Queued commands are
+    // written when there are maxCommands of them or maxBytes encoded
+    // bytes, maxDelay after the first one, or by flush(). A zero maxDelay
+    // flushes at the end of the current event loop turn.
+     void cork(size_t maxCommands, size_t maxBytes,
+            const boost::posix_time::time_duration &maxDelay = boost::posix_time::microseconds(0));
+
+    // Send commands as soon as they are queued again, flushes the queue.
+     void uncork();
+
+    // Write commands queued so far, for corked clients.
+     void flush();
+
+    // Execute command on Redis server with the list of arguments.
+    //
+    // The client takes ownership of the arguments and keeps them until the
+    // command is written, big values are written from their own memory.
+    // Move the arguments in (std::move) to send a big value without a copy.
+     void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = dummyHandler);
+
+    // Same as above, but the handler is kept in the completion slot of the
+    // command as is. Handlers of up to detail::ReplyCallback::inlineSize
+    // bytes are stored without heap allocation.
+    template<typename Handler>
+    inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+        std::function<void(RedisValue)>>::value>::type
+    command(const std::string &cmd, RedisArguments args, Handler &&handler);
+
+    // Execute command on Redis server and pass elements of the array reply
+    // to chunkHandler, up to chunkSize elements at a time, as soon as they
+    // are parsed. The whole reply is never kept in memory. The handler is
+    // called after the last chunk with an empty array, or with the reply
+    // itself if it is not an array (an error, for example).
+     void commandStream(
+            const std::string &cmd, RedisArguments args,
+            size_t chunkSize,
+            std::function<void(std::vector<RedisValue>)> chunkHandler,
+            std::function<void(RedisValue)> handler = dummyHandler);
+
+    // Execute command on Redis server and pass the payload of the bulk
+    // string reply (GET of a big value, for example) to the sink in chunks
+    // as they arrive from the socket. The payload is never kept in memory.
+    // The handler is called at the end with an empty string, or with the
+    // reply itself if it is not a bulk string (a null or an error).
+     void commandToSink(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink,
+            std::function<void(RedisValue)> handler = dummyHandler);
+
+    // Subscribe to channel. Handler msgHandler will be called
+    // when someone publish message on channel. Call unsubscribe 
+    // to stop the subscription.
+     Handle subscribe(const std::string &channelName,
+                                       std::function<void(std::vector<char> msg)> msgHandler,
+                                       std::function<void(RedisValue)> handler = &dummyHandler);
+
+
+     Handle psubscribe(const std::string &pattern,
+                                        std::function<void(std::vector<char> msg)> msgHandler,
+                                        std::function<void(RedisValue)> handler = &dummyHandler);
+
+    // Unsubscribe
+     void unsubscribe(const Handle &handle);
+     void punsubscribe(const Handle &handle);
+
+    // Subscribe to channel. Handler msgHandler will be called
+    // when someone publish message on channel; it will be 
+    // unsubscribed after call.
+     void singleShotSubscribe(
+            const std::string &channel,
+            std::function<void(std::vector<char> msg)> msgHandler,
+            std::function<void(RedisValue)> handler = &dummyHandler);
+
+     void singleShotPSubscribe(
+            const std::string &channel,
+            std::function<void(std::vector<char> msg)> msgHandler,
+            std::function<void(RedisValue)> handler = &dummyHandler);
+
+    // Publish message on channel.
+     void publish(
+            const std::string &channel, const RedisBuffer &msg,
+            std::function<void(RedisValue)> handler = &dummyHandler);
+
+     static void dummyHandler(RedisValue) {}
+
+protected:
+     bool stateValid() const;
+
+private:
+    std::shared_ptr<RedisClientImpl> pimpl;
+};
+
+template<typename Handler>
+inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+    std::function<void(RedisValue)>>::value>::type
+RedisAsyncClient::command(const std::string &cmd, RedisArguments args, Handler &&handler)
+{
+    if(stateValid())
+    {
+        args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        RedisClientImpl::ReplyHandler replyHandler{std::forward<Handler>(handler),
+            nullptr, nullptr};
+
+        pimpl->submit(args, std::move(replyHandler));
+    }
+}
+
+}
+
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISSYNCCLIENT_REDISCLIENT_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <string>
+#include <list>
+#include <functional>
+#include <type_traits>
+
+
+
+
+
+
+
+
+
+namespace redisclient {
+
+class RedisClientImpl;
+class Pipeline;
+
+class RedisSyncClient : boost::noncopyable {
+public:
+    typedef RedisClientImpl::State State;
+
+     RedisSyncClient(boost::asio::io_service &ioService);
+     RedisSyncClient(RedisSyncClient &&other);
+     ~RedisSyncClient();
+
+    // Connect to redis server
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            boost::system::error_code &ec);
+
+    // Connect to redis server
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint);
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+     void connect(
+            const boost::asio::local::stream_protocol::endpoint &endpoint,
+            boost::system::error_code &ec);
+
+     void connect(
+            const boost::asio::local::stream_protocol::endpoint &endpoint);
+#endif
+
+    // Return true if is connected to redis.
+     bool isConnected() const;
+
+    // disconnect from redis
+     void disconnect();
+
+    // Set custom error handler.
+     void installErrorHandler(
+        std::function<void(const std::string &)> handler);
+
+    // Execute command on Redis server with the list of arguments.
+    //
+    // Big values are written from the memory of the arguments, so move
+    // them in (std::move) to send them without a copy.
+     RedisValue command(
+            std::string cmd, RedisArguments args);
+
+    // Execute command on Redis server with the list of arguments.
+     RedisValue command(
+            std::string cmd, RedisArguments args,
+            boost::system::error_code &ec);
+
+    // Execute command on Redis server with the arguments, without building
+    // a list of them. Arguments are anything RedisBuffer is constructible
+    // from and are written without a copy:
+    //
+    //  redis.command("SET", key, value);
+    //
+    // Throws: boost::system::system_error on errors.
+    template<typename ...Args>
+    inline typename std::enable_if<detail::AreArguments<Args...>::value, RedisValue>::type
+    command(const std::string &cmd, Args &&...args);
+
+    // Execute command encoded by RedisCommandEncoder, integer arguments
+    // are formatted in place:
+    //
+    //  redis.command(encoders::IncrBy(), "counter", 10);
+    //
+    // Throws: boost::system::system_error on errors.
+    template<char ...Name, typename ...Args>
+    inline typename std::enable_if<detail::AreEncoderArguments<Args...>::value, RedisValue>::type
+    command(RedisCommandEncoder<Name...> encoder, const Args &...args);
+
+    // Execute command on Redis server and pass the payload of the bulk
+    // string reply to the sink in chunks as they are read from the socket.
+    // Returns an empty string then, or the reply itself if it is not a bulk
+    // string (a null or an error).
+     RedisValue commandToSink(
+            std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink);
+
+    // Execute command on Redis server and pass the payload of the bulk
+    // string reply to the sink in chunks as they are read from the socket.
+     RedisValue commandToSink(
+            std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink,
+            boost::system::error_code &ec);
+
+    // Create pipeline (see Pipeline)
+     Pipeline pipelined();
+
+     RedisValue pipelined(
+            std::deque<std::deque<RedisBuffer>> commands,
+            boost::system::error_code &ec);
+
+     RedisValue pipelined(
+            std::deque<std::deque<RedisBuffer>> commands);
+
+    // Return connection state. See RedisClientImpl::State.
+     State state() const;
+
+     RedisSyncClient &setConnectTimeout(
+            const boost::posix_time::time_duration &timeout);
+    // Set the time limit of a command or a whole pipeline, from the first
+    // byte written to the last byte of the reply read. The connection is
+    // closed on a timeout, as on other errors, since the reply may still
+    // come.
+     RedisSyncClient &setCommandTimeout(
+            const boost::posix_time::time_duration &timeout);
+
+     RedisSyncClient &setTcpNoDelay(bool enable);
+     RedisSyncClient &setTcpKeepAlive(bool enable);
+
+    // Set the limit of the read buffer. The buffer starts at 4 KiB and grows
+    // up to the limit while big replies are read, 1 MiB by default.
+     RedisSyncClient &setMaxReadBufferSize(size_t size);
+
+protected:
+     bool stateValid() const;
+
+private:
+    friend class Pipeline;
+
+     RedisValue commandRefs(const boost::string_ref *items, size_t size,
+            boost::system::error_code &ec);
+     RedisValue pipelinedArguments(const std::vector<RedisArguments> &commands,
+            boost::system::error_code &ec);
+    // Drop what is left of the last connection before connecting again.
+     void reset();
+
+    std::shared_ptr<RedisClientImpl> pimpl;
+    boost::posix_time::time_duration connectTimeout;
+    boost::posix_time::time_duration commandTimeout;
+    bool tcpNoDelay;
+    bool tcpKeepAlive;
+};
+
+template<typename ...Args>
+inline typename std::enable_if<detail::AreArguments<Args...>::value, RedisValue>::type
+RedisSyncClient::command(const std::string &cmd, Args &&...args)
+{
+    const boost::string_ref items[] = {boost::string_ref(cmd), detail::argumentRef(args)...};
+    boost::system::error_code ec;
+    RedisValue result = commandRefs(items, 1 + sizeof...(Args), ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+template<char ...Name, typename ...Args>
+inline typename std::enable_if<detail::AreEncoderArguments<Args...>::value, RedisValue>::type
+RedisSyncClient::command(RedisCommandEncoder<Name...> encoder, const Args &...args)
+{
+    boost::system::error_code ec;
+    RedisValue result;
+
+    if(stateValid())
+    {
+        encoder.append(pimpl->writeBuffer, args...);
+        result = pimpl->doSyncEncodedCommand(commandTimeout, ec);
+    }
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+}
+
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#pragma once
+
+#include <deque>
+#include <type_traits>
+#include <vector>
+#include <boost/system/error_code.hpp>
+
+
+
+
+
+namespace redisclient
+{
+
+class RedisSyncClient;
+class RedisValue;
+
+// See https://redis.io/topics/pipelining.
+class Pipeline
+{
+public:
+     Pipeline(RedisSyncClient &client);
+
+    // add command to pipe, non-owning arguments (see RedisBuffer) must be
+    // alive until finish() returns
+     Pipeline &command(std::string cmd, RedisArguments args);
+
+    // add command to pipe, without building a list of arguments:
+    //
+    //  pipe.command("SET", key, value);
+    //
+    // Arguments are stored by RedisBuffer, so a non-owning one (see
+    // RedisBuffer) must be alive until finish() returns.
+    template<typename ...Args>
+    inline typename std::enable_if<detail::AreArguments<Args...>::value, Pipeline &>::type
+    command(std::string cmd, Args &&...args);
+
+    // Sends all commands to the redis server.
+    // For every request command will get response value.
+    // Example:
+    //
+    //  Pipeline pipe(redis);
+    //
+    //  pipe.command("GET", {"foo"})
+    //      .command("GET", {"bar"})
+    //      .command("GET", {"more"});
+    //
+    //  std::vector<RedisValue> result = pipe.finish().toArray();
+    //
+    //  result[0];  // value of the key "foo"
+    //  result[1];  // value of the key "bar"
+    //  result[2];  // value of the key "more"
+    //
+     RedisValue finish();
+     RedisValue finish(boost::system::error_code &ec);
+
+private:
+    std::vector<RedisArguments> commands;
+    RedisSyncClient &client;
+};
+
+template<typename ...Args>
+inline typename std::enable_if<detail::AreArguments<Args...>::value, Pipeline &>::type
+Pipeline::command(std::string cmd, Args &&...args)
+{
+    commands.push_back(detail::makeArguments(std::move(cmd), std::forward<Args>(args)...));
+    return *this;
+}
+
+}
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISCLIENTPOOL_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+
+
+
+
+namespace redisclient {
+
+// Fixed number of connections to one server. Every command is sent by the
+// connection with the fewest commands waiting for a reply, so a slow
+// command holds back only the commands queued after it on its connection.
+//
+// Commands are not ordered between connections, send commands which
+// depend on each other by the same connection (see leastLoaded).
+class RedisClientPool : boost::noncopyable {
+public:
+     RedisClientPool(boost::asio::io_service &ioService, size_t size);
+     ~RedisClientPool();
+
+    // Connect all connections to redis server. The handler is called once,
+    // when all of them are connected or with the first error.
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+
+    // Return true if all connections are connected.
+     bool isConnected() const;
+
+    // Disconnect all connections.
+     void disconnect();
+
+    // Set custom error handler of all connections.
+     void installErrorHandler(
+        std::function<void(const std::string &)> handler);
+
+    // Number of connections.
+     size_t size() const;
+
+     RedisAsyncClient &connection(size_t index);
+
+    // Number of commands of the connection waiting for a reply (see
+    // RedisAsyncClient::queueDepth).
+     size_t queueDepth(size_t index) const;
+
+    // Connected connection with the fewest commands waiting for a reply.
+    // Ties are broken round-robin. Safe to call from any thread.
+     RedisAsyncClient &leastLoaded();
+
+    // Execute command by the least loaded connection.
+     void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = RedisAsyncClient::dummyHandler);
+
+    // Same as above, the handler is kept as is (see RedisAsyncClient::command).
+    template<typename Handler>
+    inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+        std::function<void(RedisValue)>>::value>::type
+    command(const std::string &cmd, RedisArguments args, Handler &&handler);
+
+private:
+    std::vector<std::unique_ptr<RedisAsyncClient>> clients;
+    // Round-robin start of the least loaded search.
+    std::atomic<size_t> next;
+};
+
+template<typename Handler>
+inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+    std::function<void(RedisValue)>>::value>::type
+RedisClientPool::command(const std::string &cmd, RedisArguments args, Handler &&handler)
+{
+    leastLoaded().command(cmd, std::move(args), std::forward<Handler>(handler));
+}
+
+}
+
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISSYNCCLIENTPOOL_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+
+
+namespace redisclient {
+
+// Fixed number of sync connections to one server, shared by threads. A
+// thread checks a connection out, uses it alone and checks it back in:
+//
+//  RedisSyncClientPool pool(ioService, 8);
+//
+//  pool.connect(endpoint);
+//
+//  {
+//      RedisSyncClientPool::Lease redis = pool.checkout();
+//
+//      redis->command("SET", {"key", "value"});
+//  } // checked in
+//
+// A connection closed by an error or a timeout of a command is connected
+// again when it is checked out, so the borrower does not get the late
+// replies of the previous one.
+class RedisSyncClientPool : boost::noncopyable {
+public:
+    // Connection checked out of the pool, checked in when destroyed.
+    class Lease {
+    public:
+         Lease();
+         Lease(Lease &&other);
+         Lease &operator=(Lease &&other);
+         ~Lease();
+
+        // False for the empty lease of a failed tryCheckout.
+         explicit operator bool() const;
+
+         RedisSyncClient &operator*() const;
+         RedisSyncClient *operator->() const;
+
+        // Check the connection in before the lease is destroyed.
+         void checkin();
+
+    private:
+        friend class RedisSyncClientPool;
+
+         Lease(RedisSyncClientPool *pool, RedisSyncClient *client);
+
+        RedisSyncClientPool *pool;
+        RedisSyncClient *client;
+    };
+
+     RedisSyncClientPool(boost::asio::io_service &ioService, size_t size);
+     ~RedisSyncClientPool();
+
+    // Connect all connections to redis server, stops at the first error.
+    // Closed connections are connected to the endpoint again on checkout.
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            boost::system::error_code &ec);
 
+    // Connect all connections to redis server.
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint);
 
+    // Set the time limit of connecting a connection, in connect() and
+    // again on checkout, 5 seconds by default. Must be called before use.
+     RedisSyncClientPool &setConnectTimeout(
+            const boost::posix_time::time_duration &timeout);
 
+    // Number of connections.
+     size_t size() const;
 
+    // Number of connections not checked out.
+     size_t available() const;
 
+    // Connection by index, to set it up (timeouts, etc) before use. Must
+    // not be used while checked out by someone else.
+     RedisSyncClient &connection(size_t index);
 
-#pragma once
+    // Check out a connection, waiting for one to be checked in if all of
+    // them are in use. Return an empty lease if a closed connection fails
+    // to connect again, it stays in the pool to be tried by the next one.
+     Lease checkout(boost::system::error_code &ec);
 
-#include <boost/system/error_code.hpp>
-#include <boost/system/system_error.hpp>
+    // Check out a connection, waiting for one to be checked in if all of
+    // them are in use.
+     Lease checkout();
 
-namespace redisclient
-{
+    // Check out a connection if there is a free one, otherwise return an
+    // empty lease, also if a closed connection fails to connect again.
+     Lease tryCheckout(boost::system::error_code &ec);
 
-namespace detail
-{
+    // Check out a connection if there is a free one, otherwise return an
+    // empty lease.
+     Lease tryCheckout();
 
-inline void throwError(const boost::system::error_code &ec)
-{
-    boost::system::system_error error(ec);
-    throw error;
-}
+private:
+    // Lease of the client taken out of idle, connected again if it is
+    // closed. Called without the lock, connecting takes time.
+     Lease lease(RedisSyncClient *client, bool reconnect,
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            boost::system::error_code &ec);
+     void checkin(RedisSyncClient *client);
+
+    std::vector<std::unique_ptr<RedisSyncClient>> clients;
+    std::vector<RedisSyncClient *> idle;
+    boost::asio::ip::tcp::endpoint endpoint;
+    bool reconnect;
+    mutable std::mutex mutex;
+    std::condition_variable checkedIn;
+};
 
-inline void throwIfError(const boost::system::error_code &ec)
-{
-    if (ec)
-    {
-        throwError(ec);
-    }
 }
 
-}
 
-}
+
 /*
  * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
  * License: MIT
  */
 
 
-#define REDISASYNCCLIENT_REDISCLIENT_H
+#define REDISCLIENT_REDISSHARDEDCLIENT_H
 
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
-#include <list>
+#include <thread>
 #include <type_traits>
-#include <functional>
+#include <vector>
 
 
 
@@ -499,97 +3275,109 @@ inline void throwIfError(const boost::system::error_code &ec)
 
 namespace redisclient {
 
-class RedisClientImpl;
-
-class RedisAsyncClient : boost::noncopyable {
+// Connections to one server spread over several io_service threads
+// (shards), so that reading, parsing and handlers of different
+// connections run in parallel. Every shard runs its own io_service in its
+// own thread, optionally pinned to a core, with a RedisClientPool.
+//
+// Handlers are called in the thread of the shard of the connection.
+//
+// Commands are sent by the shards in turn, by the least loaded connection
+// of the shard. With Routing::KeyHash commands with the same first
+// argument (the key) are sent by the same connection, so they are
+// executed and replied in order.
+class RedisShardedClient : boost::noncopyable {
 public:
-    // Subscribe handle.
-    struct Handle {
-        size_t id;
-        std::string channel;
+    enum class Routing {
+        LeastLoaded,
+        KeyHash
     };
 
-    typedef RedisClientImpl::State State;
+    // Start shards threads with connectionsPerShard connections each.
+    // Threads are pinned to the CPUs the process may run on, one per
+    // core, if pinThreads is true.
+     RedisShardedClient(size_t shards, size_t connectionsPerShard = 1,
+            bool pinThreads = true);
 
-     RedisAsyncClient(boost::asio::io_service &ioService);
-     ~RedisAsyncClient();
+    // Stop the threads, disconnect all connections.
+     ~RedisShardedClient();
 
-    // Connect to redis server
+    // Connect all connections to redis server. The handler is called once,
+    // when all of them are connected or with the first error, in the thread
+    // of one of the shards.
      void connect(
             const boost::asio::ip::tcp::endpoint &endpoint,
             std::function<void(boost::system::error_code)> handler);
 
-
-     void connect(
-            const boost::asio::local::stream_protocol::endpoint &endpoint,
-            std::function<void(boost::system::error_code)> handler);
-
-
-    // Return true if is connected to redis.
+    // Return true if all connections are connected.
      bool isConnected() const;
 
-    // Return connection state. See RedisClientImpl::State.
-     State state() const;
-
-    // disconnect from redis and clear command queue
+    // Disconnect all connections, in the threads of the shards.
      void disconnect();
 
-    // Set custom error handler.
+    // Set custom error handler of all connections, called in the thread of
+    // the shard. Errors are ignored by default. The handler must not throw,
+    // nothing catches exceptions in the threads of the shards. Call it
+    // before connect.
      void installErrorHandler(
-            std::function<void(const std::string &)> handler);
-
-    // Execute command on Redis server with the list of arguments.
-     void command(
-            const std::string &cmd, std::deque<RedisBuffer> args,
-            std::function<void(RedisValue)> handler = dummyHandler);
+        std::function<void(const std::string &)> handler);
 
-    // Subscribe to channel. Handler msgHandler will be called
-    // when someone publish message on channel. Call unsubscribe 
-    // to stop the subscription.
-     Handle subscribe(const std::string &channelName,
-                                       std::function<void(std::vector<char> msg)> msgHandler,
-                                       std::function<void(RedisValue)> handler = &dummyHandler);
+    // Call it before sending commands.
+     void setRouting(Routing routing);
 
+    // Number of shards (threads).
+     size_t size() const;
 
-     Handle psubscribe(const std::string &pattern,
-                                        std::function<void(std::vector<char> msg)> msgHandler,
-                                        std::function<void(RedisValue)> handler = &dummyHandler);
+     boost::asio::io_service &ioService(size_t shard);
+     RedisClientPool &shard(size_t shard);
 
-    // Unsubscribe
-     void unsubscribe(const Handle &handle);
-     void punsubscribe(const Handle &handle);
+    // Connection which sends the commands of the key with Routing::KeyHash.
+     RedisAsyncClient &connectionForKey(const boost::string_ref &key);
 
-    // Subscribe to channel. Handler msgHandler will be called
-    // when someone publish message on channel; it will be 
-    // unsubscribed after call.
-     void singleShotSubscribe(
-            const std::string &channel,
-            std::function<void(std::vector<char> msg)> msgHandler,
-            std::function<void(RedisValue)> handler = &dummyHandler);
+    // Connection for the next command, see Routing. Safe to call from any
+    // thread.
+     RedisAsyncClient &route(const RedisArguments &args);
 
-     void singleShotPSubscribe(
-            const std::string &channel,
-            std::function<void(std::vector<char> msg)> msgHandler,
-            std::function<void(RedisValue)> handler = &dummyHandler);
+    // Execute command by the connection chosen by route().
+     void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = RedisAsyncClient::dummyHandler);
 
-    // Publish message on channel.
-     void publish(
-            const std::string &channel, const RedisBuffer &msg,
-            std::function<void(RedisValue)> handler = &dummyHandler);
+    // Same as above, the handler is kept as is (see RedisAsyncClient::command).
+    template<typename Handler>
+    inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+        std::function<void(RedisValue)>>::value>::type
+    command(const std::string &cmd, RedisArguments args, Handler &&handler);
 
-     static void dummyHandler(RedisValue) {}
+private:
+    struct Shard {
+         Shard(size_t connections);
 
-protected:
-     bool stateValid() const;
+        boost::asio::io_service ioService;
+        std::unique_ptr<boost::asio::io_service::work> work;
+        RedisClientPool pool;
+        std::thread thread;
+    };
 
-private:
-    std::shared_ptr<RedisClientImpl> pimpl;
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t connectionsPerShard;
+    Routing routing;
+    // Round-robin over the shards for Routing::LeastLoaded.
+    std::atomic<size_t> next;
 };
 
-}
-
+template<typename Handler>
+inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+    std::function<void(RedisValue)>>::value>::type
+RedisShardedClient::command(const std::string &cmd, RedisArguments args, Handler &&handler)
+{
+    // the key is read before the arguments are moved
+    RedisAsyncClient &client = route(args);
 
+    client.command(cmd, std::move(args), std::forward<Handler>(handler));
+}
 
+}
 
 
 
@@ -599,117 +3387,226 @@ private:
  */
 
 
-#define REDISSYNCCLIENT_REDISCLIENT_H
+#define REDISCLIENT_REDISCLUSTERIMPL_H
 
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/noncopyable.hpp>
 
-#include <string>
-#include <list>
+#include <deque>
 #include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 
 
 
 
 
-namespace redisclient {
 
-class RedisClientImpl;
-class Pipeline;
+namespace redisclient {
 
-class RedisSyncClient : boost::noncopyable {
+class RedisClusterImpl : public std::enable_shared_from_this<RedisClusterImpl>,
+    boost::noncopyable {
 public:
-    typedef RedisClientImpl::State State;
+    // Command kept until it is replied, to be sent again on a redirection.
+    struct Request {
+        std::string cmd;
+        RedisArguments args;
+        std::function<void(RedisValue)> handler;
+        size_t redirects;
+    };
 
-     RedisSyncClient(boost::asio::io_service &ioService);
-     RedisSyncClient(RedisSyncClient &&other);
-     ~RedisSyncClient();
+    // Connection to one node of the cluster.
+    struct Node {
+         Node(boost::asio::io_service &ioService,
+                const boost::asio::ip::tcp::endpoint &endpoint);
+
+        boost::asio::ip::tcp::endpoint endpoint;
+        RedisAsyncClient client;
+        // Called when the connection is established or failed.
+        std::vector<std::function<void(boost::system::error_code)>> waiting;
+        // Requests sent and not replied yet, in order. They are replied
+        // with an error if the connection fails.
+        std::deque<std::shared_ptr<Request>> sent;
+    };
 
-    // Connect to redis server
-     void connect(
-            const boost::asio::ip::tcp::endpoint &endpoint,
-            boost::system::error_code &ec);
+     RedisClusterImpl(boost::asio::io_service &ioService);
+     ~RedisClusterImpl();
 
-    // Connect to redis server
-     void connect(
-            const boost::asio::ip::tcp::endpoint &endpoint);
+     void connect(const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+     void disconnect();
 
+     void refreshSlots(std::function<void(boost::system::error_code)> handler);
 
-     void connect(
-            const boost::asio::local::stream_protocol::endpoint &endpoint,
-            boost::system::error_code &ec);
+     void send(Node *node, std::shared_ptr<Request> request, bool asking);
 
-     void connect(
-            const boost::asio::local::stream_protocol::endpoint &endpoint);
+    // Send the commands grouped by node, reply with the array of replies.
+    // A command whose node fails gets an error reply in the array, the
+    // whole pipeline an error reply before connect.
+     void pipelined(std::vector<RedisArguments> commands,
+            std::function<void(RedisValue)> handler);
 
+    // Node of the slot of args[key], any node if there is no key or the
+    // slot has no node, nullptr before connect.
+     Node *route(const RedisArguments &args, size_t key);
 
-    // Return true if is connected to redis.
+    // Node of the endpoint, created on first use.
+     Node *node(const boost::asio::ip::tcp::endpoint &endpoint);
+
+    // Connected node if there is one, a node to connect to otherwise.
+     Node *anyNode();
+
+     void whenConnected(Node *node,
+            std::function<void(boost::system::error_code)> handler);
+     void handleConnect(Node *node, const boost::system::error_code &ec);
+    // Take the request out of the sent ones of the node, false if it is
+    // not there (failed with the connection already).
+     bool takeSent(Node *node, const std::shared_ptr<Request> &request);
+     void handleReply(std::shared_ptr<Request> request, RedisValue value);
+    // Error of the connection to the node: close it, so it is connected
+    // again on next use, and reply to the requests sent with the error.
+     void handleError(Node *node, const std::string &error);
+     void handleSlots(Node *node, const RedisValue &value);
+
+    // Parse "MOVED <slot> <host>:<port>" and "ASK <slot> <host>:<port>".
+     static bool parseRedirection(const std::string &error,
+            bool &ask, size_t &slot, boost::asio::ip::tcp::endpoint &endpoint);
+
+    boost::asio::io_service &ioService;
+    // Node of every hash slot, nullptr for slots without one.
+    std::vector<Node *> slots;
+    std::map<boost::asio::ip::tcp::endpoint, std::unique_ptr<Node>> nodes;
+    std::function<void(const std::string &)> errorHandler;
+    // Handlers of the CLUSTER SLOTS request in progress.
+    std::vector<std::function<void(boost::system::error_code)>> refreshHandlers;
+    bool refreshing;
+    bool slotsLoaded;
+    size_t maxRedirects;
+};
+
+}
+
+
+
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+
+#define REDISCLIENT_REDISCLUSTERCLIENT_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+
+
+
+
+
+namespace redisclient {
+
+class ClusterPipeline;
+
+// Client of a Redis Cluster (see https://redis.io/topics/cluster-spec).
+//
+// The owner of every hash slot, loaded by CLUSTER SLOTS, is kept in a flat
+// table, so a command is sent by the connection of the node of its key
+// with one lookup. There is one RedisAsyncClient per node, connected on
+// first use, which pipelines the commands.
+//
+// MOVED and ASK redirections are followed transparently: the command is
+// sent again to the node named in the reply. MOVED updates the slot and
+// reloads the table in the background.
+//
+// Use the client from the io_service thread only.
+class RedisClusterClient : boost::noncopyable {
+public:
+     RedisClusterClient(boost::asio::io_service &ioService);
+     ~RedisClusterClient();
+
+    // Connect to a node of the cluster and load the slot table from it.
+    // Connections to the other nodes are established on first use.
+     void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+
+    // Return true if the slot table is loaded.
      bool isConnected() const;
 
-    // disconnect from redis
+    // Disconnect from all nodes.
      void disconnect();
 
-    // Set custom error handler.
+    // Set custom error handler of the connections to all nodes. A
+    // connection is closed on an error, the commands waiting for its
+    // replies get an error reply, and it is connected again on next use.
      void installErrorHandler(
-        std::function<void(const std::string &)> handler);
-
-    // Execute command on Redis server with the list of arguments.
-     RedisValue command(
-            std::string cmd, std::deque<RedisBuffer> args);
+            std::function<void(const std::string &)> handler);
 
-    // Execute command on Redis server with the list of arguments.
-     RedisValue command(
-            std::string cmd, std::deque<RedisBuffer> args,
-            boost::system::error_code &ec);
+    // Reload the slot table by CLUSTER SLOTS.
+     void refreshSlots(
+            std::function<void(boost::system::error_code)> handler);
 
-    // Create pipeline (see Pipeline)
-     Pipeline pipelined();
+    // Hash slot of the key, see detail::hashSlot.
+     static size_t keySlot(const boost::string_ref &key);
 
-     RedisValue pipelined(
-            std::deque<std::deque<RedisBuffer>> commands,
-            boost::system::error_code &ec);
+    // Address of the node of the slot as known by the client, an
+    // unspecified endpoint if the slot has none.
+     boost::asio::ip::tcp::endpoint slotNode(size_t slot) const;
 
-     RedisValue pipelined(
-            std::deque<std::deque<RedisBuffer>> commands);
+    // Number of nodes known by the client.
+     size_t nodes() const;
 
-    // Return connection state. See RedisClientImpl::State.
-     State state() const;
+    // Execute command by the node of the first argument (the key), by any
+    // node for commands without arguments.
+    //
+    // The arguments are kept until the command is replied, to be sent
+    // again on a redirection. Commands with keys in different slots must
+    // not be sent, the cluster replies with CROSSSLOT.
+     void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = RedisAsyncClient::dummyHandler);
 
-     RedisSyncClient &setConnectTimeout(
-            const boost::posix_time::time_duration &timeout);
-     RedisSyncClient &setCommandTimeout(
-            const boost::posix_time::time_duration &timeout);
+    // Create pipeline (see ClusterPipeline)
+     ClusterPipeline pipelined();
 
-     RedisSyncClient &setTcpNoDelay(bool enable);
-     RedisSyncClient &setTcpKeepAlive(bool enable);
+private:
+    friend class ClusterPipeline;
 
-protected:
-     bool stateValid() const;
+     void pipelinedArguments(std::vector<RedisArguments> commands,
+            std::function<void(RedisValue)> handler);
 
-private:
-    std::shared_ptr<RedisClientImpl> pimpl;
-    boost::posix_time::time_duration connectTimeout;
-    boost::posix_time::time_duration commandTimeout;
-    bool tcpNoDelay;
-    bool tcpKeepAlive;
+    std::shared_ptr<RedisClusterImpl> pimpl;
 };
 
 }
 
 
 
-
-
-
 /*
  * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
  * License: MIT
  */
 
-#pragma once
 
-#include <deque>
+#define REDISCLIENT_CLUSTERPIPELINE_H
+
+#include <functional>
+#include <type_traits>
+#include <vector>
+
 
 
 
@@ -717,45 +3614,60 @@ private:
 namespace redisclient
 {
 
-class RedisSyncClient;
+class RedisClusterClient;
 class RedisValue;
 
-// See https://redis.io/topics/pipelining.
-class Pipeline
+// Pipeline of a Redis Cluster (see Pipeline). Commands are grouped by the
+// node of their key (the first argument) and every node gets its commands
+// as one pipeline, all nodes at once. MOVED and ASK replies are followed as
+// by RedisClusterClient::command.
+class ClusterPipeline
 {
 public:
-     Pipeline(RedisSyncClient &client);
+     ClusterPipeline(RedisClusterClient &client);
 
-    // add command to pipe
-     Pipeline &command(std::string cmd, std::deque<RedisBuffer> args);
+    // add command to pipe, the arguments are copied when the pipeline is
+    // sent (see RedisClusterClient::command)
+     ClusterPipeline &command(std::string cmd, RedisArguments args);
 
-    // Sends all commands to the redis server.
-    // For every request command will get response value.
-    // Example:
+    // add command to pipe, without building a list of arguments:
     //
-    //  Pipeline pipe(redis);
+    //  pipe.command("GET", key);
+    template<typename ...Args>
+    inline typename std::enable_if<detail::AreArguments<Args...>::value, ClusterPipeline &>::type
+    command(std::string cmd, Args &&...args);
+
+    // Sends all commands to the nodes of the cluster. The handler gets the
+    // array of replies in order of the commands, when all of them are
+    // replied. The commands of a node whose connection fails get an error
+    // reply, and the handler gets an error instead of the array if the
+    // client is not connected. Example:
     //
-    //  pipe.command("GET", {"foo"})
-    //      .command("GET", {"bar"})
-    //      .command("GET", {"more"});
+    //  ClusterPipeline pipe(redis);
     //
-    //  std::vector<RedisValue> result = pipe.finish().toArray();
+    //  for(const std::string &key: keys)
+    //      pipe.command("GET", key);
     //
-    //  result[0];  // value of the key "foo"
-    //  result[1];  // value of the key "bar"
-    //  result[2];  // value of the key "more"
+    //  pipe.finish([](RedisValue result) {
+    //      result.getArray()[0];  // value of keys[0]
+    //  });
     //
-     RedisValue finish();
-     RedisValue finish(boost::system::error_code &ec);
+     void finish(std::function<void(RedisValue)> handler);
 
 private:
-    std::deque<std::deque<RedisBuffer>> commands;
-    RedisSyncClient &client;
+    std::vector<RedisArguments> commands;
+    RedisClusterClient &client;
 };
 
+template<typename ...Args>
+inline typename std::enable_if<detail::AreArguments<Args...>::value, ClusterPipeline &>::type
+ClusterPipeline::command(std::string cmd, Args &&...args)
+{
+    commands.push_back(detail::makeArguments(std::move(cmd), std::forward<Args>(args)...));
+    return *this;
 }
 
-
+}
 
 
 
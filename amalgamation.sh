@@ -2,14 +2,31 @@
 
 AMALGAMATION_FILE_NAME=amalgamated/redisclient
 HEADERS="src/redisclient/version.h \
+    src/redisclient/smallvector.h \
     src/redisclient/redisbuffer.h \
     src/redisclient/redisvalue.h \
+    src/redisclient/redisarena.h \
+    src/redisclient/redisvalueview.h \
     src/redisclient/redisparser.h \
+    src/redisclient/impl/rediscommand.h \
+    src/redisclient/rediscommandencoder.h \
+    src/redisclient/impl/submissionqueue.h \
+    src/redisclient/impl/completionslots.h \
+    src/redisclient/impl/handlermemory.h \
     src/redisclient/impl/redisclientimpl.h \
     src/redisclient/impl/throwerror.h \
+    src/redisclient/impl/hashslot.h \
     src/redisclient/redisasyncclient.h \
     src/redisclient/redissyncclient.h \
-    src/redisclient/pipeline.h"
+    src/redisclient/pipeline.h \
+    src/redisclient/redisclientpool.h \
+    src/redisclient/redissyncclientpool.h \
+    src/redisclient/redisshardedclient.h \
+    src/redisclient/impl/redisclusterimpl.h \
+    src/redisclient/redisclusterclient.h \
+    src/redisclient/clusterpipeline.h"
+# Internal headers used by the sources only, go to the source file
+IMPL_HEADERS="src/redisclient/impl/redisscanner.h"
 
 
 echo > "$AMALGAMATION_FILE_NAME.h"
@@ -20,10 +37,17 @@ do
     cat "$file" >> "$AMALGAMATION_FILE_NAME.h"
 done
 
+for file in $IMPL_HEADERS
+do
+    cat "$file" >> "$AMALGAMATION_FILE_NAME.cpp"
+done
+
 find src -name '*.cpp' -print0 | sort -z | xargs -r0 cat >> "$AMALGAMATION_FILE_NAME.cpp"
 
-sed -i 's|# *ifn\?def .*$||' "$AMALGAMATION_FILE_NAME.h"
-sed -i 's|# *endif.*$||' "$AMALGAMATION_FILE_NAME.h"
+# Include guards and the includes of the sources go, other conditions stay
+sed -i '/^# *ifdef REDIS_CLIENT_HEADER_ONLY$/,/^# *endif/d' "$AMALGAMATION_FILE_NAME.h"
+sed -i 's|^# *ifndef REDIS[A-Z_]*_H$||' "$AMALGAMATION_FILE_NAME.h"
+sed -i 's|^# *endif *// *REDIS[A-Z_]*_H$||' "$AMALGAMATION_FILE_NAME.h"
 sed -i 's|#include ".*$||' "$AMALGAMATION_FILE_NAME.h"
 sed -i 's|#include ".*$||' "$AMALGAMATION_FILE_NAME.cpp"
 sed -i 's|REDIS_CLIENT_DECL||' "$AMALGAMATION_FILE_NAME.h"
@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+#include <redisclient/impl/redisclientimpl.h>
+#include <redisclient/rediscommandencoder.h>
+
+#include <string>
+#include <vector>
+
+using namespace redisclient;
+
+static const std::string key = "user:1000:counter";
+static const std::string value(32, 'v');
+
+static void MakeCommandGet(benchmark::State &state)
+{
+    for(auto _: state)
+    {
+        std::vector<char> buffer = RedisClientImpl::makeCommand({"GET", key});
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+static void EncoderGet(benchmark::State &state)
+{
+    for(auto _: state)
+    {
+        std::vector<char> buffer = encoders::Get::encode(key);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+static void EncoderGetReused(benchmark::State &state)
+{
+    std::vector<char> buffer;
+
+    for(auto _: state)
+    {
+        buffer.clear();
+        encoders::Get::append(buffer, key);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+static void MakeCommandSet(benchmark::State &state)
+{
+    for(auto _: state)
+    {
+        std::vector<char> buffer = RedisClientImpl::makeCommand({"SET", key, value});
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+static void EncoderSet(benchmark::State &state)
+{
+    for(auto _: state)
+    {
+        std::vector<char> buffer = encoders::Set::encode(key, value);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+static void MakeCommandIncrBy(benchmark::State &state)
+{
+    int64_t increment = 0;
+
+    for(auto _: state)
+    {
+        std::vector<char> buffer = RedisClientImpl::makeCommand(
+                {"INCRBY", key, std::to_string(++increment)});
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+static void EncoderIncrBy(benchmark::State &state)
+{
+    int64_t increment = 0;
+
+    for(auto _: state)
+    {
+        std::vector<char> buffer = encoders::IncrBy::encode(key, ++increment);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+
+BENCHMARK(MakeCommandGet);
+BENCHMARK(EncoderGet);
+BENCHMARK(EncoderGetReused);
+BENCHMARK(MakeCommandSet);
+BENCHMARK(EncoderSet);
+BENCHMARK(MakeCommandIncrBy);
+BENCHMARK(EncoderIncrBy);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,218 @@
+#include <benchmark/benchmark.h>
+#include <redisclient/redisasyncclient.h>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <stdlib.h>
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+
+using namespace redisclient;
+
+// Heap allocations made by the benchmark loops. All forms of operator new
+// and delete are replaced, not inlined, so that the compiler never pairs
+// its own allocation with the free of another one.
+static size_t allocations = 0;
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    ++allocations;
+
+    if( void *ptr = malloc(size ? size : 1) )
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline)) void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    ++allocations;
+    return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+namespace
+{
+    const std::string getCommand = "*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n";
+    const std::string nullReply = "$-1\r\n";
+
+    struct Session
+    {
+        int64_t replies = 0;
+    };
+
+    // Captures of a typical GET handler: the session and a couple of
+    // pointers, too big for the small buffer of std::function.
+    struct GetHandler
+    {
+        std::shared_ptr<Session> session;
+        const char *key;
+        int64_t *total;
+
+        void operator()(RedisValue value)
+        {
+            session->replies += value.isNull() ? 1 : 0;
+            ++*total;
+        }
+    };
+
+    // RedisAsyncClient connected to a socket of the benchmark thread,
+    // which plays the server: it reads the commands and replies to every
+    // GET with a null (a missing key), so that the reply itself allocates
+    // nothing.
+    class Connection
+    {
+    public:
+        Connection()
+            : acceptor(ioService, boost::asio::ip::tcp::endpoint(
+                        boost::asio::ip::address::from_string("127.0.0.1"), 0)),
+            server(ioService), redis(ioService), total(0)
+        {
+            bool connected = false;
+
+            redis.connect(acceptor.local_endpoint(), [&](boost::system::error_code) {
+                connected = true;
+            });
+
+            acceptor.accept(server);
+
+            while( !connected )
+                ioService.run_one();
+        }
+
+        // Reply to count GETs and wait for their handlers.
+        void reply(size_t count)
+        {
+            commands.resize(count * getCommand.size());
+            replies.clear();
+
+            for(size_t i = 0; i < count; ++i)
+                replies += nullReply;
+
+            // the commands are written by the strand of the client
+            ioService.poll();
+            ioService.reset();
+
+            boost::asio::read(server, boost::asio::buffer(&commands[0], commands.size()));
+            boost::asio::write(server, boost::asio::buffer(replies));
+
+            for(int64_t expected = total + count; total < expected;)
+                ioService.run_one();
+
+            ioService.reset();
+        }
+
+        boost::asio::io_service ioService;
+        boost::asio::ip::tcp::acceptor acceptor;
+        boost::asio::ip::tcp::socket server;
+        RedisAsyncClient redis;
+        int64_t total;
+        std::string commands;
+        std::string replies;
+    };
+
+    void reportAllocations(benchmark::State &state, size_t gets)
+    {
+        state.counters["allocs/GET"] = static_cast<double>(allocations) / gets;
+    }
+
+    // Send range(0) GETs at a time by RedisAsyncClient::command, with the
+    // handler passed as std::function if erase is true, as is otherwise.
+    void commandGet(benchmark::State &state, bool erase)
+    {
+        const int64_t inFlight = state.range(0);
+
+        Connection connection;
+        GetHandler handler = {std::make_shared<Session>(), "key", &connection.total};
+
+        // warm up both output buffers, the completion slots and the node
+        // caches
+        for(int round = 0; round < 4; ++round)
+        {
+            for(int64_t i = 0; i < inFlight; ++i)
+                connection.redis.command("GET", {"key"}, handler);
+
+            connection.reply(inFlight);
+        }
+
+        allocations = 0;
+
+        for(auto _: state)
+        {
+            for(int64_t i = 0; i < inFlight; ++i)
+            {
+                if( erase )
+                    connection.redis.command("GET", {"key"},
+                            std::function<void(RedisValue)>(handler));
+                else
+                    connection.redis.command("GET", {"key"}, handler);
+            }
+
+            connection.reply(inFlight);
+        }
+
+        reportAllocations(state, state.iterations() * inFlight);
+        state.SetItemsProcessed(state.iterations() * inFlight);
+    }
+}
+
+// Handler type erased by std::function, as by the previous versions.
+static void CommandGetStdFunction(benchmark::State &state)
+{
+    commandGet(state, true);
+}
+
+// Handler kept in the completion slot of the command as is.
+static void CommandGetCompletionSlots(benchmark::State &state)
+{
+    commandGet(state, false);
+}
+
+BENCHMARK(CommandGetStdFunction)->Arg(1)->Arg(16)->Arg(1000);
+BENCHMARK(CommandGetCompletionSlots)->Arg(1)->Arg(16)->Arg(1000);
+
+BENCHMARK_MAIN();
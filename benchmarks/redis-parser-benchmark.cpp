@@ -1,4 +1,5 @@
 #include <benchmark/benchmark.h>
+#include <redisclient/redisarena.h>
 #include <redisclient/redisparser.h>
 
 
@@ -83,6 +84,100 @@ BENCHMARK_DEFINE_F(ParserFixture, ArrayParserByBytes)(benchmark::State &state)
     }
 }
 
+// HGETALL-like reply: range(0) field/value pairs, flat (range(1) == 0) or
+// XRANGE-like with every pair in a nested array (range(1) == 1).
+class BulkArrayFixture : public benchmark::Fixture
+{
+public:
+    void SetUp(const ::benchmark::State &state)
+    {
+        size_t pairs = state.range(0);
+        bool nested = state.range(1) != 0;
+
+        buffer.clear();
+        buffer += '*';
+        buffer += std::to_string(nested ? pairs : pairs * 2);
+        buffer += "\r\n";
+
+        for(size_t i = 0; i < pairs; ++i)
+        {
+            if (nested)
+                buffer += "*2\r\n";
+
+            appendBulk("field:" + std::to_string(i));
+            appendBulk("value:" + std::to_string(i));
+        }
+    }
+
+    void TearDown(const ::benchmark::State &)
+    {
+        buffer.clear();
+    }
+
+    void appendBulk(const std::string &s)
+    {
+        buffer += '$';
+        buffer += std::to_string(s.size());
+        buffer += "\r\n";
+        buffer += s;
+        buffer += "\r\n";
+    }
+
+    std::string buffer;
+};
+
+BENCHMARK_DEFINE_F(BulkArrayFixture, ValueParser)(benchmark::State &state)
+{
+    RedisParser parser;
+
+    while (state.KeepRunning())
+    {
+        if (parser.parse(buffer.c_str(), buffer.size()).second != RedisParser::Completed)
+        {
+            state.SkipWithError("parse incompleted");
+        }
+        parser.result();
+    }
+
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+BENCHMARK_DEFINE_F(BulkArrayFixture, ViewParser)(benchmark::State &state)
+{
+    RedisParser parser(RedisParser::ViewMode);
+
+    while (state.KeepRunning())
+    {
+        if (parser.parse(buffer.c_str(), buffer.size()).second != RedisParser::Completed)
+        {
+            state.SkipWithError("parse incompleted");
+        }
+        parser.resultView();
+    }
+
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+BENCHMARK_DEFINE_F(BulkArrayFixture, ArenaViewParser)(benchmark::State &state)
+{
+    RedisArena arena;
+    RedisParser parser(RedisParser::ViewMode);
+
+    parser.setArena(&arena);
+
+    while (state.KeepRunning())
+    {
+        if (parser.parse(buffer.c_str(), buffer.size()).second != RedisParser::Completed)
+        {
+            state.SkipWithError("parse incompleted");
+        }
+        parser.resultView();
+        arena.release();
+    }
+
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
 template<typename ParserType>
 void benchmarkParser(benchmark::State &state, const std::string &buffer, ParserType parser)
 {
@@ -101,11 +196,21 @@ void benchmarkParser(benchmark::State &state, const std::string &buffer, ParserT
 
 BENCHMARK_REGISTER_F(ParserFixture, ArrayParser)
     ->Ranges({{8, 16}, {0, 0}})
-    ->Ranges({{8, 16}, {1, 2}});
+    ->Ranges({{8, 16}, {1, 2}})
+    // deeper nested replies (EXEC results, XRANGE, CLUSTER SLOTS)
+    ->Args({8, 3})
+    ->Args({8, 4});
 BENCHMARK_REGISTER_F(ParserFixture, ArrayParserByBytes)
     ->Ranges({{8, 16}, {0, 0}})
     ->Ranges({{8, 16}, {1, 2}});
 
+BENCHMARK_REGISTER_F(BulkArrayFixture, ValueParser)
+    ->Ranges({{1 << 10, 1 << 17}, {0, 1}});
+BENCHMARK_REGISTER_F(BulkArrayFixture, ViewParser)
+    ->Ranges({{1 << 10, 1 << 17}, {0, 1}});
+BENCHMARK_REGISTER_F(BulkArrayFixture, ArenaViewParser)
+    ->Ranges({{1 << 10, 1 << 17}, {0, 1}});
+
 BENCHMARK_CAPTURE(benchmarkParser, parse_integer, ":123456789\r\n", RedisParser());
 BENCHMARK_CAPTURE(benchmarkParser, parse_string, "+simple string\r\n", RedisParser());
 BENCHMARK_CAPTURE(benchmarkParser, parse_error, "-error message\r\n", RedisParser());
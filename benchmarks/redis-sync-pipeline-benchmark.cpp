@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+#include <redisclient/pipeline.h>
+#include <redisclient/redissyncclient.h>
+
+#include <string>
+#include <vector>
+
+#include "standinserver.h"
+
+using namespace redisclient;
+
+static const std::string key = "user:1000:name";
+
+static void SyncPipelineGet(benchmark::State &state)
+{
+    const size_t count = state.range(0);
+
+    StandInServer server([](const std::vector<std::string> &) {
+        return StandInServer::bulk("bar");
+    });
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+
+    redis.connect(server.endpoint());
+
+    for(auto _: state)
+    {
+        Pipeline pipeline = redis.pipelined();
+
+        for(size_t i = 0; i < count; ++i)
+            pipeline.command("GET", {key});
+
+        RedisValue result = pipeline.finish();
+        benchmark::DoNotOptimize(result);
+    }
+
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(SyncPipelineGet)->Arg(1)->Arg(100)->Arg(1000)->Arg(10000);
+
+BENCHMARK_MAIN();
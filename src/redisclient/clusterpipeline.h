@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_CLUSTERPIPELINE_H
+#define REDISCLIENT_CLUSTERPIPELINE_H
+
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "redisbuffer.h"
+#include "redisclient/impl/rediscommand.h"
+#include "config.h"
+
+namespace redisclient
+{
+
+class RedisClusterClient;
+class RedisValue;
+
+// Pipeline of a Redis Cluster (see Pipeline). Commands are grouped by the
+// node of their key (the first argument) and every node gets its commands
+// as one pipeline, all nodes at once. MOVED and ASK replies are followed as
+// by RedisClusterClient::command.
+class ClusterPipeline
+{
+public:
+    REDIS_CLIENT_DECL ClusterPipeline(RedisClusterClient &client);
+
+    // add command to pipe, the arguments are copied when the pipeline is
+    // sent (see RedisClusterClient::command)
+    REDIS_CLIENT_DECL ClusterPipeline &command(std::string cmd, RedisArguments args);
+
+    // add command to pipe, without building a list of arguments:
+    //
+    //  pipe.command("GET", key);
+    template<typename ...Args>
+    inline typename std::enable_if<detail::AreArguments<Args...>::value, ClusterPipeline &>::type
+    command(std::string cmd, Args &&...args);
+
+    // Sends all commands to the nodes of the cluster. The handler gets the
+    // array of replies in order of the commands, when all of them are
+    // replied. The commands of a node whose connection fails get an error
+    // reply, and the handler gets an error instead of the array if the
+    // client is not connected. Example:
+    //
+    //  ClusterPipeline pipe(redis);
+    //
+    //  for(const std::string &key: keys)
+    //      pipe.command("GET", key);
+    //
+    //  pipe.finish([](RedisValue result) {
+    //      result.getArray()[0];  // value of keys[0]
+    //  });
+    //
+    REDIS_CLIENT_DECL void finish(std::function<void(RedisValue)> handler);
+
+private:
+    std::vector<RedisArguments> commands;
+    RedisClusterClient &client;
+};
+
+template<typename ...Args>
+inline typename std::enable_if<detail::AreArguments<Args...>::value, ClusterPipeline &>::type
+ClusterPipeline::command(std::string cmd, Args &&...args)
+{
+    commands.push_back(detail::makeArguments(std::move(cmd), std::forward<Args>(args)...));
+    return *this;
+}
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/clusterpipeline.cpp"
+#endif
+
+#endif // REDISCLIENT_CLUSTERPIPELINE_H
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_CLUSTERPIPELINE_CPP
+#define REDISCLIENT_CLUSTERPIPELINE_CPP
+
+#include "redisclient/clusterpipeline.h"
+#include "redisclient/redisvalue.h"
+#include "redisclient/redisclusterclient.h"
+
+namespace redisclient
+{
+
+ClusterPipeline::ClusterPipeline(RedisClusterClient &client)
+    : client(client)
+{
+}
+
+ClusterPipeline &ClusterPipeline::command(std::string cmd, RedisArguments args)
+{
+    args.push_front(std::move(cmd));
+    commands.push_back(std::move(args));
+    return *this;
+}
+
+void ClusterPipeline::finish(std::function<void(RedisValue)> handler)
+{
+    std::vector<RedisArguments> items;
+
+    items.swap(commands);
+    client.pipelinedArguments(std::move(items), std::move(handler));
+}
+
+}
+
+#endif // REDISCLIENT_CLUSTERPIPELINE_CPP
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_COMPLETIONSLOTS_H
+#define REDISCLIENT_COMPLETIONSLOTS_H
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+#include "redisclient/redisvalue.h"
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Reply handler, a type erased void(RedisValue) callable. Callables of up
+// to inlineSize bytes (a lambda capturing a few pointers and strings, or a
+// std::function) are stored in place, bigger ones on the heap.
+class ReplyCallback
+{
+public:
+    static const size_t inlineSize = 64;
+
+    ReplyCallback() noexcept
+        : ops(nullptr)
+    {
+    }
+
+    ReplyCallback(std::nullptr_t) noexcept
+        : ops(nullptr)
+    {
+    }
+
+    template<typename F, typename = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, ReplyCallback>::value>::type>
+    ReplyCallback(F &&f)
+        : ops(nullptr)
+    {
+        typedef typename std::decay<F>::type Callable;
+
+        construct<Callable>(std::forward<F>(f),
+                std::integral_constant<bool, isInline<Callable>()>());
+    }
+
+    ReplyCallback(ReplyCallback &&other) noexcept
+        : ops(other.ops)
+    {
+        if( ops )
+        {
+            ops->move(&other.storage, &storage);
+            other.ops = nullptr;
+        }
+    }
+
+    ReplyCallback &operator=(ReplyCallback &&other) noexcept
+    {
+        if( this != &other )
+        {
+            reset();
+
+            if( other.ops )
+            {
+                other.ops->move(&other.storage, &storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    ~ReplyCallback()
+    {
+        reset();
+    }
+
+    explicit operator bool() const
+    {
+        return ops != nullptr;
+    }
+
+    void operator()(RedisValue value)
+    {
+        ops->invoke(&storage, std::move(value));
+    }
+
+    template<typename Callable>
+    static constexpr bool isInline()
+    {
+        return sizeof(Callable) <= inlineSize &&
+            alignof(Callable) <= alignof(Storage) &&
+            std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+private:
+    typedef typename std::aligned_storage<inlineSize>::type Storage;
+
+    struct Ops
+    {
+        void (*invoke)(void *storage, RedisValue &&value);
+        // Move constructs to `to` and destroys `from`.
+        void (*move)(void *from, void *to);
+        void (*destroy)(void *storage);
+    };
+
+    template<typename Callable>
+    struct InlineOps
+    {
+        static void invoke(void *storage, RedisValue &&value)
+        {
+            (*static_cast<Callable *>(storage))(std::move(value));
+        }
+
+        static void move(void *from, void *to)
+        {
+            Callable *callable = static_cast<Callable *>(from);
+
+            new (to) Callable(std::move(*callable));
+            callable->~Callable();
+        }
+
+        static void destroy(void *storage)
+        {
+            static_cast<Callable *>(storage)->~Callable();
+        }
+
+        static const Ops ops;
+    };
+
+    template<typename Callable>
+    struct HeapOps
+    {
+        static void invoke(void *storage, RedisValue &&value)
+        {
+            (**static_cast<Callable **>(storage))(std::move(value));
+        }
+
+        static void move(void *from, void *to)
+        {
+            new (to) Callable *(*static_cast<Callable **>(from));
+        }
+
+        static void destroy(void *storage)
+        {
+            delete *static_cast<Callable **>(storage);
+        }
+
+        static const Ops ops;
+    };
+
+    template<typename Callable, typename F>
+    void construct(F &&f, std::true_type)
+    {
+        new (&storage) Callable(std::forward<F>(f));
+        ops = &InlineOps<Callable>::ops;
+    }
+
+    template<typename Callable, typename F>
+    void construct(F &&f, std::false_type)
+    {
+        Callable *callable = new Callable(std::forward<F>(f));
+
+        new (&storage) Callable *(callable);
+        ops = &HeapOps<Callable>::ops;
+    }
+
+    void reset() noexcept
+    {
+        if( ops )
+        {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+    Storage storage;
+    const Ops *ops;
+};
+
+template<typename Callable>
+const ReplyCallback::Ops ReplyCallback::InlineOps<Callable>::ops = {
+    &InlineOps<Callable>::invoke, &InlineOps<Callable>::move, &InlineOps<Callable>::destroy
+};
+
+template<typename Callable>
+const ReplyCallback::Ops ReplyCallback::HeapOps<Callable>::ops = {
+    &HeapOps<Callable>::invoke, &HeapOps<Callable>::move, &HeapOps<Callable>::destroy
+};
+
+// FIFO of completion slots in a ring buffer. Slots are allocated once
+// and reused by the following commands, the ring doubles when all of them
+// are in use and never shrinks, so a connection stops allocating as soon
+// as it has seen its maximum number of commands in flight.
+template<typename T>
+class CompletionRing : boost::noncopyable
+{
+public:
+    static const size_t defaultCapacity = 64;
+
+    explicit CompletionRing(size_t capacity = defaultCapacity)
+        : slots(nullptr), mask(0), head(0), count(0)
+    {
+        size_t size = 1;
+
+        while( size < capacity )
+            size *= 2;
+
+        slots = allocate(size);
+        mask = size - 1;
+    }
+
+    ~CompletionRing()
+    {
+        clear();
+        ::operator delete(slots);
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    T &front()
+    {
+        return slots[head];
+    }
+
+    void push(T &&value)
+    {
+        if( count == capacity() )
+            grow();
+
+        new (&slots[(head + count) & mask]) T(std::move(value));
+        ++count;
+    }
+
+    void pop()
+    {
+        slots[head].~T();
+        head = (head + 1) & mask;
+        --count;
+    }
+
+    // Destroy all queued items, the slots are kept.
+    void clear()
+    {
+        while( !empty() )
+            pop();
+
+        head = 0;
+    }
+
+private:
+    static T *allocate(size_t size)
+    {
+        return static_cast<T *>(::operator new(size * sizeof(T)));
+    }
+
+    void grow()
+    {
+        size_t size = capacity() * 2;
+        T *grown = allocate(size);
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            T &slot = slots[(head + i) & mask];
+
+            new (&grown[i]) T(std::move(slot));
+            slot.~T();
+        }
+
+        ::operator delete(slots);
+        slots = grown;
+        mask = size - 1;
+        head = 0;
+    }
+
+    T *slots;
+    size_t mask;
+    size_t head;
+    size_t count;
+};
+
+}
+
+}
+
+#endif // REDISCLIENT_COMPLETIONSLOTS_H
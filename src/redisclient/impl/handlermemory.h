@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_HANDLERMEMORY_H
+#define REDISCLIENT_HANDLERMEMORY_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <boost/version.hpp>
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Memory of one asynchronous operation at a time, the next operation
+// reuses it. An operation started while the memory is taken, or too big
+// for it, is allocated on the heap.
+class HandlerMemory : boost::noncopyable
+{
+public:
+    static const size_t size = 256;
+
+    HandlerMemory()
+        : inUse(false)
+    {
+    }
+
+    void *allocate(size_t bytes)
+    {
+        if( bytes <= size && inUse.exchange(true, std::memory_order_acquire) == false )
+            return &storage;
+        else
+            return ::operator new(bytes);
+    }
+
+    void deallocate(void *ptr)
+    {
+        if( ptr == &storage )
+            inUse.store(false, std::memory_order_release);
+        else
+            ::operator delete(ptr);
+    }
+
+private:
+    typename std::aligned_storage<size>::type storage;
+    std::atomic<bool> inUse;
+};
+
+// Allocator of the operations of an AllocatingHandler.
+template<typename T>
+class HandlerAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit HandlerAllocator(HandlerMemory &memory)
+        : memory(&memory)
+    {
+    }
+
+    template<typename U>
+    HandlerAllocator(const HandlerAllocator<U> &other)
+        : memory(other.memory)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(memory->allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T *ptr, size_t)
+    {
+        memory->deallocate(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const HandlerAllocator<U> &other) const
+    {
+        return memory == other.memory;
+    }
+
+    template<typename U>
+    bool operator!=(const HandlerAllocator<U> &other) const
+    {
+        return memory != other.memory;
+    }
+
+private:
+    template<typename> friend class HandlerAllocator;
+
+    HandlerMemory *memory;
+};
+
+// Handler whose operation is allocated from a HandlerMemory, by its
+// associated allocator.
+template<typename Handler>
+class AllocatingHandler
+{
+public:
+    typedef HandlerAllocator<Handler> allocator_type;
+
+    AllocatingHandler(HandlerMemory &memory, Handler handler)
+        : memory(&memory), handler(std::move(handler))
+    {
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(*memory);
+    }
+
+    template<typename ...Args>
+    void operator()(Args &&...args)
+    {
+        handler(std::forward<Args>(args)...);
+    }
+
+#if BOOST_VERSION < 106600
+    // boost::asio before associated allocators
+    friend void *asio_handler_allocate(size_t bytes, AllocatingHandler *self)
+    {
+        return self->memory->allocate(bytes);
+    }
+
+    friend void asio_handler_deallocate(void *ptr, size_t, AllocatingHandler *self)
+    {
+        self->memory->deallocate(ptr);
+    }
+#endif
+
+private:
+    HandlerMemory *memory;
+    Handler handler;
+};
+
+template<typename Handler>
+inline AllocatingHandler<typename std::decay<Handler>::type> makeAllocatingHandler(
+        HandlerMemory &memory, Handler &&handler)
+{
+    return AllocatingHandler<typename std::decay<Handler>::type>(
+            memory, std::forward<Handler>(handler));
+}
+
+}
+
+}
+
+#endif // REDISCLIENT_HANDLERMEMORY_H
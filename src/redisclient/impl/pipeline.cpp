@@ -18,7 +18,7 @@ Pipeline::Pipeline(RedisSyncClient &client)
 {
 }
 
-Pipeline &Pipeline::command(std::string cmd, std::deque<RedisBuffer> args)
+Pipeline &Pipeline::command(std::string cmd, RedisArguments args)
 {
     args.push_front(std::move(cmd));
     commands.push_back(std::move(args));
@@ -27,12 +27,20 @@ Pipeline &Pipeline::command(std::string cmd, std::deque<RedisBuffer> args)
 
 RedisValue Pipeline::finish()
 {
-    return client.pipelined(std::move(commands));
+    boost::system::error_code ec;
+    RedisValue result = client.pipelinedArguments(commands, ec);
+
+    commands.clear();
+    detail::throwIfError(ec);
+    return result;
 }
 
 RedisValue Pipeline::finish(boost::system::error_code &ec)
 {
-    return client.pipelined(std::move(commands), ec);
+    RedisValue result = client.pipelinedArguments(commands, ec);
+
+    commands.clear();
+    return result;
 }
 
 }
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISARENA_CPP
+#define REDISCLIENT_REDISARENA_CPP
+
+#include <stdint.h>
+
+#include "redisclient/redisarena.h"
+
+namespace redisclient {
+
+RedisArena::RedisArena(size_t blockSize)
+    : blockSize(blockSize), current(nullptr), available(0)
+{
+}
+
+RedisArena::~RedisArena()
+{
+    for(void *block: blocks)
+    {
+        ::operator delete(block);
+    }
+
+    for(void *block: largeBlocks)
+    {
+        ::operator delete(block);
+    }
+}
+
+void *RedisArena::allocate(size_t size, size_t alignment)
+{
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(current) % alignment) % alignment;
+
+    if( padding + size > available )
+    {
+        if( size > blockSize / 2 )
+        {
+            // Big arrays get a block of their own, the current block
+            // is still used for the small allocations.
+            void *block = ::operator new(size);
+
+            largeBlocks.push_back(block);
+            return block;
+        }
+
+        current = static_cast<char *>(::operator new(blockSize));
+        available = blockSize;
+        blocks.push_back(current);
+        padding = 0;
+    }
+
+    void *result = current + padding;
+
+    current += padding + size;
+    available -= padding + size;
+
+    return result;
+}
+
+void RedisArena::release()
+{
+    for(void *block: largeBlocks)
+    {
+        ::operator delete(block);
+    }
+
+    largeBlocks.clear();
+
+    if( blocks.empty() == false )
+    {
+        for(size_t i = 1; i < blocks.size(); ++i)
+        {
+            ::operator delete(blocks[i]);
+        }
+
+        blocks.resize(1);
+        current = static_cast<char *>(blocks.front());
+        available = blockSize;
+    }
+}
+
+size_t RedisArena::blockCount() const
+{
+    return blocks.size() + largeBlocks.size();
+}
+
+}
+
+#endif // REDISCLIENT_REDISARENA_CPP
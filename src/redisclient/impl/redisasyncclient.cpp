@@ -6,6 +6,7 @@
 #ifndef REDISASYNCCLIENT_REDISASYNCCLIENT_CPP
 #define REDISASYNCCLIENT_REDISASYNCCLIENT_CPP
 
+#include <algorithm>
 #include <memory>
 #include <functional>
 
@@ -31,6 +32,7 @@ void RedisAsyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
     if( pimpl->state == State::Closed )
     {
         pimpl->redisParser = RedisParser();
+        pimpl->replyInProgress = false;
         std::move(pimpl->socket);
     }
 
@@ -75,8 +77,9 @@ void RedisAsyncClient::connect(const boost::asio::local::stream_protocol::endpoi
 
 bool RedisAsyncClient::isConnected() const
 {
-    return pimpl->getState() == State::Connected ||
-            pimpl->getState() == State::Subscribed;
+    State state = pimpl->getState();
+
+    return state == State::Connected || state == State::Subscribed;
 }
 
 void RedisAsyncClient::disconnect()
@@ -89,15 +92,110 @@ void RedisAsyncClient::installErrorHandler(std::function<void(const std::string
     pimpl->errorHandler = std::move(handler);
 }
 
-void RedisAsyncClient::command(const std::string &cmd, std::deque<RedisBuffer> args,
+void RedisAsyncClient::setMaxReadBufferSize(size_t size)
+{
+    pimpl->setMaxReadBufferSize(size);
+}
+
+void RedisAsyncClient::setMaxWriteBufferSize(size_t size)
+{
+    pimpl->setMaxWriteBufferSize(size);
+}
+
+size_t RedisAsyncClient::queueDepth() const
+{
+    return pimpl->outstanding.load(std::memory_order_relaxed);
+}
+
+void RedisAsyncClient::cork(size_t maxCommands, size_t maxBytes,
+        const boost::posix_time::time_duration &maxDelay)
+{
+    pimpl->post(std::bind(&RedisClientImpl::cork, pimpl,
+                maxCommands, maxBytes, maxDelay));
+}
+
+void RedisAsyncClient::uncork()
+{
+    pimpl->post(std::bind(&RedisClientImpl::uncork, pimpl));
+}
+
+void RedisAsyncClient::flush()
+{
+    pimpl->post(std::bind(&RedisClientImpl::flush, pimpl));
+}
+
+void RedisAsyncClient::command(const std::string &cmd, RedisArguments args,
                           std::function<void(RedisValue)> handler)
 {
     if(stateValid())
     {
         args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        pimpl->submit(args, std::move(handler));
+    }
+}
+
+void RedisAsyncClient::commandStream(const std::string &cmd, RedisArguments args,
+                                     size_t chunkSize,
+                                     std::function<void(std::vector<RedisValue>)> chunkHandler,
+                                     std::function<void(RedisValue)> handler)
+{
+    if(stateValid())
+    {
+        args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        chunkSize = std::max<size_t>(chunkSize, 1);
+
+        std::shared_ptr<std::vector<RedisValue>> chunk =
+            std::make_shared<std::vector<RedisValue>>();
+
+        chunk->reserve(chunkSize);
+
+        auto elementHandler = [chunk, chunkSize, chunkHandler](RedisValue value) {
+            chunk->push_back(std::move(value));
+
+            if( chunk->size() >= chunkSize )
+            {
+                std::vector<RedisValue> ready;
+
+                ready.reserve(chunkSize);
+                ready.swap(*chunk);
+                chunkHandler(std::move(ready));
+            }
+        };
+
+        auto replyHandler = [chunk, chunkHandler, handler](RedisValue value) {
+            if( chunk->empty() == false )
+            {
+                chunkHandler(std::move(*chunk));
+                chunk->clear();
+            }
+
+            handler(std::move(value));
+        };
 
-        pimpl->post(std::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(args), std::move(handler)));
+        RedisClientImpl::ReplyHandler replyHandlers{std::move(replyHandler),
+            std::move(elementHandler), nullptr};
+
+        pimpl->submit(args, std::move(replyHandlers));
+    }
+}
+
+void RedisAsyncClient::commandToSink(const std::string &cmd, RedisArguments args,
+                                     std::function<void(const char *, size_t)> sink,
+                                     std::function<void(RedisValue)> handler)
+{
+    if(stateValid())
+    {
+        args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        RedisClientImpl::ReplyHandler replyHandlers{std::move(handler),
+            nullptr, std::move(sink)};
+
+        pimpl->submit(args, std::move(replyHandlers));
     }
 }
 
@@ -152,14 +250,10 @@ void RedisAsyncClient::publish(const std::string &channel, const RedisBuffer &ms
 
     if( pimpl->state == State::Connected )
     {
-        std::deque<RedisBuffer> items(3);
-
-        items[0] = publishStr;
-        items[1] = channel;
-        items[2] = msg;
+        RedisArguments items{publishStr, channel, msg};
+        detail::copyRefs(items);
 
-        pimpl->post(std::bind(&RedisClientImpl::doAsyncCommand, pimpl,
-                    pimpl->makeCommand(items), std::move(handler)));
+        pimpl->submit(items, std::move(handler));
     }
     else
     {
@@ -7,209 +7,268 @@
 #define REDISCLIENT_REDISCLIENTIMPL_CPP
 
 #include <boost/asio/write.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
+
+#include <sys/uio.h>
 
 #include "redisclientimpl.h"
+#include "redisclient/impl/rediscommand.h"
 
 namespace
 {
-    static const char crlf[] = {'\r', '\n'};
-    inline void bufferAppend(std::vector<char> &vec, const std::string &s);
-    inline void bufferAppend(std::vector<char> &vec, const std::vector<char> &s);
-    inline void bufferAppend(std::vector<char> &vec, const char *s);
-    inline void bufferAppend(std::vector<char> &vec, char c);
-    template<size_t size>
-    inline void bufferAppend(std::vector<char> &vec, const char (&s)[size]);
+    // Bounds of the read buffer (see RedisClientImpl::prepareReadBuffer).
+    const size_t minReadBufferSize = 4096;
+    const size_t defaultMaxReadBufferSize = 1024 * 1024;
+
+    // The read buffer shrinks by half after this number of consecutive
+    // reads which filled less than a quarter of it.
+    const size_t smallReadsToShrink = 8;
+
+    // Default limit of the async output buffer.
+    const size_t defaultMaxWriteBufferSize = 1024 * 1024;
+
+    // Limit of buffers in one sendmsg call.
+#ifdef IOV_MAX
+    const size_t maxIovecs = IOV_MAX;
+#else
+    const size_t maxIovecs = 1024;
+#endif
 
-    inline void bufferAppend(std::vector<char> &vec, const redisclient::RedisBuffer &buf)
-    {
-        if (buf.data.type() == typeid(std::string))
-            bufferAppend(vec, boost::get<std::string>(buf.data));
-        else
-            bufferAppend(vec, boost::get<std::vector<char>>(buf.data));
-    }
+    typedef redisclient::RedisClientImpl::Deadline Deadline;
 
-    inline void bufferAppend(std::vector<char> &vec, const std::string &s)
+    // Milliseconds left until the deadline, rounded up, so poll does not
+    // wake up just before the deadline.
+    int remainingMsec(const Deadline &deadline)
     {
-        vec.insert(vec.end(), s.begin(), s.end());
-    }
+        Deadline now = std::chrono::steady_clock::now();
 
-    inline void bufferAppend(std::vector<char> &vec, const std::vector<char> &s)
-    {
-        vec.insert(vec.end(), s.begin(), s.end());
-    }
-
-    inline void bufferAppend(std::vector<char> &vec, const char *s)
-    {
-        vec.insert(vec.end(), s, s + strlen(s));
-    }
+        if (now >= deadline)
+            return 0;
 
-    inline void bufferAppend(std::vector<char> &vec, char c)
-    {
-        vec.resize(vec.size() + 1);
-        vec[vec.size() - 1] = c;
-    }
+        std::chrono::milliseconds::rep msec = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - now + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
 
-    template<size_t size>
-    inline void bufferAppend(std::vector<char> &vec, const char (&s)[size])
-    {
-        vec.insert(vec.end(), s, s + size);
+        return static_cast<int>(std::min<std::chrono::milliseconds::rep>(msec, INT_MAX));
     }
 
-    ssize_t socketReadSomeImpl(int socket, char *buffer, size_t size,
-            size_t timeoutMsec)
+    // Wait until the socket is ready for the events. The socket is polled
+    // only after a non-blocking recv/send would block, so the usual
+    // request/response takes one syscall for each direction.
+    bool socketWait(int socket, short events, const Deadline &deadline,
+            boost::system::error_code &ec)
     {
-        struct timeval tv = {static_cast<time_t>(timeoutMsec / 1000),
-            static_cast<__suseconds_t>((timeoutMsec % 1000) * 1000)};
-        int result = setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-        if (result != 0)
-        {
-            return result;
-        }
-
         pollfd pfd;
 
         pfd.fd = socket;
-        pfd.events = POLLIN;
+        pfd.events = events;
 
-        result = ::poll(&pfd, 1, timeoutMsec);
-        if (result > 0)
-        {
-            return recv(socket, buffer, size, MSG_DONTWAIT);
-        }
-        else
+        for(;;)
         {
-            return result;
+            int result = ::poll(&pfd, 1, remainingMsec(deadline));
+
+            if (result > 0)
+            {
+                return true;
+            }
+            else if (result == 0)
+            {
+                // poll waits INT_MAX msec at most
+                if (std::chrono::steady_clock::now() < deadline)
+                    continue;
+
+                ec = boost::asio::error::timed_out;
+                return false;
+            }
+            else if (errno != EINTR)
+            {
+                ec = boost::system::error_code(errno,
+                        boost::asio::error::get_system_category());
+                return false;
+            }
         }
     }
 
-    size_t socketReadSome(int socket, boost::asio::mutable_buffer buffer,
-            const boost::posix_time::time_duration &timeout,
+    // Read what is available without waiting. Returns 0 if there is no
+    // data, ec is set on errors.
+    size_t socketTryReadSome(int socket, boost::asio::mutable_buffer buffer,
             boost::system::error_code &ec)
     {
-        size_t bytesRecv = 0;
-        size_t timeoutMsec = timeout.total_milliseconds();
-
         for(;;)
         {
-            ssize_t result = socketReadSomeImpl(socket,
-                    boost::asio::buffer_cast<char *>(buffer) + bytesRecv,
-                    boost::asio::buffer_size(buffer) - bytesRecv, timeoutMsec);
+            ssize_t result = recv(socket, boost::asio::buffer_cast<char *>(buffer),
+                    boost::asio::buffer_size(buffer), MSG_DONTWAIT);
 
-            if (result < 0)
+            if (result > 0)
             {
-                if (errno == EINTR)
-                {
-                    continue;
-                }
-                else
-                {
-                    ec = boost::system::error_code(errno,
-                            boost::asio::error::get_system_category());
-                    break;
-                }
+                return result;
             }
             else if (result == 0)
             {
-                // boost::asio::error::connection_reset();
-                // boost::asio::error::eof
                 ec = boost::asio::error::eof;
-                break;
+                return 0;
             }
-            else
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
             {
-                bytesRecv += result;
-                break;
+                return 0;
+            }
+            else if (errno != EINTR)
+            {
+                ec = boost::system::error_code(errno,
+                        boost::asio::error::get_system_category());
+                return 0;
             }
         }
-
-        return bytesRecv;
     }
 
-
-    ssize_t socketWriteImpl(int socket, const char *buffer, size_t size,
-            size_t timeoutMsec)
+    size_t socketReadSome(int socket, boost::asio::mutable_buffer buffer,
+            const Deadline &deadline,
+            boost::system::error_code &ec)
     {
-        struct timeval tv = {static_cast<time_t>(timeoutMsec / 1000),
-            static_cast<__suseconds_t>((timeoutMsec % 1000) * 1000)};
-        int result = setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-
-        if (result != 0)
+        for(;;)
         {
-            return result;
+            size_t result = socketTryReadSome(socket, buffer, ec);
+
+            if (result > 0 || ec)
+                return result;
+            if (!socketWait(socket, POLLIN, deadline, ec))
+                return 0;
         }
+    }
 
-        pollfd pfd;
+    // Gather list written with sendmsg, IOV_MAX buffers at a time.
+    class GatherWriter
+    {
+    public:
+        explicit GatherWriter(const std::vector<boost::asio::const_buffer> &buffers)
+            : first(0)
+        {
+            iov.reserve(buffers.size());
 
-        pfd.fd = socket;
-        pfd.events = POLLOUT;
+            for(const auto &buffer: buffers)
+            {
+                if (boost::asio::buffer_size(buffer) > 0)
+                {
+                    iovec item;
 
-        result = ::poll(&pfd, 1, timeoutMsec);
-        if (result > 0)
-        {
-            return send(socket, buffer, size, 0);
+                    item.iov_base = const_cast<char *>(boost::asio::buffer_cast<const char *>(buffer));
+                    item.iov_len = boost::asio::buffer_size(buffer);
+                    iov.push_back(item);
+                }
+            }
         }
-        else
+
+        bool done() const
         {
-            return result;
+            return first == iov.size();
         }
-    }
 
-    size_t socketWrite(int socket, boost::asio::const_buffer buffer,
-            const boost::posix_time::time_duration &timeout,
-            boost::system::error_code &ec)
-    {
-        size_t bytesSend = 0;
-        size_t timeoutMsec = timeout.total_milliseconds();
-
-        while(bytesSend < boost::asio::buffer_size(buffer))
+        // Write as much as the socket takes without waiting. Returns false
+        // if nothing was written, ec is set on errors.
+        bool writeSome(int socket, boost::system::error_code &ec)
         {
-            ssize_t result = socketWriteImpl(socket,
-                    boost::asio::buffer_cast<const char *>(buffer) + bytesSend,
-                    boost::asio::buffer_size(buffer) - bytesSend, timeoutMsec);
-
-            if (result < 0)
+            for(;;)
             {
-                if (errno == EINTR)
+                msghdr msg = msghdr();
+
+                msg.msg_iov = iov.data() + first;
+                msg.msg_iovlen = std::min(iov.size() - first, maxIovecs);
+
+                ssize_t result = sendmsg(socket, &msg, MSG_DONTWAIT);
+
+                if (result > 0)
                 {
-                    continue;
+                    skip(result);
+                    return true;
+                }
+                else if (result == 0)
+                {
+                    ec = boost::asio::error::eof;
+                    return false;
                 }
-                else
+                else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    return false;
+                }
+                else if (errno != EINTR)
                 {
                     ec = boost::system::error_code(errno,
                             boost::asio::error::get_system_category());
-                    break;
+                    return false;
                 }
             }
-            else if (result == 0)
+        }
+
+    private:
+        // skip the written buffers and the written part of the last one
+        void skip(size_t written)
+        {
+            while(first < iov.size() && written >= iov[first].iov_len)
             {
-                    // boost::asio::error::connection_reset();
-                    // boost::asio::error::eof
-                    ec = boost::asio::error::eof;
-                    break;
+                written -= iov[first].iov_len;
+                ++first;
             }
-            else
+
+            if (written > 0)
             {
-                bytesSend += result;
+                iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + written;
+                iov[first].iov_len -= written;
             }
         }
 
-        return bytesSend;
+        std::vector<iovec> iov;
+        size_t first;
+    };
+
+    void socketWrite(int socket, const std::vector<boost::asio::const_buffer> &buffers,
+            const Deadline &deadline,
+            boost::system::error_code &ec)
+    {
+        GatherWriter writer(buffers);
+
+        while(!writer.done())
+        {
+            if (!writer.writeSome(socket, ec) &&
+                    (ec || !socketWait(socket, POLLOUT, deadline, ec)))
+                break;
+        }
     }
 
-    size_t socketWrite(int socket, const std::vector<boost::asio::const_buffer> &buffers,
-            const boost::posix_time::time_duration &timeout,
+    size_t socketWrite(int socket, boost::asio::const_buffer buffer,
+            const Deadline &deadline,
             boost::system::error_code &ec)
     {
         size_t bytesSend = 0;
-        for(const auto &buffer: buffers)
+
+        while(bytesSend < boost::asio::buffer_size(buffer))
         {
-            bytesSend += socketWrite(socket, buffer, timeout, ec);
+            ssize_t result = send(socket,
+                    boost::asio::buffer_cast<const char *>(buffer) + bytesSend,
+                    boost::asio::buffer_size(buffer) - bytesSend, MSG_DONTWAIT);
 
-            if (ec)
+            if (result > 0)
+            {
+                bytesSend += result;
+            }
+            else if (result == 0)
+            {
+                ec = boost::asio::error::eof;
                 break;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (!socketWait(socket, POLLOUT, deadline, ec))
+                    break;
+            }
+            else if (errno != EINTR)
+            {
+                ec = boost::system::error_code(errno,
+                        boost::asio::error::get_system_category());
+                break;
+            }
         }
 
         return bytesSend;
@@ -220,7 +279,14 @@ namespace redisclient {
 
 RedisClientImpl::RedisClientImpl(boost::asio::io_service &ioService_)
     : ioService(ioService_), strand(ioService), socket(ioService),
-    bufSize(0),subscribeSeq(0), state(State::Unconnected)
+    buf(minReadBufferSize), bufPos(0), bufSize(0), lastReadSize(0), smallReads(0),
+    maxReadBufferSize(defaultMaxReadBufferSize),
+    subscribeSeq(0), replyInProgress(false),
+    maxWriteBufferSize(defaultMaxWriteBufferSize), writeInProgress(false),
+    corked(false), corkCommands(0), corkBytes(0), queuedCommands(0), queuedBytes(0),
+    flushScheduled(false), flushRequested(false), flushTimer(ioService), flushGeneration(0),
+    outstanding(0),
+    state(State::Unconnected)
 {
 }
 
@@ -234,8 +300,24 @@ void RedisClientImpl::close() noexcept
     boost::system::error_code ignored_ec;
 
     msgHandlers.clear();
-    decltype(handlers)().swap(handlers);
-
+    outstanding.fetch_sub(handlers.size(), std::memory_order_relaxed);
+    handlers.clear();
+
+    // the commands not written yet would go to the next connection, with
+    // their handlers dropped their replies would go to the next commands
+    outputQueued.data.clear();
+    outputQueued.splices.clear();
+    outputQueued.args.clear();
+    dataQueued.clear();
+    queuedCommands = 0;
+    queuedBytes = 0;
+
+    // nor is a reply cut by the close continued there
+    redisParser = RedisParser();
+    replyInProgress = false;
+
+    cancelFlush();
+    flushRequested = false;
     socket.cancel(ignored_ec);
     socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored_ec);
     socket.close(ignored_ec);
@@ -248,11 +330,66 @@ RedisClientImpl::State RedisClientImpl::getState() const
     return state;
 }
 
+void RedisClientImpl::setMaxReadBufferSize(size_t size)
+{
+    maxReadBufferSize = std::max(size, minReadBufferSize);
+}
+
+void RedisClientImpl::setMaxWriteBufferSize(size_t size)
+{
+    maxWriteBufferSize = size;
+}
+
+// Resize the read buffer before the next read. The buffer doubles after a
+// read which filled it and grows to fit the rest of a big bulk string, so
+// big replies take a few large reads instead of many 4 KiB ones. It shrinks
+// back after a series of small reads. Must be called only when the buffer
+// holds no unparsed data. lastReadSize is the size of the read since the
+// last call, 0 if there was none.
+void RedisClientImpl::prepareReadBuffer()
+{
+    size_t size = buf.size();
+
+    if( lastReadSize == 0 )
+    {
+        // no read since the last call
+    }
+    else if( lastReadSize == size )
+    {
+        smallReads = 0;
+        size *= 2;
+    }
+    else if( lastReadSize < size / 4 && size > minReadBufferSize )
+    {
+        if( ++smallReads >= smallReadsToShrink )
+        {
+            smallReads = 0;
+            size /= 2;
+        }
+    }
+    else
+    {
+        smallReads = 0;
+    }
+
+    lastReadSize = 0;
+    size = std::max(size, redisParser.pendingBulkSize());
+    size = std::max(std::min(size, maxReadBufferSize), minReadBufferSize);
+
+    if( size != buf.size() )
+    {
+        // the content is not needed, do not copy it
+        std::vector<char>(size).swap(buf);
+    }
+}
+
 void RedisClientImpl::processMessage()
 {
+    prepareReadBuffer();
     socket.async_read_some(boost::asio::buffer(buf),
-                           std::bind(&RedisClientImpl::asyncRead,
-                                       shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+                           detail::makeAllocatingHandler(readMemory,
+                               std::bind(&RedisClientImpl::asyncRead,
+                                   shared_from_this(), std::placeholders::_1, std::placeholders::_2)));
 }
 
 void RedisClientImpl::doProcessMessage(RedisValue v)
@@ -293,8 +430,11 @@ void RedisClientImpl::doProcessMessage(RedisValue v)
                     cmd == "psubscribe" || cmd == "punsubscribe")
                    )
             {
-                handlers.front()(std::move(v));
+                detail::ReplyCallback handler = std::move(handlers.front().handler);
+
                 handlers.pop();
+                outstanding.fetch_sub(1, std::memory_order_relaxed);
+                handler(std::move(v));
             }
             else
             {
@@ -318,8 +458,12 @@ void RedisClientImpl::doProcessMessage(RedisValue v)
     {
         if( handlers.empty() == false )
         {
-            handlers.front()(std::move(v));
+            // the slot may be reused by a command sent from the handler
+            detail::ReplyCallback handler = std::move(handlers.front().handler);
+
             handlers.pop();
+            outstanding.fetch_sub(1, std::memory_order_relaxed);
+            handler(std::move(v));
         }
         else
         {
@@ -336,31 +480,159 @@ void RedisClientImpl::doProcessMessage(RedisValue v)
 
 void RedisClientImpl::asyncWrite(const boost::system::error_code &ec, size_t)
 {
+    writeInProgress = false;
     dataWrited.clear();
 
+    // keep the buffer for the next write unless it was over the limit
+    if( outputWrited.data.capacity() > maxWriteBufferSize )
+        std::vector<char>().swap(outputWrited.data);
+    else
+        outputWrited.data.clear();
+
+    outputWrited.splices.clear();
+    outputWrited.args.clear();
+
     if( ec )
     {
-        errorHandler(ec.message());
+        // the write is cancelled by close
+        if( ec != boost::asio::error::operation_aborted )
+        {
+            errorHandler(ec.message());
+        }
         return;
     }
 
-    if( dataQueued.empty() == false )
+    writeQueued(flushRequested);
+}
+
+void RedisClientImpl::writeQueued(bool force)
+{
+    if( writeInProgress )
+    {
+        return;
+    }
+    else if( outputQueued.data.empty() && dataQueued.empty() )
     {
-        std::vector<boost::asio::const_buffer> buffers(dataQueued.size());
+        // a flush of nothing does not apply to the next commands
+        flushRequested = false;
+        return;
+    }
 
-        for(size_t i = 0; i < dataQueued.size(); ++i)
+    if( !corked || force || queuedCommands >= corkCommands || queuedBytes >= corkBytes )
+    {
+        startWrite();
+    }
+    else if( !flushScheduled )
+    {
+        flushScheduled = true;
+
+        if( corkDelay.ticks() > 0 )
         {
-            buffers[i] = boost::asio::buffer(dataQueued[i]);
+            flushTimer.expires_from_now(corkDelay);
+            flushTimer.async_wait(std::bind(&RedisClientImpl::flushTimeout,
+                        shared_from_this(), std::placeholders::_1, flushGeneration));
         }
+        else
+        {
+            // flush at the end of the current event loop turn
+            post(std::bind(&RedisClientImpl::flushTimeout,
+                        shared_from_this(), boost::system::error_code(), flushGeneration));
+        }
+    }
+}
+
+void RedisClientImpl::startWrite()
+{
+    // the flush scheduled for these commands must not cut the next batch
+    cancelFlush();
+
+    outputQueued.swap(outputWrited);
+    dataQueued.swap(dataWrited);
+    writeInProgress = true;
+    flushRequested = false;
+    queuedCommands = 0;
+    queuedBytes = 0;
+
+    if( outputWrited.splices.empty() && dataWrited.empty() )
+    {
+        boost::asio::async_write(socket, boost::asio::buffer(outputWrited.data),
+                detail::makeAllocatingHandler(writeMemory,
+                    std::bind(&RedisClientImpl::asyncWrite, shared_from_this(),
+                        std::placeholders::_1, std::placeholders::_2)));
+    }
+    else
+    {
+        std::vector<boost::asio::const_buffer> buffers;
 
-        std::swap(dataQueued, dataWrited);
+        buffers.reserve(2 * outputWrited.splices.size() + 1 + dataWrited.size());
+        detail::gatherBuffers(outputWrited.data, outputWrited.splices, buffers);
+
+        for(const QueuedCommand &queued: dataWrited)
+        {
+            if( queued.splices.empty() )
+                buffers.push_back(boost::asio::buffer(queued.data));
+            else
+                detail::gatherBuffers(queued.data, queued.splices, buffers);
+        }
 
         boost::asio::async_write(socket, buffers,
-                std::bind(&RedisClientImpl::asyncWrite, shared_from_this(),
-                    std::placeholders::_1, std::placeholders::_2));
+                detail::makeAllocatingHandler(writeMemory,
+                    std::bind(&RedisClientImpl::asyncWrite, shared_from_this(),
+                        std::placeholders::_1, std::placeholders::_2)));
+    }
+}
+
+void RedisClientImpl::cork(size_t maxCommands, size_t maxBytes,
+        const boost::posix_time::time_duration &maxDelay)
+{
+    corked = true;
+    corkCommands = std::max<size_t>(maxCommands, 1);
+    corkBytes = std::max<size_t>(maxBytes, 1);
+    corkDelay = maxDelay;
+}
+
+void RedisClientImpl::uncork()
+{
+    corked = false;
+    flush();
+}
+
+void RedisClientImpl::flush()
+{
+    // commands submitted before the flush are sent by it
+    drainSubmissions();
+
+    if( writeInProgress )
+        flushRequested = true;
+    else
+        writeQueued(true);
+}
+
+void RedisClientImpl::cancelFlush()
+{
+    if( flushScheduled )
+    {
+        boost::system::error_code ignored_ec;
+
+        flushScheduled = false;
+        ++flushGeneration;
+        flushTimer.cancel(ignored_ec);
     }
 }
 
+void RedisClientImpl::flushTimeout(const boost::system::error_code &ec,
+        size_t generation)
+{
+    if( ec == boost::asio::error::operation_aborted || generation != flushGeneration )
+    {
+        return;
+    }
+
+    // no write has started since the flush was scheduled
+    flushScheduled = false;
+    writeQueued(true);
+}
+
 void RedisClientImpl::handleAsyncConnect(const boost::system::error_code &ec,
             std::function<void(boost::system::error_code)> handler)
 {
@@ -383,126 +655,316 @@ std::vector<char> RedisClientImpl::makeCommand(const std::deque<RedisBuffer> &it
 {
     std::vector<char> result;
 
-    bufferAppend(result, '*');
-    bufferAppend(result, std::to_string(items.size()));
-    bufferAppend<>(result, crlf);
+    detail::appendCommand(result, items);
+    return result;
+}
+
+RedisClientImpl::Deadline RedisClientImpl::makeDeadline(
+        const boost::posix_time::time_duration &timeout)
+{
+    if( timeout.is_pos_infinity() )
+        return Deadline::max();
+
+    return std::chrono::steady_clock::now() +
+        std::chrono::microseconds(timeout.total_microseconds());
+}
 
-    for(const auto &item: items)
+void RedisClientImpl::syncWriteBuffer(const Deadline &deadline,
+        boost::system::error_code &ec)
+{
+    if( writeSplices.empty() )
     {
-        bufferAppend(result, '$');
-        bufferAppend(result, std::to_string(item.size()));
-        bufferAppend<>(result, crlf);
-        bufferAppend(result, item);
-        bufferAppend<>(result, crlf);
+        socketWrite(socket.native_handle(), boost::asio::buffer(writeBuffer), deadline, ec);
     }
+    else
+    {
+        std::vector<boost::asio::const_buffer> buffers;
 
-    return result;
+        detail::gatherBuffers(writeBuffer, writeSplices, buffers);
+        socketWrite(socket.native_handle(), buffers, deadline, ec);
+    }
+
+    resetWriteBuffer();
+}
+
+void RedisClientImpl::resetWriteBuffer()
+{
+    // keep the buffer for the next command unless a huge one was sent
+    static const size_t maxCapacity = 1024 * 1024;
+
+    if( writeBuffer.capacity() > maxCapacity )
+        std::vector<char>().swap(writeBuffer);
+    else
+        writeBuffer.clear();
+
+    writeSplices.clear();
+}
+
+RedisValue RedisClientImpl::doSyncCommand(const RedisArguments &command,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec)
+{
+    detail::appendCommand(writeBuffer, writeSplices, command);
+    return doSyncEncodedCommand(timeout, ec);
 }
-RedisValue RedisClientImpl::doSyncCommand(const std::deque<RedisBuffer> &command,
+
+RedisValue RedisClientImpl::doSyncCommand(const boost::string_ref *items, size_t size,
         const boost::posix_time::time_duration &timeout,
         boost::system::error_code &ec)
 {
-    std::vector<char> data = makeCommand(command);
-    socketWrite(socket.native_handle(), boost::asio::buffer(data), timeout, ec);
+    detail::appendCommand(writeBuffer, writeSplices, boost::make_iterator_range(items, items + size));
+    return doSyncEncodedCommand(timeout, ec);
+}
+
+RedisValue RedisClientImpl::doSyncEncodedCommand(
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec)
+{
+    Deadline deadline = makeDeadline(timeout);
+    RedisValue result;
+
+    syncWriteBuffer(deadline, ec);
+
+    if( !ec )
+    {
+        result = syncReadResponse(deadline, ec);
+    }
 
     if( ec )
     {
-        return RedisValue();
+        // the reply may still come, the next command would read it
+        close();
     }
 
-    return syncReadResponse(timeout, ec);
+    return result;
 }
 
-RedisValue RedisClientImpl::doSyncCommand(const std::deque<std::deque<RedisBuffer>> &commands,
+RedisValue RedisClientImpl::doSyncCommand(const std::vector<RedisArguments> &commands,
         const boost::posix_time::time_duration &timeout,
         boost::system::error_code &ec)
 {
-    std::vector<std::vector<char>> data;
-    std::vector<boost::asio::const_buffer> buffers;
-
-    data.reserve(commands.size());
-    buffers.reserve(commands.size());
+    size_t size = 0;
 
     for(const auto &command: commands)
     {
-        data.push_back(makeCommand(command));
-        buffers.push_back(boost::asio::buffer(data.back()));
+        size += detail::commandSize(command, detail::spliceThreshold);
     }
 
-    socketWrite(socket.native_handle(), buffers, timeout, ec);
+    writeBuffer.reserve(size);
 
-    if( ec )
+    for(const auto &command: commands)
     {
-        return RedisValue();
+        detail::appendCommand(writeBuffer, writeSplices, command);
     }
 
+    // the timeout is for the whole pipeline
+    Deadline deadline = makeDeadline(timeout);
+    int fd = socket.native_handle();
+    std::vector<boost::asio::const_buffer> buffers;
     std::vector<RedisValue> responses;
+    RedisValue value;
+
+    if( writeSplices.empty() )
+        buffers.push_back(boost::asio::buffer(writeBuffer));
+    else
+        detail::gatherBuffers(writeBuffer, writeSplices, buffers);
 
-    for(size_t i = 0; i < commands.size(); ++i)
+    responses.reserve(commands.size());
+
+    // Replies are read while the pipeline is written. Otherwise, when the
+    // pipeline is bigger than socket buffers, the server blocks writing
+    // replies and stops reading commands, while we block writing them.
+    GatherWriter writer(buffers);
+
+    while( !writer.done() )
     {
-        responses.push_back(syncReadResponse(timeout, ec));
+        bool wrote = writer.writeSome(fd, ec);
 
-        if (ec)
-        {
-            return RedisValue();
-        }
+        if( ec )
+            break;
+
+        while( syncParseResponse(value) )
+            responses.push_back(std::move(value));
+
+        bool read = syncRead(false, deadline, ec);
+
+        if( ec )
+            break;
+
+        if( !wrote && !read && !socketWait(fd, POLLIN | POLLOUT, deadline, ec) )
+            break;
+    }
+
+    resetWriteBuffer();
+
+    while( !ec && responses.size() < commands.size() )
+    {
+        responses.push_back(syncReadResponse(deadline, ec));
+    }
+
+    if( ec )
+    {
+        // the replies may still come, the next command would read them
+        close();
+        return RedisValue();
     }
 
     return RedisValue(std::move(responses));
 }
 
 RedisValue RedisClientImpl::syncReadResponse(
-        const boost::posix_time::time_duration &timeout,
+        const Deadline &deadline,
         boost::system::error_code &ec)
 {
-    for(;;)
+    RedisValue value;
+
+    while( !syncParseResponse(value) )
     {
-        if (bufSize == 0)
-        {
-            bufSize = socketReadSome(socket.native_handle(),
-                    boost::asio::buffer(buf), timeout, ec);
+        if( !syncRead(true, deadline, ec) )
+            return RedisValue();
+    }
 
-            if (ec)
-                return RedisValue();
-        }
+    return value;
+}
 
-        for(size_t pos = 0; pos < bufSize;)
-        {
-            std::pair<size_t, RedisParser::ParseResult> result =
-                redisParser.parse(buf.data() + pos, bufSize - pos);
+bool RedisClientImpl::syncParseResponse(RedisValue &value)
+{
+    if( bufPos == bufSize )
+        return false;
 
-            pos += result.first;
+    // Parsed bytes are skipped, never moved. The parser keeps its state
+    // between chunks, so the buffer is read again only when all of it
+    // is consumed.
+    std::pair<size_t, RedisParser::ParseResult> result =
+        redisParser.parse(buf.data() + bufPos, bufSize - bufPos);
 
-            ::memmove(buf.data(), buf.data() + pos, bufSize - pos);
-            bufSize -= pos;
+    bufPos += result.first;
 
-            if( result.second == RedisParser::Completed )
-            {
-                return redisParser.result();
-            }
-            else if( result.second == RedisParser::Incompleted )
-            {
-                continue;
-            }
-            else
-            {
-                errorHandler("[RedisClient] Parser error");
-                return RedisValue();
-            }
-        }
+    if( result.second == RedisParser::Completed )
+    {
+        value = redisParser.result();
+        return true;
     }
+    else if( result.second == RedisParser::Error )
+    {
+        bufPos = bufSize = 0;
+        errorHandler("[RedisClient] Parser error");
+        value = RedisValue();
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool RedisClientImpl::syncRead(bool wait, const Deadline &deadline,
+        boost::system::error_code &ec)
+{
+    assert( bufPos == bufSize );
+
+    bufPos = bufSize = 0;
+    prepareReadBuffer();
+
+    if( wait )
+        bufSize = socketReadSome(socket.native_handle(), boost::asio::buffer(buf), deadline, ec);
+    else
+        bufSize = socketTryReadSome(socket.native_handle(), boost::asio::buffer(buf), ec);
+
+    if( bufSize > 0 )
+        lastReadSize = bufSize;
+
+    return bufSize > 0;
 }
 
-void RedisClientImpl::doAsyncCommand(std::vector<char> buff,
-                                     std::function<void(RedisValue)> handler)
+void RedisClientImpl::submit(RedisArguments &command, ReplyHandler handler)
 {
-    handlers.push( std::move(handler) );
-    dataQueued.push_back(std::move(buff));
+    // nodes drained by any client come back to the threads submitting
+    static thread_local detail::NodeCache<Submission> cache;
 
-    if( dataWrited.empty() )
+    Submission *submission = cache.pop(freeSubmissions);
+
+    if( submission )
     {
-        // start transmit process
-        asyncWrite(boost::system::error_code(), 0);
+        submission->args = std::move(command);
+        submission->handler = std::move(handler);
+    }
+    else
+    {
+        submission = new Submission{nullptr, std::move(command), std::move(handler)};
+    }
+
+    outstanding.fetch_add(1, std::memory_order_relaxed);
+
+    if( submissions.push(submission) )
+    {
+        post(detail::makeAllocatingHandler(drainMemory,
+                    std::bind(&RedisClientImpl::drainSubmissions, shared_from_this())));
+    }
+}
+
+void RedisClientImpl::submit(RedisArguments &command,
+                             std::function<void(RedisValue)> handler)
+{
+    submit(command, ReplyHandler{std::move(handler), nullptr, nullptr});
+}
+
+void RedisClientImpl::drainSubmissions()
+{
+    Submission *first = submissions.takeAll();
+    Submission *last = nullptr;
+
+    for(Submission *submission = first; submission; submission = submission->next)
+    {
+        queueCommand(submission->args, std::move(submission->handler));
+        submission->args.clear();
+        last = submission;
+    }
+
+    // the nodes are reused by the next submissions
+    if( first )
+        freeSubmissions.pushAll(first, last);
+
+    // the whole batch is sent by one write
+    writeQueued(false);
+}
+
+void RedisClientImpl::queueCommand(RedisArguments &command, ReplyHandler handler)
+{
+    handlers.push(std::move(handler));
+    ++queuedCommands;
+
+    if( outputQueued.data.size() < maxWriteBufferSize && dataQueued.empty() )
+    {
+        const RedisArguments *args = &command;
+
+        for(const RedisBuffer &item: command)
+        {
+            if( item.size() >= detail::spliceThreshold )
+            {
+                // big arguments are written from here
+                outputQueued.args.push_back(std::move(command));
+                args = &outputQueued.args.back();
+                break;
+            }
+        }
+
+        size_t size = outputQueued.data.size();
+
+        detail::appendCommand(outputQueued.data, outputQueued.splices, *args);
+        queuedBytes += outputQueued.data.size() - size;
+    }
+    else
+    {
+        dataQueued.emplace_back();
+
+        // The queued command is never moved until it is written,
+        // so big arguments are written from the moved arguments.
+        QueuedCommand &queued = dataQueued.back();
+
+        queued.args = std::move(command);
+        detail::appendCommand(queued.data, queued.splices, queued.args);
+        queuedBytes += queued.data.size();
     }
 }
 
@@ -517,16 +979,25 @@ void RedisClientImpl::asyncRead(const boost::system::error_code &ec, const size_
         return;
     }
 
+    lastReadSize = size;
+
     for(size_t pos = 0; pos < size;)
     {
+        if( !replyInProgress )
+        {
+            prepareNextReply();
+        }
+
         std::pair<size_t, RedisParser::ParseResult> result = redisParser.parse(buf.data() + pos, size - pos);
 
         if( result.second == RedisParser::Completed )
         {
+            replyInProgress = false;
             doProcessMessage(redisParser.result());
         }
         else if( result.second == RedisParser::Incompleted )
         {
+            replyInProgress = true;
             processMessage();
             return;
         }
@@ -542,6 +1013,20 @@ void RedisClientImpl::asyncRead(const boost::system::error_code &ec, const size_
     processMessage();
 }
 
+void RedisClientImpl::prepareNextReply()
+{
+    // The next reply belongs to the first handler in the queue
+    if( state != State::Subscribed && handlers.empty() == false )
+    {
+        const ReplyHandler &next = handlers.front();
+
+        if( next.elementHandler )
+            redisParser.streamNextReply(next.elementHandler);
+        if( next.bulkSink )
+            redisParser.sinkNextReply(next.bulkSink);
+    }
+}
+
 void RedisClientImpl::onRedisError(const RedisValue &v)
 {
     errorHandler(v.toString());
@@ -563,9 +1048,9 @@ size_t RedisClientImpl::subscribe(
 
     if (state == State::Connected || state == State::Subscribed)
     {
-        std::deque<RedisBuffer> items{ command, channel };
+        RedisArguments items{ command, channel };
 
-        post(std::bind(&RedisClientImpl::doAsyncCommand, this, makeCommand(items), std::move(handler)));
+        submit(items, std::move(handler));
         msgHandlers.insert(std::make_pair(channel, std::make_pair(subscribeSeq, std::move(msgHandler))));
         state = State::Subscribed;
 
@@ -595,9 +1080,9 @@ void RedisClientImpl::singleShotSubscribe(
     if (state == State::Connected ||
         state == State::Subscribed)
     {
-        std::deque<RedisBuffer> items{ command, channel };
+        RedisArguments items{ command, channel };
 
-        post(std::bind(&RedisClientImpl::doAsyncCommand, this, makeCommand(items), std::move(handler)));
+        submit(items, std::move(handler));
         singleShotMsgHandlers.insert(std::make_pair(channel, std::move(msgHandler)));
         state = State::Subscribed;
     }
@@ -644,11 +1129,10 @@ void RedisClientImpl::unsubscribe(const std::string &command,
             }
         }
 
-        std::deque<RedisBuffer> items{ command, channel };
+        RedisArguments items{ command, channel };
 
         // Unsubscribe command for Redis
-        post(std::bind(&RedisClientImpl::doAsyncCommand, this,
-             makeCommand(items), handler));
+        submit(items, handler);
     }
     else
     {
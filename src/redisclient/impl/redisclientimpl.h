@@ -6,23 +6,28 @@
 #ifndef REDISCLIENT_REDISCLIENTIMPL_H
 #define REDISCLIENT_REDISCLIENTIMPL_H
 
-#include <boost/array.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/local/stream_protocol.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/deadline_timer.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <vector>
-#include <queue>
 #include <map>
 #include <functional>
 #include <memory>
 
 #include "redisclient/redisparser.h"
 #include "redisclient/redisbuffer.h"
+#include "redisclient/impl/rediscommand.h"
+#include "redisclient/impl/completionslots.h"
+#include "redisclient/impl/handlermemory.h"
+#include "redisclient/impl/submissionqueue.h"
 #include "redisclient/config.h"
 
 namespace redisclient {
@@ -37,6 +42,16 @@ public:
         Closed
     };
 
+    struct ReplyHandler {
+        detail::ReplyCallback handler;
+        // Optional, called for every element of an array reply
+        // (see RedisParser::streamNextReply).
+        std::function<void(RedisValue)> elementHandler;
+        // Optional, receives the payload of a bulk string reply
+        // (see RedisParser::sinkNextReply).
+        std::function<void(const char *, size_t)> bulkSink;
+    };
+
     REDIS_CLIENT_DECL RedisClientImpl(boost::asio::io_service &ioService);
     REDIS_CLIENT_DECL ~RedisClientImpl();
 
@@ -64,23 +79,76 @@ public:
 
     REDIS_CLIENT_DECL static std::vector<char> makeCommand(const std::deque<RedisBuffer> &items);
 
-    REDIS_CLIENT_DECL RedisValue doSyncCommand(const std::deque<RedisBuffer> &command,
+    REDIS_CLIENT_DECL RedisValue doSyncCommand(const RedisArguments &command,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec);
+    REDIS_CLIENT_DECL RedisValue doSyncCommand(const boost::string_ref *items, size_t size,
+        const boost::posix_time::time_duration &timeout,
+        boost::system::error_code &ec);
+    // Send the command encoded to writeBuffer.
+    REDIS_CLIENT_DECL RedisValue doSyncEncodedCommand(
         const boost::posix_time::time_duration &timeout,
         boost::system::error_code &ec);
-    REDIS_CLIENT_DECL RedisValue doSyncCommand(const std::deque<std::deque<RedisBuffer>> &commands,
+    REDIS_CLIENT_DECL RedisValue doSyncCommand(const std::vector<RedisArguments> &commands,
         const boost::posix_time::time_duration &timeout,
         boost::system::error_code &ec);
+
+    // Time limit of a sync command or pipeline as a whole, on a monotonic
+    // clock. All writes and reads of the command share it.
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    REDIS_CLIENT_DECL static Deadline makeDeadline(
+            const boost::posix_time::time_duration &timeout);
+    REDIS_CLIENT_DECL void syncWriteBuffer(
+            const Deadline &deadline,
+            boost::system::error_code &ec);
+    REDIS_CLIENT_DECL void resetWriteBuffer();
     REDIS_CLIENT_DECL RedisValue syncReadResponse(
-            const boost::posix_time::time_duration &timeout,
+            const Deadline &deadline,
+            boost::system::error_code &ec);
+    // Parse the next reply from buf, false if more data is needed.
+    REDIS_CLIENT_DECL bool syncParseResponse(RedisValue &value);
+    // Read to the empty buf, waiting until the deadline if wait is true.
+    // Returns false if nothing was read.
+    REDIS_CLIENT_DECL bool syncRead(bool wait, const Deadline &deadline,
             boost::system::error_code &ec);
 
-    REDIS_CLIENT_DECL void doAsyncCommand(
-            std::vector<char> buff,
+    // Queue the command from any thread, the command is moved from. The
+    // strand is posted to only when the queue was empty, the queued
+    // commands are sent by drainSubmissions in one batch.
+    REDIS_CLIENT_DECL void submit(RedisArguments &command, ReplyHandler handler);
+    REDIS_CLIENT_DECL void submit(RedisArguments &command,
             std::function<void(RedisValue)> handler);
+    REDIS_CLIENT_DECL void drainSubmissions();
+
+    // Serialize the command to the output buffer, it is written by
+    // writeQueued. The command is moved from.
+    REDIS_CLIENT_DECL void queueCommand(
+            RedisArguments &command,
+            ReplyHandler handler);
+
+    REDIS_CLIENT_DECL void setMaxReadBufferSize(size_t size);
+    REDIS_CLIENT_DECL void prepareReadBuffer();
+    REDIS_CLIENT_DECL void setMaxWriteBufferSize(size_t size);
+
+    // Corking, see RedisAsyncClient::cork.
+    REDIS_CLIENT_DECL void cork(size_t maxCommands, size_t maxBytes,
+            const boost::posix_time::time_duration &maxDelay);
+    REDIS_CLIENT_DECL void uncork();
+    REDIS_CLIENT_DECL void flush();
+    // Drop the scheduled flush, if any.
+    REDIS_CLIENT_DECL void cancelFlush();
+    REDIS_CLIENT_DECL void flushTimeout(const boost::system::error_code &ec,
+            size_t generation);
+    // Start writing the queued commands if no write is in progress and
+    // corking allows it (or force is true).
+    REDIS_CLIENT_DECL void writeQueued(bool force);
+    REDIS_CLIENT_DECL void startWrite();
 
     REDIS_CLIENT_DECL void sendNextCommand();
     REDIS_CLIENT_DECL void processMessage();
     REDIS_CLIENT_DECL void doProcessMessage(RedisValue v);
+    REDIS_CLIENT_DECL void prepareNextReply();
     REDIS_CLIENT_DECL void asyncWrite(const boost::system::error_code &ec, const size_t);
     REDIS_CLIENT_DECL void asyncRead(const boost::system::error_code &ec, const size_t);
 
@@ -88,15 +156,22 @@ public:
     REDIS_CLIENT_DECL static void defaulErrorHandler(const std::string &s);
 
     template<typename Handler>
-    inline void post(const Handler &handler);
+    inline void post(Handler &&handler);
 
     boost::asio::io_service &ioService;
     boost::asio::io_service::strand strand;
     boost::asio::generic::stream_protocol::socket socket;
     RedisParser redisParser;
-    boost::array<char, 4096> buf;
+    std::vector<char> buf; // read buffer, see prepareReadBuffer
+    size_t bufPos; // only for sync, start of the unparsed data in buf
     size_t bufSize; // only for sync
+    size_t lastReadSize;
+    size_t smallReads; // consecutive reads which used a small part of buf
+    size_t maxReadBufferSize;
+    std::vector<char> writeBuffer; // only for sync, reused by every command
+    std::vector<detail::Splice> writeSplices; // only for sync
     size_t subscribeSeq;
+    bool replyInProgress; // only for async
 
     typedef std::pair<size_t, std::function<void(const std::vector<char> &buf)> > MsgHandlerType;
     typedef std::function<void(const std::vector<char> &buf)> SingleShotHandlerType;
@@ -104,20 +179,92 @@ public:
     typedef std::multimap<std::string, MsgHandlerType> MsgHandlersMap;
     typedef std::multimap<std::string, SingleShotHandlerType> SingleShotHandlersMap;
 
-    std::queue<std::function<void(RedisValue)> > handlers;
-    std::deque<std::vector<char>> dataWrited;
-    std::deque<std::vector<char>> dataQueued;
+    // Commands serialized to one contiguous buffer. Big arguments are
+    // written from their own memory (see detail::Splice), commands with
+    // big arguments are kept in args until written.
+    struct OutputBuffer {
+        std::vector<char> data;
+        std::vector<detail::Splice> splices;
+        std::deque<RedisArguments> args;
+
+        // Unlike std::swap, never allocates.
+        void swap(OutputBuffer &other)
+        {
+            data.swap(other.data);
+            splices.swap(other.splices);
+            args.swap(other.args);
+        }
+    };
+
+    // A command with its own buffer, used when the output buffer is full
+    // (see maxWriteBufferSize).
+    struct QueuedCommand {
+        std::vector<char> data;
+        // Arguments of the command, big ones are written from here
+        // (see detail::Splice).
+        RedisArguments args;
+        std::vector<detail::Splice> splices;
+    };
+
+    struct Submission {
+        Submission *next;
+        RedisArguments args;
+        ReplyHandler handler;
+    };
+
+    detail::SubmissionQueue<Submission> submissions;
+    // Drained submissions, taken back by submit (see detail::NodeCache).
+    detail::SubmissionQueue<Submission> freeSubmissions;
+    // Operations of the drain, the write and the read in progress, so that
+    // a round trip does not allocate them (see detail::HandlerMemory).
+    detail::HandlerMemory drainMemory;
+    detail::HandlerMemory writeMemory;
+    detail::HandlerMemory readMemory;
+    // Handlers of the commands sent, in order. The slots are reused by
+    // the next commands, see detail::CompletionRing.
+    detail::CompletionRing<ReplyHandler> handlers;
+    // Commands are written by a single write of outputWrited, while new
+    // ones are added to outputQueued. Those added when outputQueued is over
+    // maxWriteBufferSize are queued one by one to dataQueued and written
+    // after it by a gather write.
+    OutputBuffer outputWrited;
+    OutputBuffer outputQueued;
+    std::deque<QueuedCommand> dataWrited;
+    std::deque<QueuedCommand> dataQueued;
+    size_t maxWriteBufferSize;
+    bool writeInProgress;
+
+    // Corking state (see cork), counters are of the commands queued since
+    // the last write started.
+    bool corked;
+    size_t corkCommands;
+    size_t corkBytes;
+    boost::posix_time::time_duration corkDelay;
+    size_t queuedCommands;
+    size_t queuedBytes;
+    bool flushScheduled;
+    bool flushRequested;
+    boost::asio::deadline_timer flushTimer;
+    // Changed when the scheduled flush is not needed anymore (a write has
+    // started or the connection is closed), so that a flush scheduled
+    // before, which may be already on its way, is ignored.
+    size_t flushGeneration;
+
+    // Commands submitted and not replied yet, read from any thread.
+    std::atomic<size_t> outstanding;
     MsgHandlersMap msgHandlers;
     SingleShotHandlersMap singleShotMsgHandlers;
 
     std::function<void(const std::string &)> errorHandler;
-    State state;
+    // Changed in the thread of the io_service, read from any thread (see
+    // RedisAsyncClient::isConnected).
+    std::atomic<State> state;
 };
 
 template<typename Handler>
-inline void RedisClientImpl::post(const Handler &handler)
+inline void RedisClientImpl::post(Handler &&handler)
 {
-    strand.post(handler);
+    strand.post(std::forward<Handler>(handler));
 }
 
 inline std::string to_string(RedisClientImpl::State state)
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLIENTPOOL_CPP
+#define REDISCLIENT_REDISCLIENTPOOL_CPP
+
+#include <algorithm>
+
+#include "redisclient/redisclientpool.h"
+
+namespace redisclient {
+
+RedisClientPool::RedisClientPool(boost::asio::io_service &ioService, size_t size)
+    : next(0)
+{
+    size = std::max<size_t>(size, 1);
+    clients.reserve(size);
+
+    for(size_t i = 0; i < size; ++i)
+        clients.emplace_back(new RedisAsyncClient(ioService));
+}
+
+RedisClientPool::~RedisClientPool()
+{
+}
+
+void RedisClientPool::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                              std::function<void(boost::system::error_code)> handler)
+{
+    struct Progress {
+        size_t remaining;
+        std::function<void(boost::system::error_code)> handler;
+    };
+
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+
+    progress->remaining = clients.size();
+    progress->handler = std::move(handler);
+
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+    {
+        client->connect(endpoint, [progress](boost::system::error_code ec) {
+            if( !progress->handler )
+            {
+                // already failed
+                return;
+            }
+            else if( ec || --progress->remaining == 0 )
+            {
+                std::function<void(boost::system::error_code)> handler;
+
+                handler.swap(progress->handler);
+                handler(ec);
+            }
+        });
+    }
+}
+
+bool RedisClientPool::isConnected() const
+{
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+    {
+        if( !client->isConnected() )
+            return false;
+    }
+
+    return true;
+}
+
+void RedisClientPool::disconnect()
+{
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+        client->disconnect();
+}
+
+void RedisClientPool::installErrorHandler(std::function<void(const std::string &)> handler)
+{
+    for(const std::unique_ptr<RedisAsyncClient> &client: clients)
+        client->installErrorHandler(handler);
+}
+
+size_t RedisClientPool::size() const
+{
+    return clients.size();
+}
+
+RedisAsyncClient &RedisClientPool::connection(size_t index)
+{
+    return *clients.at(index);
+}
+
+size_t RedisClientPool::queueDepth(size_t index) const
+{
+    return clients.at(index)->queueDepth();
+}
+
+RedisAsyncClient &RedisClientPool::leastLoaded()
+{
+    const size_t size = clients.size();
+    const size_t start = next.fetch_add(1, std::memory_order_relaxed) % size;
+
+    RedisAsyncClient *best = nullptr;
+    size_t bestDepth = 0;
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        RedisAsyncClient *client = clients[(start + i) % size].get();
+
+        // a subscribed connection takes no commands
+        if( client->state() != RedisAsyncClient::State::Connected )
+            continue;
+
+        size_t depth = client->queueDepth();
+
+        if( best == nullptr || depth < bestDepth )
+        {
+            best = client;
+            bestDepth = depth;
+
+            if( depth == 0 )
+                break;
+        }
+    }
+
+    // nothing is connected, the command fails on the connection
+    return best ? *best : *clients[start];
+}
+
+void RedisClientPool::command(const std::string &cmd, RedisArguments args,
+                              std::function<void(RedisValue)> handler)
+{
+    leastLoaded().command(cmd, std::move(args), std::move(handler));
+}
+
+}
+
+#endif // REDISCLIENT_REDISCLIENTPOOL_CPP
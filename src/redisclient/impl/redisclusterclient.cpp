@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLUSTERCLIENT_CPP
+#define REDISCLIENT_REDISCLUSTERCLIENT_CPP
+
+#include "redisclient/redisclusterclient.h"
+#include "redisclient/clusterpipeline.h"
+
+namespace redisclient {
+
+RedisClusterClient::RedisClusterClient(boost::asio::io_service &ioService)
+    : pimpl(std::make_shared<RedisClusterImpl>(ioService))
+{
+}
+
+RedisClusterClient::~RedisClusterClient()
+{
+    pimpl->disconnect();
+}
+
+void RedisClusterClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                                 std::function<void(boost::system::error_code)> handler)
+{
+    pimpl->connect(endpoint, std::move(handler));
+}
+
+bool RedisClusterClient::isConnected() const
+{
+    return pimpl->slotsLoaded;
+}
+
+void RedisClusterClient::disconnect()
+{
+    pimpl->disconnect();
+}
+
+void RedisClusterClient::installErrorHandler(std::function<void(const std::string &)> handler)
+{
+    // called by the connections to the nodes, see RedisClusterImpl::handleError
+    pimpl->errorHandler = std::move(handler);
+}
+
+void RedisClusterClient::refreshSlots(std::function<void(boost::system::error_code)> handler)
+{
+    pimpl->refreshSlots(std::move(handler));
+}
+
+size_t RedisClusterClient::keySlot(const boost::string_ref &key)
+{
+    return detail::hashSlot(key);
+}
+
+boost::asio::ip::tcp::endpoint RedisClusterClient::slotNode(size_t slot) const
+{
+    RedisClusterImpl::Node *node = pimpl->slots.at(slot);
+
+    return node ? node->endpoint : boost::asio::ip::tcp::endpoint();
+}
+
+size_t RedisClusterClient::nodes() const
+{
+    return pimpl->nodes.size();
+}
+
+void RedisClusterClient::command(const std::string &cmd, RedisArguments args,
+                                 std::function<void(RedisValue)> handler)
+{
+    RedisClusterImpl::Node *node = pimpl->route(args, 0);
+
+    if( node == nullptr )
+    {
+        pimpl->errorHandler("RedisClusterClient::command called before connect");
+        return;
+    }
+
+    std::shared_ptr<RedisClusterImpl::Request> request =
+        std::make_shared<RedisClusterImpl::Request>();
+
+    detail::copyRefs(args);
+
+    request->cmd = cmd;
+    request->args = std::move(args);
+    request->handler = std::move(handler);
+    request->redirects = 0;
+
+    pimpl->send(node, std::move(request), false);
+}
+
+void RedisClusterClient::pipelinedArguments(std::vector<RedisArguments> commands,
+                                            std::function<void(RedisValue)> handler)
+{
+    pimpl->pipelined(std::move(commands), std::move(handler));
+}
+
+ClusterPipeline RedisClusterClient::pipelined()
+{
+    return ClusterPipeline(*this);
+}
+
+}
+
+#endif // REDISCLIENT_REDISCLUSTERCLIENT_CPP
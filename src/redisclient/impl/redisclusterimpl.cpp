@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLUSTERIMPL_CPP
+#define REDISCLIENT_REDISCLUSTERIMPL_CPP
+
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+#include "redisclusterimpl.h"
+
+namespace redisclient {
+
+namespace
+{
+    RedisValue errorValue(const std::string &message)
+    {
+        return RedisValue(std::vector<char>(message.begin(), message.end()),
+                RedisValue::ErrorTag());
+    }
+}
+
+RedisClusterImpl::Node::Node(boost::asio::io_service &ioService,
+                             const boost::asio::ip::tcp::endpoint &endpoint)
+    : endpoint(endpoint), client(ioService)
+{
+}
+
+RedisClusterImpl::RedisClusterImpl(boost::asio::io_service &ioService)
+    : ioService(ioService), slots(detail::hashSlots, nullptr),
+    errorHandler(&RedisClientImpl::defaulErrorHandler),
+    refreshing(false), slotsLoaded(false), maxRedirects(5)
+{
+}
+
+RedisClusterImpl::~RedisClusterImpl()
+{
+}
+
+void RedisClusterImpl::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                               std::function<void(boost::system::error_code)> handler)
+{
+    std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+    whenConnected(node(endpoint), [weak, handler](boost::system::error_code ec) {
+        std::shared_ptr<RedisClusterImpl> self = weak.lock();
+
+        if( !self )
+            return;
+        else if( ec )
+            handler(ec);
+        else
+            self->refreshSlots(handler);
+    });
+}
+
+void RedisClusterImpl::disconnect()
+{
+    for(auto &item: nodes)
+    {
+        item.second->client.disconnect();
+        item.second->sent.clear();
+    }
+}
+
+void RedisClusterImpl::refreshSlots(std::function<void(boost::system::error_code)> handler)
+{
+    if( handler )
+        refreshHandlers.push_back(std::move(handler));
+
+    if( refreshing )
+        return;
+
+    if( nodes.empty() )
+    {
+        std::vector<std::function<void(boost::system::error_code)>> handlers;
+
+        handlers.swap(refreshHandlers);
+
+        for(const std::function<void(boost::system::error_code)> &handler: handlers)
+            handler(boost::asio::error::not_connected);
+
+        return;
+    }
+
+    refreshing = true;
+
+    std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    Node *target = anyNode();
+
+    request->cmd = "CLUSTER";
+    request->args.emplace_back("SLOTS");
+    request->redirects = maxRedirects;
+    request->handler = [weak, target](RedisValue value) {
+        if( std::shared_ptr<RedisClusterImpl> self = weak.lock() )
+            self->handleSlots(target, value);
+    };
+
+    send(target, std::move(request), false);
+}
+
+void RedisClusterImpl::send(Node *node, std::shared_ptr<Request> request, bool asking)
+{
+    if( node->client.isConnected() == false )
+    {
+        std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+        whenConnected(node, [weak, node, request, asking](boost::system::error_code ec) {
+            std::shared_ptr<RedisClusterImpl> self = weak.lock();
+
+            if( !self )
+            {
+                return;
+            }
+            else if( ec )
+            {
+                std::stringstream ss;
+
+                ss << "ERR cluster node " << node->endpoint << ": " << ec.message();
+                request->handler(errorValue(ss.str()));
+            }
+            else
+            {
+                self->send(node, request, asking);
+            }
+        });
+
+        return;
+    }
+
+    std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+    // ASKING is valid for the next command of the connection only
+    if( asking )
+        node->client.command("ASKING", {});
+
+    node->sent.push_back(request);
+    node->client.command(request->cmd, request->args, [weak, node, request](RedisValue value) {
+        std::shared_ptr<RedisClusterImpl> self = weak.lock();
+
+        if( self && self->takeSent(node, request) )
+            self->handleReply(request, std::move(value));
+    });
+}
+
+void RedisClusterImpl::pipelined(std::vector<RedisArguments> commands,
+                                 std::function<void(RedisValue)> handler)
+{
+    struct Batch {
+        std::vector<RedisValue> replies;
+        size_t remaining;
+        std::function<void(RedisValue)> handler;
+    };
+
+    if( commands.empty() )
+    {
+        handler(RedisValue(std::vector<RedisValue>()));
+        return;
+    }
+
+    std::vector<std::pair<Node *, size_t>> order;
+
+    order.reserve(commands.size());
+
+    for(size_t i = 0; i < commands.size(); ++i)
+    {
+        Node *node = route(commands[i], 1);
+
+        // the pipeline is replied anyway, not left waiting
+        if( node == nullptr )
+        {
+            handler(errorValue("ERR RedisClusterClient::pipelined called before connect"));
+            return;
+        }
+
+        order.emplace_back(node, i);
+    }
+
+    // one sub-pipeline per node, the commands of a node keep their order
+    std::stable_sort(order.begin(), order.end(),
+            [](const std::pair<Node *, size_t> &a, const std::pair<Node *, size_t> &b) {
+        return std::less<Node *>()(a.first, b.first);
+    });
+
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+
+    batch->replies.resize(commands.size());
+    batch->remaining = commands.size();
+    batch->handler = std::move(handler);
+
+    for(const std::pair<Node *, size_t> &item: order)
+    {
+        RedisArguments &items = commands[item.second];
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        size_t index = item.second;
+
+        request->cmd = detail::argumentRef(items.front()).to_string();
+        request->args.reserve(items.size() - 1);
+
+        for(size_t i = 1; i < items.size(); ++i)
+            request->args.push_back(std::move(items[i]));
+
+        request->redirects = 0;
+        request->handler = [batch, index](RedisValue value) {
+            batch->replies[index] = std::move(value);
+
+            if( --batch->remaining == 0 )
+                batch->handler(RedisValue(std::move(batch->replies)));
+        };
+
+        detail::copyRefs(request->args);
+        send(item.first, std::move(request), false);
+    }
+}
+
+RedisClusterImpl::Node *RedisClusterImpl::route(const RedisArguments &args, size_t key)
+{
+    Node *node = nullptr;
+
+    if( args.size() > key )
+        node = slots[detail::hashSlot(detail::argumentRef(args[key]))];
+
+    // a slot without a node replies with MOVED
+    if( node == nullptr && nodes.empty() == false )
+        node = anyNode();
+
+    return node;
+}
+
+RedisClusterImpl::Node *RedisClusterImpl::node(const boost::asio::ip::tcp::endpoint &endpoint)
+{
+    std::unique_ptr<Node> &node = nodes[endpoint];
+
+    if( !node )
+    {
+        std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+        Node *target = new Node(ioService, endpoint);
+
+        node.reset(target);
+        node->client.installErrorHandler([weak, target](const std::string &error) {
+            if( std::shared_ptr<RedisClusterImpl> self = weak.lock() )
+                self->handleError(target, error);
+        });
+    }
+
+    return node.get();
+}
+
+RedisClusterImpl::Node *RedisClusterImpl::anyNode()
+{
+    for(auto &item: nodes)
+    {
+        if( item.second->client.isConnected() )
+            return item.second.get();
+    }
+
+    return nodes.begin()->second.get();
+}
+
+void RedisClusterImpl::whenConnected(Node *node,
+                                     std::function<void(boost::system::error_code)> handler)
+{
+    if( node->client.isConnected() )
+    {
+        handler(boost::system::error_code());
+        return;
+    }
+
+    node->waiting.push_back(std::move(handler));
+
+    if( node->client.state() != RedisAsyncClient::State::Connecting )
+    {
+        std::weak_ptr<RedisClusterImpl> weak = shared_from_this();
+
+        node->client.connect(node->endpoint, [weak, node](boost::system::error_code ec) {
+            if( std::shared_ptr<RedisClusterImpl> self = weak.lock() )
+                self->handleConnect(node, ec);
+        });
+    }
+}
+
+void RedisClusterImpl::handleConnect(Node *node, const boost::system::error_code &ec)
+{
+    std::vector<std::function<void(boost::system::error_code)>> waiting;
+
+    waiting.swap(node->waiting);
+
+    for(const std::function<void(boost::system::error_code)> &handler: waiting)
+        handler(ec);
+}
+
+bool RedisClusterImpl::takeSent(Node *node, const std::shared_ptr<Request> &request)
+{
+    // replies come in order, the request is the first one
+    std::deque<std::shared_ptr<Request>>::iterator it =
+        std::find(node->sent.begin(), node->sent.end(), request);
+
+    if( it == node->sent.end() )
+        return false;
+
+    node->sent.erase(it);
+    return true;
+}
+
+void RedisClusterImpl::handleReply(std::shared_ptr<Request> request, RedisValue value)
+{
+    bool ask = false;
+    size_t slot = 0;
+    boost::asio::ip::tcp::endpoint endpoint;
+
+    if( value.isError() && request->redirects < maxRedirects &&
+            parseRedirection(value.toString(), ask, slot, endpoint) )
+    {
+        Node *target = this->node(endpoint);
+
+        ++request->redirects;
+
+        if( !ask )
+        {
+            // the slot has moved for good, the other slots may have too
+            slots[slot] = target;
+            refreshSlots(nullptr);
+        }
+
+        send(target, std::move(request), ask);
+        return;
+    }
+
+    request->handler(std::move(value));
+}
+
+void RedisClusterImpl::handleError(Node *node, const std::string &error)
+{
+    std::deque<std::shared_ptr<Request>> failed;
+
+    // the replies of the requests sent are lost with the connection
+    failed.swap(node->sent);
+    node->client.disconnect();
+
+    if( failed.empty() == false )
+    {
+        std::stringstream ss;
+
+        ss << "ERR cluster node " << node->endpoint << ": " << error;
+
+        RedisValue value = errorValue(ss.str());
+
+        // the CLUSTER SLOTS request in progress too, so the next refresh
+        // is not held back by it
+        for(const std::shared_ptr<Request> &request: failed)
+            request->handler(value);
+    }
+
+    errorHandler(error);
+}
+
+void RedisClusterImpl::handleSlots(Node *node, const RedisValue &value)
+{
+    std::vector<Node *> map(detail::hashSlots, nullptr);
+    bool valid = value.isArray();
+
+    if( valid )
+    {
+        // [[start, end, [host, port, id], replicas...], ...]
+        for(const RedisValue &range: value.getArray())
+        {
+            if( range.isArray() == false || range.getArray().size() < 3 ||
+                    range.getArray()[2].isArray() == false ||
+                    range.getArray()[2].getArray().size() < 2 )
+            {
+                valid = false;
+                break;
+            }
+
+            const std::vector<RedisValue> &items = range.getArray();
+            const std::vector<RedisValue> &master = items[2].getArray();
+            int64_t start = items[0].toInt();
+            int64_t end = items[1].toInt();
+            std::string host = master[0].toString();
+            boost::system::error_code ec;
+            boost::asio::ip::tcp::endpoint endpoint(node->endpoint.address(),
+                    static_cast<unsigned short>(master[1].toInt()));
+
+            // an empty host is the address of the node replying
+            if( host.empty() == false )
+                endpoint.address(boost::asio::ip::address::from_string(host, ec));
+
+            if( ec || start < 0 || start > end || end >= static_cast<int64_t>(detail::hashSlots) )
+            {
+                valid = false;
+                break;
+            }
+
+            Node *owner = this->node(endpoint);
+
+            for(int64_t slot = start; slot <= end; ++slot)
+                map[slot] = owner;
+        }
+    }
+
+    std::vector<std::function<void(boost::system::error_code)>> handlers;
+
+    handlers.swap(refreshHandlers);
+    refreshing = false;
+
+    boost::system::error_code ec;
+
+    if( valid )
+    {
+        slots.swap(map);
+        slotsLoaded = true;
+    }
+    else
+    {
+        ec = boost::system::errc::make_error_code(boost::system::errc::protocol_error);
+    }
+
+    for(const std::function<void(boost::system::error_code)> &handler: handlers)
+        handler(ec);
+}
+
+bool RedisClusterImpl::parseRedirection(const std::string &error, bool &ask, size_t &slot,
+                                        boost::asio::ip::tcp::endpoint &endpoint)
+{
+    std::istringstream ss(error);
+    std::string kind, address;
+    size_t colon;
+    unsigned short port;
+    boost::system::error_code ec;
+
+    if( !(ss >> kind >> slot >> address) || slot >= detail::hashSlots )
+        return false;
+    else if( kind != "MOVED" && kind != "ASK" )
+        return false;
+    else if( (colon = address.rfind(':')) == std::string::npos )
+        return false;
+    else if( !(std::istringstream(address.substr(colon + 1)) >> port) )
+        return false;
+
+    endpoint.address(boost::asio::ip::address::from_string(address.substr(0, colon), ec));
+    endpoint.port(port);
+    ask = kind == "ASK";
+
+    return !ec;
+}
+
+}
+
+#endif // REDISCLIENT_REDISCLUSTERIMPL_CPP
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLUSTERIMPL_H
+#define REDISCLIENT_REDISCLUSTERIMPL_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "redisclient/redisasyncclient.h"
+#include "redisclient/redisbuffer.h"
+#include "redisclient/redisvalue.h"
+#include "redisclient/impl/hashslot.h"
+#include "redisclient/config.h"
+
+namespace redisclient {
+
+class RedisClusterImpl : public std::enable_shared_from_this<RedisClusterImpl>,
+    boost::noncopyable {
+public:
+    // Command kept until it is replied, to be sent again on a redirection.
+    struct Request {
+        std::string cmd;
+        RedisArguments args;
+        std::function<void(RedisValue)> handler;
+        size_t redirects;
+    };
+
+    // Connection to one node of the cluster.
+    struct Node {
+        REDIS_CLIENT_DECL Node(boost::asio::io_service &ioService,
+                const boost::asio::ip::tcp::endpoint &endpoint);
+
+        boost::asio::ip::tcp::endpoint endpoint;
+        RedisAsyncClient client;
+        // Called when the connection is established or failed.
+        std::vector<std::function<void(boost::system::error_code)>> waiting;
+        // Requests sent and not replied yet, in order. They are replied
+        // with an error if the connection fails.
+        std::deque<std::shared_ptr<Request>> sent;
+    };
+
+    REDIS_CLIENT_DECL RedisClusterImpl(boost::asio::io_service &ioService);
+    REDIS_CLIENT_DECL ~RedisClusterImpl();
+
+    REDIS_CLIENT_DECL void connect(const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+    REDIS_CLIENT_DECL void disconnect();
+
+    REDIS_CLIENT_DECL void refreshSlots(std::function<void(boost::system::error_code)> handler);
+
+    REDIS_CLIENT_DECL void send(Node *node, std::shared_ptr<Request> request, bool asking);
+
+    // Send the commands grouped by node, reply with the array of replies.
+    // A command whose node fails gets an error reply in the array, the
+    // whole pipeline an error reply before connect.
+    REDIS_CLIENT_DECL void pipelined(std::vector<RedisArguments> commands,
+            std::function<void(RedisValue)> handler);
+
+    // Node of the slot of args[key], any node if there is no key or the
+    // slot has no node, nullptr before connect.
+    REDIS_CLIENT_DECL Node *route(const RedisArguments &args, size_t key);
+
+    // Node of the endpoint, created on first use.
+    REDIS_CLIENT_DECL Node *node(const boost::asio::ip::tcp::endpoint &endpoint);
+
+    // Connected node if there is one, a node to connect to otherwise.
+    REDIS_CLIENT_DECL Node *anyNode();
+
+    REDIS_CLIENT_DECL void whenConnected(Node *node,
+            std::function<void(boost::system::error_code)> handler);
+    REDIS_CLIENT_DECL void handleConnect(Node *node, const boost::system::error_code &ec);
+    // Take the request out of the sent ones of the node, false if it is
+    // not there (failed with the connection already).
+    REDIS_CLIENT_DECL bool takeSent(Node *node, const std::shared_ptr<Request> &request);
+    REDIS_CLIENT_DECL void handleReply(std::shared_ptr<Request> request, RedisValue value);
+    // Error of the connection to the node: close it, so it is connected
+    // again on next use, and reply to the requests sent with the error.
+    REDIS_CLIENT_DECL void handleError(Node *node, const std::string &error);
+    REDIS_CLIENT_DECL void handleSlots(Node *node, const RedisValue &value);
+
+    // Parse "MOVED <slot> <host>:<port>" and "ASK <slot> <host>:<port>".
+    REDIS_CLIENT_DECL static bool parseRedirection(const std::string &error,
+            bool &ask, size_t &slot, boost::asio::ip::tcp::endpoint &endpoint);
+
+    boost::asio::io_service &ioService;
+    // Node of every hash slot, nullptr for slots without one.
+    std::vector<Node *> slots;
+    std::map<boost::asio::ip::tcp::endpoint, std::unique_ptr<Node>> nodes;
+    std::function<void(const std::string &)> errorHandler;
+    // Handlers of the CLUSTER SLOTS request in progress.
+    std::vector<std::function<void(boost::system::error_code)>> refreshHandlers;
+    bool refreshing;
+    bool slotsLoaded;
+    size_t maxRedirects;
+};
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redisclusterimpl.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISCLUSTERIMPL_H
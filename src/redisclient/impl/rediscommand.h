@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCOMMAND_H
+#define REDISCLIENT_REDISCOMMAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/asio/buffer.hpp>
+
+#include <deque>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "redisclient/redisbuffer.h"
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Command serializer. The encoded size is computed first, so a command is
+// written into the output buffer with a single resize and no reallocations:
+//
+//  *<items>\r\n
+//  $<size>\r\n<data>\r\n   (for every item)
+//
+// Arguments of spliceThreshold bytes and more are not copied to the buffer,
+// they are written from their own memory by a gather write (see Splice).
+//
+// Items of a command are any range of RedisBuffer or boost::string_ref.
+
+static const size_t spliceThreshold = 16 * 1024;
+
+// Argument data written from its own memory at the offset of the command
+// buffer. The argument must be alive until the buffer is written.
+struct Splice
+{
+    size_t offset;
+    const char *ptr;
+    size_t size;
+};
+
+// Number of decimal digits in value.
+inline size_t decimalLength(uint64_t value)
+{
+    size_t length = 1;
+
+    for(;;)
+    {
+        if( value < 10 )
+            return length;
+        if( value < 100 )
+            return length + 1;
+        if( value < 1000 )
+            return length + 2;
+        if( value < 10000 )
+            return length + 3;
+
+        value /= 10000;
+        length += 4;
+    }
+}
+
+// Write exactly `length` (see decimalLength) digits of value to out,
+// two digits at a time. Returns pointer past the last digit.
+inline char *formatDecimal(char *out, uint64_t value, size_t length)
+{
+    static const char digits[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    char *end = out + length;
+    char *pos = end;
+
+    while( value >= 100 )
+    {
+        size_t index = (value % 100) * 2;
+
+        value /= 100;
+        *--pos = digits[index + 1];
+        *--pos = digits[index];
+    }
+
+    if( value >= 10 )
+    {
+        size_t index = value * 2;
+
+        *--pos = digits[index + 1];
+        *--pos = digits[index];
+    }
+    else
+    {
+        *--pos = static_cast<char>('0' + value);
+    }
+
+    return end;
+}
+
+// Size of "<prefix><value>\r\n".
+inline size_t headerSize(uint64_t value)
+{
+    return 1 + decimalLength(value) + 2;
+}
+
+inline char *writeHeader(char *out, char prefix, uint64_t value)
+{
+    *out++ = prefix;
+    out = formatDecimal(out, value, decimalLength(value));
+    *out++ = '\r';
+    *out++ = '\n';
+
+    return out;
+}
+
+inline void bufferData(const boost::string_ref &ref, const char *&ptr, size_t &size)
+{
+    ptr = ref.data();
+    size = ref.size();
+}
+
+inline void bufferData(const RedisBuffer &buffer, const char *&ptr, size_t &size)
+{
+    if( const std::string *s = boost::get<std::string>(&buffer.data) )
+    {
+        ptr = s->data();
+        size = s->size();
+    }
+    else if( const boost::string_ref *ref = boost::get<boost::string_ref>(&buffer.data) )
+    {
+        ptr = ref->data();
+        size = ref->size();
+    }
+    else
+    {
+        const std::vector<char> &v = boost::get<std::vector<char>>(buffer.data);
+
+        ptr = v.data();
+        size = v.size();
+    }
+}
+
+// Arguments of the variadic command(), passed as references.
+inline boost::string_ref argumentRef(const std::string &s)
+{
+    return boost::string_ref(s);
+}
+
+inline boost::string_ref argumentRef(const char *s)
+{
+    return boost::string_ref(s);
+}
+
+inline boost::string_ref argumentRef(const std::vector<char> &v)
+{
+    return boost::string_ref(v.data(), v.size());
+}
+
+inline boost::string_ref argumentRef(boost::string_ref ref)
+{
+    return ref;
+}
+
+inline boost::string_ref argumentRef(const RedisBuffer &buffer)
+{
+    const char *ptr;
+    size_t size;
+
+    bufferData(buffer, ptr, size);
+    return boost::string_ref(ptr, size);
+}
+
+// True if all types are valid arguments of the variadic command().
+template<typename ...Args>
+struct AreArguments;
+
+template<>
+struct AreArguments<> : std::true_type
+{
+};
+
+template<typename Arg, typename ...Args>
+struct AreArguments<Arg, Args...> : std::integral_constant<bool,
+    std::is_convertible<Arg, RedisBuffer>::value && AreArguments<Args...>::value>
+{
+};
+
+// Arguments of the variadic command() as one list, the command first.
+template<typename ...Args>
+inline RedisArguments makeArguments(std::string cmd, Args &&...args)
+{
+    RedisArguments items;
+
+    items.reserve(1 + sizeof...(Args));
+    items.emplace_back(std::move(cmd));
+
+    // expand the arguments in order
+    int expand[] = {0, (items.emplace_back(std::forward<Args>(args)), 0)...};
+    (void)expand;
+
+    return items;
+}
+
+// Replace non-owning buffers with copies of the data, for commands which
+// outlive the arguments.
+template<typename Items>
+inline void copyRefs(Items &items)
+{
+    for(RedisBuffer &item: items)
+    {
+        if( item.isRef() )
+        {
+            const boost::string_ref &ref = boost::get<boost::string_ref>(item.data);
+            item.data = std::string(ref.data(), ref.size());
+        }
+    }
+}
+
+// Exact size of the encoded command, without arguments of spliceLimit
+// bytes and more.
+template<typename Items>
+inline size_t commandSize(const Items &items,
+        size_t spliceLimit = SIZE_MAX)
+{
+    size_t result = headerSize(items.size());
+
+    for(const auto &item: items)
+    {
+        size_t size = item.size();
+
+        result += headerSize(size) + 2;
+        if( size < spliceLimit )
+            result += size;
+    }
+
+    return result;
+}
+
+// Encode the command to out, which must have commandSize(items) bytes.
+// Returns pointer past the last written byte.
+template<typename Items>
+inline char *writeCommand(char *out, const Items &items)
+{
+    out = writeHeader(out, '*', items.size());
+
+    for(const auto &item: items)
+    {
+        const char *ptr;
+        size_t size;
+
+        bufferData(item, ptr, size);
+
+        out = writeHeader(out, '$', size);
+        if( size > 0 )
+            memcpy(out, ptr, size);
+        out += size;
+        *out++ = '\r';
+        *out++ = '\n';
+    }
+
+    return out;
+}
+
+// Append the encoded command to the buffer, the buffer grows at most once.
+template<typename Items>
+inline void appendCommand(std::vector<char> &buffer, const Items &items)
+{
+    size_t offset = buffer.size();
+
+    buffer.resize(offset + commandSize(items));
+    writeCommand(buffer.data() + offset, items);
+}
+
+// Append the encoded command to the buffer, big arguments are appended to
+// splices instead.
+template<typename Items>
+inline void appendCommand(std::vector<char> &buffer, std::vector<Splice> &splices,
+        const Items &items)
+{
+    size_t offset = buffer.size();
+
+    buffer.resize(offset + commandSize(items, spliceThreshold));
+
+    char *base = buffer.data();
+    char *out = writeHeader(base + offset, '*', items.size());
+
+    for(const auto &item: items)
+    {
+        const char *ptr;
+        size_t size;
+
+        bufferData(item, ptr, size);
+
+        out = writeHeader(out, '$', size);
+        if( size >= spliceThreshold )
+        {
+            Splice splice = {static_cast<size_t>(out - base), ptr, size};
+            splices.push_back(splice);
+        }
+        else
+        {
+            if( size > 0 )
+                memcpy(out, ptr, size);
+            out += size;
+        }
+        *out++ = '\r';
+        *out++ = '\n';
+    }
+}
+
+// Gather list of the buffer with the splices inserted.
+inline void gatherBuffers(const std::vector<char> &buffer, const std::vector<Splice> &splices,
+        std::vector<boost::asio::const_buffer> &buffers)
+{
+    size_t offset = 0;
+
+    for(const Splice &splice: splices)
+    {
+        buffers.push_back(boost::asio::buffer(buffer.data() + offset, splice.offset - offset));
+        buffers.push_back(boost::asio::buffer(splice.ptr, splice.size));
+        offset = splice.offset;
+    }
+
+    if( offset < buffer.size() )
+        buffers.push_back(boost::asio::buffer(buffer.data() + offset, buffer.size() - offset));
+}
+
+}
+
+}
+
+#endif // REDISCLIENT_REDISCOMMAND_H
@@ -14,13 +14,51 @@
 #endif
 
 #include "redisclient/redisparser.h"
+#include "redisclient/impl/redisscanner.h"
 
 namespace redisclient {
 
 RedisParser::RedisParser()
-    : bulkSize(0)
+    : mode(ValueMode), arena(nullptr), bulkSize(0), offset(0), stringOffset(0)
 {
+    reserve();
+}
+
+RedisParser::RedisParser(Mode mode)
+    : mode(mode), arena(nullptr), bulkSize(0), offset(0), stringOffset(0)
+{
+    reserve();
+}
+
+void RedisParser::reserve()
+{
+    // Usual replies are nested a few levels at most (EXEC, XRANGE,
+    // CLUSTER SLOTS), deeper ones just grow the storage.
+    static const size_t depth = 16;
+
     buf.reserve(64);
+    states.reserve(1);
+    arraySizes.reserve(depth);
+
+    if( mode == ViewMode )
+        arrayViews.reserve(depth);
+    else
+        arrayValues.reserve(depth);
+}
+
+void RedisParser::reset()
+{
+    states.clear();
+    bulkSize = 0;
+    buf.clear();
+    bulk.clear();
+    elementHandler = nullptr;
+    bulkSink = nullptr;
+    offset = 0;
+    stringOffset = 0;
+    arraySizes.clear();
+    arrayValues.clear();
+    arrayViews.clear();
 }
 
 std::pair<size_t, RedisParser::ParseResult> RedisParser::parse(const char *ptr, size_t size)
@@ -28,6 +66,43 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parse(const char *ptr,
     return RedisParser::parseChunk(ptr, size);
 }
 
+template<typename Value>
+void RedisParser::appendToArray(std::vector<Value> &arrays, Value &value)
+{
+    // Values are only moved, so a subtree is never copied when the arrays
+    // are closed, whatever the nesting level.
+    assert(arraySizes.size() > 0);
+
+    if (!streamElement(value))
+        arrays.back().getArray().push_back(std::move(value));
+
+    while(!arraySizes.empty() && --arraySizes.back() == 0)
+    {
+        arraySizes.pop_back();
+        value = std::move(arrays.back());
+        arrays.pop_back();
+
+        if (!arraySizes.empty() && !streamElement(value))
+            arrays.back().getArray().push_back(std::move(value));
+    }
+}
+
+bool RedisParser::streamElement(RedisValue &value)
+{
+    if (elementHandler && arraySizes.size() == 1)
+    {
+        elementHandler(std::move(value));
+        return true;
+    }
+
+    return false;
+}
+
+bool RedisParser::streamElement(RedisValueView &)
+{
+    return false;
+}
+
 std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *ptr, size_t size)
 {
     size_t position = 0;
@@ -35,8 +110,8 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
 
     if (!states.empty())
     {
-        state = states.top();
-        states.pop();
+        state = states.back();
+        states.pop_back();
     }
 
     while(position < size)
@@ -55,9 +130,11 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     case stringReply:
                         state = String;
+                        stringOffset = offset + position;
                         break;
                     case errorReply:
                         state = ErrorString;
+                        stringOffset = offset + position;
                         break;
                     case integerReply:
                         state = Integer;
@@ -70,6 +147,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                         state = ArraySize;
                         break;
                     default:
+                        reset();
                         return std::make_pair(position, Error);
                 }
                 break;
@@ -80,11 +158,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isChar(c) && !isControl(c) )
                 {
-                    buf.push_back(c);
+                    // consume the whole run of valid bytes at once
+                    size_t run = detail::scanSimpleString(ptr + position, size - position);
+
+                    if( mode == ValueMode )
+                        buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -95,11 +178,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isChar(c) && !isControl(c) )
                 {
-                    buf.push_back(c);
+                    // consume the whole run of valid bytes at once
+                    size_t run = detail::scanSimpleString(ptr + position, size - position);
+
+                    if( mode == ValueMode )
+                        buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -108,7 +196,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     if( buf.empty() )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
@@ -118,11 +206,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isdigit(c) || c == '-' )
                 {
-                    buf.push_back(c);
+                    size_t run = detail::scanInteger(ptr + position, size - position);
+
+                    buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -130,11 +221,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 if( c == '\n')
                 {
                     state = Start;
-                    redisValue = RedisValue(buf);
+
+                    if( mode == ViewMode )
+                        redisValueView = RedisValueView(stringOffset,
+                                offset + position - 2 - stringOffset);
+                    else
+                        redisValue = RedisValue(buf);
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -143,11 +239,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     state = Start;
                     RedisValue::ErrorTag tag;
-                    redisValue = RedisValue(buf, tag);
+
+                    if( mode == ViewMode )
+                        redisValueView = RedisValueView(stringOffset,
+                                offset + position - 2 - stringOffset, tag);
+                    else
+                        redisValue = RedisValue(buf, tag);
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -156,11 +257,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     bulkSize = bufToLong(buf.data(), buf.size());
                     buf.clear();
+                    bulk.clear();
+                    stringOffset = offset + position;
 
                     if( bulkSize == -1 )
                     {
                         state = Start;
                         redisValue = RedisValue(); // Nil
+                        redisValueView = RedisValueView();
                     }
                     else if( bulkSize == 0 )
                     {
@@ -168,19 +272,23 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                     }
                     else if( bulkSize < 0 )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
                     {
-                        buf.reserve(bulkSize);
+                        if( mode == ValueMode && !sinkBulk() )
+                            bulk.reserve(bulkSize);
 
                         long int available = size - position;
                         long int canRead = std::min(bulkSize, available);
 
                         if( canRead > 0 )
                         {
-                            buf.assign(ptr + position, ptr + position + canRead);
+                            if( sinkBulk() )
+                                bulkSink(ptr + position, canRead);
+                            else if( mode == ValueMode )
+                                bulk.assign(ptr + position, ptr + position + canRead);
                             position += canRead;
                             bulkSize -= canRead;
                         }
@@ -198,7 +306,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -208,7 +316,10 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 long int available = size - position + 1;
                 long int canRead = std::min(available, bulkSize);
 
-                buf.insert(buf.end(), ptr + position - 1, ptr + position - 1 + canRead);
+                if( sinkBulk() )
+                    bulkSink(ptr + position - 1, canRead);
+                else if( mode == ValueMode )
+                    bulk.insert(bulk.end(), ptr + position - 1, ptr + position - 1 + canRead);
                 bulkSize -= canRead;
                 position += canRead - 1;
 
@@ -225,7 +336,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -233,11 +344,16 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 if( c == '\n')
                 {
                     state = Start;
-                    redisValue = RedisValue(buf);
+
+                    if( mode == ViewMode )
+                        redisValueView = RedisValueView(stringOffset,
+                                offset + position - 2 - stringOffset);
+                    else
+                        redisValue = RedisValue(std::move(bulk));
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -246,7 +362,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     if( buf.empty() )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
@@ -256,11 +372,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isdigit(c) || c == '-' )
                 {
-                    buf.push_back(c);
+                    size_t run = detail::scanInteger(ptr + position, size - position);
+
+                    buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -274,29 +393,45 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                     {
                         state = Start;
                         redisValue = RedisValue();  // Nil value
+                        redisValueView = RedisValueView();
                     }
                     else if( arraySize == 0 )
                     {
                         state = Start;
                         redisValue = RedisValue(std::move(array));  // Empty array
+                        redisValueView = RedisValueView(RedisValueView::Elements());
                     }
                     else if( arraySize < 0 )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
+                    else if( mode == ViewMode )
+                    {
+                        RedisArenaAllocator<RedisValueView> allocator(arena);
+                        RedisValueView::Elements views(allocator);
+
+                        views.reserve(arraySize);
+                        arraySizes.push_back(arraySize);
+                        arrayViews.push_back(std::move(views));
+
+                        state = StartArray;
+                    }
                     else
                     {
-                        array.reserve(arraySize);
-                        arraySizes.push(arraySize);
-                        arrayValues.push(std::move(array));
+                        // streamed elements are not collected
+                        if( !elementHandler || !arraySizes.empty() )
+                            array.reserve(arraySize);
+
+                        arraySizes.push_back(arraySize);
+                        arrayValues.push_back(std::move(array));
 
                         state = StartArray;
                     }
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -305,7 +440,7 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 {
                     if( buf.empty() )
                     {
-                        std::stack<State>().swap(states);
+                        reset();
                         return std::make_pair(position, Error);
                     }
                     else
@@ -315,11 +450,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
                 }
                 else if( isdigit(c) || c == '-' )
                 {
-                    buf.push_back(c);
+                    size_t run = detail::scanInteger(ptr + position, size - position);
+
+                    buf.insert(buf.end(), ptr + position - 1, ptr + position + run);
+                    position += run;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
@@ -330,16 +468,17 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
 
                     buf.clear();
                     redisValue = RedisValue(value);
+                    redisValueView = RedisValueView(value);
                     state = Start;
                 }
                 else
                 {
-                    std::stack<State>().swap(states);
+                    reset();
                     return std::make_pair(position, Error);
                 }
                 break;
             default:
-                std::stack<State>().swap(states);
+                reset();
                 return std::make_pair(position, Error);
         }
 
@@ -348,18 +487,10 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
         {
             if (!arraySizes.empty())
             {
-                assert(arraySizes.size() > 0);
-                arrayValues.top().getArray().push_back(redisValue);
-
-                while(!arraySizes.empty() && --arraySizes.top() == 0)
-                {
-                    arraySizes.pop();
-                    redisValue = std::move(arrayValues.top());
-                    arrayValues.pop();
-
-                    if (!arraySizes.empty())
-                        arrayValues.top().getArray().push_back(redisValue);
-                }
+                if (mode == ViewMode)
+                    appendToArray(arrayViews, redisValueView);
+                else
+                    appendToArray(arrayValues, redisValue);
             }
 
 
@@ -373,11 +504,14 @@ std::pair<size_t, RedisParser::ParseResult> RedisParser::parseChunk(const char *
 
     if (arraySizes.empty() && state == Start)
     {
+        // the next reply starts from scratch
+        reset();
         return std::make_pair(position, Completed);
     }
     else
     {
-        states.push(state);
+        offset += position;
+        states.push_back(state);
         return std::make_pair(position, Incompleted);
     }
 }
@@ -387,6 +521,40 @@ RedisValue RedisParser::result()
     return std::move(redisValue);
 }
 
+RedisValueView RedisParser::resultView()
+{
+    return std::move(redisValueView);
+}
+
+void RedisParser::setArena(RedisArena *arena_)
+{
+    arena = arena_;
+}
+
+void RedisParser::streamNextReply(std::function<void(RedisValue)> handler)
+{
+    elementHandler = std::move(handler);
+}
+
+void RedisParser::sinkNextReply(std::function<void(const char *, size_t)> sink)
+{
+    bulkSink = std::move(sink);
+}
+
+size_t RedisParser::pendingBulkSize() const
+{
+    if( !states.empty() && states.back() == Bulk )
+        return static_cast<size_t>(bulkSize) + 2;
+    else
+        return 0;
+}
+
+bool RedisParser::sinkBulk() const
+{
+    // only the bulk string reply itself, not bulk strings inside of arrays
+    return bulkSink && arraySizes.empty();
+}
+
 /*
  * Convert string to long. I can't use atol/strtol because it
  * work only with null terminated string. I can use temporary
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSCANNER_H
+#define REDISCLIENT_REDISSCANNER_H
+
+#include <stddef.h>
+
+// SSE2 is a part of x86-64, AVX2 is selected at runtime (GCC and clang only).
+#if !defined(REDIS_CLIENT_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#    define REDIS_CLIENT_HAS_SSE2
+#    include <emmintrin.h>
+#    if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#        define REDIS_CLIENT_HAS_AVX2
+#        include <immintrin.h>
+#    endif
+#endif
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Scanning kernels for RedisParser. Every function returns the length of
+// the leading run of valid bytes, so the first invalid byte (usually '\r')
+// is ptr[result] or result == size.
+//
+// scanSimpleString: bytes allowed in simple string and error replies
+//                   (printable ASCII, 0x20..0x7e).
+// scanInteger:      bytes allowed in integer, bulk size and array size
+//                   lines ('0'..'9' and '-').
+
+typedef size_t (*ScanFunction)(const char *ptr, size_t size);
+
+inline bool isSimpleStringChar(char c)
+{
+    return c >= 0x20 && c < 0x7f;
+}
+
+inline bool isIntegerChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-';
+}
+
+inline unsigned countTrailingZeros(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline size_t scanSimpleStringScalar(const char *ptr, size_t size)
+{
+    size_t i = 0;
+
+    while( i < size && isSimpleStringChar(ptr[i]) )
+        ++i;
+
+    return i;
+}
+
+inline size_t scanIntegerScalar(const char *ptr, size_t size)
+{
+    size_t i = 0;
+
+    while( i < size && isIntegerChar(ptr[i]) )
+        ++i;
+
+    return i;
+}
+
+#ifdef REDIS_CLIENT_HAS_SSE2
+
+inline size_t scanSimpleStringSse2(const char *ptr, size_t size)
+{
+    // signed compare: bytes >= 0x80 are negative and fail the lower bound
+    const __m128i lower = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + i));
+        __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, del),
+                                         _mm_cmpgt_epi8(chunk, lower));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(valid)) ^ 0xffffu;
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanSimpleStringScalar(ptr + i, size - i);
+}
+
+inline size_t scanIntegerSse2(const char *ptr, size_t size)
+{
+    const __m128i beforeZero = _mm_set1_epi8('0' - 1);
+    const __m128i afterNine = _mm_set1_epi8('9' + 1);
+    const __m128i minus = _mm_set1_epi8('-');
+    size_t i = 0;
+
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + i));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, beforeZero),
+                                      _mm_cmplt_epi8(chunk, afterNine));
+        __m128i valid = _mm_or_si128(digit, _mm_cmpeq_epi8(chunk, minus));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(valid)) ^ 0xffffu;
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanIntegerScalar(ptr + i, size - i);
+}
+
+#endif // REDIS_CLIENT_HAS_SSE2
+
+#ifdef REDIS_CLIENT_HAS_AVX2
+
+__attribute__((target("avx2")))
+inline size_t scanSimpleStringAvx2(const char *ptr, size_t size)
+{
+    const __m256i lower = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + i));
+        __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, del),
+                                            _mm256_cmpgt_epi8(chunk, lower));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(valid));
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanSimpleStringSse2(ptr + i, size - i);
+}
+
+__attribute__((target("avx2")))
+inline size_t scanIntegerAvx2(const char *ptr, size_t size)
+{
+    const __m256i beforeZero = _mm256_set1_epi8('0' - 1);
+    const __m256i nine = _mm256_set1_epi8('9');
+    const __m256i minus = _mm256_set1_epi8('-');
+    size_t i = 0;
+
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + i));
+        __m256i digit = _mm256_andnot_si256(_mm256_cmpgt_epi8(chunk, nine),
+                                            _mm256_cmpgt_epi8(chunk, beforeZero));
+        __m256i valid = _mm256_or_si256(digit, _mm256_cmpeq_epi8(chunk, minus));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(valid));
+
+        if( mask != 0 )
+            return i + countTrailingZeros(mask);
+    }
+
+    return i + scanIntegerSse2(ptr + i, size - i);
+}
+
+inline bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // REDIS_CLIENT_HAS_AVX2
+
+inline ScanFunction selectScanSimpleString()
+{
+#if defined(REDIS_CLIENT_HAS_AVX2)
+    return cpuHasAvx2() ? &scanSimpleStringAvx2 : &scanSimpleStringSse2;
+#elif defined(REDIS_CLIENT_HAS_SSE2)
+    return &scanSimpleStringSse2;
+#else
+    return &scanSimpleStringScalar;
+#endif
+}
+
+inline ScanFunction selectScanInteger()
+{
+#if defined(REDIS_CLIENT_HAS_AVX2)
+    return cpuHasAvx2() ? &scanIntegerAvx2 : &scanIntegerSse2;
+#elif defined(REDIS_CLIENT_HAS_SSE2)
+    return &scanIntegerSse2;
+#else
+    return &scanIntegerScalar;
+#endif
+}
+
+// Most lines are short (+OK, :123, *2), so the first 16 bytes are checked
+// inline and the vector code is called only for longer runs.
+static const size_t scanInlineBytes = 16;
+
+inline size_t scanSimpleString(const char *ptr, size_t size)
+{
+    size_t head = size < scanInlineBytes ? size : scanInlineBytes;
+    size_t i = scanSimpleStringScalar(ptr, head);
+
+    if( i < head )
+        return i;
+
+    static const ScanFunction scan = selectScanSimpleString();
+    return i + scan(ptr + i, size - i);
+}
+
+inline size_t scanInteger(const char *ptr, size_t size)
+{
+    size_t head = size < scanInlineBytes ? size : scanInlineBytes;
+    size_t i = scanIntegerScalar(ptr, head);
+
+    if( i < head )
+        return i;
+
+    static const ScanFunction scan = selectScanInteger();
+    return i + scan(ptr + i, size - i);
+}
+
+}
+
+}
+
+#endif // REDISCLIENT_REDISSCANNER_H
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSHARDEDCLIENT_CPP
+#define REDISCLIENT_REDISSHARDEDCLIENT_CPP
+
+#include <algorithm>
+#include <mutex>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "redisclient/redisshardedclient.h"
+
+namespace redisclient {
+
+namespace
+{
+    // FNV-1a, stable between runs and platforms unlike std::hash.
+    inline uint64_t keyHash(const boost::string_ref &key)
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        for(char c: key)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    // CPUs the process may run on.
+    inline std::vector<int> allowedCpus()
+    {
+        std::vector<int> result;
+
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+
+        if( sched_getaffinity(0, sizeof(set), &set) == 0 )
+        {
+            for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if( CPU_ISSET(cpu, &set) )
+                    result.push_back(cpu);
+            }
+        }
+#endif
+
+        return result;
+    }
+
+    // Default error handler of the connections. The default one of
+    // RedisAsyncClient throws, which would terminate the process from the
+    // thread of the shard.
+    inline void ignoreError(const std::string &)
+    {
+    }
+
+    // Best effort, the thread keeps running anywhere on failure.
+    inline void pinThread(std::thread &thread, int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+    }
+}
+
+RedisShardedClient::Shard::Shard(size_t connections)
+    : work(new boost::asio::io_service::work(ioService)),
+    pool(ioService, connections)
+{
+    pool.installErrorHandler(&ignoreError);
+}
+
+RedisShardedClient::RedisShardedClient(size_t shardsCount, size_t connectionsPerShard,
+                                       bool pinThreads)
+    : connectionsPerShard(std::max<size_t>(connectionsPerShard, 1)),
+    routing(Routing::LeastLoaded), next(0)
+{
+    std::vector<int> cpus;
+
+    if( pinThreads )
+        cpus = allowedCpus();
+
+    shardsCount = std::max<size_t>(shardsCount, 1);
+    shards.reserve(shardsCount);
+
+    for(size_t i = 0; i < shardsCount; ++i)
+    {
+        shards.emplace_back(new Shard(this->connectionsPerShard));
+
+        Shard *shard = shards.back().get();
+
+        shard->thread = std::thread([shard]() { shard->ioService.run(); });
+
+        if( !cpus.empty() )
+            pinThread(shard->thread, cpus[i % cpus.size()]);
+    }
+}
+
+RedisShardedClient::~RedisShardedClient()
+{
+    disconnect();
+
+    for(const std::unique_ptr<Shard> &shard: shards)
+        shard->work.reset();
+
+    for(const std::unique_ptr<Shard> &shard: shards)
+        shard->thread.join();
+}
+
+void RedisShardedClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
+                                 std::function<void(boost::system::error_code)> handler)
+{
+    // shards connect in parallel, in their threads
+    struct Progress {
+        std::mutex mutex;
+        size_t remaining;
+        std::function<void(boost::system::error_code)> handler;
+    };
+
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+
+    progress->remaining = shards.size();
+    progress->handler = std::move(handler);
+
+    for(const std::unique_ptr<Shard> &shard: shards)
+    {
+        RedisClientPool *pool = &shard->pool;
+
+        shard->ioService.post([pool, endpoint, progress]() {
+            pool->connect(endpoint, [progress](boost::system::error_code ec) {
+                std::function<void(boost::system::error_code)> handler;
+
+                {
+                    std::lock_guard<std::mutex> lock(progress->mutex);
+
+                    if( progress->handler && (ec || --progress->remaining == 0) )
+                        handler.swap(progress->handler);
+                }
+
+                if( handler )
+                    handler(ec);
+            });
+        });
+    }
+}
+
+bool RedisShardedClient::isConnected() const
+{
+    for(const std::unique_ptr<Shard> &shard: shards)
+    {
+        if( !shard->pool.isConnected() )
+            return false;
+    }
+
+    return true;
+}
+
+void RedisShardedClient::disconnect()
+{
+    for(const std::unique_ptr<Shard> &shard: shards)
+    {
+        RedisClientPool *pool = &shard->pool;
+
+        shard->ioService.post([pool]() { pool->disconnect(); });
+    }
+}
+
+void RedisShardedClient::installErrorHandler(std::function<void(const std::string &)> handler)
+{
+    for(const std::unique_ptr<Shard> &shard: shards)
+        shard->pool.installErrorHandler(handler);
+}
+
+void RedisShardedClient::setRouting(Routing routing_)
+{
+    routing = routing_;
+}
+
+size_t RedisShardedClient::size() const
+{
+    return shards.size();
+}
+
+boost::asio::io_service &RedisShardedClient::ioService(size_t index)
+{
+    return shards.at(index)->ioService;
+}
+
+RedisClientPool &RedisShardedClient::shard(size_t index)
+{
+    return shards.at(index)->pool;
+}
+
+RedisAsyncClient &RedisShardedClient::connectionForKey(const boost::string_ref &key)
+{
+    uint64_t index = keyHash(key) % (shards.size() * connectionsPerShard);
+
+    return shards[index % shards.size()]->pool.connection(index / shards.size());
+}
+
+RedisAsyncClient &RedisShardedClient::route(const RedisArguments &args)
+{
+    if( routing == Routing::KeyHash && args.empty() == false )
+        return connectionForKey(detail::argumentRef(args.front()));
+
+    size_t index = next.fetch_add(1, std::memory_order_relaxed) % shards.size();
+
+    // reads only the atomic state and queue depth of the connections
+    return shards[index]->pool.leastLoaded();
+}
+
+void RedisShardedClient::command(const std::string &cmd, RedisArguments args,
+                                 std::function<void(RedisValue)> handler)
+{
+    // the key is read before the arguments are moved
+    RedisAsyncClient &client = route(args);
+
+    client.command(cmd, std::move(args), std::move(handler));
+}
+
+}
+
+#endif // REDISCLIENT_REDISSHARDEDCLIENT_CPP
@@ -51,6 +51,8 @@ void RedisSyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint)
 void RedisSyncClient::connect(const boost::asio::ip::tcp::endpoint &endpoint,
     boost::system::error_code &ec)
 {
+    reset();
+
     pimpl->socket.open(endpoint.protocol(), ec);
 
     if (!ec && tcpNoDelay)
@@ -186,6 +188,8 @@ void RedisSyncClient::connect(const boost::asio::local::stream_protocol::endpoin
 void RedisSyncClient::connect(const boost::asio::local::stream_protocol::endpoint &endpoint,
         boost::system::error_code &ec)
 {
+    reset();
+
     pimpl->socket.open(endpoint.protocol(), ec);
 
     if (!ec)
@@ -197,6 +201,20 @@ void RedisSyncClient::connect(const boost::asio::local::stream_protocol::endpoin
 
 #endif
 
+void RedisSyncClient::reset()
+{
+    // the connection was closed in the middle of a reply, or the last
+    // connect failed
+    if (pimpl->state == State::Closed)
+    {
+        boost::system::error_code ignored_ec;
+
+        pimpl->socket.close(ignored_ec);
+        pimpl->redisParser = RedisParser();
+        pimpl->bufPos = pimpl->bufSize = 0;
+    }
+}
+
 bool RedisSyncClient::isConnected() const
 {
     return pimpl->getState() == State::Connected ||
@@ -214,7 +232,7 @@ void RedisSyncClient::installErrorHandler(
     pimpl->errorHandler = std::move(handler);
 }
 
-RedisValue RedisSyncClient::command(std::string cmd, std::deque<RedisBuffer> args)
+RedisValue RedisSyncClient::command(std::string cmd, RedisArguments args)
 {
     boost::system::error_code ec;
     RedisValue result = command(std::move(cmd), std::move(args), ec);
@@ -223,7 +241,7 @@ RedisValue RedisSyncClient::command(std::string cmd, std::deque<RedisBuffer> arg
     return result;
 }
 
-RedisValue RedisSyncClient::command(std::string cmd, std::deque<RedisBuffer> args,
+RedisValue RedisSyncClient::command(std::string cmd, RedisArguments args,
             boost::system::error_code &ec)
 {
     if(stateValid())
@@ -238,6 +256,39 @@ RedisValue RedisSyncClient::command(std::string cmd, std::deque<RedisBuffer> arg
     }
 }
 
+RedisValue RedisSyncClient::commandToSink(std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink)
+{
+    boost::system::error_code ec;
+    RedisValue result = commandToSink(std::move(cmd), std::move(args), std::move(sink), ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+RedisValue RedisSyncClient::commandToSink(std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink,
+            boost::system::error_code &ec)
+{
+    if(stateValid())
+    {
+        args.push_front(std::move(cmd));
+
+        pimpl->redisParser.sinkNextReply(std::move(sink));
+
+        RedisValue result = pimpl->doSyncCommand(args, commandTimeout, ec);
+
+        // the sink is dropped by the parser when the reply is completed,
+        // but not if the command failed
+        pimpl->redisParser.sinkNextReply(nullptr);
+        return result;
+    }
+    else
+    {
+        return RedisValue();
+    }
+}
+
 Pipeline RedisSyncClient::pipelined()
 {
     Pipeline pipe(*this);
@@ -255,6 +306,21 @@ RedisValue RedisSyncClient::pipelined(std::deque<std::deque<RedisBuffer>> comman
 
 RedisValue RedisSyncClient::pipelined(std::deque<std::deque<RedisBuffer>> commands,
         boost::system::error_code &ec)
+{
+    std::vector<RedisArguments> arguments;
+
+    arguments.reserve(commands.size());
+
+    for(auto &command: commands)
+    {
+        arguments.push_back(std::move(command));
+    }
+
+    return pipelinedArguments(arguments, ec);
+}
+
+RedisValue RedisSyncClient::pipelinedArguments(const std::vector<RedisArguments> &commands,
+        boost::system::error_code &ec)
 {
     if(stateValid())
     {
@@ -266,6 +332,19 @@ RedisValue RedisSyncClient::pipelined(std::deque<std::deque<RedisBuffer>> comman
     }
 }
 
+RedisValue RedisSyncClient::commandRefs(const boost::string_ref *items, size_t size,
+        boost::system::error_code &ec)
+{
+    if(stateValid())
+    {
+        return pimpl->doSyncCommand(items, size, commandTimeout, ec);
+    }
+    else
+    {
+        return RedisValue();
+    }
+}
+
 RedisSyncClient::State RedisSyncClient::state() const
 {
     return pimpl->getState();
@@ -316,6 +395,12 @@ RedisSyncClient &RedisSyncClient::setTcpKeepAlive(bool enable)
     return *this;
 }
 
+RedisSyncClient &RedisSyncClient::setMaxReadBufferSize(size_t size)
+{
+    pimpl->setMaxReadBufferSize(size);
+    return *this;
+}
+
 }
 
 #endif // REDISCLIENT_REDISSYNCCLIENT_CPP
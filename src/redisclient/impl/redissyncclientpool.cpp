@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSYNCCLIENTPOOL_CPP
+#define REDISCLIENT_REDISSYNCCLIENTPOOL_CPP
+
+#include <algorithm>
+
+#include "redisclient/impl/throwerror.h"
+#include "redisclient/redissyncclientpool.h"
+
+namespace redisclient {
+
+RedisSyncClientPool::Lease::Lease()
+    : pool(nullptr), client(nullptr)
+{
+}
+
+RedisSyncClientPool::Lease::Lease(RedisSyncClientPool *pool, RedisSyncClient *client)
+    : pool(pool), client(client)
+{
+}
+
+RedisSyncClientPool::Lease::Lease(Lease &&other)
+    : pool(other.pool), client(other.client)
+{
+    other.pool = nullptr;
+    other.client = nullptr;
+}
+
+RedisSyncClientPool::Lease &RedisSyncClientPool::Lease::operator=(Lease &&other)
+{
+    if( this != &other )
+    {
+        checkin();
+        std::swap(pool, other.pool);
+        std::swap(client, other.client);
+    }
+
+    return *this;
+}
+
+RedisSyncClientPool::Lease::~Lease()
+{
+    checkin();
+}
+
+RedisSyncClientPool::Lease::operator bool() const
+{
+    return client != nullptr;
+}
+
+RedisSyncClient &RedisSyncClientPool::Lease::operator*() const
+{
+    return *client;
+}
+
+RedisSyncClient *RedisSyncClientPool::Lease::operator->() const
+{
+    return client;
+}
+
+void RedisSyncClientPool::Lease::checkin()
+{
+    if( client )
+    {
+        pool->checkin(client);
+        pool = nullptr;
+        client = nullptr;
+    }
+}
+
+RedisSyncClientPool::RedisSyncClientPool(boost::asio::io_service &ioService, size_t size)
+    : reconnect(false)
+{
+    size = std::max<size_t>(size, 1);
+    clients.reserve(size);
+    idle.reserve(size);
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        clients.emplace_back(new RedisSyncClient(ioService));
+        idle.push_back(clients.back().get());
+    }
+
+    setConnectTimeout(boost::posix_time::seconds(5));
+}
+
+RedisSyncClientPool::~RedisSyncClientPool()
+{
+}
+
+void RedisSyncClientPool::connect(const boost::asio::ip::tcp::endpoint &endpoint_,
+                                  boost::system::error_code &ec)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        endpoint = endpoint_;
+        reconnect = true;
+    }
+
+    for(const std::unique_ptr<RedisSyncClient> &client: clients)
+    {
+        client->connect(endpoint_, ec);
+
+        if( ec )
+            return;
+    }
+}
+
+void RedisSyncClientPool::connect(const boost::asio::ip::tcp::endpoint &endpoint)
+{
+    boost::system::error_code ec;
+
+    connect(endpoint, ec);
+    detail::throwIfError(ec);
+}
+
+RedisSyncClientPool &RedisSyncClientPool::setConnectTimeout(
+        const boost::posix_time::time_duration &timeout)
+{
+    for(const std::unique_ptr<RedisSyncClient> &client: clients)
+        client->setConnectTimeout(timeout);
+
+    return *this;
+}
+
+size_t RedisSyncClientPool::size() const
+{
+    return clients.size();
+}
+
+size_t RedisSyncClientPool::available() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return idle.size();
+}
+
+RedisSyncClient &RedisSyncClientPool::connection(size_t index)
+{
+    return *clients.at(index);
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::checkout(boost::system::error_code &ec)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    checkedIn.wait(lock, [this]() { return !idle.empty(); });
+
+    RedisSyncClient *client = idle.back();
+    bool reconnect = this->reconnect;
+    boost::asio::ip::tcp::endpoint endpoint = this->endpoint;
+
+    idle.pop_back();
+    lock.unlock();
+
+    return lease(client, reconnect, endpoint, ec);
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::checkout()
+{
+    boost::system::error_code ec;
+    Lease result = checkout(ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::tryCheckout(boost::system::error_code &ec)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    ec = boost::system::error_code();
+
+    if( idle.empty() )
+        return Lease();
+
+    RedisSyncClient *client = idle.back();
+    bool reconnect = this->reconnect;
+    boost::asio::ip::tcp::endpoint endpoint = this->endpoint;
+
+    idle.pop_back();
+    lock.unlock();
+
+    return lease(client, reconnect, endpoint, ec);
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::tryCheckout()
+{
+    boost::system::error_code ec;
+    Lease result = tryCheckout(ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+RedisSyncClientPool::Lease RedisSyncClientPool::lease(RedisSyncClient *client, bool reconnect,
+                                                      const boost::asio::ip::tcp::endpoint &endpoint,
+                                                      boost::system::error_code &ec)
+{
+    Lease result(this, client);
+
+    ec = boost::system::error_code();
+
+    if( reconnect && client->state() == RedisSyncClient::State::Closed )
+    {
+        client->connect(endpoint, ec);
+
+        // checked in closed, the next borrower tries again
+        if( ec )
+            return Lease();
+    }
+
+    return result;
+}
+
+void RedisSyncClientPool::checkin(RedisSyncClient *client)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        idle.push_back(client);
+    }
+
+    checkedIn.notify_one();
+}
+
+}
+
+#endif // REDISCLIENT_REDISSYNCCLIENTPOOL_CPP
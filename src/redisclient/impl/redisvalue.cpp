@@ -17,11 +17,18 @@ RedisValue::RedisValue()
 {
 }
 
-RedisValue::RedisValue(RedisValue &&other)
+RedisValue::RedisValue(RedisValue &&other) noexcept
     : value(std::move(other.value)), error(other.error)
 {
 }
 
+RedisValue &RedisValue::operator = (RedisValue &&other) noexcept
+{
+    value = std::move(other.value);
+    error = other.error;
+    return *this;
+}
+
 RedisValue::RedisValue(int64_t i)
     : value(i), error(false)
 {
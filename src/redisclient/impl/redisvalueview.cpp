@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISVALUEVIEW_CPP
+#define REDISCLIENT_REDISVALUEVIEW_CPP
+
+#include "redisclient/redisvalueview.h"
+
+namespace redisclient {
+
+RedisValueView::RedisValueView()
+    : valueType(Null), intValue(0), rangeOffset(0), rangeLength(0)
+{
+}
+
+RedisValueView::RedisValueView(int64_t i)
+    : valueType(Int), intValue(i), rangeOffset(0), rangeLength(0)
+{
+}
+
+RedisValueView::RedisValueView(size_t offset, size_t length)
+    : valueType(String), intValue(0), rangeOffset(offset), rangeLength(length)
+{
+}
+
+RedisValueView::RedisValueView(size_t offset, size_t length, RedisValue::ErrorTag)
+    : valueType(Error), intValue(0), rangeOffset(offset), rangeLength(length)
+{
+}
+
+RedisValueView::RedisValueView(Elements array)
+    : valueType(Array), intValue(0), rangeOffset(0), rangeLength(0),
+    arrayValue(std::move(array))
+{
+}
+
+RedisValueView::Type RedisValueView::type() const
+{
+    return valueType;
+}
+
+bool RedisValueView::isOk() const
+{
+    return !isError();
+}
+
+bool RedisValueView::isError() const
+{
+    return valueType == Error;
+}
+
+bool RedisValueView::isNull() const
+{
+    return valueType == Null;
+}
+
+bool RedisValueView::isInt() const
+{
+    return valueType == Int;
+}
+
+bool RedisValueView::isString() const
+{
+    return valueType == String;
+}
+
+bool RedisValueView::isArray() const
+{
+    return valueType == Array;
+}
+
+int64_t RedisValueView::toInt() const
+{
+    return intValue;
+}
+
+size_t RedisValueView::offset() const
+{
+    return rangeOffset;
+}
+
+size_t RedisValueView::length() const
+{
+    return rangeLength;
+}
+
+const char *RedisValueView::data(const char *base) const
+{
+    return base + rangeOffset;
+}
+
+std::string RedisValueView::toString(const char *base) const
+{
+    if( valueType == String || valueType == Error )
+        return std::string(data(base), rangeLength);
+    else
+        return std::string();
+}
+
+RedisValueView::Elements &RedisValueView::getArray()
+{
+    if( valueType != Array )
+        throw boost::bad_get();
+    return arrayValue;
+}
+
+const RedisValueView::Elements &RedisValueView::getArray() const
+{
+    if( valueType != Array )
+        throw boost::bad_get();
+    return arrayValue;
+}
+
+RedisValue RedisValueView::toRedisValue(const char *base) const
+{
+    switch(valueType)
+    {
+        case Int:
+            return RedisValue(intValue);
+        case String:
+            return RedisValue(std::vector<char>(data(base), data(base) + rangeLength));
+        case Error:
+            return RedisValue(std::vector<char>(data(base), data(base) + rangeLength),
+                    RedisValue::ErrorTag());
+        case Array: {
+            std::vector<RedisValue> array;
+
+            array.reserve(arrayValue.size());
+
+            for(const RedisValueView &item: arrayValue)
+            {
+                array.push_back(item.toRedisValue(base));
+            }
+
+            return RedisValue(std::move(array));
+        }
+        case Null:
+        default:
+            return RedisValue();
+    }
+}
+
+}
+
+#endif // REDISCLIENT_REDISVALUEVIEW_CPP
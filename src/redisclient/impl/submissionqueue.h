@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_SUBMISSIONQUEUE_H
+#define REDISCLIENT_SUBMISSIONQUEUE_H
+
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+
+namespace redisclient
+{
+
+namespace detail
+{
+
+// Lock-free multi-producer single-consumer queue of heap allocated nodes.
+// Producers push nodes one by one from any thread, the consumer takes all
+// of them at once, oldest first. Node must have a `Node *next` member.
+template<typename Node>
+class SubmissionQueue : boost::noncopyable
+{
+public:
+    SubmissionQueue()
+        : head(nullptr)
+    {
+    }
+
+    ~SubmissionQueue()
+    {
+        Node *node = takeAll();
+
+        while( node )
+        {
+            Node *next = node->next;
+
+            delete node;
+            node = next;
+        }
+    }
+
+    // Returns true if the queue was empty, so the pusher is the one to
+    // wake up the consumer.
+    bool push(Node *node)
+    {
+        Node *top = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            node->next = top;
+        }
+        while( !head.compare_exchange_weak(top, node,
+                    std::memory_order_release, std::memory_order_relaxed) );
+
+        return top == nullptr;
+    }
+
+    // Push the nodes from first to last, linked by next, at once.
+    void pushAll(Node *first, Node *last)
+    {
+        Node *top = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            last->next = top;
+        }
+        while( !head.compare_exchange_weak(top, first,
+                    std::memory_order_release, std::memory_order_relaxed) );
+    }
+
+    // Take all queued nodes, oldest first, the caller owns them.
+    Node *takeAll()
+    {
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        Node *first = nullptr;
+
+        // nodes are pushed to the head, reverse them
+        while( node )
+        {
+            Node *next = node->next;
+
+            node->next = first;
+            first = node;
+            node = next;
+        }
+
+        return first;
+    }
+
+private:
+    std::atomic<Node *> head;
+};
+
+// Free nodes of one thread. When it runs out, it takes all nodes returned
+// to a SubmissionQueue at once, so nodes are reused without a lock.
+template<typename Node>
+class NodeCache : boost::noncopyable
+{
+public:
+    NodeCache()
+        : head(nullptr)
+    {
+    }
+
+    ~NodeCache()
+    {
+        while( head )
+        {
+            Node *next = head->next;
+
+            delete head;
+            head = next;
+        }
+    }
+
+    // Take a node, from returned if the cache is empty, nullptr if both
+    // are.
+    Node *pop(SubmissionQueue<Node> &returned)
+    {
+        if( head == nullptr )
+            head = returned.takeAll();
+
+        Node *node = head;
+
+        if( node )
+            head = node->next;
+
+        return node;
+    }
+
+private:
+    Node *head;
+};
+
+}
+
+}
+
+#endif // REDISCLIENT_SUBMISSIONQUEUE_H
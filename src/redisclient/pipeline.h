@@ -6,9 +6,12 @@
 #pragma once
 
 #include <deque>
+#include <type_traits>
+#include <vector>
 #include <boost/system/error_code.hpp>
 
 #include "redisbuffer.h"
+#include "redisclient/impl/rediscommand.h"
 #include "config.h"
 
 namespace redisclient
@@ -23,8 +26,19 @@ class Pipeline
 public:
     REDIS_CLIENT_DECL Pipeline(RedisSyncClient &client);
 
-    // add command to pipe
-    REDIS_CLIENT_DECL Pipeline &command(std::string cmd, std::deque<RedisBuffer> args);
+    // add command to pipe, non-owning arguments (see RedisBuffer) must be
+    // alive until finish() returns
+    REDIS_CLIENT_DECL Pipeline &command(std::string cmd, RedisArguments args);
+
+    // add command to pipe, without building a list of arguments:
+    //
+    //  pipe.command("SET", key, value);
+    //
+    // Arguments are stored by RedisBuffer, so a non-owning one (see
+    // RedisBuffer) must be alive until finish() returns.
+    template<typename ...Args>
+    inline typename std::enable_if<detail::AreArguments<Args...>::value, Pipeline &>::type
+    command(std::string cmd, Args &&...args);
 
     // Sends all commands to the redis server.
     // For every request command will get response value.
@@ -46,10 +60,18 @@ public:
     REDIS_CLIENT_DECL RedisValue finish(boost::system::error_code &ec);
 
 private:
-    std::deque<std::deque<RedisBuffer>> commands;
+    std::vector<RedisArguments> commands;
     RedisSyncClient &client;
 };
 
+template<typename ...Args>
+inline typename std::enable_if<detail::AreArguments<Args...>::value, Pipeline &>::type
+Pipeline::command(std::string cmd, Args &&...args)
+{
+    commands.push_back(detail::makeArguments(std::move(cmd), std::forward<Args>(args)...));
+    return *this;
+}
+
 }
 
 #ifdef REDIS_CLIENT_HEADER_ONLY
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISARENA_H
+#define REDISCLIENT_REDISARENA_H
+
+#include <boost/noncopyable.hpp>
+
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "config.h"
+
+namespace redisclient {
+
+// Monotonic memory arena for reply trees. Memory is carved sequentially from
+// large blocks, deallocation is a no-op and everything is freed at once by
+// release(). Not thread safe.
+//
+// Usage:
+//
+//  RedisArena arena;
+//  RedisParser parser(RedisParser::ViewMode);
+//
+//  parser.setArena(&arena);
+//  ... parse and use parser.resultView() ...
+//
+//  // all views must be destroyed before release()
+//  arena.release();
+//
+class RedisArena : boost::noncopyable {
+public:
+    REDIS_CLIENT_DECL explicit RedisArena(size_t blockSize = 64 * 1024);
+    REDIS_CLIENT_DECL ~RedisArena();
+
+    REDIS_CLIENT_DECL void *allocate(size_t size, size_t alignment);
+
+    // Free all allocated memory. The first block is kept for the next reply.
+    REDIS_CLIENT_DECL void release();
+
+    // Number of blocks allocated from the heap.
+    REDIS_CLIENT_DECL size_t blockCount() const;
+
+private:
+    size_t blockSize;
+    std::vector<void *> blocks;
+    std::vector<void *> largeBlocks;
+    char *current;
+    size_t available;
+};
+
+// std allocator adapter for RedisArena. Default constructed allocator
+// uses the heap, so containers behave as usual without an arena.
+template<typename T>
+class RedisArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    RedisArenaAllocator() noexcept
+        : arena(nullptr)
+    {
+    }
+
+    explicit RedisArenaAllocator(RedisArena *arena) noexcept
+        : arena(arena)
+    {
+    }
+
+    template<typename U>
+    RedisArenaAllocator(const RedisArenaAllocator<U> &other) noexcept
+        : arena(other.arena)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        if( arena )
+            return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+        else
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, size_t) noexcept
+    {
+        if( arena == nullptr )
+            ::operator delete(ptr);
+    }
+
+    template<typename U>
+    bool operator == (const RedisArenaAllocator<U> &rhs) const noexcept
+    {
+        return arena == rhs.arena;
+    }
+
+    template<typename U>
+    bool operator != (const RedisArenaAllocator<U> &rhs) const noexcept
+    {
+        return arena != rhs.arena;
+    }
+
+    RedisArena *arena;
+};
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redisarena.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISARENA_H
@@ -47,10 +47,11 @@ public:
             std::function<void(boost::system::error_code)> handler);
 #endif
 
-    // Return true if is connected to redis.
+    // Return true if is connected to redis. Safe to call from any thread.
     REDIS_CLIENT_DECL bool isConnected() const;
 
-    // Return connection state. See RedisClientImpl::State.
+    // Return connection state. See RedisClientImpl::State. Safe to call
+    // from any thread.
     REDIS_CLIENT_DECL State state() const;
 
     // disconnect from redis and clear command queue
@@ -60,9 +61,70 @@ public:
     REDIS_CLIENT_DECL void installErrorHandler(
             std::function<void(const std::string &)> handler);
 
+    // Set the limit of the read buffer. The buffer starts at 4 KiB and grows
+    // up to the limit while big replies are read, 1 MiB by default.
+    // Call it before connect.
+    REDIS_CLIENT_DECL void setMaxReadBufferSize(size_t size);
+
+    // Set the limit of the output buffer. Commands are serialized to one
+    // contiguous buffer and sent by a single write, until it reaches the
+    // limit, the rest are sent by a gather write. 1 MiB by default.
+    // Call it before connect.
+    REDIS_CLIENT_DECL void setMaxWriteBufferSize(size_t size);
+
+    // Number of commands waiting for a reply, including the ones not
+    // written yet. Safe to call from any thread.
+    REDIS_CLIENT_DECL size_t queueDepth() const;
+
+    // Hold commands back to send them in batches. Queued commands are
+    // written when there are maxCommands of them or maxBytes encoded
+    // bytes, maxDelay after the first one, or by flush(). A zero maxDelay
+    // flushes at the end of the current event loop turn.
+    REDIS_CLIENT_DECL void cork(size_t maxCommands, size_t maxBytes,
+            const boost::posix_time::time_duration &maxDelay = boost::posix_time::microseconds(0));
+
+    // Send commands as soon as they are queued again, flushes the queue.
+    REDIS_CLIENT_DECL void uncork();
+
+    // Write commands queued so far, for corked clients.
+    REDIS_CLIENT_DECL void flush();
+
     // Execute command on Redis server with the list of arguments.
+    //
+    // The client takes ownership of the arguments and keeps them until the
+    // command is written, big values are written from their own memory.
+    // Move the arguments in (std::move) to send a big value without a copy.
     REDIS_CLIENT_DECL void command(
-            const std::string &cmd, std::deque<RedisBuffer> args,
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = dummyHandler);
+
+    // Same as above, but the handler is kept in the completion slot of the
+    // command as is. Handlers of up to detail::ReplyCallback::inlineSize
+    // bytes are stored without heap allocation.
+    template<typename Handler>
+    inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+        std::function<void(RedisValue)>>::value>::type
+    command(const std::string &cmd, RedisArguments args, Handler &&handler);
+
+    // Execute command on Redis server and pass elements of the array reply
+    // to chunkHandler, up to chunkSize elements at a time, as soon as they
+    // are parsed. The whole reply is never kept in memory. The handler is
+    // called after the last chunk with an empty array, or with the reply
+    // itself if it is not an array (an error, for example).
+    REDIS_CLIENT_DECL void commandStream(
+            const std::string &cmd, RedisArguments args,
+            size_t chunkSize,
+            std::function<void(std::vector<RedisValue>)> chunkHandler,
+            std::function<void(RedisValue)> handler = dummyHandler);
+
+    // Execute command on Redis server and pass the payload of the bulk
+    // string reply (GET of a big value, for example) to the sink in chunks
+    // as they arrive from the socket. The payload is never kept in memory.
+    // The handler is called at the end with an empty string, or with the
+    // reply itself if it is not a bulk string (a null or an error).
+    REDIS_CLIENT_DECL void commandToSink(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink,
             std::function<void(RedisValue)> handler = dummyHandler);
 
     // Subscribe to channel. Handler msgHandler will be called
@@ -108,6 +170,23 @@ private:
     std::shared_ptr<RedisClientImpl> pimpl;
 };
 
+template<typename Handler>
+inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+    std::function<void(RedisValue)>>::value>::type
+RedisAsyncClient::command(const std::string &cmd, RedisArguments args, Handler &&handler)
+{
+    if(stateValid())
+    {
+        args.emplace_front(cmd);
+        detail::copyRefs(args);
+
+        RedisClientImpl::ReplyHandler replyHandler{std::forward<Handler>(handler),
+            nullptr, nullptr};
+
+        pimpl->submit(args, std::move(replyHandler));
+    }
+}
+
 }
 
 #ifdef REDIS_CLIENT_HEADER_ONLY
@@ -8,10 +8,12 @@
 #define REDISSYNCCLIENT_REDISBUFFER_H
 
 #include <boost/variant.hpp>
+#include <boost/utility/string_ref.hpp>
 
 #include <string>
 #include <vector>
 
+#include "smallvector.h"
 #include "config.h"
 
 namespace redisclient {
@@ -24,11 +26,27 @@ struct RedisBuffer
     inline RedisBuffer(std::string s);
     inline RedisBuffer(std::vector<char> buf);
 
+    // Non-owning buffer, the data is not copied:
+    //
+    //  redis.command("GET", {boost::string_ref(key.data(), key.size())});
+    //
+    // The data must be alive until the sync command returns or until
+    // Pipeline::finish() returns. The async client copies the data when
+    // the command is queued.
+    inline RedisBuffer(boost::string_ref ref);
+
     inline size_t size() const;
 
-    boost::variant<std::string,std::vector<char>> data;
+    // Return true if the buffer refers to data it does not own.
+    inline bool isRef() const;
+
+    boost::variant<std::string,std::vector<char>,boost::string_ref> data;
 };
 
+// Arguments of a command. Usual commands fit into the inline storage,
+// so no allocation is made for the list itself.
+typedef SmallVector<RedisBuffer, 8> RedisArguments;
+
 
 RedisBuffer::RedisBuffer(const char *ptr, size_t dataSize)
     : data(std::vector<char>(ptr, ptr + dataSize))
@@ -50,12 +68,27 @@ RedisBuffer::RedisBuffer(std::vector<char> buf)
 {
 }
 
+RedisBuffer::RedisBuffer(boost::string_ref ref)
+    : data(ref)
+{
+}
+
 size_t RedisBuffer::size() const
 {
-    if (data.type() == typeid(std::string))
-        return boost::get<std::string>(data).size();
-    else
-        return boost::get<std::vector<char>>(data).size();
+    switch(data.which())
+    {
+        case 0:
+            return boost::get<std::string>(data).size();
+        case 1:
+            return boost::get<std::vector<char>>(data).size();
+        default:
+            return boost::get<boost::string_ref>(data).size();
+    }
+}
+
+bool RedisBuffer::isRef() const
+{
+    return data.which() == 2;
 }
 
 }
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLIENTPOOL_H
+#define REDISCLIENT_REDISCLIENTPOOL_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "redisclient/redisasyncclient.h"
+#include "redisbuffer.h"
+#include "redisvalue.h"
+#include "config.h"
+
+namespace redisclient {
+
+// Fixed number of connections to one server. Every command is sent by the
+// connection with the fewest commands waiting for a reply, so a slow
+// command holds back only the commands queued after it on its connection.
+//
+// Commands are not ordered between connections, send commands which
+// depend on each other by the same connection (see leastLoaded).
+class RedisClientPool : boost::noncopyable {
+public:
+    REDIS_CLIENT_DECL RedisClientPool(boost::asio::io_service &ioService, size_t size);
+    REDIS_CLIENT_DECL ~RedisClientPool();
+
+    // Connect all connections to redis server. The handler is called once,
+    // when all of them are connected or with the first error.
+    REDIS_CLIENT_DECL void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+
+    // Return true if all connections are connected.
+    REDIS_CLIENT_DECL bool isConnected() const;
+
+    // Disconnect all connections.
+    REDIS_CLIENT_DECL void disconnect();
+
+    // Set custom error handler of all connections.
+    REDIS_CLIENT_DECL void installErrorHandler(
+        std::function<void(const std::string &)> handler);
+
+    // Number of connections.
+    REDIS_CLIENT_DECL size_t size() const;
+
+    REDIS_CLIENT_DECL RedisAsyncClient &connection(size_t index);
+
+    // Number of commands of the connection waiting for a reply (see
+    // RedisAsyncClient::queueDepth).
+    REDIS_CLIENT_DECL size_t queueDepth(size_t index) const;
+
+    // Connected connection with the fewest commands waiting for a reply.
+    // Ties are broken round-robin. Safe to call from any thread.
+    REDIS_CLIENT_DECL RedisAsyncClient &leastLoaded();
+
+    // Execute command by the least loaded connection.
+    REDIS_CLIENT_DECL void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = RedisAsyncClient::dummyHandler);
+
+    // Same as above, the handler is kept as is (see RedisAsyncClient::command).
+    template<typename Handler>
+    inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+        std::function<void(RedisValue)>>::value>::type
+    command(const std::string &cmd, RedisArguments args, Handler &&handler);
+
+private:
+    std::vector<std::unique_ptr<RedisAsyncClient>> clients;
+    // Round-robin start of the least loaded search.
+    std::atomic<size_t> next;
+};
+
+template<typename Handler>
+inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+    std::function<void(RedisValue)>>::value>::type
+RedisClientPool::command(const std::string &cmd, RedisArguments args, Handler &&handler)
+{
+    leastLoaded().command(cmd, std::move(args), std::forward<Handler>(handler));
+}
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redisclientpool.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISCLIENTPOOL_H
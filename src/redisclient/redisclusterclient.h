@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCLUSTERCLIENT_H
+#define REDISCLIENT_REDISCLUSTERCLIENT_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "redisclient/impl/redisclusterimpl.h"
+#include "redisclient/redisasyncclient.h"
+#include "redisbuffer.h"
+#include "redisvalue.h"
+#include "config.h"
+
+namespace redisclient {
+
+class ClusterPipeline;
+
+// Client of a Redis Cluster (see https://redis.io/topics/cluster-spec).
+//
+// The owner of every hash slot, loaded by CLUSTER SLOTS, is kept in a flat
+// table, so a command is sent by the connection of the node of its key
+// with one lookup. There is one RedisAsyncClient per node, connected on
+// first use, which pipelines the commands.
+//
+// MOVED and ASK redirections are followed transparently: the command is
+// sent again to the node named in the reply. MOVED updates the slot and
+// reloads the table in the background.
+//
+// Use the client from the io_service thread only.
+class RedisClusterClient : boost::noncopyable {
+public:
+    REDIS_CLIENT_DECL RedisClusterClient(boost::asio::io_service &ioService);
+    REDIS_CLIENT_DECL ~RedisClusterClient();
+
+    // Connect to a node of the cluster and load the slot table from it.
+    // Connections to the other nodes are established on first use.
+    REDIS_CLIENT_DECL void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+
+    // Return true if the slot table is loaded.
+    REDIS_CLIENT_DECL bool isConnected() const;
+
+    // Disconnect from all nodes.
+    REDIS_CLIENT_DECL void disconnect();
+
+    // Set custom error handler of the connections to all nodes. A
+    // connection is closed on an error, the commands waiting for its
+    // replies get an error reply, and it is connected again on next use.
+    REDIS_CLIENT_DECL void installErrorHandler(
+            std::function<void(const std::string &)> handler);
+
+    // Reload the slot table by CLUSTER SLOTS.
+    REDIS_CLIENT_DECL void refreshSlots(
+            std::function<void(boost::system::error_code)> handler);
+
+    // Hash slot of the key, see detail::hashSlot.
+    REDIS_CLIENT_DECL static size_t keySlot(const boost::string_ref &key);
+
+    // Address of the node of the slot as known by the client, an
+    // unspecified endpoint if the slot has none.
+    REDIS_CLIENT_DECL boost::asio::ip::tcp::endpoint slotNode(size_t slot) const;
+
+    // Number of nodes known by the client.
+    REDIS_CLIENT_DECL size_t nodes() const;
+
+    // Execute command by the node of the first argument (the key), by any
+    // node for commands without arguments.
+    //
+    // The arguments are kept until the command is replied, to be sent
+    // again on a redirection. Commands with keys in different slots must
+    // not be sent, the cluster replies with CROSSSLOT.
+    REDIS_CLIENT_DECL void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = RedisAsyncClient::dummyHandler);
+
+    // Create pipeline (see ClusterPipeline)
+    REDIS_CLIENT_DECL ClusterPipeline pipelined();
+
+private:
+    friend class ClusterPipeline;
+
+    REDIS_CLIENT_DECL void pipelinedArguments(std::vector<RedisArguments> commands,
+            std::function<void(RedisValue)> handler);
+
+    std::shared_ptr<RedisClusterImpl> pimpl;
+};
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redisclusterclient.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISCLUSTERCLIENT_H
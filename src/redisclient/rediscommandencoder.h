@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISCOMMANDENCODER_H
+#define REDISCLIENT_REDISCOMMANDENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+#include <vector>
+
+#include "redisclient/impl/rediscommand.h"
+
+namespace redisclient {
+
+namespace detail
+{
+
+// Compile time strings as character packs.
+template<char ...C>
+struct Chars
+{
+    static const size_t size = sizeof...(C);
+    static const char value[sizeof...(C)];
+};
+
+template<char ...C>
+const char Chars<C...>::value[sizeof...(C)] = {C...};
+
+template<typename ...Strings>
+struct Concat;
+
+template<char ...A>
+struct Concat<Chars<A...>>
+{
+    typedef Chars<A...> type;
+};
+
+template<char ...A, char ...B, typename ...Rest>
+struct Concat<Chars<A...>, Chars<B...>, Rest...>
+{
+    typedef typename Concat<Chars<A..., B...>, Rest...>::type type;
+};
+
+template<size_t N, char ...Digits>
+struct DecimalChars
+{
+    typedef typename DecimalChars<N / 10, static_cast<char>('0' + N % 10), Digits...>::type type;
+};
+
+template<char ...Digits>
+struct DecimalChars<0, Digits...>
+{
+    typedef Chars<Digits...> type;
+};
+
+template<>
+struct DecimalChars<0>
+{
+    typedef Chars<'0'> type;
+};
+
+// "*<items>\r\n$<name size>\r\n<name>\r\n"
+template<size_t Items, char ...Name>
+struct CommandPrefix
+{
+    typedef typename Concat<
+        Chars<'*'>, typename DecimalChars<Items>::type, Chars<'\r', '\n', '$'>,
+        typename DecimalChars<sizeof...(Name)>::type, Chars<'\r', '\n'>,
+        Chars<Name...>, Chars<'\r', '\n'>
+    >::type type;
+};
+
+// Integer arguments are formatted in place, other ones are anything
+// RedisBuffer is constructible from.
+template<typename T>
+struct IsIntegerArgument : std::integral_constant<bool,
+    std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>
+{
+};
+
+template<typename T>
+inline typename std::enable_if<std::is_signed<T>::value, bool>::type
+isNegative(T value)
+{
+    return value < 0;
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_unsigned<T>::value, bool>::type
+isNegative(T)
+{
+    return false;
+}
+
+template<typename T>
+inline uint64_t integerMagnitude(T value)
+{
+    return isNegative(value) ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+}
+
+template<typename T>
+inline typename std::enable_if<IsIntegerArgument<T>::value, size_t>::type
+encodedArgumentSize(const T &value)
+{
+    size_t length = decimalLength(integerMagnitude(value)) + (isNegative(value) ? 1 : 0);
+
+    return headerSize(length) + length + 2;
+}
+
+template<typename T>
+inline typename std::enable_if<!IsIntegerArgument<T>::value, size_t>::type
+encodedArgumentSize(const T &value)
+{
+    size_t size = argumentRef(value).size();
+
+    return headerSize(size) + size + 2;
+}
+
+template<typename T>
+inline typename std::enable_if<IsIntegerArgument<T>::value, char *>::type
+writeArgument(char *out, const T &value)
+{
+    uint64_t magnitude = integerMagnitude(value);
+    size_t digits = decimalLength(magnitude);
+
+    out = writeHeader(out, '$', digits + (isNegative(value) ? 1 : 0));
+    if( isNegative(value) )
+        *out++ = '-';
+    out = formatDecimal(out, magnitude, digits);
+    *out++ = '\r';
+    *out++ = '\n';
+
+    return out;
+}
+
+template<typename T>
+inline typename std::enable_if<!IsIntegerArgument<T>::value, char *>::type
+writeArgument(char *out, const T &value)
+{
+    boost::string_ref ref = argumentRef(value);
+
+    out = writeHeader(out, '$', ref.size());
+    if( ref.size() > 0 )
+        memcpy(out, ref.data(), ref.size());
+    out += ref.size();
+    *out++ = '\r';
+    *out++ = '\n';
+
+    return out;
+}
+
+template<typename ...Args>
+struct AreEncoderArguments;
+
+template<>
+struct AreEncoderArguments<> : std::true_type
+{
+};
+
+template<typename Arg, typename ...Args>
+struct AreEncoderArguments<Arg, Args...> : std::integral_constant<bool,
+    (IsIntegerArgument<typename std::decay<Arg>::type>::value ||
+     std::is_convertible<Arg, RedisBuffer>::value) &&
+    AreEncoderArguments<Args...>::value>
+{
+};
+
+}
+
+// Encoder of a command with the name known at compile time. The header
+// with the number of items and the name is a constant, only arguments
+// are formatted at runtime. Integer arguments are formatted in place.
+//
+// Usage:
+//
+//  std::vector<char> buffer;
+//
+//  encoders::Get::append(buffer, "key");
+//  encoders::IncrBy::append(buffer, "counter", 10);
+//
+//  redis.command(encoders::Set(), "key", "value");  // see RedisSyncClient
+//
+template<char ...Name>
+class RedisCommandEncoder {
+public:
+    // Exact size of the encoded command.
+    template<typename ...Args>
+    static size_t size(const Args &...args)
+    {
+        typedef typename detail::CommandPrefix<1 + sizeof...(Args), Name...>::type Prefix;
+        size_t result = Prefix::size;
+
+        // expand the arguments in order
+        int expand[] = {0, (result += detail::encodedArgumentSize(args), 0)...};
+        (void)expand;
+
+        return result;
+    }
+
+    // Encode the command to out, which must have size(args...) bytes.
+    // Returns pointer past the last written byte.
+    template<typename ...Args>
+    static char *write(char *out, const Args &...args)
+    {
+        typedef typename detail::CommandPrefix<1 + sizeof...(Args), Name...>::type Prefix;
+
+        memcpy(out, Prefix::value, Prefix::size);
+        out += Prefix::size;
+
+        int expand[] = {0, (out = detail::writeArgument(out, args), 0)...};
+        (void)expand;
+
+        return out;
+    }
+
+    // Append the encoded command to the buffer.
+    template<typename ...Args>
+    static void append(std::vector<char> &buffer, const Args &...args)
+    {
+        size_t offset = buffer.size();
+
+        buffer.resize(offset + size(args...));
+        write(buffer.data() + offset, args...);
+    }
+
+    template<typename ...Args>
+    static std::vector<char> encode(const Args &...args)
+    {
+        std::vector<char> result;
+
+        append(result, args...);
+        return result;
+    }
+};
+
+// Encoders of the most used commands.
+namespace encoders
+{
+typedef RedisCommandEncoder<'G', 'E', 'T'> Get;
+typedef RedisCommandEncoder<'S', 'E', 'T'> Set;
+typedef RedisCommandEncoder<'D', 'E', 'L'> Del;
+typedef RedisCommandEncoder<'E', 'X', 'P', 'I', 'R', 'E'> Expire;
+typedef RedisCommandEncoder<'I', 'N', 'C', 'R', 'B', 'Y'> IncrBy;
+typedef RedisCommandEncoder<'H', 'G', 'E', 'T'> HGet;
+typedef RedisCommandEncoder<'H', 'S', 'E', 'T'> HSet;
+}
+
+}
+
+#endif // REDISCLIENT_REDISCOMMANDENCODER_H
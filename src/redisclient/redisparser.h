@@ -6,11 +6,12 @@
 #ifndef REDISCLIENT_REDISPARSER_H
 #define REDISCLIENT_REDISPARSER_H
 
-#include <stack>
+#include <functional>
 #include <vector>
 #include <utility>
 
 #include "redisvalue.h"
+#include "redisvalueview.h"
 #include "config.h"
 
 namespace redisclient {
@@ -18,7 +19,15 @@ namespace redisclient {
 class RedisParser
 {
 public:
+    enum Mode {
+        // Build RedisValue, string data is copied.
+        ValueMode,
+        // Build RedisValueView, string data stays in the caller's buffer.
+        ViewMode,
+    };
+
     REDIS_CLIENT_DECL RedisParser();
+    REDIS_CLIENT_DECL explicit RedisParser(Mode mode);
 
     enum ParseResult {
         Completed,
@@ -30,6 +39,31 @@ public:
 
     REDIS_CLIENT_DECL RedisValue result();
 
+    // Return the parsed value in the view mode. Views are relative to the
+    // first byte of the reply, so all bytes of the reply must be kept in one
+    // contiguous buffer until the view is no longer used.
+    REDIS_CLIENT_DECL RedisValueView resultView();
+
+    // Allocate arrays of the view mode replies from the arena, so a reply
+    // tree takes one or a few arena blocks instead of an allocation per
+    // array. Pass nullptr to allocate from the heap again.
+    REDIS_CLIENT_DECL void setArena(RedisArena *arena);
+
+    // Pass elements of the next reply to the handler one by one as soon as
+    // they are parsed, instead of collecting them. Applies only if the reply
+    // is an array, its result is an empty array then. Value mode only.
+    REDIS_CLIENT_DECL void streamNextReply(std::function<void(RedisValue)> handler);
+
+    // Pass payload of the next reply to the sink chunk by chunk as it
+    // arrives, instead of collecting it. Applies only if the reply is a bulk
+    // string, its result is an empty string then (or a null).
+    REDIS_CLIENT_DECL void sinkNextReply(std::function<void(const char *, size_t)> sink);
+
+    // Number of bytes still expected for the bulk string being parsed
+    // (including the trailing CRLF), or 0 if a bulk string is not in
+    // progress. Lets the caller size the next read.
+    REDIS_CLIENT_DECL size_t pendingBulkSize() const;
+
 protected:
     REDIS_CLIENT_DECL std::pair<size_t, ParseResult> parseChunk(const char *ptr, size_t size);
 
@@ -46,6 +80,17 @@ protected:
     REDIS_CLIENT_DECL long int bufToLong(const char *str, size_t size);
 
 private:
+    REDIS_CLIENT_DECL void reserve();
+    // Drop everything of the reply being parsed, called when a reply is
+    // completed or fails to parse, so the next one starts clean.
+    REDIS_CLIENT_DECL void reset();
+    REDIS_CLIENT_DECL bool streamElement(RedisValue &value);
+    REDIS_CLIENT_DECL bool streamElement(RedisValueView &value);
+    REDIS_CLIENT_DECL bool sinkBulk() const;
+
+    template<typename Value>
+    inline void appendToArray(std::vector<Value> &arrays, Value &value);
+
     enum State {
         Start = 0,
         StartArray = 1,
@@ -69,15 +114,27 @@ private:
         ArraySizeLF = 14,
     };
 
-    std::stack<State> states;
+    std::vector<State> states;
 
+    Mode mode;
+    RedisArena *arena;
     long int bulkSize;
     std::vector<char> buf;
+    std::vector<char> bulk; // moved to the RedisValue when completed
     RedisValue redisValue;
+    RedisValueView redisValueView;
+    std::function<void(RedisValue)> elementHandler;
+    std::function<void(const char *, size_t)> bulkSink;
+
+    // offset of the current chunk from the start of the reply and
+    // offset of the current string value (view mode only)
+    size_t offset;
+    size_t stringOffset;
 
     // temporary variables
-    std::stack<long int> arraySizes;
-    std::stack<RedisValue> arrayValues;
+    std::vector<long int> arraySizes;
+    std::vector<RedisValue> arrayValues;
+    std::vector<RedisValueView> arrayViews;
 
     static const char stringReply = '+';
     static const char errorReply = '-';
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSHARDEDCLIENT_H
+#define REDISCLIENT_REDISSHARDEDCLIENT_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "redisclient/redisclientpool.h"
+#include "redisbuffer.h"
+#include "redisvalue.h"
+#include "config.h"
+
+namespace redisclient {
+
+// Connections to one server spread over several io_service threads
+// (shards), so that reading, parsing and handlers of different
+// connections run in parallel. Every shard runs its own io_service in its
+// own thread, optionally pinned to a core, with a RedisClientPool.
+//
+// Handlers are called in the thread of the shard of the connection.
+//
+// Commands are sent by the shards in turn, by the least loaded connection
+// of the shard. With Routing::KeyHash commands with the same first
+// argument (the key) are sent by the same connection, so they are
+// executed and replied in order.
+class RedisShardedClient : boost::noncopyable {
+public:
+    enum class Routing {
+        LeastLoaded,
+        KeyHash
+    };
+
+    // Start shards threads with connectionsPerShard connections each.
+    // Threads are pinned to the CPUs the process may run on, one per
+    // core, if pinThreads is true.
+    REDIS_CLIENT_DECL RedisShardedClient(size_t shards, size_t connectionsPerShard = 1,
+            bool pinThreads = true);
+
+    // Stop the threads, disconnect all connections.
+    REDIS_CLIENT_DECL ~RedisShardedClient();
+
+    // Connect all connections to redis server. The handler is called once,
+    // when all of them are connected or with the first error, in the thread
+    // of one of the shards.
+    REDIS_CLIENT_DECL void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            std::function<void(boost::system::error_code)> handler);
+
+    // Return true if all connections are connected.
+    REDIS_CLIENT_DECL bool isConnected() const;
+
+    // Disconnect all connections, in the threads of the shards.
+    REDIS_CLIENT_DECL void disconnect();
+
+    // Set custom error handler of all connections, called in the thread of
+    // the shard. Errors are ignored by default. The handler must not throw,
+    // nothing catches exceptions in the threads of the shards. Call it
+    // before connect.
+    REDIS_CLIENT_DECL void installErrorHandler(
+        std::function<void(const std::string &)> handler);
+
+    // Call it before sending commands.
+    REDIS_CLIENT_DECL void setRouting(Routing routing);
+
+    // Number of shards (threads).
+    REDIS_CLIENT_DECL size_t size() const;
+
+    REDIS_CLIENT_DECL boost::asio::io_service &ioService(size_t shard);
+    REDIS_CLIENT_DECL RedisClientPool &shard(size_t shard);
+
+    // Connection which sends the commands of the key with Routing::KeyHash.
+    REDIS_CLIENT_DECL RedisAsyncClient &connectionForKey(const boost::string_ref &key);
+
+    // Connection for the next command, see Routing. Safe to call from any
+    // thread.
+    REDIS_CLIENT_DECL RedisAsyncClient &route(const RedisArguments &args);
+
+    // Execute command by the connection chosen by route().
+    REDIS_CLIENT_DECL void command(
+            const std::string &cmd, RedisArguments args,
+            std::function<void(RedisValue)> handler = RedisAsyncClient::dummyHandler);
+
+    // Same as above, the handler is kept as is (see RedisAsyncClient::command).
+    template<typename Handler>
+    inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+        std::function<void(RedisValue)>>::value>::type
+    command(const std::string &cmd, RedisArguments args, Handler &&handler);
+
+private:
+    struct Shard {
+        REDIS_CLIENT_DECL Shard(size_t connections);
+
+        boost::asio::io_service ioService;
+        std::unique_ptr<boost::asio::io_service::work> work;
+        RedisClientPool pool;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t connectionsPerShard;
+    Routing routing;
+    // Round-robin over the shards for Routing::LeastLoaded.
+    std::atomic<size_t> next;
+};
+
+template<typename Handler>
+inline typename std::enable_if<!std::is_same<typename std::decay<Handler>::type,
+    std::function<void(RedisValue)>>::value>::type
+RedisShardedClient::command(const std::string &cmd, RedisArguments args, Handler &&handler)
+{
+    // the key is read before the arguments are moved
+    RedisAsyncClient &client = route(args);
+
+    client.command(cmd, std::move(args), std::forward<Handler>(handler));
+}
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redisshardedclient.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISSHARDEDCLIENT_H
@@ -12,8 +12,12 @@
 #include <string>
 #include <list>
 #include <functional>
+#include <type_traits>
 
 #include "redisclient/impl/redisclientimpl.h"
+#include "redisclient/impl/rediscommand.h"
+#include "redisclient/impl/throwerror.h"
+#include "rediscommandencoder.h"
 #include "redisbuffer.h"
 #include "redisvalue.h"
 #include "config.h"
@@ -60,12 +64,51 @@ public:
         std::function<void(const std::string &)> handler);
 
     // Execute command on Redis server with the list of arguments.
+    //
+    // Big values are written from the memory of the arguments, so move
+    // them in (std::move) to send them without a copy.
     REDIS_CLIENT_DECL RedisValue command(
-            std::string cmd, std::deque<RedisBuffer> args);
+            std::string cmd, RedisArguments args);
 
     // Execute command on Redis server with the list of arguments.
     REDIS_CLIENT_DECL RedisValue command(
-            std::string cmd, std::deque<RedisBuffer> args,
+            std::string cmd, RedisArguments args,
+            boost::system::error_code &ec);
+
+    // Execute command on Redis server with the arguments, without building
+    // a list of them. Arguments are anything RedisBuffer is constructible
+    // from and are written without a copy:
+    //
+    //  redis.command("SET", key, value);
+    //
+    // Throws: boost::system::system_error on errors.
+    template<typename ...Args>
+    inline typename std::enable_if<detail::AreArguments<Args...>::value, RedisValue>::type
+    command(const std::string &cmd, Args &&...args);
+
+    // Execute command encoded by RedisCommandEncoder, integer arguments
+    // are formatted in place:
+    //
+    //  redis.command(encoders::IncrBy(), "counter", 10);
+    //
+    // Throws: boost::system::system_error on errors.
+    template<char ...Name, typename ...Args>
+    inline typename std::enable_if<detail::AreEncoderArguments<Args...>::value, RedisValue>::type
+    command(RedisCommandEncoder<Name...> encoder, const Args &...args);
+
+    // Execute command on Redis server and pass the payload of the bulk
+    // string reply to the sink in chunks as they are read from the socket.
+    // Returns an empty string then, or the reply itself if it is not a bulk
+    // string (a null or an error).
+    REDIS_CLIENT_DECL RedisValue commandToSink(
+            std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink);
+
+    // Execute command on Redis server and pass the payload of the bulk
+    // string reply to the sink in chunks as they are read from the socket.
+    REDIS_CLIENT_DECL RedisValue commandToSink(
+            std::string cmd, RedisArguments args,
+            std::function<void(const char *, size_t)> sink,
             boost::system::error_code &ec);
 
     // Create pipeline (see Pipeline)
@@ -83,16 +126,33 @@ public:
 
     REDIS_CLIENT_DECL RedisSyncClient &setConnectTimeout(
             const boost::posix_time::time_duration &timeout);
+    // Set the time limit of a command or a whole pipeline, from the first
+    // byte written to the last byte of the reply read. The connection is
+    // closed on a timeout, as on other errors, since the reply may still
+    // come.
     REDIS_CLIENT_DECL RedisSyncClient &setCommandTimeout(
             const boost::posix_time::time_duration &timeout);
 
     REDIS_CLIENT_DECL RedisSyncClient &setTcpNoDelay(bool enable);
     REDIS_CLIENT_DECL RedisSyncClient &setTcpKeepAlive(bool enable);
 
+    // Set the limit of the read buffer. The buffer starts at 4 KiB and grows
+    // up to the limit while big replies are read, 1 MiB by default.
+    REDIS_CLIENT_DECL RedisSyncClient &setMaxReadBufferSize(size_t size);
+
 protected:
     REDIS_CLIENT_DECL bool stateValid() const;
 
 private:
+    friend class Pipeline;
+
+    REDIS_CLIENT_DECL RedisValue commandRefs(const boost::string_ref *items, size_t size,
+            boost::system::error_code &ec);
+    REDIS_CLIENT_DECL RedisValue pipelinedArguments(const std::vector<RedisArguments> &commands,
+            boost::system::error_code &ec);
+    // Drop what is left of the last connection before connecting again.
+    REDIS_CLIENT_DECL void reset();
+
     std::shared_ptr<RedisClientImpl> pimpl;
     boost::posix_time::time_duration connectTimeout;
     boost::posix_time::time_duration commandTimeout;
@@ -100,6 +160,35 @@ private:
     bool tcpKeepAlive;
 };
 
+template<typename ...Args>
+inline typename std::enable_if<detail::AreArguments<Args...>::value, RedisValue>::type
+RedisSyncClient::command(const std::string &cmd, Args &&...args)
+{
+    const boost::string_ref items[] = {boost::string_ref(cmd), detail::argumentRef(args)...};
+    boost::system::error_code ec;
+    RedisValue result = commandRefs(items, 1 + sizeof...(Args), ec);
+
+    detail::throwIfError(ec);
+    return result;
+}
+
+template<char ...Name, typename ...Args>
+inline typename std::enable_if<detail::AreEncoderArguments<Args...>::value, RedisValue>::type
+RedisSyncClient::command(RedisCommandEncoder<Name...> encoder, const Args &...args)
+{
+    boost::system::error_code ec;
+    RedisValue result;
+
+    if(stateValid())
+    {
+        encoder.append(pimpl->writeBuffer, args...);
+        result = pimpl->doSyncEncodedCommand(commandTimeout, ec);
+    }
+
+    detail::throwIfError(ec);
+    return result;
+}
+
 }
 
 #ifdef REDIS_CLIENT_HEADER_ONLY
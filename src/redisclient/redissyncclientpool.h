@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISSYNCCLIENTPOOL_H
+#define REDISCLIENT_REDISSYNCCLIENTPOOL_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "redisclient/redissyncclient.h"
+#include "config.h"
+
+namespace redisclient {
+
+// Fixed number of sync connections to one server, shared by threads. A
+// thread checks a connection out, uses it alone and checks it back in:
+//
+//  RedisSyncClientPool pool(ioService, 8);
+//
+//  pool.connect(endpoint);
+//
+//  {
+//      RedisSyncClientPool::Lease redis = pool.checkout();
+//
+//      redis->command("SET", {"key", "value"});
+//  } // checked in
+//
+// A connection closed by an error or a timeout of a command is connected
+// again when it is checked out, so the borrower does not get the late
+// replies of the previous one.
+class RedisSyncClientPool : boost::noncopyable {
+public:
+    // Connection checked out of the pool, checked in when destroyed.
+    class Lease {
+    public:
+        REDIS_CLIENT_DECL Lease();
+        REDIS_CLIENT_DECL Lease(Lease &&other);
+        REDIS_CLIENT_DECL Lease &operator=(Lease &&other);
+        REDIS_CLIENT_DECL ~Lease();
+
+        // False for the empty lease of a failed tryCheckout.
+        REDIS_CLIENT_DECL explicit operator bool() const;
+
+        REDIS_CLIENT_DECL RedisSyncClient &operator*() const;
+        REDIS_CLIENT_DECL RedisSyncClient *operator->() const;
+
+        // Check the connection in before the lease is destroyed.
+        REDIS_CLIENT_DECL void checkin();
+
+    private:
+        friend class RedisSyncClientPool;
+
+        REDIS_CLIENT_DECL Lease(RedisSyncClientPool *pool, RedisSyncClient *client);
+
+        RedisSyncClientPool *pool;
+        RedisSyncClient *client;
+    };
+
+    REDIS_CLIENT_DECL RedisSyncClientPool(boost::asio::io_service &ioService, size_t size);
+    REDIS_CLIENT_DECL ~RedisSyncClientPool();
+
+    // Connect all connections to redis server, stops at the first error.
+    // Closed connections are connected to the endpoint again on checkout.
+    REDIS_CLIENT_DECL void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            boost::system::error_code &ec);
+
+    // Connect all connections to redis server.
+    REDIS_CLIENT_DECL void connect(
+            const boost::asio::ip::tcp::endpoint &endpoint);
+
+    // Set the time limit of connecting a connection, in connect() and
+    // again on checkout, 5 seconds by default. Must be called before use.
+    REDIS_CLIENT_DECL RedisSyncClientPool &setConnectTimeout(
+            const boost::posix_time::time_duration &timeout);
+
+    // Number of connections.
+    REDIS_CLIENT_DECL size_t size() const;
+
+    // Number of connections not checked out.
+    REDIS_CLIENT_DECL size_t available() const;
+
+    // Connection by index, to set it up (timeouts, etc) before use. Must
+    // not be used while checked out by someone else.
+    REDIS_CLIENT_DECL RedisSyncClient &connection(size_t index);
+
+    // Check out a connection, waiting for one to be checked in if all of
+    // them are in use. Return an empty lease if a closed connection fails
+    // to connect again, it stays in the pool to be tried by the next one.
+    REDIS_CLIENT_DECL Lease checkout(boost::system::error_code &ec);
+
+    // Check out a connection, waiting for one to be checked in if all of
+    // them are in use.
+    REDIS_CLIENT_DECL Lease checkout();
+
+    // Check out a connection if there is a free one, otherwise return an
+    // empty lease, also if a closed connection fails to connect again.
+    REDIS_CLIENT_DECL Lease tryCheckout(boost::system::error_code &ec);
+
+    // Check out a connection if there is a free one, otherwise return an
+    // empty lease.
+    REDIS_CLIENT_DECL Lease tryCheckout();
+
+private:
+    // Lease of the client taken out of idle, connected again if it is
+    // closed. Called without the lock, connecting takes time.
+    REDIS_CLIENT_DECL Lease lease(RedisSyncClient *client, bool reconnect,
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            boost::system::error_code &ec);
+    REDIS_CLIENT_DECL void checkin(RedisSyncClient *client);
+
+    std::vector<std::unique_ptr<RedisSyncClient>> clients;
+    std::vector<RedisSyncClient *> idle;
+    boost::asio::ip::tcp::endpoint endpoint;
+    bool reconnect;
+    mutable std::mutex mutex;
+    std::condition_variable checkedIn;
+};
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redissyncclientpool.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISSYNCCLIENTPOOL_H
@@ -19,7 +19,7 @@ public:
     struct ErrorTag {};
 
     REDIS_CLIENT_DECL RedisValue();
-    REDIS_CLIENT_DECL RedisValue(RedisValue &&other);
+    REDIS_CLIENT_DECL RedisValue(RedisValue &&other) noexcept;
     REDIS_CLIENT_DECL RedisValue(int64_t i);
     REDIS_CLIENT_DECL RedisValue(const char *s);
     REDIS_CLIENT_DECL RedisValue(const std::string &s);
@@ -30,7 +30,9 @@ public:
 
     RedisValue(const RedisValue &) = default;
     RedisValue& operator = (const RedisValue &) = default;
-    RedisValue& operator = (RedisValue &&) = default;
+    // noexcept, so that std::vector<RedisValue> moves the values when it
+    // grows instead of copying them with all the nested arrays
+    REDIS_CLIENT_DECL RedisValue& operator = (RedisValue &&other) noexcept;
 
     // Return the value as a std::string if
     // type is a byte string; otherwise returns an empty std::string.
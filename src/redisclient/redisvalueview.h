@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_REDISVALUEVIEW_H
+#define REDISCLIENT_REDISVALUEVIEW_H
+
+#include <string>
+#include <vector>
+
+#include "redisarena.h"
+#include "redisvalue.h"
+#include "config.h"
+
+namespace redisclient {
+
+// Non-owning reply value produced by RedisParser in the view mode.
+//
+// String and error values do not hold a copy of the bytes, only an
+// (offset, length) range in the receive buffer. Offsets are counted from
+// the first byte of the reply, so the caller passes a pointer to that byte
+// as `base` to access the data.
+//
+// Arrays may be allocated from a RedisArena (see RedisParser::setArena),
+// in that case the arena must outlive the view.
+class RedisValueView {
+public:
+    typedef std::vector<RedisValueView, RedisArenaAllocator<RedisValueView> > Elements;
+
+    enum Type {
+        Null,
+        Int,
+        String,
+        Error,
+        Array,
+    };
+
+    REDIS_CLIENT_DECL RedisValueView();
+    REDIS_CLIENT_DECL RedisValueView(int64_t i);
+    REDIS_CLIENT_DECL RedisValueView(size_t offset, size_t length);
+    REDIS_CLIENT_DECL RedisValueView(size_t offset, size_t length, RedisValue::ErrorTag);
+    REDIS_CLIENT_DECL RedisValueView(Elements array);
+
+    // Return type of the value.
+    REDIS_CLIENT_DECL Type type() const;
+
+    // Return true if value not a error
+    REDIS_CLIENT_DECL bool isOk() const;
+    // Return true if value is a error
+    REDIS_CLIENT_DECL bool isError() const;
+    // Return true if this is a null.
+    REDIS_CLIENT_DECL bool isNull() const;
+    // Return true if type is an int
+    REDIS_CLIENT_DECL bool isInt() const;
+    // Return true if type is a string/byte array (error strings are excluded).
+    REDIS_CLIENT_DECL bool isString() const;
+    // Return true if type is an array
+    REDIS_CLIENT_DECL bool isArray() const;
+
+    // Return the value as an int if type is an int; otherwise returns 0.
+    REDIS_CLIENT_DECL int64_t toInt() const;
+
+    // Byte range of a string or error value, relative to the first byte
+    // of the reply. Both are 0 for other types.
+    REDIS_CLIENT_DECL size_t offset() const;
+    REDIS_CLIENT_DECL size_t length() const;
+
+    // Return pointer to the string data inside the receive buffer.
+    REDIS_CLIENT_DECL const char *data(const char *base) const;
+
+    // Return a copy of the string data if type is a string or an error;
+    // otherwise returns an empty std::string.
+    REDIS_CLIENT_DECL std::string toString(const char *base) const;
+
+    // Throws: boost::bad_get if the type is not an array
+    REDIS_CLIENT_DECL Elements &getArray();
+    REDIS_CLIENT_DECL const Elements &getArray() const;
+
+    // Build the owning value. This is the only place where string data
+    // is copied out of the receive buffer.
+    REDIS_CLIENT_DECL RedisValue toRedisValue(const char *base) const;
+
+private:
+    Type valueType;
+    int64_t intValue;
+    size_t rangeOffset;
+    size_t rangeLength;
+    Elements arrayValue;
+};
+
+}
+
+#ifdef REDIS_CLIENT_HEADER_ONLY
+#include "redisclient/impl/redisvalueview.cpp"
+#endif
+
+#endif // REDISCLIENT_REDISVALUEVIEW_H
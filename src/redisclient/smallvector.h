@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) Alex Nekipelov (alex@nekipelov.net)
+ * License: MIT
+ */
+
+#ifndef REDISCLIENT_SMALLVECTOR_H
+#define REDISCLIENT_SMALLVECTOR_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace redisclient {
+
+// Vector with inline storage for N elements, the heap is used only when
+// it grows beyond N. Elements are stored contiguously.
+//
+// Unlike std::vector, push_front/emplace_front are provided (O(size)),
+// and SmallVector is implicitly constructible from std::deque, so the
+// API which used to take std::deque keeps accepting it.
+template<typename T, size_t N>
+class SmallVector {
+public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+    typedef size_t size_type;
+
+    SmallVector() noexcept
+        : items(inlineItems()), itemCount(0), itemCapacity(N)
+    {
+    }
+
+    SmallVector(std::initializer_list<T> list)
+        : SmallVector()
+    {
+        append(list.begin(), list.end());
+    }
+
+    SmallVector(const std::deque<T> &other)
+        : SmallVector()
+    {
+        append(other.begin(), other.end());
+    }
+
+    SmallVector(std::deque<T> &&other)
+        : SmallVector()
+    {
+        append(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+    }
+
+    SmallVector(const SmallVector &other)
+        : SmallVector()
+    {
+        append(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector &&other) noexcept
+        : SmallVector()
+    {
+        steal(other);
+    }
+
+    ~SmallVector()
+    {
+        clear();
+        freeItems();
+    }
+
+    SmallVector &operator = (const SmallVector &other)
+    {
+        if( this != &other )
+        {
+            clear();
+            append(other.begin(), other.end());
+        }
+
+        return *this;
+    }
+
+    SmallVector &operator = (SmallVector &&other) noexcept
+    {
+        if( this != &other )
+        {
+            clear();
+            freeItems();
+            steal(other);
+        }
+
+        return *this;
+    }
+
+    iterator begin() noexcept
+    {
+        return items;
+    }
+
+    iterator end() noexcept
+    {
+        return items + itemCount;
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return items;
+    }
+
+    const_iterator end() const noexcept
+    {
+        return items + itemCount;
+    }
+
+    T *data() noexcept
+    {
+        return items;
+    }
+
+    const T *data() const noexcept
+    {
+        return items;
+    }
+
+    size_t size() const noexcept
+    {
+        return itemCount;
+    }
+
+    size_t capacity() const noexcept
+    {
+        return itemCapacity;
+    }
+
+    bool empty() const noexcept
+    {
+        return itemCount == 0;
+    }
+
+    T &operator[](size_t index)
+    {
+        return items[index];
+    }
+
+    const T &operator[](size_t index) const
+    {
+        return items[index];
+    }
+
+    T &front()
+    {
+        return items[0];
+    }
+
+    const T &front() const
+    {
+        return items[0];
+    }
+
+    T &back()
+    {
+        return items[itemCount - 1];
+    }
+
+    const T &back() const
+    {
+        return items[itemCount - 1];
+    }
+
+    void reserve(size_t capacity)
+    {
+        if( capacity > itemCapacity )
+            reallocate(capacity);
+    }
+
+    void clear() noexcept
+    {
+        for(size_t i = 0; i < itemCount; ++i)
+        {
+            items[i].~T();
+        }
+
+        itemCount = 0;
+    }
+
+    void push_back(const T &value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(T &&value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template<typename ...Args>
+    void emplace_back(Args &&...args)
+    {
+        if( itemCount == itemCapacity )
+        {
+            // the argument may refer to an element, construct it first
+            T value(std::forward<Args>(args)...);
+
+            reallocate(itemCapacity * 2);
+            new (items + itemCount) T(std::move(value));
+        }
+        else
+        {
+            new (items + itemCount) T(std::forward<Args>(args)...);
+        }
+
+        ++itemCount;
+    }
+
+    void push_front(T value)
+    {
+        insert(begin(), std::move(value));
+    }
+
+    template<typename ...Args>
+    void emplace_front(Args &&...args)
+    {
+        insert(begin(), T(std::forward<Args>(args)...));
+    }
+
+    iterator insert(const_iterator position, T value)
+    {
+        size_t index = position - items;
+
+        if( itemCount == itemCapacity )
+            reallocate(itemCapacity * 2);
+
+        if( index == itemCount )
+        {
+            new (items + itemCount) T(std::move(value));
+        }
+        else
+        {
+            new (items + itemCount) T(std::move(items[itemCount - 1]));
+            std::move_backward(items + index, items + itemCount - 1, items + itemCount);
+            items[index] = std::move(value);
+        }
+
+        ++itemCount;
+        return items + index;
+    }
+
+    void pop_back()
+    {
+        items[--itemCount].~T();
+    }
+
+private:
+    T *inlineItems() noexcept
+    {
+        return reinterpret_cast<T *>(&storage);
+    }
+
+    bool isInline() const noexcept
+    {
+        return items == reinterpret_cast<const T *>(&storage);
+    }
+
+    template<typename Iterator>
+    void append(Iterator first, Iterator last)
+    {
+        reserve(itemCount + std::distance(first, last));
+
+        for(; first != last; ++first)
+        {
+            new (items + itemCount) T(*first);
+            ++itemCount;
+        }
+    }
+
+    void reallocate(size_t capacity)
+    {
+        T *newItems = static_cast<T *>(::operator new(capacity * sizeof(T)));
+
+        for(size_t i = 0; i < itemCount; ++i)
+        {
+            new (newItems + i) T(std::move(items[i]));
+            items[i].~T();
+        }
+
+        freeItems();
+        items = newItems;
+        itemCapacity = capacity;
+    }
+
+    void freeItems() noexcept
+    {
+        if( !isInline() )
+        {
+            ::operator delete(items);
+            items = inlineItems();
+            itemCapacity = N;
+        }
+    }
+
+    // this must be empty and inline
+    void steal(SmallVector &other) noexcept
+    {
+        if( other.isInline() )
+        {
+            for(size_t i = 0; i < other.itemCount; ++i)
+            {
+                new (items + i) T(std::move(other.items[i]));
+            }
+
+            itemCount = other.itemCount;
+            other.clear();
+        }
+        else
+        {
+            items = other.items;
+            itemCount = other.itemCount;
+            itemCapacity = other.itemCapacity;
+
+            other.items = other.inlineItems();
+            other.itemCount = 0;
+            other.itemCapacity = N;
+        }
+    }
+
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type storage;
+    T *items;
+    size_t itemCount;
+    size_t itemCapacity;
+};
+
+}
+
+#endif // REDISCLIENT_SMALLVECTOR_H
@@ -0,0 +1,441 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/redisasyncclient.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_AsyncClient
+
+#include <boost/test/unit_test.hpp>
+
+#include "standinserver.h"
+
+using namespace redisclient;
+
+namespace
+{
+    // LRANGE replies with the elements "0".."N-1", N is the last argument,
+    // GET with a payload of the size of the last argument or a null,
+    // ERR replies with an error, anything else with the last argument.
+    std::string reply(const std::vector<std::string> &command)
+    {
+        if( command.front() == "GET" )
+        {
+            if( command.back() == "nil" )
+                return StandInServer::nullBulk();
+
+            return StandInServer::bulk(StandInServer::payload(std::stoul(command.back())));
+        }
+        else if( command.front() == "LRANGE" )
+        {
+            std::vector<std::string> elements;
+
+            for(int i = 0; i < std::stoi(command.back()); ++i)
+                elements.push_back(StandInServer::bulk(std::to_string(i)));
+
+            return StandInServer::array(elements);
+        }
+        else if( command.front() == "ERR" )
+        {
+            return StandInServer::error("ERR " + command.back());
+        }
+
+        return StandInServer::bulk(command.back());
+    }
+
+    // Run the io_service until the condition is true, false on timeout.
+    template<typename Condition>
+    bool runUntil(boost::asio::io_service &ioService, Condition condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+        while( !condition() )
+        {
+            if( std::chrono::steady_clock::now() > deadline )
+                return false;
+
+            ioService.poll();
+            ioService.reset();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    // Run the io_service for the duration.
+    void runFor(boost::asio::io_service &ioService, std::chrono::milliseconds duration)
+    {
+        auto deadline = std::chrono::steady_clock::now() + duration;
+
+        runUntil(ioService, [&]() { return std::chrono::steady_clock::now() >= deadline; });
+    }
+
+    void connect(boost::asio::io_service &ioService, RedisAsyncClient &redis,
+            const StandInServer &server)
+    {
+        bool connected = false;
+
+        redis.connect(server.endpoint(), [&](boost::system::error_code ec) {
+            BOOST_REQUIRE(!ec);
+            connected = true;
+        });
+
+        BOOST_REQUIRE(runUntil(ioService, [&]() { return connected; }));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_command_stream)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(reply);
+    RedisAsyncClient redis(ioService);
+    std::vector<std::string> events;
+    std::vector<std::string> elements;
+
+    connect(ioService, redis, server);
+
+    redis.commandStream("LRANGE", {"list", "0", "10"}, 4,
+        [&](std::vector<RedisValue> chunk) {
+            events.push_back("chunk " + std::to_string(chunk.size()));
+
+            for(const RedisValue &value: chunk)
+                elements.push_back(value.toString());
+        },
+        [&](RedisValue value) {
+            // the elements are not collected
+            BOOST_CHECK(value.isArray());
+            BOOST_CHECK(value.getArray().empty());
+            events.push_back("done");
+        });
+
+    // queued behind the streamed reply
+    redis.command("ECHO", {"next"}, [&](RedisValue value) {
+        events.push_back("next " + value.toString());
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return events.size() == 5; }));
+
+    BOOST_CHECK(events == std::vector<std::string>({"chunk 4", "chunk 4", "chunk 2",
+                "done", "next next"}));
+    BOOST_REQUIRE_EQUAL(elements.size(), 10u);
+
+    for(size_t i = 0; i < elements.size(); ++i)
+        BOOST_CHECK_EQUAL(elements[i], std::to_string(i));
+}
+
+BOOST_AUTO_TEST_CASE(test_command_stream_not_array)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(reply);
+    RedisAsyncClient redis(ioService);
+    size_t chunks = 0;
+    std::vector<std::string> replies;
+
+    connect(ioService, redis, server);
+
+    redis.commandStream("ERR", {"wrong type"}, 4,
+        [&](std::vector<RedisValue>) { ++chunks; },
+        [&](RedisValue value) {
+            BOOST_CHECK(value.isError());
+            replies.push_back(value.toString());
+        });
+
+    // an empty array has no chunks
+    redis.commandStream("LRANGE", {"list", "0", "0"}, 4,
+        [&](std::vector<RedisValue>) { ++chunks; },
+        [&](RedisValue value) {
+            BOOST_CHECK(value.isArray());
+            replies.push_back("empty");
+        });
+
+    // the next reply is not streamed
+    redis.command("LRANGE", {"list", "0", "2"}, [&](RedisValue value) {
+        BOOST_REQUIRE(value.isArray());
+        BOOST_CHECK_EQUAL(value.getArray().size(), 2u);
+        replies.push_back("array");
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies.size() == 3; }));
+
+    BOOST_CHECK_EQUAL(chunks, 0u);
+    BOOST_CHECK(replies == std::vector<std::string>({"ERR wrong type", "empty", "array"}));
+}
+
+BOOST_AUTO_TEST_CASE(test_command_to_sink)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(reply);
+    RedisAsyncClient redis(ioService);
+    const size_t size = 3 * 1024 * 1024 + 7;
+    std::string received;
+    size_t chunks = 0;
+    std::vector<std::string> replies;
+
+    connect(ioService, redis, server);
+
+    redis.commandToSink("GET", {std::to_string(size)},
+        [&](const char *data, size_t dataSize) {
+            received.append(data, dataSize);
+            ++chunks;
+        },
+        [&](RedisValue value) {
+            BOOST_CHECK(value.isString());
+            BOOST_CHECK(value.toString().empty());
+            replies.push_back("done");
+        });
+
+    // not sunk
+    redis.command("GET", {"5"}, [&](RedisValue value) {
+        replies.push_back(value.toString());
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies.size() == 2; }));
+
+    // split across several reads
+    BOOST_CHECK_GT(chunks, 1u);
+    BOOST_CHECK(received == StandInServer::payload(size));
+    BOOST_CHECK(replies == std::vector<std::string>({"done", StandInServer::payload(5)}));
+}
+
+BOOST_AUTO_TEST_CASE(test_command_to_sink_not_bulk)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(reply);
+    RedisAsyncClient redis(ioService);
+    size_t chunks = 0;
+    std::vector<RedisValue> replies;
+
+    connect(ioService, redis, server);
+
+    redis.commandToSink("GET", {"nil"},
+        [&](const char *, size_t) { ++chunks; },
+        [&](RedisValue value) { replies.push_back(value); });
+    redis.commandToSink("ERR", {"no such key"},
+        [&](const char *, size_t) { ++chunks; },
+        [&](RedisValue value) { replies.push_back(value); });
+    redis.command("GET", {"3"}, [&](RedisValue value) { replies.push_back(value); });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies.size() == 3; }));
+
+    BOOST_CHECK_EQUAL(chunks, 0u);
+    BOOST_CHECK(replies[0].isNull());
+    BOOST_CHECK(replies[1].isError());
+    BOOST_CHECK_EQUAL(replies[1].toString(), "ERR no such key");
+    BOOST_CHECK_EQUAL(replies[2].toString(), StandInServer::payload(3));
+}
+
+BOOST_AUTO_TEST_CASE(test_output_buffer_limit)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(reply);
+    RedisAsyncClient redis(ioService);
+    const size_t count = 300;
+    std::vector<std::string> values;
+    std::vector<std::string> replies;
+
+    // a few commands fit to the output buffer, the rest are queued one by one
+    redis.setMaxWriteBufferSize(1024);
+    connect(ioService, redis, server);
+
+    for(size_t round = 0; round < 2; ++round)
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            // every 10th argument is big, written from its own memory
+            size_t size = i % 10 == 0 ? 20 * 1024 + i : 100 + i;
+
+            values.push_back(std::to_string(i) + StandInServer::payload(size));
+            redis.command("ECHO", {values.back()}, [&](RedisValue value) {
+                replies.push_back(value.toString());
+            });
+        }
+
+        // the next round is queued while the first one is written
+        ioService.poll();
+        ioService.reset();
+    }
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies.size() == values.size(); }));
+
+    for(size_t i = 0; i < values.size(); ++i)
+        BOOST_REQUIRE(replies[i] == values[i]);
+
+    BOOST_CHECK_EQUAL(redis.queueDepth(), 0u);
+}
+
+namespace
+{
+    // Counts commands received by the stand-in server.
+    class CountingServer
+    {
+    public:
+        CountingServer()
+            : received(0), server([this](const std::vector<std::string> &command) {
+                ++received;
+                return reply(command);
+            })
+        {
+        }
+
+        std::atomic<size_t> received;
+        StandInServer server;
+    };
+}
+
+BOOST_AUTO_TEST_CASE(test_cork_commands)
+{
+    boost::asio::io_service ioService;
+    CountingServer counting;
+    RedisAsyncClient redis(ioService);
+    size_t replies = 0;
+
+    connect(ioService, redis, counting.server);
+    redis.cork(5, 1024 * 1024, boost::posix_time::seconds(10));
+
+    for(int i = 0; i < 4; ++i)
+        redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+
+    runFor(ioService, std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(counting.received, 0u);
+
+    // the 5th command sends the batch
+    redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 5; }));
+    BOOST_CHECK_EQUAL(counting.received, 5u);
+}
+
+BOOST_AUTO_TEST_CASE(test_cork_bytes)
+{
+    boost::asio::io_service ioService;
+    CountingServer counting;
+    RedisAsyncClient redis(ioService);
+    const std::string value = StandInServer::payload(100);
+    size_t replies = 0;
+
+    connect(ioService, redis, counting.server);
+    // two commands are under the limit, three are over it
+    redis.cork(1000, 256, boost::posix_time::seconds(10));
+
+    for(int i = 0; i < 2; ++i)
+        redis.command("ECHO", {value}, [&](RedisValue) { ++replies; });
+
+    runFor(ioService, std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(counting.received, 0u);
+
+    redis.command("ECHO", {value}, [&](RedisValue) { ++replies; });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 3; }));
+    BOOST_CHECK_EQUAL(counting.received, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(test_cork_delay)
+{
+    boost::asio::io_service ioService;
+    CountingServer counting;
+    RedisAsyncClient redis(ioService);
+    size_t replies = 0;
+
+    connect(ioService, redis, counting.server);
+    redis.cork(1000, 1024 * 1024, boost::posix_time::milliseconds(200));
+
+    auto start = std::chrono::steady_clock::now();
+
+    redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+    runFor(ioService, std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(counting.received, 0u);
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 1; }));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(200));
+}
+
+BOOST_AUTO_TEST_CASE(test_cork_delay_restarts)
+{
+    boost::asio::io_service ioService;
+    CountingServer counting;
+    RedisAsyncClient redis(ioService);
+    size_t replies = 0;
+
+    connect(ioService, redis, counting.server);
+    redis.cork(3, 1024 * 1024, boost::posix_time::milliseconds(300));
+
+    // the first command schedules the flush, the batch is sent by the
+    // limit before the delay
+    redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+    runFor(ioService, std::chrono::milliseconds(10));
+
+    for(int i = 0; i < 2; ++i)
+        redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 3; }));
+
+    // the delay of the sent batch does not apply to the next one
+    runFor(ioService, std::chrono::milliseconds(150));
+
+    auto start = std::chrono::steady_clock::now();
+
+    redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+    runFor(ioService, std::chrono::milliseconds(250));
+    BOOST_CHECK_EQUAL(counting.received, 3u);
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 4; }));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(300));
+}
+
+BOOST_AUTO_TEST_CASE(test_cork_flush)
+{
+    boost::asio::io_service ioService;
+    CountingServer counting;
+    RedisAsyncClient redis(ioService);
+    size_t replies = 0;
+
+    connect(ioService, redis, counting.server);
+    redis.cork(1000, 1024 * 1024, boost::posix_time::seconds(10));
+
+    for(int i = 0; i < 2; ++i)
+        redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+
+    redis.flush();
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 2; }));
+
+    // the next commands wait again
+    redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+    runFor(ioService, std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(counting.received, 2u);
+
+    // uncork flushes
+    redis.uncork();
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 3; }));
+
+    redis.command("ECHO", {"x"}, [&](RedisValue) { ++replies; });
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 4; }));
+}
+
+BOOST_AUTO_TEST_CASE(test_disconnect_drops_queued)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(reply);
+    RedisAsyncClient redis(ioService);
+    std::string result;
+
+    connect(ioService, redis, server);
+    redis.cork(1000, 1024 * 1024, boost::posix_time::seconds(10));
+
+    // held by the cork when the connection is closed
+    redis.command("ECHO", {"old"}, [](RedisValue) { BOOST_ERROR("replied after disconnect"); });
+    runFor(ioService, std::chrono::milliseconds(20));
+    redis.disconnect();
+
+    // not written on the next connection, where its reply would go to the
+    // handler of the next command
+    connect(ioService, redis, server);
+    redis.command("ECHO", {"new"}, [&](RedisValue value) { result = value.toString(); });
+    runFor(ioService, std::chrono::milliseconds(20));
+    redis.uncork();
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return result.empty() == false; }));
+    BOOST_CHECK_EQUAL(result, "new");
+}
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/redisclientpool.h>
+#include <redisclient/redissyncclientpool.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_ClientPool
+
+#include <boost/test/unit_test.hpp>
+
+#include "standinserver.h"
+
+using namespace redisclient;
+
+namespace
+{
+    // Answers PING on every connection but the first one, which never
+    // replies.
+    std::string pong(size_t connection, const std::vector<std::string> &)
+    {
+        return connection == 0 ? std::string() : StandInServer::status("PONG");
+    }
+
+    // Run the io_service until the condition is true, false on timeout.
+    template<typename Condition>
+    bool runUntil(boost::asio::io_service &ioService, Condition condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+        while( !condition() )
+        {
+            if( std::chrono::steady_clock::now() > deadline )
+                return false;
+
+            ioService.poll();
+            ioService.reset();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    std::vector<size_t> queueDepths(const RedisClientPool &pool)
+    {
+        std::vector<size_t> result;
+
+        for(size_t i = 0; i < pool.size(); ++i)
+            result.push_back(pool.queueDepth(i));
+
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_least_outstanding)
+{
+    boost::asio::io_service ioService;
+    StandInServer server(pong);
+    RedisClientPool pool(ioService, 3);
+    bool connected = false;
+    size_t replies = 0;
+
+    pool.connect(server.endpoint(), [&](boost::system::error_code ec) {
+        BOOST_REQUIRE(!ec);
+        connected = true;
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return connected; }));
+    BOOST_CHECK(pool.isConnected());
+
+    // spread over all connections
+    for(int i = 0; i < 6; ++i)
+        pool.command("PING", {}, [&](RedisValue value) {
+            BOOST_CHECK_EQUAL(value.toString(), "PONG");
+            ++replies;
+        });
+
+    BOOST_CHECK(queueDepths(pool) == std::vector<size_t>({2, 2, 2}));
+
+    // the first connection is stuck, the others are replied
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == 4; }));
+    BOOST_CHECK(queueDepths(pool) == std::vector<size_t>({0, 0, 2}));
+
+    // commands go around the stuck connection
+    for(size_t i = 5; i < 25; ++i)
+    {
+        pool.command("PING", {}, [&](RedisValue) { ++replies; });
+        BOOST_REQUIRE(runUntil(ioService, [&]() { return replies == i; }));
+    }
+
+    BOOST_CHECK(queueDepths(pool) == std::vector<size_t>({0, 0, 2}));
+
+    pool.disconnect();
+    BOOST_CHECK(queueDepths(pool) == std::vector<size_t>({0, 0, 0}));
+}
+
+BOOST_AUTO_TEST_CASE(test_least_loaded_skips_subscribed)
+{
+    boost::asio::io_service ioService;
+    StandInServer server([](const std::vector<std::string> &command) {
+        if( command.front() == "subscribe" )
+        {
+            return StandInServer::array({StandInServer::bulk("subscribe"),
+                    StandInServer::bulk(command.back()), StandInServer::integer(1)});
+        }
+
+        return StandInServer::status("PONG");
+    });
+    RedisClientPool pool(ioService, 2);
+    bool connected = false;
+    bool subscribed = false;
+
+    pool.connect(server.endpoint(), [&](boost::system::error_code ec) {
+        BOOST_REQUIRE(!ec);
+        connected = true;
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return connected; }));
+
+    pool.connection(0).subscribe("channel", [](std::vector<char>) {},
+            [&](RedisValue) { subscribed = true; });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return subscribed; }));
+    BOOST_REQUIRE(pool.connection(0).state() == RedisAsyncClient::State::Subscribed);
+    BOOST_REQUIRE_EQUAL(pool.queueDepth(0), 0u);
+
+    // as idle as the other one, but in subscribed mode
+    for(int i = 0; i < 4; ++i)
+        BOOST_CHECK(&pool.leastLoaded() == &pool.connection(1));
+
+    pool.disconnect();
+}
+
+BOOST_AUTO_TEST_CASE(test_sync_checkout)
+{
+    boost::asio::io_service ioService;
+    RedisSyncClientPool pool(ioService, 2);
+
+    BOOST_CHECK_EQUAL(pool.size(), 2u);
+    BOOST_CHECK_EQUAL(pool.available(), 2u);
+
+    RedisSyncClientPool::Lease first = pool.checkout();
+    RedisSyncClientPool::Lease second = pool.tryCheckout();
+
+    BOOST_REQUIRE(first);
+    BOOST_REQUIRE(second);
+    BOOST_CHECK(&*first != &*second);
+    BOOST_CHECK_EQUAL(pool.available(), 0u);
+    BOOST_CHECK(!pool.tryCheckout());
+
+    // moved leases check in once
+    RedisSyncClientPool::Lease moved = std::move(first);
+
+    BOOST_CHECK(!first);
+    moved.checkin();
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+    first.checkin();
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+
+    {
+        RedisSyncClientPool::Lease third = pool.checkout();
+        BOOST_CHECK_EQUAL(pool.available(), 0u);
+    }
+
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_sync_checkout_waits)
+{
+    boost::asio::io_service ioService;
+    RedisSyncClientPool pool(ioService, 1);
+    RedisSyncClientPool::Lease lease = pool.checkout();
+    RedisSyncClient *client = &*lease;
+    std::atomic<RedisSyncClient *> checkedOut(nullptr);
+
+    std::thread thread([&]() {
+        RedisSyncClientPool::Lease other = pool.checkout();
+
+        checkedOut = &*other;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(checkedOut == nullptr);
+
+    lease.checkin();
+    thread.join();
+
+    BOOST_CHECK(checkedOut == client);
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_sync_checkin_after_timeout)
+{
+    StandInServer server([](const std::vector<std::string> &command) {
+        if( command.front() == "SLOW" )
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return StandInServer::status("SLOW");
+        }
+
+        return StandInServer::status("PONG");
+    });
+    boost::asio::io_service ioService;
+    RedisSyncClientPool pool(ioService, 1);
+
+    pool.connect(server.endpoint());
+
+    {
+        RedisSyncClientPool::Lease lease = pool.checkout();
+        boost::system::error_code ec;
+
+        lease->setCommandTimeout(boost::posix_time::milliseconds(50));
+        lease->command("SLOW", {}, ec);
+        BOOST_CHECK(ec == boost::asio::error::timed_out);
+        BOOST_CHECK(!lease->isConnected());
+    }
+
+    // checked in closed, connected again by the next borrower, which
+    // does not read the late reply
+    BOOST_CHECK(pool.connection(0).state() == RedisSyncClient::State::Closed);
+
+    RedisSyncClientPool::Lease lease = pool.checkout();
+
+    BOOST_REQUIRE(lease->isConnected());
+    lease->setCommandTimeout(boost::posix_time::seconds(5));
+    BOOST_CHECK_EQUAL(lease->command("PING", {}).toString(), "PONG");
+}
+
+BOOST_AUTO_TEST_CASE(test_sync_checkout_reconnect_failed)
+{
+    std::unique_ptr<StandInServer> server(new StandInServer(
+                [](const std::vector<std::string> &command) {
+        if( command.front() == "SLOW" )
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        return StandInServer::status("PONG");
+    }));
+    boost::asio::io_service ioService;
+    RedisSyncClientPool pool(ioService, 1);
+    boost::system::error_code ec;
+
+    pool.connect(server->endpoint());
+
+    {
+        RedisSyncClientPool::Lease lease = pool.checkout();
+
+        lease->setCommandTimeout(boost::posix_time::milliseconds(50));
+        lease->command("SLOW", {}, ec);
+        BOOST_CHECK(ec == boost::asio::error::timed_out);
+    }
+
+    // nothing listens on the port any more
+    server.reset();
+
+    RedisSyncClientPool::Lease lease = pool.checkout(ec);
+
+    BOOST_CHECK(ec);
+    BOOST_CHECK(!lease);
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+
+    lease = pool.tryCheckout(ec);
+
+    BOOST_CHECK(ec);
+    BOOST_CHECK(!lease);
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+
+    BOOST_CHECK_THROW(pool.checkout(), boost::system::system_error);
+    BOOST_CHECK_EQUAL(pool.available(), 1u);
+}
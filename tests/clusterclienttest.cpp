@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/clusterpipeline.h>
+#include <redisclient/redisclusterclient.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_ClusterClient
+
+#include <boost/test/unit_test.hpp>
+
+#include "standinserver.h"
+
+using namespace redisclient;
+
+namespace
+{
+    // Cluster of two stand-in nodes, "a" owns the lower half of the slots
+    // and "b" the upper one. GET replies with the name of the node and
+    // the key, or redirects to the owner of the slot.
+    class StandInCluster
+    {
+    public:
+        StandInCluster()
+            : owner(detail::hashSlots, 0), migrating(detail::hashSlots, false),
+            slotsRequests(0), moved(0), asked(0), commands(0),
+            a([this](const std::vector<std::string> &command) { return handle(0, command); }),
+            b([this](const std::vector<std::string> &command) { return handle(1, command); })
+        {
+            std::fill(owner.begin() + detail::hashSlots / 2, owner.end(), 1);
+            asking[0] = asking[1] = false;
+            muted[0] = muted[1] = false;
+        }
+
+        boost::asio::ip::tcp::endpoint endpoint(size_t node) const
+        {
+            return node == 0 ? a.endpoint() : b.endpoint();
+        }
+
+        // The slot is moved to the node for good.
+        void move(size_t slot, size_t node)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            owner[slot] = node;
+        }
+
+        // The slot is being moved to the other node, see ASK.
+        void migrate(size_t slot)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            migrating[slot] = true;
+        }
+
+        // The node reads the commands but does not reply.
+        void mute(size_t node, bool mute)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            muted[node] = mute;
+        }
+
+        // The node closes its connections.
+        void drop(size_t node)
+        {
+            if( node == 0 )
+                a.dropConnections();
+            else
+                b.dropConnections();
+        }
+
+        size_t counter(const size_t &value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return value;
+        }
+
+        std::vector<size_t> owner;
+        std::vector<bool> migrating;
+        size_t slotsRequests;
+        size_t moved;
+        size_t asked;
+        size_t commands;
+
+    private:
+        std::string address(size_t node) const
+        {
+            return "127.0.0.1:" + std::to_string(endpoint(node).port());
+        }
+
+        std::string slots() const
+        {
+            std::vector<std::string> ranges;
+
+            for(size_t start = 0; start < owner.size();)
+            {
+                size_t end = start;
+
+                while( end + 1 < owner.size() && owner[end + 1] == owner[start] )
+                    ++end;
+
+                ranges.push_back(StandInServer::array({
+                    StandInServer::integer(start), StandInServer::integer(end),
+                    StandInServer::array({
+                        StandInServer::bulk("127.0.0.1"),
+                        StandInServer::integer(endpoint(owner[start]).port()),
+                        StandInServer::bulk("node" + std::to_string(owner[start]))
+                    })
+                }));
+
+                start = end + 1;
+            }
+
+            return StandInServer::array(ranges);
+        }
+
+        std::string handle(size_t node, const std::vector<std::string> &command)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            ++commands;
+
+            if( muted[node] )
+                return std::string();
+            else if( command[0] == "CLUSTER" && command[1] == "SLOTS" )
+            {
+                ++slotsRequests;
+                return slots();
+            }
+            else if( command[0] == "ASKING" )
+            {
+                asking[node] = true;
+                return StandInServer::status("OK");
+            }
+
+            size_t slot = detail::hashSlot(command[1]);
+            bool wasAsking = asking[node];
+            std::string reply = StandInServer::bulk((node == 0 ? "a:" : "b:") + command[1]);
+
+            asking[node] = false;
+
+            if( owner[slot] == node && migrating[slot] )
+            {
+                ++asked;
+                return StandInServer::error("ASK " + std::to_string(slot) + " " +
+                        address(1 - node));
+            }
+            else if( owner[slot] == node || (migrating[slot] && wasAsking) )
+            {
+                return reply;
+            }
+            else
+            {
+                ++moved;
+                return StandInServer::error("MOVED " + std::to_string(slot) + " " +
+                        address(owner[slot]));
+            }
+        }
+
+        std::mutex mutex;
+        bool asking[2];
+        bool muted[2];
+        StandInServer a;
+        StandInServer b;
+    };
+
+    // Run the io_service until the condition is true, false on timeout.
+    template<typename Condition>
+    bool runUntil(boost::asio::io_service &ioService, Condition condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+        while( !condition() )
+        {
+            if( std::chrono::steady_clock::now() > deadline )
+                return false;
+
+            ioService.poll();
+            ioService.reset();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return true;
+    }
+
+    void connect(boost::asio::io_service &ioService, RedisClusterClient &redis,
+                 const StandInCluster &cluster)
+    {
+        bool connected = false;
+
+        redis.connect(cluster.endpoint(0), [&](boost::system::error_code ec) {
+            BOOST_REQUIRE(!ec);
+            connected = true;
+        });
+
+        BOOST_REQUIRE(runUntil(ioService, [&]() { return connected; }));
+        BOOST_REQUIRE(redis.isConnected());
+    }
+
+    std::string get(boost::asio::io_service &ioService, RedisClusterClient &redis,
+                    const std::string &key)
+    {
+        std::string result;
+
+        redis.command("GET", {key}, [&](RedisValue value) { result = value.toString(); });
+        BOOST_REQUIRE(runUntil(ioService, [&]() { return result.empty() == false; }));
+
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_hash_slot)
+{
+    BOOST_CHECK_EQUAL(detail::crc16("123456789", 9), 0x31c3);
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("foo"), 12182u);
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("bar"), 5061u);
+
+    // only the hash tag is hashed
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("{user1000}.following"),
+            RedisClusterClient::keySlot("user1000"));
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("{user1000}.followers"),
+            RedisClusterClient::keySlot("user1000"));
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("foo{bar}{zap}"),
+            RedisClusterClient::keySlot("bar"));
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("foo{{bar}}zap"),
+            RedisClusterClient::keySlot("{bar"));
+
+    // an empty tag does not count
+    BOOST_CHECK_EQUAL(RedisClusterClient::keySlot("foo{}{bar}"),
+            detail::crc16("foo{}{bar}", 10) % detail::hashSlots);
+}
+
+BOOST_AUTO_TEST_CASE(test_slot_map)
+{
+    boost::asio::io_service ioService;
+    StandInCluster cluster;
+    RedisClusterClient redis(ioService);
+
+    connect(ioService, redis, cluster);
+
+    BOOST_CHECK_EQUAL(redis.nodes(), 2u);
+    BOOST_CHECK(redis.slotNode(0) == cluster.endpoint(0));
+    BOOST_CHECK(redis.slotNode(detail::hashSlots - 1) == cluster.endpoint(1));
+
+    // replies of different nodes are not ordered
+    std::vector<std::string> replies(100);
+    size_t count = 0;
+
+    for(size_t i = 0; i < replies.size(); ++i)
+    {
+        redis.command("GET", {"key:" + std::to_string(i)}, [&, i](RedisValue value) {
+            replies[i] = value.toString();
+            ++count;
+        });
+    }
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return count == replies.size(); }));
+
+    // every key is sent to its node at once
+    for(size_t i = 0; i < 100; ++i)
+    {
+        std::string key = "key:" + std::to_string(i);
+        const char *node = RedisClusterClient::keySlot(key) < detail::hashSlots / 2 ? "a:" : "b:";
+
+        BOOST_CHECK_EQUAL(replies[i], node + key);
+    }
+
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.moved), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_moved)
+{
+    boost::asio::io_service ioService;
+    StandInCluster cluster;
+    RedisClusterClient redis(ioService);
+    const size_t slot = RedisClusterClient::keySlot("foo");
+
+    connect(ioService, redis, cluster);
+    BOOST_CHECK(redis.slotNode(slot) == cluster.endpoint(1));
+
+    cluster.move(slot, 0);
+
+    BOOST_CHECK_EQUAL(get(ioService, redis, "foo"), "a:foo");
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.moved), 1u);
+    BOOST_CHECK(redis.slotNode(slot) == cluster.endpoint(0));
+
+    // the table is reloaded
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return cluster.counter(cluster.slotsRequests) == 2; }));
+
+    BOOST_CHECK_EQUAL(get(ioService, redis, "foo"), "a:foo");
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.moved), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(test_ask)
+{
+    boost::asio::io_service ioService;
+    StandInCluster cluster;
+    RedisClusterClient redis(ioService);
+    const size_t slot = RedisClusterClient::keySlot("bar");
+
+    connect(ioService, redis, cluster);
+    BOOST_CHECK(redis.slotNode(slot) == cluster.endpoint(0));
+
+    cluster.migrate(slot);
+
+    BOOST_CHECK_EQUAL(get(ioService, redis, "bar"), "b:bar");
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.asked), 1u);
+
+    // the slot stays with its node until it is moved
+    BOOST_CHECK(redis.slotNode(slot) == cluster.endpoint(0));
+    BOOST_CHECK_EQUAL(get(ioService, redis, "bar"), "b:bar");
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.asked), 2u);
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.moved), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_node_dropped)
+{
+    boost::asio::io_service ioService;
+    StandInCluster cluster;
+    RedisClusterClient redis(ioService);
+    std::vector<std::string> errors;
+    std::vector<RedisValue> replies;
+    boost::system::error_code refreshed;
+    bool refreshDone = false;
+
+    redis.installErrorHandler([&](const std::string &error) { errors.push_back(error); });
+    connect(ioService, redis, cluster);
+    cluster.mute(0, true);
+
+    // by the only connected node, "a"
+    redis.refreshSlots([&](boost::system::error_code ec) {
+        refreshed = ec;
+        refreshDone = true;
+    });
+
+    for(int i = 0; i < 2; ++i)
+        redis.command("GET", {"bar"}, [&](RedisValue value) { replies.push_back(value); });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return cluster.counter(cluster.commands) == 4; }));
+    cluster.drop(0);
+
+    // replied with the error of the connection, not left waiting
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return refreshDone && replies.size() == 2; }));
+    BOOST_CHECK(refreshed);
+    BOOST_CHECK_EQUAL(errors.size(), 1u);
+
+    for(const RedisValue &value: replies)
+    {
+        BOOST_CHECK(value.isError());
+        BOOST_CHECK_EQUAL(value.toString().compare(0, 17, "ERR cluster node "), 0);
+    }
+
+    // connected again on next use, the next refresh is not held back
+    cluster.mute(0, false);
+    BOOST_CHECK_EQUAL(get(ioService, redis, "bar"), "a:bar");
+
+    refreshDone = false;
+    redis.refreshSlots([&](boost::system::error_code ec) {
+        refreshed = ec;
+        refreshDone = true;
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return refreshDone; }));
+    BOOST_CHECK(!refreshed);
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline)
+{
+    boost::asio::io_service ioService;
+    StandInCluster cluster;
+    RedisClusterClient redis(ioService);
+    ClusterPipeline pipe = redis.pipelined();
+    const size_t slot = RedisClusterClient::keySlot("key:7");
+    RedisValue result;
+    bool done = false;
+
+    connect(ioService, redis, cluster);
+    cluster.move(slot, slot < detail::hashSlots / 2 ? 1 : 0);
+
+    for(size_t i = 0; i < 500; ++i)
+        pipe.command("GET", "key:" + std::to_string(i));
+
+    pipe.finish([&](RedisValue value) {
+        result = std::move(value);
+        done = true;
+    });
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return done; }));
+    BOOST_REQUIRE(result.isArray());
+    BOOST_REQUIRE_EQUAL(result.getArray().size(), 500u);
+
+    // replies in order of the commands, "key:7" by the node it moved to
+    for(size_t i = 0; i < 500; ++i)
+    {
+        std::string key = "key:" + std::to_string(i);
+        bool lower = RedisClusterClient::keySlot(key) < detail::hashSlots / 2;
+
+        if( i == 7 )
+            lower = !lower;
+
+        BOOST_CHECK_EQUAL(result.getArray()[i].toString(), (lower ? "a:" : "b:") + key);
+    }
+
+    BOOST_CHECK_EQUAL(cluster.counter(cluster.moved), 1u);
+
+    // an empty pipeline replies with an empty array
+    done = false;
+    pipe.finish([&](RedisValue value) {
+        result = std::move(value);
+        done = true;
+    });
+
+    BOOST_CHECK(done);
+    BOOST_CHECK(result.isArray() && result.getArray().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline_before_connect)
+{
+    boost::asio::io_service ioService;
+    RedisClusterClient redis(ioService);
+    ClusterPipeline pipe = redis.pipelined();
+    RedisValue result;
+    bool done = false;
+
+    pipe.command("GET", "foo");
+    pipe.finish([&](RedisValue value) {
+        result = std::move(value);
+        done = true;
+    });
+
+    BOOST_REQUIRE(done);
+    BOOST_CHECK(result.isError());
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline_node_dropped)
+{
+    boost::asio::io_service ioService;
+    StandInCluster cluster;
+    RedisClusterClient redis(ioService);
+    ClusterPipeline pipe = redis.pipelined();
+    std::vector<std::string> keys;
+    RedisValue result;
+    bool done = false;
+
+    redis.installErrorHandler([](const std::string &) {});
+    connect(ioService, redis, cluster);
+    cluster.mute(1, true);
+
+    for(size_t i = 0; i < 20; ++i)
+    {
+        keys.push_back("key:" + std::to_string(i));
+        pipe.command("GET", keys.back());
+    }
+
+    pipe.finish([&](RedisValue value) {
+        result = std::move(value);
+        done = true;
+    });
+
+    // "b" reads its commands and drops the connection instead of replying,
+    // the first command was CLUSTER SLOTS
+    BOOST_REQUIRE(runUntil(ioService, [&]() {
+        return cluster.counter(cluster.commands) == 1 + keys.size();
+    }));
+    cluster.drop(1);
+
+    BOOST_REQUIRE(runUntil(ioService, [&]() { return done; }));
+    BOOST_REQUIRE(result.isArray());
+    BOOST_REQUIRE_EQUAL(result.getArray().size(), keys.size());
+
+    // the commands of "a" are replied, those of "b" fail
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        const RedisValue &value = result.getArray()[i];
+
+        if( RedisClusterClient::keySlot(keys[i]) < detail::hashSlots / 2 )
+            BOOST_CHECK_EQUAL(value.toString(), "a:" + keys[i]);
+        else
+            BOOST_CHECK(value.isError());
+    }
+}
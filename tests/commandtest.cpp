@@ -0,0 +1,186 @@
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/range/iterator_range.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <redisclient/impl/rediscommand.h>
+#include <redisclient/rediscommandencoder.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_RedisCommand
+
+#include <boost/test/unit_test.hpp>
+
+using namespace redisclient;
+using namespace redisclient::detail;
+
+namespace
+{
+    std::string format(uint64_t value)
+    {
+        std::string result(decimalLength(value), '\0');
+        char *end = formatDecimal(&result[0], value, result.size());
+
+        BOOST_CHECK(end == &result[0] + result.size());
+        return result;
+    }
+
+    std::string encode(const RedisArguments &items)
+    {
+        std::vector<char> buffer;
+
+        appendCommand(buffer, items);
+        BOOST_CHECK_EQUAL(buffer.size(), commandSize(items));
+
+        return std::string(buffer.begin(), buffer.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_format_decimal)
+{
+    const uint64_t values[] = {0, 1, 9, 10, 99, 100, 999, 1000, 9999,
+        10000, 12345, 99999, 100000, 1234567890, UINT64_MAX};
+
+    for(uint64_t value: values)
+    {
+        BOOST_CHECK_EQUAL(format(value), std::to_string(value));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_command)
+{
+    BOOST_CHECK_EQUAL(encode({"GET", "foo"}),
+            "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n");
+    BOOST_CHECK_EQUAL(encode({"SET", std::string("key"), std::vector<char>(12, 'x')}),
+            "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$12\r\nxxxxxxxxxxxx\r\n");
+    BOOST_CHECK_EQUAL(encode({"ECHO", ""}),
+            "*2\r\n$4\r\nECHO\r\n$0\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_append_command)
+{
+    std::vector<char> buffer;
+
+    appendCommand(buffer, RedisArguments{"PING"});
+    appendCommand(buffer, RedisArguments{"GET", "foo"});
+
+    BOOST_CHECK_EQUAL(std::string(buffer.begin(), buffer.end()),
+            "*1\r\n$4\r\nPING\r\n*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_splice_command)
+{
+    const std::string value(spliceThreshold, 'x');
+    RedisArguments items{"SET", "foo", value};
+    std::vector<char> buffer;
+    std::vector<Splice> splices;
+
+    appendCommand(buffer, splices, items);
+
+    // the value is not copied to the buffer
+    BOOST_CHECK_EQUAL(buffer.size(), commandSize(items, spliceThreshold));
+    BOOST_REQUIRE_EQUAL(splices.size(), 1);
+    BOOST_CHECK_EQUAL(splices[0].size, value.size());
+    BOOST_CHECK(splices[0].ptr == boost::get<std::string>(items[2].data).data());
+
+    std::vector<boost::asio::const_buffer> buffers;
+    std::string result;
+
+    gatherBuffers(buffer, splices, buffers);
+    BOOST_REQUIRE_EQUAL(buffers.size(), 3);
+
+    for(const boost::asio::const_buffer &item: buffers)
+    {
+        result.append(boost::asio::buffer_cast<const char *>(item),
+                boost::asio::buffer_size(item));
+    }
+
+    BOOST_CHECK(result == encode(items));
+}
+
+BOOST_AUTO_TEST_CASE(test_ref_command)
+{
+    const std::string key = "foo";
+
+    BOOST_CHECK_EQUAL(encode({"GET", boost::string_ref(key)}),
+            "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n");
+    BOOST_CHECK_EQUAL(encode({"GET", boost::string_ref(key.data(), 2)}),
+            "*2\r\n$3\r\nGET\r\n$2\r\nfo\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_refs)
+{
+    std::string key = "foo";
+    RedisArguments items{"GET", boost::string_ref(key)};
+
+    BOOST_CHECK(items[1].isRef());
+
+    copyRefs(items);
+    key = "bar";
+
+    BOOST_CHECK(items[1].isRef() == false);
+    BOOST_CHECK_EQUAL(encode(items), "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_deque_command)
+{
+    std::deque<RedisBuffer> items{"GET", "foo"};
+
+    BOOST_CHECK_EQUAL(encode(items), "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_argument_refs)
+{
+    const std::string key = "foo";
+    const std::vector<char> value{'b', 'a', 'r'};
+    const RedisBuffer option("EX");
+    const boost::string_ref items[] = {argumentRef("SET"), argumentRef(key),
+        argumentRef(value), argumentRef(option)};
+    std::vector<char> buffer;
+
+    BOOST_CHECK((AreArguments<const char (&)[4], std::string, boost::string_ref>::value));
+    BOOST_CHECK((AreArguments<std::string, boost::system::error_code>::value == false));
+
+    appendCommand(buffer, boost::make_iterator_range(items, items + 4));
+    BOOST_CHECK_EQUAL(std::string(buffer.begin(), buffer.end()),
+            "*4\r\n$3\r\nSET\r\n$3\r\nfoo\r\n$3\r\nbar\r\n$2\r\nEX\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_encoder_prefix)
+{
+    typedef detail::CommandPrefix<2, 'G', 'E', 'T'>::type Get;
+    typedef detail::CommandPrefix<12, 'I', 'N', 'C', 'R', 'B', 'Y'>::type IncrBy;
+
+    BOOST_CHECK_EQUAL(std::string(Get::value, Get::size), "*2\r\n$3\r\nGET\r\n");
+    BOOST_CHECK_EQUAL(std::string(IncrBy::value, IncrBy::size), "*12\r\n$6\r\nINCRBY\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_encoder)
+{
+    const std::string key = "foo";
+    std::vector<char> value(20, 'v');
+
+    std::vector<char> get = encoders::Get::encode(key);
+    BOOST_CHECK_EQUAL(std::string(get.begin(), get.end()), encode({"GET", "foo"}));
+
+    std::vector<char> set = encoders::Set::encode("foo", value, boost::string_ref("EX"), 10);
+    BOOST_CHECK_EQUAL(std::string(set.begin(), set.end()), encode({"SET", "foo", value, "EX", "10"}));
+    BOOST_CHECK_EQUAL(encoders::Set::size("foo", value, boost::string_ref("EX"), 10), set.size());
+
+    std::vector<char> incr;
+
+    encoders::IncrBy::append(incr, key, -1234567);
+    encoders::IncrBy::append(incr, key, 0u);
+    encoders::IncrBy::append(incr, key, INT64_MIN);
+    encoders::IncrBy::append(incr, key, UINT64_MAX);
+    BOOST_CHECK_EQUAL(std::string(incr.begin(), incr.end()),
+            encode({"INCRBY", "foo", "-1234567"}) +
+            encode({"INCRBY", "foo", "0"}) +
+            encode({"INCRBY", "foo", std::to_string(INT64_MIN)}) +
+            encode({"INCRBY", "foo", std::to_string(UINT64_MAX)}));
+
+    std::vector<char> ping = RedisCommandEncoder<'P', 'I', 'N', 'G'>::encode();
+    BOOST_CHECK_EQUAL(std::string(ping.begin(), ping.end()), encode({"PING"}));
+}
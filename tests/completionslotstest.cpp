@@ -0,0 +1,146 @@
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <redisclient/impl/completionslots.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_CompletionSlots
+
+#include <boost/test/unit_test.hpp>
+
+using namespace redisclient;
+
+namespace
+{
+    typedef detail::ReplyCallback Callback;
+    typedef detail::CompletionRing<Callback> Ring;
+
+    // Callback which records the value it is called with to the result.
+    Callback recorder(std::vector<int64_t> &result, int64_t offset = 0)
+    {
+        return Callback([&result, offset](RedisValue value) {
+            result.push_back(value.toInt() + offset);
+        });
+    }
+
+    void callFront(Ring &ring, int64_t value)
+    {
+        Callback callback = std::move(ring.front());
+
+        ring.pop();
+        callback(RedisValue(value));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_callback_storage)
+{
+    std::array<char, 128> big = {{0}};
+    std::shared_ptr<int> counter = std::make_shared<int>(0);
+
+    auto small = [counter](RedisValue value) { *counter += value.toInt(); };
+    auto large = [counter, big](RedisValue value) { *counter += value.toInt() + big[0]; };
+
+    BOOST_CHECK(Callback::isInline<decltype(small)>());
+    BOOST_CHECK(Callback::isInline<std::function<void(RedisValue)>>());
+    BOOST_CHECK(!Callback::isInline<decltype(large)>());
+
+    Callback inlineCallback(small);
+    Callback heapCallback(large);
+    Callback empty;
+
+    BOOST_CHECK(inlineCallback);
+    BOOST_CHECK(!empty);
+
+    inlineCallback(RedisValue(1));
+    heapCallback(RedisValue(2));
+    BOOST_CHECK_EQUAL(*counter, 3);
+
+    // moved callbacks keep their captures alive, the moved from are empty
+    Callback moved(std::move(inlineCallback));
+    empty = std::move(heapCallback);
+
+    BOOST_CHECK(!inlineCallback);
+    BOOST_CHECK(!heapCallback);
+
+    moved(RedisValue(10));
+    empty(RedisValue(20));
+    BOOST_CHECK_EQUAL(*counter, 33);
+
+    BOOST_CHECK_EQUAL(counter.use_count(), 5);
+    moved = nullptr;
+    empty = Callback();
+    BOOST_CHECK_EQUAL(counter.use_count(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_ring_fifo)
+{
+    Ring ring(4);
+    std::vector<int64_t> result;
+
+    BOOST_CHECK(ring.empty());
+    BOOST_CHECK_EQUAL(ring.capacity(), 4u);
+
+    // wrap around the end of the slots
+    for(int64_t i = 0; i < 10; ++i)
+    {
+        ring.push(recorder(result));
+        ring.push(recorder(result, 100));
+        callFront(ring, i);
+        callFront(ring, i);
+    }
+
+    BOOST_CHECK(ring.empty());
+    BOOST_CHECK_EQUAL(ring.capacity(), 4u);
+    BOOST_REQUIRE_EQUAL(result.size(), 20u);
+
+    for(int64_t i = 0; i < 10; ++i)
+    {
+        BOOST_CHECK_EQUAL(result[2 * i], i);
+        BOOST_CHECK_EQUAL(result[2 * i + 1], i + 100);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_ring_grow)
+{
+    Ring ring(4);
+    std::vector<int64_t> result;
+
+    // grow while the queued items wrap around
+    ring.push(recorder(result));
+    ring.push(recorder(result));
+    callFront(ring, 0);
+    callFront(ring, 1);
+
+    for(int64_t i = 0; i < 9; ++i)
+        ring.push(recorder(result));
+
+    BOOST_CHECK_EQUAL(ring.size(), 9u);
+    BOOST_CHECK_EQUAL(ring.capacity(), 16u);
+
+    for(int64_t i = 2; i < 11; ++i)
+        callFront(ring, i);
+
+    BOOST_REQUIRE_EQUAL(result.size(), 11u);
+
+    for(int64_t i = 0; i < 11; ++i)
+        BOOST_CHECK_EQUAL(result[i], i);
+}
+
+BOOST_AUTO_TEST_CASE(test_ring_clear)
+{
+    std::shared_ptr<int> counter = std::make_shared<int>(0);
+    Ring ring(2);
+
+    for(int i = 0; i < 3; ++i)
+        ring.push(Callback([counter](RedisValue) { ++*counter; }));
+
+    BOOST_CHECK_EQUAL(counter.use_count(), 4);
+
+    // callbacks are destroyed, the slots are kept
+    ring.clear();
+    BOOST_CHECK(ring.empty());
+    BOOST_CHECK_EQUAL(ring.capacity(), 4u);
+    BOOST_CHECK_EQUAL(counter.use_count(), 1);
+    BOOST_CHECK_EQUAL(*counter, 0);
+}
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <redisclient/redisarena.h>
 #include <redisclient/redisparser.h>
 #include <redisclient/redisvalue.h>
 
@@ -296,3 +297,261 @@ BOOST_FIXTURE_TEST_CASE(test_parser_by_parts, ParserFixture)
     }
 }
 
+class ViewParserFixture
+{
+public:
+    ViewParserFixture()
+        : parser(RedisParser::ViewMode)
+    {
+    }
+
+    RedisValueView parse(const char *str)
+    {
+        BOOST_REQUIRE(parser.parse(str, strlen(str)).second == RedisParser::Completed);
+        return parser.resultView();
+    }
+
+    void parseByPartsTest(const std::string &buf, const RedisValue &expected)
+    {
+        for(size_t partSize = 1; partSize < buf.size(); ++partSize)
+        {
+            std::pair<size_t, RedisParser::ParseResult> pair;
+
+            for(size_t i = 0; i < buf.size(); i+= partSize )
+            {
+                size_t chunkSize = std::min(partSize, buf.size() - i);
+                pair = parser.parse(buf.c_str() + i, chunkSize);
+
+                BOOST_REQUIRE(pair.second != RedisParser::Error);
+                BOOST_REQUIRE_EQUAL(pair.first, chunkSize);
+            }
+
+            BOOST_REQUIRE(pair.second == RedisParser::Completed);
+            BOOST_CHECK(parser.resultView().toRedisValue(buf.c_str()) == expected);
+        }
+    }
+
+    RedisParser parser;
+};
+
+BOOST_FIXTURE_TEST_CASE(test_view_bulk, ViewParserFixture)
+{
+    const char *reply = "$6\r\nfoobar\r\n";
+    RedisValueView view = parse(reply);
+
+    BOOST_CHECK_EQUAL(view.isString(), true);
+    BOOST_CHECK_EQUAL(view.offset(), 4);
+    BOOST_CHECK_EQUAL(view.length(), 6);
+    BOOST_CHECK(view.data(reply) == reply + 4);
+    BOOST_CHECK_EQUAL(view.toString(reply), "foobar");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_view_error, ViewParserFixture)
+{
+    const char *reply = "-Error message\r\n";
+    RedisValueView view = parse(reply);
+
+    BOOST_CHECK_EQUAL(view.isError(), true);
+    BOOST_CHECK_EQUAL(view.toString(reply), "Error message");
+    BOOST_CHECK_EQUAL(view.toRedisValue(reply).isError(), true);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_view_second_reply, ViewParserFixture)
+{
+    const char *replies = "+OK\r\n$3\r\nfoo\r\n";
+    size_t size = strlen(replies);
+
+    std::pair<size_t, RedisParser::ParseResult> pair = parser.parse(replies, size);
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK_EQUAL(parser.resultView().toString(replies), "OK");
+
+    // offsets are relative to the start of the reply
+    const char *second = replies + pair.first;
+    pair = parser.parse(second, size - pair.first);
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK_EQUAL(parser.resultView().toString(second), "foo");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_view_parser_by_parts, ViewParserFixture)
+{
+    parseByPartsTest("+OK\r\n", "OK");
+    parseByPartsTest(":321654987\r\n", 321654987);
+    parseByPartsTest("$6\r\nfoobar\r\n", "foobar");
+    parseByPartsTest("$0\r\n\r\n", "");
+    parseByPartsTest("$-1\r\n",  RedisValue());
+    parseByPartsTest("*0\r\n", std::vector<RedisValue>());
+    parseByPartsTest("*-1\r\n", RedisValue());
+
+    {
+        std::vector<RedisValue> array;
+        std::vector<RedisValue> sub1;
+        std::vector<RedisValue> sub2;
+
+        sub1.push_back(1);
+        sub1.push_back("foo");
+        sub1.push_back(RedisValue());
+
+        sub2.push_back("bar");
+        sub2.push_back("baz");
+
+        array.push_back(sub1);
+        array.push_back(sub2);
+
+        parseByPartsTest("*2\r\n"
+                     "*3\r\n"
+                     ":1\r\n"
+                     "$3\r\n"
+                     "foo\r\n"
+                     "$-1\r\n"
+                     "*2\r\n"
+                     "+bar\r\n"
+                     "$3\r\n"
+                     "baz\r\n", array);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_view_after_error, ViewParserFixture)
+{
+    // an error in the middle of an array, after an incomplete chunk
+    BOOST_CHECK(parser.parse("*2\r\n$3\r\nfoo\r\n", 13).second == RedisParser::Incompleted);
+    BOOST_CHECK(parser.parse("*xx\r\n", 5).second == RedisParser::Error);
+
+    // nothing of the failed reply is left
+    const char *reply = "*2\r\n$3\r\nbar\r\n:1\r\n";
+    RedisValueView view = parse(reply);
+
+    BOOST_CHECK_EQUAL(view.toRedisValue(reply).inspect(), "[bar, 1]");
+
+    BOOST_CHECK(parser.parse("$3\r\nfoo!", 8).second == RedisParser::Error);
+    BOOST_CHECK_EQUAL(parse("$3\r\nbaz\r\n").toString("$3\r\nbaz\r\n"), "baz");
+}
+
+BOOST_FIXTURE_TEST_CASE(test_view_arena, ViewParserFixture)
+{
+    const std::string reply = "*3\r\n"
+        "*2\r\n$3\r\nfoo\r\n:1\r\n"
+        "*2\r\n$3\r\nbar\r\n:2\r\n"
+        "*0\r\n";
+    RedisArena arena;
+
+    parser.setArena(&arena);
+
+    for(size_t i = 0; i < 3; ++i)
+    {
+        {
+            RedisValueView view = parse(reply.c_str());
+
+            BOOST_CHECK(view.getArray().get_allocator().arena == &arena);
+            BOOST_CHECK(view.getArray()[0].getArray().get_allocator().arena == &arena);
+            BOOST_CHECK_EQUAL(view.toRedisValue(reply.c_str()).inspect(), "[[foo, 1], [bar, 2], []]");
+        }
+
+        BOOST_CHECK_EQUAL(arena.blockCount(), 1);
+        arena.release();
+    }
+
+    // the arena does not outlive the test
+    parser.setArena(nullptr);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_stream_next_reply, ParserFixture)
+{
+    const std::string buf = "*3\r\n$3\r\nfoo\r\n*2\r\n:1\r\n:2\r\n$-1\r\n+OK\r\n";
+    std::vector<RedisValue> elements;
+
+    parser.streamNextReply([&](RedisValue value) {
+        elements.push_back(std::move(value));
+    });
+
+    std::pair<size_t, RedisParser::ParseResult> pair;
+
+    // by parts, elements are passed as soon as they are parsed
+    pair = parser.parse(buf.c_str(), 13);
+    BOOST_REQUIRE(pair.second == RedisParser::Incompleted);
+    BOOST_REQUIRE_EQUAL(elements.size(), 1);
+    BOOST_CHECK_EQUAL(elements[0].toString(), "foo");
+
+    pair = parser.parse(buf.c_str() + 13, buf.size() - 13);
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK(parser.result() == std::vector<RedisValue>());
+    BOOST_REQUIRE_EQUAL(elements.size(), 3);
+    BOOST_CHECK(elements[1] == std::vector<RedisValue>({1, 2}));
+    BOOST_CHECK(elements[2].isNull());
+
+    // only the next reply is streamed
+    pair = parser.parse(buf.c_str() + 13 + pair.first, buf.size() - 13 - pair.first);
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK_EQUAL(parser.result().toString(), "OK");
+    BOOST_CHECK_EQUAL(elements.size(), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_sink_next_reply, ParserFixture)
+{
+    const std::string buf = "$10\r\n0123456789\r\n$3\r\nfoo\r\n";
+    std::vector<std::string> chunks;
+
+    parser.sinkNextReply([&](const char *data, size_t size) {
+        chunks.push_back(std::string(data, size));
+    });
+
+    std::pair<size_t, RedisParser::ParseResult> pair;
+
+    // by parts, the payload is passed as it arrives
+    pair = parser.parse(buf.c_str(), 8);
+    BOOST_REQUIRE(pair.second == RedisParser::Incompleted);
+    BOOST_REQUIRE_EQUAL(chunks.size(), 1);
+    BOOST_CHECK_EQUAL(chunks[0], "012");
+
+    pair = parser.parse(buf.c_str() + 8, 5);
+    BOOST_REQUIRE(pair.second == RedisParser::Incompleted);
+    BOOST_REQUIRE_EQUAL(chunks.size(), 2);
+    BOOST_CHECK_EQUAL(chunks[1], "34567");
+
+    pair = parser.parse(buf.c_str() + 13, buf.size() - 13);
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK(parser.result() == std::string());
+    BOOST_REQUIRE_EQUAL(chunks.size(), 3);
+    BOOST_CHECK_EQUAL(chunks[2], "89");
+
+    // only the next reply is passed to the sink
+    size_t pos = 13 + pair.first;
+
+    pair = parser.parse(buf.c_str() + pos, buf.size() - pos);
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK_EQUAL(parser.result().toString(), "foo");
+    BOOST_CHECK_EQUAL(chunks.size(), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_sink_array_reply, ParserFixture)
+{
+    const std::string buf = "*1\r\n$3\r\nfoo\r\n";
+    bool called = false;
+
+    parser.sinkNextReply([&](const char *, size_t) {
+        called = true;
+    });
+
+    std::pair<size_t, RedisParser::ParseResult> pair = parser.parse(buf.c_str(), buf.size());
+
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK(parser.result() == std::vector<RedisValue>({std::string("foo")}));
+    BOOST_CHECK(called == false);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_pending_bulk_size, ParserFixture)
+{
+    const std::string buf = "$10\r\n0123456789\r\n";
+
+    BOOST_CHECK_EQUAL(parser.pendingBulkSize(), 0u);
+
+    std::pair<size_t, RedisParser::ParseResult> pair = parser.parse(buf.c_str(), 8);
+
+    BOOST_REQUIRE(pair.second == RedisParser::Incompleted);
+    BOOST_CHECK_EQUAL(parser.pendingBulkSize(), 9u);
+
+    pair = parser.parse(buf.c_str() + 8, buf.size() - 8);
+
+    BOOST_REQUIRE(pair.second == RedisParser::Completed);
+    BOOST_CHECK_EQUAL(parser.pendingBulkSize(), 0u);
+    BOOST_CHECK_EQUAL(parser.result().toString(), "0123456789");
+}
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
 #include <redisclient/redisvalue.h>
 
@@ -116,3 +118,21 @@ BOOST_AUTO_TEST_CASE(test_get_byte_array_throw_error)
     BOOST_CHECK_THROW(constValue.getByteArray(), boost::bad_get);
 }
 
+
+BOOST_AUTO_TEST_CASE(test_move)
+{
+    // a growing std::vector<RedisValue> moves the values only if it can't throw
+    static_assert(std::is_nothrow_move_constructible<RedisValue>::value, "");
+    static_assert(std::is_nothrow_move_assignable<RedisValue>::value, "");
+
+    RedisValue value(std::vector<RedisValue>{RedisValue(1), RedisValue("two")});
+    RedisValue moved(std::move(value));
+    RedisValue assigned;
+
+    assigned = std::move(moved);
+
+    BOOST_REQUIRE(assigned.isArray());
+    BOOST_REQUIRE_EQUAL(assigned.getArray().size(), 2u);
+    BOOST_CHECK_EQUAL(assigned.getArray()[0].toInt(), 1);
+    BOOST_CHECK_EQUAL(assigned.getArray()[1].toString(), "two");
+}
@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <redisclient/impl/redisscanner.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_RedisScanner
+
+#include <boost/test/unit_test.hpp>
+
+using namespace redisclient::detail;
+
+namespace
+{
+    std::vector<ScanFunction> simpleStringScanners()
+    {
+        std::vector<ScanFunction> result{&scanSimpleStringScalar, &scanSimpleString};
+#ifdef REDIS_CLIENT_HAS_SSE2
+        result.push_back(&scanSimpleStringSse2);
+#endif
+#ifdef REDIS_CLIENT_HAS_AVX2
+        if (cpuHasAvx2())
+            result.push_back(&scanSimpleStringAvx2);
+#endif
+        return result;
+    }
+
+    std::vector<ScanFunction> integerScanners()
+    {
+        std::vector<ScanFunction> result{&scanIntegerScalar, &scanInteger};
+#ifdef REDIS_CLIENT_HAS_SSE2
+        result.push_back(&scanIntegerSse2);
+#endif
+#ifdef REDIS_CLIENT_HAS_AVX2
+        if (cpuHasAvx2())
+            result.push_back(&scanIntegerAvx2);
+#endif
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_scan_simple_string)
+{
+    for(ScanFunction scan: simpleStringScanners())
+    {
+        BOOST_CHECK_EQUAL(scan("OK\r\n", 4), 2);
+        BOOST_CHECK_EQUAL(scan("\r\n", 2), 0);
+        BOOST_CHECK_EQUAL(scan("", 0), 0);
+
+        std::string line(100, 'x');
+
+        for(size_t i = 0; i < line.size(); ++i)
+        {
+            std::string s = line;
+
+            s[i] = '\r';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+            s[i] = '\x7f';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+            s[i] = '\x80';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+            s[i] = '\x1f';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+
+            // scanner must not read past the end
+            BOOST_CHECK_EQUAL(scan(line.data(), i), i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_scan_integer)
+{
+    for(ScanFunction scan: integerScanners())
+    {
+        BOOST_CHECK_EQUAL(scan("123\r\n", 5), 3);
+        BOOST_CHECK_EQUAL(scan("-1\r\n", 4), 2);
+        BOOST_CHECK_EQUAL(scan("\r\n", 2), 0);
+
+        std::string line;
+
+        for(size_t i = 0; i < 100; ++i)
+            line += "0123456789-"[i % 11];
+
+        for(size_t i = 0; i < line.size(); ++i)
+        {
+            std::string s = line;
+
+            s[i] = '\r';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+            s[i] = '/';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+            s[i] = ':';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+            s[i] = '\xb0';
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), i);
+
+            BOOST_CHECK_EQUAL(scan(line.data(), i), i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_scan_all_bytes)
+{
+    for(int c = 0; c < 256; ++c)
+    {
+        std::string s(40, static_cast<char>(c));
+        size_t expectedString = (c >= 0x20 && c < 0x7f) ? s.size() : 0;
+        size_t expectedInteger = ((c >= '0' && c <= '9') || c == '-') ? s.size() : 0;
+
+        for(ScanFunction scan: simpleStringScanners())
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), expectedString);
+        for(ScanFunction scan: integerScanners())
+            BOOST_CHECK_EQUAL(scan(s.data(), s.size()), expectedInteger);
+    }
+}
@@ -0,0 +1,244 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/redisshardedclient.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_ShardedClient
+
+#include <boost/test/unit_test.hpp>
+
+#include "standinserver.h"
+
+using namespace redisclient;
+
+namespace
+{
+    // Replies with the last argument of the command.
+    std::string echoLast(const std::vector<std::string> &command)
+    {
+        return StandInServer::bulk(command.back());
+    }
+
+    // Counts replies from the shards threads.
+    class Replies
+    {
+    public:
+        void add(const std::string &key, const std::string &value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            values[key].push_back(value);
+            ++count;
+            changed.notify_all();
+        }
+
+        bool wait(size_t expected)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            return changed.wait_for(lock, std::chrono::seconds(10),
+                    [this, expected]() { return count == expected; });
+        }
+
+        std::map<std::string, std::vector<std::string>> values;
+
+    private:
+        std::mutex mutex;
+        std::condition_variable changed;
+        size_t count = 0;
+    };
+
+    void connect(RedisShardedClient &redis, const StandInServer &server)
+    {
+        std::mutex mutex;
+        std::condition_variable connected;
+        bool done = false;
+        boost::system::error_code result;
+
+        redis.connect(server.endpoint(), [&](boost::system::error_code ec) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            result = ec;
+            done = true;
+            connected.notify_all();
+        });
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        BOOST_REQUIRE(connected.wait_for(lock, std::chrono::seconds(10), [&]() { return done; }));
+        BOOST_REQUIRE(!result);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_key_hash)
+{
+    StandInServer server(echoLast);
+    RedisShardedClient redis(4, 2);
+    Replies replies;
+    const size_t keys = 16;
+    const size_t count = 200;
+
+    BOOST_CHECK_EQUAL(redis.size(), 4u);
+
+    connect(redis, server);
+    BOOST_CHECK(redis.isConnected());
+
+    redis.setRouting(RedisShardedClient::Routing::KeyHash);
+
+    // the same key goes by the same connection
+    BOOST_CHECK(&redis.connectionForKey("key:1") == &redis.connectionForKey("key:1"));
+    BOOST_CHECK(&redis.route({"key:1", "value"}) == &redis.connectionForKey("key:1"));
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        for(size_t j = 0; j < keys; ++j)
+        {
+            std::string key = "key:" + std::to_string(j);
+
+            redis.command("APPEND", {key, std::to_string(i)}, [&replies, key](RedisValue value) {
+                replies.add(key, value.toString());
+            });
+        }
+    }
+
+    BOOST_REQUIRE(replies.wait(keys * count));
+
+    // replies of every key are in order
+    for(size_t j = 0; j < keys; ++j)
+    {
+        const std::vector<std::string> &values = replies.values["key:" + std::to_string(j)];
+
+        BOOST_REQUIRE_EQUAL(values.size(), count);
+
+        for(size_t i = 0; i < count; ++i)
+            BOOST_REQUIRE_EQUAL(values[i], std::to_string(i));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_least_loaded)
+{
+    StandInServer server(echoLast);
+    RedisShardedClient redis(3, 1, false);
+    Replies replies;
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    const size_t count = 3000;
+
+    connect(redis, server);
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        redis.command("ECHO", {std::to_string(i)}, [&](RedisValue value) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                threads.insert(std::this_thread::get_id());
+            }
+
+            replies.add("", value.toString());
+        });
+    }
+
+    BOOST_REQUIRE(replies.wait(count));
+
+    // handlers ran in the threads of all shards
+    BOOST_CHECK_EQUAL(threads.size(), 3u);
+
+    for(size_t i = 0; i < redis.size(); ++i)
+        BOOST_CHECK_EQUAL(redis.shard(i).queueDepth(0), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_route_from_threads)
+{
+    StandInServer server(echoLast);
+    RedisShardedClient redis(2, 2);
+    Replies replies;
+    std::vector<std::thread> producers;
+    const size_t threads = 4;
+    const size_t count = 500;
+
+    connect(redis, server);
+
+    // route reads the state of the connections while their shards run
+    for(size_t i = 0; i < threads; ++i)
+    {
+        producers.emplace_back([&redis, &replies, i, count]() {
+            std::string key = "thread:" + std::to_string(i);
+
+            for(size_t j = 0; j < count; ++j)
+            {
+                redis.command("ECHO", {std::to_string(j)}, [&replies, key](RedisValue value) {
+                    replies.add(key, value.toString());
+                });
+            }
+        });
+    }
+
+    for(std::thread &thread: producers)
+        thread.join();
+
+    BOOST_REQUIRE(replies.wait(threads * count));
+
+    for(size_t i = 0; i < threads; ++i)
+        BOOST_CHECK_EQUAL(replies.values["thread:" + std::to_string(i)].size(), count);
+}
+
+BOOST_AUTO_TEST_CASE(test_connection_dropped)
+{
+    StandInServer server(echoLast);
+    RedisShardedClient redis(2, 2, false);
+    Replies replies;
+    Replies errors;
+
+    redis.installErrorHandler([&errors](const std::string &error) {
+        errors.add("", error);
+    });
+    connect(redis, server);
+
+    redis.command("ECHO", {"before"}, [&replies](RedisValue value) {
+        replies.add("", value.toString());
+    });
+    BOOST_REQUIRE(replies.wait(1));
+
+    // every connection reports the error in the thread of its shard
+    server.dropConnections();
+    BOOST_REQUIRE(errors.wait(4));
+}
+
+BOOST_AUTO_TEST_CASE(test_connection_dropped_default_handler)
+{
+    std::unique_ptr<StandInServer> server(new StandInServer(echoLast));
+    std::unique_ptr<RedisShardedClient> redis(new RedisShardedClient(2, 1, false));
+    Replies replies;
+
+    connect(*redis, *server);
+
+    redis->command("ECHO", {"before"}, [&replies](RedisValue value) {
+        replies.add("", value.toString());
+    });
+    BOOST_REQUIRE(replies.wait(1));
+
+    // errors are ignored, they do not terminate the process
+    server->dropConnections();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // writes in progress are cancelled by the destructor
+    server.reset(new StandInServer(echoLast));
+    redis.reset(new RedisShardedClient(2, 1, false));
+    connect(*redis, *server);
+
+    for(int i = 0; i < 100; ++i)
+        redis->command("ECHO", {StandInServer::payload(64 * 1024)});
+
+    redis.reset();
+    BOOST_CHECK(!redis);
+}
@@ -0,0 +1,140 @@
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <redisclient/smallvector.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_SmallVector
+
+#include <boost/test/unit_test.hpp>
+
+using namespace redisclient;
+
+typedef SmallVector<std::string, 4> Strings;
+
+namespace
+{
+    std::string join(const Strings &items)
+    {
+        std::string result;
+
+        for(const std::string &item: items)
+        {
+            result += item;
+            result += ',';
+        }
+
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_inline)
+{
+    Strings items{"a", "b", "c"};
+
+    BOOST_CHECK_EQUAL(items.size(), 3);
+    BOOST_CHECK_EQUAL(items.capacity(), 4);
+    BOOST_CHECK_EQUAL(join(items), "a,b,c,");
+
+    items.push_back("d");
+    BOOST_CHECK_EQUAL(items.capacity(), 4);
+    BOOST_CHECK_EQUAL(join(items), "a,b,c,d,");
+}
+
+BOOST_AUTO_TEST_CASE(test_grow)
+{
+    Strings items;
+
+    for(int i = 0; i < 10; ++i)
+    {
+        items.emplace_back(std::to_string(i));
+    }
+
+    BOOST_CHECK_EQUAL(items.size(), 10);
+    BOOST_CHECK(items.capacity() >= 10);
+    BOOST_CHECK_EQUAL(join(items), "0,1,2,3,4,5,6,7,8,9,");
+
+    // the argument refers to an element which is moved on growth
+    Strings more{"x", "y", "z", "w"};
+
+    more.push_back(more[0]);
+    BOOST_CHECK_EQUAL(join(more), "x,y,z,w,x,");
+}
+
+BOOST_AUTO_TEST_CASE(test_push_front)
+{
+    Strings items{"b", "c"};
+
+    items.push_front("a");
+    BOOST_CHECK_EQUAL(join(items), "a,b,c,");
+
+    items.emplace_front(3, '0');
+    items.push_front("1");
+    BOOST_CHECK_EQUAL(join(items), "1,000,a,b,c,");
+
+    Strings empty;
+
+    empty.push_front("a");
+    BOOST_CHECK_EQUAL(join(empty), "a,");
+}
+
+BOOST_AUTO_TEST_CASE(test_copy_move)
+{
+    Strings small{"a", "b"};
+    Strings big{"a", "b", "c", "d", "e"};
+    const std::string *bigData = big.data();
+
+    Strings smallCopy(small);
+    Strings bigCopy = big;
+
+    BOOST_CHECK_EQUAL(join(smallCopy), "a,b,");
+    BOOST_CHECK_EQUAL(join(bigCopy), "a,b,c,d,e,");
+
+    Strings smallMoved(std::move(small));
+    Strings bigMoved(std::move(big));
+
+    BOOST_CHECK_EQUAL(join(smallMoved), "a,b,");
+    BOOST_CHECK(small.empty());
+    BOOST_CHECK_EQUAL(join(bigMoved), "a,b,c,d,e,");
+    BOOST_CHECK(bigMoved.data() == bigData);
+    BOOST_CHECK(big.empty());
+
+    smallMoved = std::move(bigMoved);
+    BOOST_CHECK_EQUAL(join(smallMoved), "a,b,c,d,e,");
+
+    bigCopy = smallCopy;
+    BOOST_CHECK_EQUAL(join(bigCopy), "a,b,");
+}
+
+BOOST_AUTO_TEST_CASE(test_from_deque)
+{
+    std::deque<std::string> items{"a", "b", "c", "d", "e"};
+
+    Strings copy(items);
+    BOOST_CHECK_EQUAL(join(copy), "a,b,c,d,e,");
+
+    Strings moved(std::move(items));
+    BOOST_CHECK_EQUAL(join(moved), "a,b,c,d,e,");
+}
+
+BOOST_AUTO_TEST_CASE(test_destroy)
+{
+    std::shared_ptr<int> counter = std::make_shared<int>(0);
+
+    {
+        SmallVector<std::shared_ptr<int>, 2> items;
+
+        for(int i = 0; i < 5; ++i)
+        {
+            items.push_back(counter);
+        }
+
+        BOOST_CHECK_EQUAL(counter.use_count(), 6);
+
+        items.pop_back();
+        BOOST_CHECK_EQUAL(counter.use_count(), 5);
+    }
+
+    BOOST_CHECK_EQUAL(counter.use_count(), 1);
+}
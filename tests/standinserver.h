@@ -0,0 +1,214 @@
+#ifndef REDISCLIENT_TESTS_STANDINSERVER_H
+#define REDISCLIENT_TESTS_STANDINSERVER_H
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/redisparser.h>
+#include <redisclient/redisvalue.h>
+
+// Stand-in for a redis server on the loopback interface, in its own
+// thread. Commands are parsed and answered by the handler, which returns
+// the encoded reply, or an empty string to not reply. The handler may
+// take the number of the connection, in the order they are accepted.
+// Replies to the commands of one read are written together, except that
+// the handler may sleep to delay its reply, which is then written right
+// away.
+class StandInServer
+{
+public:
+    typedef std::function<std::string(const std::vector<std::string> &command)> Handler;
+    typedef std::function<std::string(size_t connection,
+            const std::vector<std::string> &command)> ConnectionHandler;
+
+    explicit StandInServer(Handler handler)
+        : StandInServer(ConnectionHandler(
+                    [handler](size_t, const std::vector<std::string> &command) {
+                        return handler(command);
+                    }))
+    {
+    }
+
+    explicit StandInServer(ConnectionHandler handler)
+        : acceptor(ioService, boost::asio::ip::tcp::endpoint(
+                    boost::asio::ip::address::from_string("127.0.0.1"), 0)),
+        handler(std::move(handler)), accepted(0)
+    {
+        accept();
+        thread = std::thread([this]() { ioService.run(); });
+    }
+
+    ~StandInServer()
+    {
+        ioService.stop();
+        thread.join();
+    }
+
+    boost::asio::ip::tcp::endpoint endpoint() const
+    {
+        return acceptor.local_endpoint();
+    }
+
+    // Close all connections accepted so far, from any thread.
+    void dropConnections()
+    {
+        ioService.post([this]() {
+            boost::system::error_code ignored;
+
+            for(const std::shared_ptr<Connection> &connection: connections)
+                connection->socket.close(ignored);
+
+            connections.clear();
+        });
+    }
+
+    static std::string status(const std::string &s)
+    {
+        return "+" + s + "\r\n";
+    }
+
+    static std::string error(const std::string &s)
+    {
+        return "-" + s + "\r\n";
+    }
+
+    static std::string integer(long long value)
+    {
+        return ":" + std::to_string(value) + "\r\n";
+    }
+
+    static std::string bulk(const std::string &s)
+    {
+        return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n";
+    }
+
+    static std::string nullBulk()
+    {
+        return "$-1\r\n";
+    }
+
+    // Data of the size, the same for the same size.
+    static std::string payload(size_t size)
+    {
+        std::string result(size, '\0');
+
+        for(size_t i = 0; i < size; ++i)
+            result[i] = static_cast<char>('a' + i % 23);
+
+        return result;
+    }
+
+    static std::string array(const std::vector<std::string> &encoded)
+    {
+        std::string result = "*" + std::to_string(encoded.size()) + "\r\n";
+
+        for(const std::string &item: encoded)
+            result += item;
+
+        return result;
+    }
+
+private:
+    struct Connection
+    {
+        Connection(boost::asio::io_service &ioService)
+            : socket(ioService), number(0)
+        {
+        }
+
+        boost::asio::ip::tcp::socket socket;
+        size_t number;
+        redisclient::RedisParser parser;
+        char buffer[16 * 1024];
+    };
+
+    void accept()
+    {
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>(ioService);
+
+        acceptor.async_accept(connection->socket, [this, connection](boost::system::error_code ec) {
+            if( !ec )
+            {
+                // replies of a pipeline are written in several writes
+                boost::system::error_code ignored;
+
+                connection->socket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+                connection->number = accepted++;
+                connections.push_back(connection);
+                read(connection);
+                accept();
+            }
+        });
+    }
+
+    void read(std::shared_ptr<Connection> connection)
+    {
+        connection->socket.async_read_some(boost::asio::buffer(connection->buffer),
+                [this, connection](boost::system::error_code ec, size_t size) {
+            if( ec )
+                return;
+
+            std::string replies;
+
+            for(size_t pos = 0; pos < size;)
+            {
+                std::pair<size_t, redisclient::RedisParser::ParseResult> result =
+                    connection->parser.parse(connection->buffer + pos, size - pos);
+
+                pos += result.first;
+
+                if( result.second == redisclient::RedisParser::Completed )
+                {
+                    redisclient::RedisValue value = connection->parser.result();
+                    std::vector<std::string> command;
+
+                    for(const redisclient::RedisValue &item: value.getArray())
+                        command.push_back(item.toString());
+
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                    replies += handler(connection->number, command);
+
+                    // the reply of a slow handler is not held back by the
+                    // next ones
+                    if( std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(1) &&
+                            !write(connection, replies) )
+                        return;
+                }
+                else if( result.second == redisclient::RedisParser::Error )
+                {
+                    return;
+                }
+            }
+
+            if( write(connection, replies) )
+                read(connection);
+        });
+    }
+
+    bool write(const std::shared_ptr<Connection> &connection, std::string &replies)
+    {
+        boost::system::error_code ec;
+
+        boost::asio::write(connection->socket, boost::asio::buffer(replies), ec);
+        replies.clear();
+        return !ec;
+    }
+
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor;
+    ConnectionHandler handler;
+    size_t accepted;
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::thread thread;
+};
+
+#endif // REDISCLIENT_TESTS_STANDINSERVER_H
@@ -0,0 +1,164 @@
+#include <boost/asio/ip/tcp.hpp>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/impl/redisclientimpl.h>
+#include <redisclient/impl/submissionqueue.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_SubmissionQueue
+
+#include <boost/test/unit_test.hpp>
+
+using namespace redisclient;
+
+namespace
+{
+    struct Node
+    {
+        Node *next;
+        int producer;
+        int value;
+    };
+
+    typedef detail::SubmissionQueue<Node> Queue;
+
+    // Take all nodes, return their count.
+    size_t drain(Queue &queue, std::vector<std::vector<int>> &values)
+    {
+        size_t count = 0;
+        Node *node = queue.takeAll();
+
+        while( node )
+        {
+            Node *next = node->next;
+
+            values[node->producer].push_back(node->value);
+            delete node;
+            node = next;
+            ++count;
+        }
+
+        return count;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fifo)
+{
+    Queue queue;
+    std::vector<std::vector<int>> values(1);
+
+    BOOST_CHECK(queue.takeAll() == nullptr);
+    BOOST_CHECK(queue.push(new Node{nullptr, 0, 1}) == true);
+    BOOST_CHECK(queue.push(new Node{nullptr, 0, 2}) == false);
+    BOOST_CHECK(queue.push(new Node{nullptr, 0, 3}) == false);
+
+    BOOST_CHECK_EQUAL(drain(queue, values), 3u);
+    BOOST_CHECK(values[0] == std::vector<int>({1, 2, 3}));
+
+    // empty again
+    BOOST_CHECK(queue.push(new Node{nullptr, 0, 4}) == true);
+}
+
+BOOST_AUTO_TEST_CASE(test_destructor)
+{
+    Queue queue;
+
+    // freed by the queue
+    queue.push(new Node{nullptr, 0, 1});
+    queue.push(new Node{nullptr, 0, 2});
+}
+
+BOOST_AUTO_TEST_CASE(test_node_cache)
+{
+    Queue returned;
+    detail::NodeCache<Node> cache;
+    Node *a = new Node{nullptr, 0, 1};
+    Node *b = new Node{nullptr, 0, 2};
+
+    BOOST_CHECK(cache.pop(returned) == nullptr);
+
+    // returned at once, taken back one by one
+    a->next = b;
+    returned.pushAll(a, b);
+
+    Node *first = cache.pop(returned);
+
+    BOOST_CHECK(first == a || first == b);
+    BOOST_CHECK(returned.takeAll() == nullptr);
+
+    // freed by the queue and the cache
+    returned.push(first);
+}
+
+BOOST_AUTO_TEST_CASE(test_producers)
+{
+    const int producers = 8;
+    const int count = 20000;
+
+    Queue queue;
+    std::vector<std::vector<int>> values(producers);
+    std::vector<std::thread> threads;
+    size_t taken = 0;
+
+    for(int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&queue, i, count]() {
+            for(int j = 0; j < count; ++j)
+                queue.push(new Node{nullptr, i, j});
+        });
+    }
+
+    while( taken < static_cast<size_t>(producers * count) )
+        taken += drain(queue, values);
+
+    for(std::thread &thread: threads)
+        thread.join();
+
+    // the order of every producer is kept
+    for(int i = 0; i < producers; ++i)
+    {
+        BOOST_REQUIRE_EQUAL(values[i].size(), static_cast<size_t>(count));
+
+        for(int j = 0; j < count; ++j)
+            BOOST_REQUIRE_EQUAL(values[i][j], j);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_drain_one_write)
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService, boost::asio::ip::tcp::endpoint(
+                boost::asio::ip::address::from_string("127.0.0.1"), 0));
+    boost::asio::ip::tcp::socket peer(ioService);
+    std::shared_ptr<RedisClientImpl> impl = std::make_shared<RedisClientImpl>(ioService);
+    std::vector<char> expected;
+    const size_t count = 16;
+
+    impl->socket.connect(acceptor.local_endpoint());
+    acceptor.accept(peer);
+    impl->state = RedisClientImpl::State::Connected;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        RedisArguments command = {"GET", "key:" + std::to_string(i)};
+
+        detail::appendCommand(expected, command);
+        impl->submit(command, std::function<void(RedisValue)>([](RedisValue) {}));
+    }
+
+    impl->drainSubmissions();
+
+    // all commands are written by the first write, nothing waits for it
+    BOOST_CHECK(impl->writeInProgress);
+    BOOST_CHECK(impl->outputWrited.data == expected);
+    BOOST_CHECK(impl->outputQueued.data.empty());
+    BOOST_CHECK(impl->dataQueued.empty());
+    BOOST_CHECK_EQUAL(impl->handlers.size(), count);
+
+    ioService.poll();
+    impl->close();
+}
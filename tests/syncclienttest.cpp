@@ -0,0 +1,287 @@
+#include <chrono>
+#include <climits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <redisclient/pipeline.h>
+#include <redisclient/redissyncclient.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE test_SyncClient
+
+#include <boost/test/unit_test.hpp>
+
+#include "standinserver.h"
+
+using namespace redisclient;
+
+namespace
+{
+    // GET replies with a payload of the size of the last argument or a
+    // null, PUSH also with one more reply, SLOW after the number of
+    // milliseconds of the last argument, NOREPLY does not reply, ERR
+    // replies with an error, anything else with the last argument.
+    std::string reply(const std::vector<std::string> &command)
+    {
+        if( command.front() == "PUSH" )
+        {
+            return StandInServer::bulk(StandInServer::payload(std::stoul(command.back()))) +
+                StandInServer::status("PUSHED");
+        }
+        else if( command.front() == "SLOW" )
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::stoi(command.back())));
+            return StandInServer::status("SLOW");
+        }
+        else if( command.front() == "NOREPLY" )
+        {
+            return std::string();
+        }
+        else if( command.front() == "GET" )
+        {
+            if( command.back() == "nil" )
+                return StandInServer::nullBulk();
+
+            return StandInServer::bulk(StandInServer::payload(std::stoul(command.back())));
+        }
+        else if( command.front() == "ERR" )
+        {
+            return StandInServer::error("ERR " + command.back());
+        }
+
+        return StandInServer::bulk(command.back());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_command_to_sink)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    const size_t size = 3 * 1024 * 1024 + 7;
+    std::string received;
+    size_t chunks = 0;
+
+    redis.connect(server.endpoint());
+
+    RedisValue result = redis.commandToSink("GET", {std::to_string(size)},
+        [&](const char *data, size_t dataSize) {
+            received.append(data, dataSize);
+            ++chunks;
+        });
+
+    BOOST_CHECK(result.isString());
+    BOOST_CHECK(result.toString().empty());
+
+    // split across several reads
+    BOOST_CHECK_GT(chunks, 1u);
+    BOOST_CHECK(received == StandInServer::payload(size));
+
+    // not sunk
+    BOOST_CHECK_EQUAL(redis.command("GET", {"5"}).toString(), StandInServer::payload(5));
+}
+
+BOOST_AUTO_TEST_CASE(test_command_to_sink_not_bulk)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    size_t chunks = 0;
+    auto sink = [&](const char *, size_t) { ++chunks; };
+
+    redis.connect(server.endpoint());
+
+    BOOST_CHECK(redis.commandToSink("GET", {"nil"}, sink).isNull());
+
+    RedisValue error = redis.commandToSink("ERR", {"no such key"}, sink);
+
+    BOOST_CHECK(error.isError());
+    BOOST_CHECK_EQUAL(error.toString(), "ERR no such key");
+    BOOST_CHECK_EQUAL(chunks, 0u);
+
+    BOOST_CHECK_EQUAL(redis.command("GET", {"3"}).toString(), StandInServer::payload(3));
+}
+
+BOOST_AUTO_TEST_CASE(test_reply_available)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    // encoded to exactly two reads of 4 KiB
+    const size_t size = 2 * 4096 - 8;
+
+    redis.setMaxReadBufferSize(4096);
+    redis.connect(server.endpoint());
+
+    BOOST_CHECK_EQUAL(redis.command("PUSH", {std::to_string(size)}).toString(),
+            StandInServer::payload(size));
+
+    // the pushed reply is in the socket already, so it is read by the
+    // first non-blocking recv, before the time left is checked
+    redis.setCommandTimeout(boost::posix_time::milliseconds(0));
+
+    boost::system::error_code ec;
+    RedisValue result = redis.command("NOREPLY", {}, ec);
+
+    BOOST_REQUIRE(!ec);
+    BOOST_CHECK_EQUAL(result.toString(), "PUSHED");
+}
+
+BOOST_AUTO_TEST_CASE(test_reply_late)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+
+    redis.setCommandTimeout(boost::posix_time::seconds(5));
+    redis.connect(server.endpoint());
+
+    auto start = std::chrono::steady_clock::now();
+
+    BOOST_CHECK_EQUAL(redis.command("SLOW", {"100"}).toString(), "SLOW");
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+
+    BOOST_CHECK_EQUAL(redis.command("ECHO", {"next"}).toString(), "next");
+}
+
+BOOST_AUTO_TEST_CASE(test_reply_timeout)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    boost::system::error_code ec;
+
+    redis.setCommandTimeout(boost::posix_time::milliseconds(50));
+    redis.connect(server.endpoint());
+
+    auto start = std::chrono::steady_clock::now();
+
+    redis.command("SLOW", {"500"}, ec);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    BOOST_CHECK(ec == boost::asio::error::timed_out);
+    BOOST_CHECK(elapsed >= std::chrono::milliseconds(50));
+    BOOST_CHECK(elapsed < std::chrono::milliseconds(500));
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline_deadline)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    boost::system::error_code ec;
+
+    redis.setCommandTimeout(boost::posix_time::milliseconds(250));
+    redis.connect(server.endpoint());
+
+    // every reply comes 100 ms after the previous one, well within the
+    // timeout, but the whole pipeline takes 400 ms
+    Pipeline pipeline = redis.pipelined();
+
+    for(int i = 0; i < 4; ++i)
+        pipeline.command("SLOW", {"100"});
+
+    auto start = std::chrono::steady_clock::now();
+
+    pipeline.finish(ec);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    BOOST_CHECK(ec == boost::asio::error::timed_out);
+    BOOST_CHECK(elapsed >= std::chrono::milliseconds(250));
+    BOOST_CHECK(elapsed < std::chrono::milliseconds(400));
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline_in_time)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+
+    redis.setCommandTimeout(boost::posix_time::seconds(5));
+    redis.connect(server.endpoint());
+
+    Pipeline pipeline = redis.pipelined();
+
+    for(int i = 0; i < 4; ++i)
+        pipeline.command("SLOW", {"20"});
+
+    RedisValue result = pipeline.finish();
+
+    BOOST_REQUIRE(result.isArray());
+    BOOST_REQUIRE_EQUAL(result.getArray().size(), 4u);
+
+    for(const RedisValue &value: result.getArray())
+        BOOST_CHECK_EQUAL(value.toString(), "SLOW");
+}
+
+BOOST_AUTO_TEST_CASE(test_gather_write)
+{
+    std::mutex mutex;
+    std::vector<std::string> received;
+    StandInServer server([&](const std::vector<std::string> &command) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        received = command;
+        return StandInServer::integer(command.size() - 2);
+    });
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    // more big arguments than sendmsg takes at once, 20 MiB in total
+    const size_t count = IOV_MAX + 200;
+    RedisArguments args;
+    std::vector<std::string> expected = {"RPUSH", "list"};
+
+    args.push_back("list");
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        std::string value = std::to_string(i) + StandInServer::payload(16 * 1024 + i);
+
+        expected.push_back(value);
+        args.push_back(std::move(value));
+    }
+
+    redis.connect(server.endpoint());
+
+    BOOST_CHECK_EQUAL(redis.command("RPUSH", std::move(args)).toInt(), static_cast<int64_t>(count));
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    BOOST_REQUIRE_EQUAL(received.size(), expected.size());
+    BOOST_CHECK(received == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_pipeline_bigger_than_socket_buffers)
+{
+    StandInServer server(reply);
+    boost::asio::io_service ioService;
+    RedisSyncClient redis(ioService);
+    boost::system::error_code ec;
+    // 32 MiB of commands and of replies, so the server blocks writing
+    // replies long before the whole pipeline is written
+    const size_t count = 2000;
+    std::vector<std::string> values;
+    Pipeline pipeline = redis.pipelined();
+
+    redis.setCommandTimeout(boost::posix_time::seconds(20));
+    redis.connect(server.endpoint());
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        values.push_back(std::to_string(i) + StandInServer::payload(16 * 1024));
+        pipeline.command("ECHO", {values.back()});
+    }
+
+    RedisValue result = pipeline.finish(ec);
+
+    BOOST_REQUIRE(!ec);
+    BOOST_REQUIRE(result.isArray());
+    BOOST_REQUIRE_EQUAL(result.getArray().size(), count);
+
+    for(size_t i = 0; i < count; ++i)
+        BOOST_REQUIRE(result.getArray()[i].toString() == values[i]);
+}